@@ -102,6 +102,12 @@
 // Default: 1000 (one second)
 #define DATABASE_BUSY_TIMEOUT 1000
 
+// Minimum delay between two scheduled WAL checkpoints [seconds]
+// This prevents retrying checkpoints too often when they cannot complete
+// because of long-running readers (e.g., the web interface)
+// Default: 10
+#define DATABASE_CHECKPOINT_DELAY 10
+
 // After how many seconds do we check again if a client can be identified by other means?
 // (e.g., interface, MAC address, hostname)
 // Default: 60 (after one minutee)
@@ -38,8 +38,22 @@
 #include "../regex_r.h"
 // get_aliasclient_list()
 #include "../database/aliasclients.h"
+// get_wal_stats()
+#include "../database/wal.h"
+// get_sql_profile()
+#include "../database/sqlite3-profile.h"
 // get_edestr()
 #include "api_helper.h"
+// get_upstream_scores()
+#include "../upstream_score.h"
+// get_tcp_pool_stats()
+#include "../tcp_pool.h"
+// get_slow_queries()
+#include "../flight.h"
+// dict_requested(), dict_id()
+#include "dictionary.h"
+// arena_alloc()
+#include "../arena.h"
 // RTF_UP, RTF_GATEWAY
 #include <linux/route.h>
 
@@ -295,7 +309,7 @@ void getTopDomains(const char *client_message, const int sock, const bool isteln
 		// Skip this domain if already audited
 		if(audit && in_auditlist(getstr(domain->domainpos)) == FOUND)
 		{
-			if(config.debug & DEBUG_API)
+			if(debug_enabled(DEBUG_API))
 				logg("API: %s has been audited.", getstr(domain->domainpos));
 			continue;
 		}
@@ -863,6 +877,23 @@ void getAllQueries(const char *client_message, const int sock, const bool isteln
 			ibeg = 0;
 	}
 
+	// Dictionary-encoded rows?
+	// example: >getallqueries (100) dict=1672531200:5000
+	// Rows are sent as one binary blob, strings are replaced by their index
+	// in the dictionary (see dictionary.c)
+	// Once the client asked for this format, we must not fall back to the
+	// plain one when the dictionary cannot be built
+	unsigned char *rows = NULL;
+	unsigned int nrows = 0;
+	bool dict = false, dict_failed = false;
+	if(!istelnet && dict_requested(client_message) != NULL)
+	{
+		dict = true;
+		dict_begin(client_message);
+		rows = arena_alloc((size_t)(counters->queries - ibeg + 1)*DICT_ROW_SIZE);
+		dict_failed = rows == NULL;
+	}
+
 	// Get potentially existing filtering flags
 	char * filter = read_setupVarsconf("API_QUERY_LOG_SHOW");
 	if(filter != NULL)
@@ -879,7 +910,7 @@ void getAllQueries(const char *client_message, const int sock, const bool isteln
 	}
 	clearSetupVarsArray();
 
-	for(int queryID = ibeg; queryID < counters->queries; queryID++)
+	for(int queryID = ibeg; queryID < counters->queries && !dict_failed; queryID++)
 	{
 		const queriesData* query = getQuery(queryID, true);
 		// Check if this query has been create while in maximum privacy mode
@@ -1069,10 +1100,36 @@ void getAllQueries(const char *client_message, const int sock, const bool isteln
 				upstream_port,
 				query->ede == -1 ? "" : get_edestr(query->ede));
 
-			if(config.debug & DEBUG_API)
+			if(debug_enabled(DEBUG_API))
 				ssend(sock, " \"%i\"", queryID);
 			ssend(sock, "\n");
 		}
+		else if(dict)
+		{
+			const uint32_t qtype_id = dict_id(qtype);
+			const uint32_t domain_id = dict_id(domain);
+			const uint32_t client_id = dict_id(clientIPName);
+			if(qtype_id == DICT_INVALID_ID || domain_id == DICT_INVALID_ID ||
+			   client_id == DICT_INVALID_ID)
+			{
+				dict_failed = true;
+				break;
+			}
+
+			// Fixed-width row (big-endian)
+			unsigned char *row = rows + (size_t)nrows++*DICT_ROW_SIZE;
+			const uint32_t fields[4] = {
+				htonl((uint32_t)query->timestamp),
+				htonl(qtype_id),
+				htonl(domain_id),
+				htonl(client_id)
+			};
+			memcpy(row, fields, sizeof(fields));
+			row[16] = query->status;
+			row[17] = query->dnssec;
+			row[18] = 0u;
+			row[19] = 0u;
+		}
 		else
 		{
 			pack_int32(sock, (int32_t)query->timestamp);
@@ -1090,6 +1147,20 @@ void getAllQueries(const char *client_message, const int sock, const bool isteln
 		}
 	}
 
+	// Send dictionary entries unknown to the client followed by the rows. On
+	// failure, the client gets an error string instead of the generation
+	if(dict_failed)
+	{
+		logg("API error: Cannot build dictionary-encoded response for >getallqueries: Out of memory");
+		pack_str32(sock, "ERROR: Out of memory");
+	}
+	else if(dict)
+	{
+		dict_send(sock);
+		pack_uint32(sock, nrows);
+		pack_bin32(sock, rows, (size_t)nrows*DICT_ROW_SIZE);
+	}
+
 	// Free allocated memory
 	if(filterclientname)
 		free(clientname);
@@ -1216,6 +1287,297 @@ void getDBstats(const int sock, const bool istelnet)
 	}
 }
 
+void getWALstats(const int sock, const bool istelnet)
+{
+	struct wal_stats wal;
+	get_wal_stats(&wal);
+
+	const unsigned int checkpoints = wal.checkpoints[CHECKPOINT_PASSIVE] +
+	                                 wal.checkpoints[CHECKPOINT_RESTART] +
+	                                 wal.checkpoints[CHECKPOINT_TRUNCATE];
+	const double avg_msec = checkpoints > 0 ? wal.total_msec / checkpoints : 0.0;
+
+	if(istelnet)
+	{
+		ssend(sock, "wal-enabled: %s\nwal-size: %llu\nwal-size-max: %llu\n",
+		            config.DBwal ? "yes" : "no", wal.size, wal.max_size);
+		ssend(sock, "checkpoints-passive: %u\ncheckpoints-restart: %u\ncheckpoints-truncate: %u\ncheckpoints-busy: %u\n",
+		            wal.checkpoints[CHECKPOINT_PASSIVE], wal.checkpoints[CHECKPOINT_RESTART],
+		            wal.checkpoints[CHECKPOINT_TRUNCATE], wal.busy);
+		ssend(sock, "checkpoint-last-ms: %.3f\ncheckpoint-avg-ms: %.3f\ncheckpoint-max-ms: %.3f\n",
+		            wal.last_msec, avg_msec, wal.max_msec);
+		ssend(sock, "checkpoint-frames: %i/%i\nlast-checkpoint: %lli\nlast-full-checkpoint: %lli\n",
+		            wal.frames_ckpt, wal.frames_log, (long long)wal.last, (long long)wal.last_full);
+	}
+	else
+	{
+		pack_bool(sock, config.DBwal);
+		pack_uint64(sock, wal.size);
+		pack_uint64(sock, wal.max_size);
+		pack_int32(sock, wal.checkpoints[CHECKPOINT_PASSIVE]);
+		pack_int32(sock, wal.checkpoints[CHECKPOINT_RESTART]);
+		pack_int32(sock, wal.checkpoints[CHECKPOINT_TRUNCATE]);
+		pack_int32(sock, wal.busy);
+		pack_float(sock, wal.last_msec);
+		pack_float(sock, avg_msec);
+		pack_float(sock, wal.max_msec);
+		pack_int64(sock, wal.last);
+		pack_int64(sock, wal.last_full);
+	}
+}
+
+void getSQLprofile(const char *client_message, const int sock, const bool istelnet)
+{
+	// Reset collected statistics
+	// example: >dbprofile reset
+	if(strstr(client_message, " reset") != NULL)
+	{
+		reset_sql_profile();
+		return;
+	}
+
+	// Number of statements to show
+	// example: >dbprofile (50)
+	int num = 20;
+	if(sscanf(client_message, "%*[^(](%i)", &num) > 0 && (num < 1 || num > PROFILE_SLOTS))
+		num = 20;
+
+	struct sql_profile *profile = calloc(num, sizeof(struct sql_profile));
+	if(profile == NULL)
+		return;
+
+	unsigned int dropped = 0;
+	const unsigned int n = get_sql_profile(profile, num, &dropped);
+
+	if(istelnet)
+		ssend(sock, "---- profiling %s, %u statements not tracked\n",
+		      config.DBprofile ? "enabled" : "disabled", dropped);
+	else
+	{
+		pack_bool(sock, config.DBprofile);
+		pack_int32(sock, dropped);
+		pack_int32(sock, n);
+	}
+
+	for(unsigned int i = 0; i < n; i++)
+	{
+		const char *sql = profile[i].sql != NULL ? profile[i].sql : "";
+		const double avg_ms = profile[i].count > 0 ? 1e-6*profile[i].total_ns / profile[i].count : 0.0;
+		if(istelnet)
+			ssend(sock, "%u %.3f %.3f %.3f %llu %s\n", profile[i].count,
+			      1e-6*profile[i].total_ns, avg_ms, 1e-6*profile[i].max_ns,
+			      profile[i].rows, sql);
+		else
+		{
+			pack_int32(sock, profile[i].count);
+			pack_float(sock, 1e-6*profile[i].total_ns);
+			pack_float(sock, 1e-6*profile[i].max_ns);
+			pack_uint64(sock, profile[i].rows);
+			pack_str32(sock, sql);
+		}
+
+		if(profile[i].sql != NULL)
+			free(profile[i].sql);
+	}
+
+	free(profile);
+}
+
+void getAllocProfile(const char *client_message, const int sock, const bool istelnet)
+{
+	// Number of call sites to show
+	// example: >allocprofile (50)
+	int num = 20;
+	if(sscanf(client_message, "%*[^(](%i)", &num) > 0 && (num < 1 || num > 1024))
+		num = 20;
+
+	struct alloc_stat *stats = calloc(num, sizeof(struct alloc_stat));
+	if(stats == NULL)
+		return;
+
+	struct alloc_summary summary;
+	const unsigned int n = get_alloc_profile(stats, num, &summary);
+
+	if(istelnet)
+		ssend(sock, "---- profiling %s, %lld bytes live, %lld bytes peak, %u call sites, %llu allocations not tracked\n",
+		      summary.enabled ? "enabled" : "disabled", summary.live, summary.peak,
+		      summary.sites, summary.untracked);
+	else
+	{
+		pack_bool(sock, summary.enabled);
+		pack_int64(sock, summary.live);
+		pack_int64(sock, summary.peak);
+		pack_uint64(sock, summary.untracked);
+		pack_int32(sock, n);
+	}
+
+	for(unsigned int i = 0; i < n; i++)
+	{
+		if(istelnet)
+			ssend(sock, "%lld %lld %llu %llu %llu %s:%i %s\n", stats[i].live,
+			      stats[i].peak, stats[i].allocs, stats[i].frees, stats[i].total,
+			      stats[i].file, stats[i].line, stats[i].func);
+		else
+		{
+			pack_int64(sock, stats[i].live);
+			pack_int64(sock, stats[i].peak);
+			pack_uint64(sock, stats[i].allocs);
+			pack_uint64(sock, stats[i].frees);
+			pack_uint64(sock, stats[i].total);
+			pack_str32(sock, stats[i].file);
+			pack_int32(sock, stats[i].line);
+			pack_str32(sock, stats[i].func);
+		}
+	}
+
+	free(stats);
+}
+
+void getUpstreamScores(const int sock, const bool istelnet)
+{
+	struct upstream_score_info *scores = calloc(SCORE_MAX_UPSTREAMS, sizeof(struct upstream_score_info));
+	if(scores == NULL)
+		return;
+
+	const unsigned int n = get_upstream_scores(scores, SCORE_MAX_UPSTREAMS);
+
+	if(istelnet)
+		ssend(sock, "---- scoring %s, probing %u%%, %u upstreams\n",
+		      config.upstream_scoring ? "enabled" : "disabled", config.upstream_probe, n);
+	else
+	{
+		pack_bool(sock, config.upstream_scoring);
+		pack_int32(sock, config.upstream_probe);
+		pack_int32(sock, n);
+	}
+
+	for(unsigned int i = 0; i < n; i++)
+	{
+		if(!istelnet)
+		{
+			pack_str32(sock, scores[i].ip);
+			pack_int32(sock, scores[i].port);
+			pack_bool(sock, scores[i].healthy);
+			pack_float(sock, scores[i].failure);
+			pack_uint64(sock, scores[i].selected);
+		}
+
+		for(unsigned int c = 0; c < SCORE_CLASS_MAX; c++)
+		{
+			if(istelnet)
+				ssend(sock, "%s#%u %s %lu %.1f %.0f %.0f %.3f %lu %s\n",
+				      scores[i].ip, scores[i].port, score_class_name(c),
+				      scores[i].class[c].samples, scores[i].class[c].ewma,
+				      scores[i].class[c].p50, scores[i].class[c].p95,
+				      scores[i].failure, scores[i].selected,
+				      scores[i].healthy ? "healthy" : "unhealthy");
+			else
+			{
+				pack_uint64(sock, scores[i].class[c].samples);
+				pack_float(sock, scores[i].class[c].ewma);
+				pack_float(sock, scores[i].class[c].p50);
+				pack_float(sock, scores[i].class[c].p95);
+			}
+		}
+	}
+
+	free(scores);
+}
+
+void getTCPpool(const int sock, const bool istelnet)
+{
+	struct tcp_pool_info *stats = calloc(TCP_POOL_MAX_UPSTREAMS, sizeof(struct tcp_pool_info));
+	if(stats == NULL)
+		return;
+
+	const unsigned int n = get_tcp_pool_stats(stats, TCP_POOL_MAX_UPSTREAMS);
+
+	if(istelnet)
+		ssend(sock, "---- pooling %s, idle timeout %us, %u upstreams\n",
+		      config.tcp_pool ? "enabled" : "disabled", config.tcp_pool_idle, n);
+	else
+	{
+		pack_bool(sock, config.tcp_pool);
+		pack_int32(sock, config.tcp_pool_idle);
+		pack_int32(sock, n);
+	}
+
+	for(unsigned int i = 0; i < n; i++)
+	{
+		if(istelnet)
+			ssend(sock, "%s#%u %u %u %lu %lu %lu %lu %lu %s\n",
+			      stats[i].ip, stats[i].port, stats[i].connections,
+			      stats[i].inflight, stats[i].queries, stats[i].reused,
+			      stats[i].connects, stats[i].failures, stats[i].timeouts,
+			      stats[i].down ? "down" : "up");
+		else
+		{
+			pack_str32(sock, stats[i].ip);
+			pack_int32(sock, stats[i].port);
+			pack_bool(sock, stats[i].down);
+			pack_int32(sock, stats[i].connections);
+			pack_int32(sock, stats[i].inflight);
+			pack_uint64(sock, stats[i].queries);
+			pack_uint64(sock, stats[i].reused);
+			pack_uint64(sock, stats[i].connects);
+			pack_uint64(sock, stats[i].failures);
+			pack_uint64(sock, stats[i].timeouts);
+		}
+	}
+
+	free(stats);
+}
+
+void getSlowQueries(const int sock, const bool istelnet)
+{
+	struct slow_query *slow = calloc(FLIGHT_SLOW_KEEP, sizeof(struct slow_query));
+	if(slow == NULL)
+		return;
+
+	const unsigned int n = get_slow_queries(slow, FLIGHT_SLOW_KEEP);
+
+	if(istelnet)
+		ssend(sock, "---- recording %s, threshold %u ms, %u queries\n",
+		      config.slow_query_ms > 0 ? "enabled" : "disabled", config.slow_query_ms, n);
+	else
+	{
+		pack_bool(sock, config.slow_query_ms > 0);
+		pack_int32(sock, config.slow_query_ms);
+		pack_int32(sock, n);
+	}
+
+	for(unsigned int i = 0; i < n; i++)
+	{
+		if(istelnet)
+		{
+			char line[1024];
+			format_slow_query(line, sizeof(line), &slow[i]);
+			ssend(sock, "%s\n", line);
+		}
+		else
+		{
+			pack_int64(sock, slow[i].timestamp);
+			pack_int32(sock, slow[i].queryID);
+			pack_str32(sock, slow[i].type);
+			pack_str32(sock, slow[i].domain);
+			pack_str32(sock, slow[i].client);
+			pack_str32(sock, slow[i].status);
+			pack_str32(sock, slow[i].reply);
+			pack_str32(sock, slow[i].upstream);
+			pack_int32(sock, slow[i].port);
+			pack_int32(sock, slow[i].retries);
+			// Time of each stage after the query arrived [ms], -1 = not reached
+			for(unsigned int k = 0; k < FLIGHT_STAGES; k++)
+				pack_float(sock, slow[i].stage[k] == FLIGHT_NONE ? -1.0f : 1e-3f*slow[i].stage[k]);
+			// Time until the reply was sent or, without reply, until
+			// the query was recorded [ms]
+			pack_float(sock, 1e-3f*slow[i].elapsed);
+		}
+	}
+
+	free(slow);
+}
+
 void getClientsOverTime(const int sock, const bool istelnet)
 {
 	// Exit before processing any data if requested via config setting
@@ -1425,7 +1787,7 @@ void delete_lease(const char *client_message, const int sock)
 	}
 	ipaddr[sizeof(ipaddr) - 1] = '\0';
 
-	if(config.debug & DEBUG_API)
+	if(debug_enabled(DEBUG_API))
 		logg("Received request to delete lease for %s", ipaddr);
 
 	if(FTL_unlink_DHCP_lease(ipaddr))
@@ -1433,7 +1795,7 @@ void delete_lease(const char *client_message, const int sock)
 	else
 		ssend(sock, "ERROR: Specified IP address invalid!\n");
 
-	if(config.debug & DEBUG_API)
+	if(debug_enabled(DEBUG_API))
 		logg("...done");
 }
 
@@ -1483,7 +1845,7 @@ static bool getDefaultInterface(char iface[IF_NAMESIZE], in_addr_t *gw)
 				*gw = gw_r;
 				strcpy(iface, iface_r);
 
-				if(config.debug & DEBUG_API)
+				if(debug_enabled(DEBUG_API))
 					logg("Reading interfaces: flags: %i, addr: %s, iface: %s, metric: %i, minmetric: %i",
 					     flags, inet_ntoa(*(struct in_addr *) gw), iface, metric, minmetric);
 			}
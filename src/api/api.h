@@ -26,6 +26,12 @@ void getClientNames(const int sock, const bool istelnet);
 void getClientID(const int sock, const bool istelnet);
 void getVersion(const int sock, const bool istelnet);
 void getDBstats(const int sock, const bool istelnet);
+void getWALstats(const int sock, const bool istelnet);
+void getSQLprofile(const char *client_message, const int sock, const bool istelnet);
+void getAllocProfile(const char *client_message, const int sock, const bool istelnet);
+void getUpstreamScores(const int sock, const bool istelnet);
+void getTCPpool(const int sock, const bool istelnet);
+void getSlowQueries(const int sock, const bool istelnet);
 void getUnknownQueries(const int sock, const bool istelnet);
 void getMAXLOGAGE(const int sock);
 void getGateway(const int sock);
@@ -40,11 +46,13 @@ void pack_eom(const int sock);
 void pack_bool(const int sock, const bool value);
 void pack_uint8(const int sock, const uint8_t value);
 void pack_uint64(const int sock, const uint64_t value);
+void pack_uint32(const int sock, const uint32_t value);
 void pack_int32(const int sock, const int32_t value);
 void pack_int64(const int sock, const int64_t value);
 void pack_float(const int sock, const float value);
 bool pack_fixstr(const int sock, const char *string);
 bool pack_str32(const int sock, const char *string);
+bool pack_bin32(const int sock, const void *data, const size_t length);
 void pack_map16_start(const int sock, const uint16_t length);
 
 // DHCP lease management
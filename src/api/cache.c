@@ -0,0 +1,274 @@
+/* Pi-hole: A black hole for Internet advertisements
+*  (c) 2023 Pi-hole, LLC (https://pi-hole.net)
+*  Network-wide ad blocking via your own hardware.
+*
+*  FTL Engine
+*  API response cache
+*
+*  This file is copyright under the latest version of the EUPL.
+*  Please see LICENSE file for your rights under this license. */
+
+#include "FTL.h"
+#include "cache.h"
+#include "socket.h"
+#include "../log.h"
+// struct config
+#include "../config.h"
+// timer_elapsed_msec()
+#include "../timers.h"
+// arena_alloc()
+#include "../arena.h"
+#include <stdatomic.h>
+
+// The dashboard endpoints (>stats, >top-domains, ...) are polled by every
+// open dashboard every few seconds. Their responses are cached for
+// API_CACHE_MS milliseconds so the work under the shared memory lock is done
+// at most once per interval, regardless of how many clients are polling.
+// Responses are cached as the serialized bytes (telnet or msgpack) sent to
+// the client
+struct api_cache_entry {
+	char key[API_CACHE_KEYLEN];
+	bool istelnet;
+	bool computing;
+	enum privacy_level privacylevel;
+	unsigned int generation;
+	struct timespec created;
+	char *data;
+	size_t len;
+};
+
+static struct api_cache_entry cache[API_CACHE_SLOTS] = { 0 };
+static pthread_mutex_t cache_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t cache_cond = PTHREAD_COND_INITIALIZER;
+
+// Incremented whenever cached responses become invalid before they expire
+// (e.g., garbage collection or change of the privacy level)
+static atomic_uint generation = 0;
+
+// Response of this thread currently being captured
+static __thread struct api_cache_entry *pending = NULL;
+static __thread char *capture = NULL;
+static __thread size_t capture_len = 0, capture_size = 0;
+static __thread int capture_sock = -1;
+
+static double __attribute__((pure)) age_msec(const struct timespec *then, const struct timespec *now)
+{
+	return 1e3*(now->tv_sec - then->tv_sec) + 1e-6*(now->tv_nsec - then->tv_nsec);
+}
+
+// Normalize the command: only the part starting at cmd up to the end of the
+// line or the next command is used. Returns false if the command cannot be
+// cached
+static bool get_key(const char *client_message, const char *cmd, char key[API_CACHE_KEYLEN])
+{
+	const char *start = strstr(client_message, cmd);
+	if(start == NULL)
+		return false;
+
+	size_t len = 0;
+	while(start[len] != '\0' && start[len] != '\r' && start[len] != '\n' &&
+	      !(len > 0 && start[len] == '>'))
+		len++;
+	// Strip trailing whitespace
+	while(len > 0 && isspace((unsigned char)start[len-1]))
+		len--;
+
+	if(len >= API_CACHE_KEYLEN)
+		return false;
+
+	memcpy(key, start, len);
+	key[len] = '\0';
+	return true;
+}
+
+static void send_response(const int sock, const char *data, const size_t len)
+{
+	if(len > 0)
+		swrite(sock, data, len);
+}
+
+// Try to serve the request from the cache. If this is not possible, start
+// capturing the response and return false. In this case, the caller has to
+// produce the response and call api_cache_store() afterwards
+bool api_cache_lookup(const char *client_message, const char *cmd, const int sock, const bool istelnet)
+{
+	if(config.api_cache_ms == 0)
+		return false;
+
+	char key[API_CACHE_KEYLEN];
+	if(!get_key(client_message, cmd, key))
+		return false;
+
+	pthread_mutex_lock(&cache_lock);
+	while(true)
+	{
+		struct timespec now;
+		clock_gettime(CLOCK_MONOTONIC, &now);
+		const unsigned int gen = atomic_load(&generation);
+
+		// Find entry for this request, remember the oldest entry for
+		// replacement
+		struct api_cache_entry *entry = NULL, *oldest = NULL;
+		for(unsigned int i = 0; i < API_CACHE_SLOTS; i++)
+		{
+			struct api_cache_entry *e = &cache[i];
+			if(e->istelnet == istelnet && e->privacylevel == config.privacylevel &&
+			   strcmp(e->key, key) == 0)
+			{
+				entry = e;
+				break;
+			}
+			if(e->computing)
+				continue;
+			// Prefer unused slots, otherwise the oldest one
+			if(oldest == NULL || (oldest->key[0] != '\0' &&
+			   (e->key[0] == '\0' || age_msec(&e->created, &oldest->created) > 0)))
+				oldest = e;
+		}
+
+		// Another thread is preparing this response, wait for it
+		if(entry != NULL && entry->computing)
+		{
+			pthread_cond_wait(&cache_cond, &cache_lock);
+			continue;
+		}
+
+		// Serve valid response
+		if(entry != NULL && entry->generation == gen &&
+		   age_msec(&entry->created, &now) < config.api_cache_ms)
+		{
+			// Copy the response so we can send it without holding
+			// the lock. The arena is reset after the request
+			char *data = NULL;
+			const size_t len = entry->len;
+			if(len > 0 && (data = arena_alloc(len)) != NULL)
+				memcpy(data, entry->data, len);
+			pthread_mutex_unlock(&cache_lock);
+
+			if(data != NULL)
+				send_response(sock, data, len);
+			if(debug_enabled(DEBUG_API))
+				logg("API: Served \"%s\" from cache (%zu bytes)", key, len);
+			return true;
+		}
+
+		// All slots are busy
+		if(entry == NULL && oldest == NULL)
+		{
+			pthread_mutex_unlock(&cache_lock);
+			return false;
+		}
+
+		// Claim entry and start capturing the response
+		if(entry == NULL)
+		{
+			entry = oldest;
+			memcpy(entry->key, key, sizeof(key));
+			entry->istelnet = istelnet;
+			entry->privacylevel = config.privacylevel;
+		}
+		entry->computing = true;
+		entry->generation = gen;
+		pending = entry;
+		capture_len = 0;
+		capture_sock = sock;
+		pthread_mutex_unlock(&cache_lock);
+		return false;
+	}
+}
+
+// Finish capturing, store the response in the cache and send it to the client
+void api_cache_store(const int sock)
+{
+	struct api_cache_entry *entry = pending;
+	if(entry == NULL)
+		return;
+	pending = NULL;
+
+	// Copy captured response
+	char *data = NULL;
+	if(capture_len > 0 && (data = calloc(capture_len, 1)) != NULL)
+		memcpy(data, capture, capture_len);
+
+	pthread_mutex_lock(&cache_lock);
+	if(entry->data != NULL)
+		free(entry->data);
+	entry->data = data;
+	entry->len = data != NULL ? capture_len : 0u;
+	// Do not cache the response if it could not be copied
+	if(data == NULL && capture_len > 0)
+		entry->key[0] = '\0';
+	clock_gettime(CLOCK_MONOTONIC, &entry->created);
+	entry->computing = false;
+	pthread_cond_broadcast(&cache_cond);
+	pthread_mutex_unlock(&cache_lock);
+
+	send_response(sock, capture, capture_len);
+}
+
+// Stop capturing the response of this thread when we run out of memory. The
+// response is not cached, waiting threads compute it themselves. What has been
+// captured so far is sent to the client, the remainder is sent directly
+static void abort_capture(void)
+{
+	struct api_cache_entry *entry = pending;
+	pending = NULL;
+
+	pthread_mutex_lock(&cache_lock);
+	if(entry->data != NULL)
+		free(entry->data);
+	entry->data = NULL;
+	entry->len = 0u;
+	entry->key[0] = '\0';
+	entry->computing = false;
+	pthread_cond_broadcast(&cache_cond);
+	pthread_mutex_unlock(&cache_lock);
+
+	logg("WARN: API: Out of memory, response is not cached");
+
+	send_response(capture_sock, capture, capture_len);
+	api_cache_free_thread();
+}
+
+// Append data to the response captured by this thread. Returns false if no
+// response is being captured
+bool api_cache_capture(const void *buf, const size_t len)
+{
+	if(pending == NULL)
+		return false;
+
+	if(capture_len + len > capture_size)
+	{
+		size_t size = capture_size > 0 ? capture_size : 4096u;
+		while(size < capture_len + len)
+			size *= 2;
+		char *new = realloc(capture, size);
+		if(new == NULL)
+		{
+			abort_capture();
+			return false;
+		}
+		capture = new;
+		capture_size = size;
+	}
+
+	memcpy(capture + capture_len, buf, len);
+	capture_len += len;
+	return true;
+}
+
+// Invalidate all cached responses
+void api_cache_invalidate(void)
+{
+	atomic_fetch_add(&generation, 1);
+}
+
+// Free the capture buffer of this thread. This has to be called when an API
+// thread terminates
+void api_cache_free_thread(void)
+{
+	if(capture != NULL)
+		free(capture);
+	capture = NULL;
+	capture_len = capture_size = 0;
+}
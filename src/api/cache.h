@@ -0,0 +1,24 @@
+/* Pi-hole: A black hole for Internet advertisements
+*  (c) 2023 Pi-hole, LLC (https://pi-hole.net)
+*  Network-wide ad blocking via your own hardware.
+*
+*  FTL Engine
+*  API response cache prototypes
+*
+*  This file is copyright under the latest version of the EUPL.
+*  Please see LICENSE file for your rights under this license. */
+#ifndef API_CACHE_H
+#define API_CACHE_H
+
+// Number of responses kept in the cache
+#define API_CACHE_SLOTS 16
+// Maximum length of a (normalized) cacheable command
+#define API_CACHE_KEYLEN 64
+
+bool api_cache_lookup(const char *client_message, const char *cmd, const int sock, const bool istelnet);
+void api_cache_store(const int sock);
+bool api_cache_capture(const void *buf, const size_t len);
+void api_cache_invalidate(void);
+void api_cache_free_thread(void);
+
+#endif //API_CACHE_H
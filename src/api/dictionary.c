@@ -0,0 +1,190 @@
+/* Pi-hole: A black hole for Internet advertisements
+*  (c) 2023 Pi-hole, LLC (https://pi-hole.net)
+*  Network-wide ad blocking via your own hardware.
+*
+*  FTL Engine
+*  API string dictionary
+*
+*  This file is copyright under the latest version of the EUPL.
+*  Please see LICENSE file for your rights under this license. */
+
+#include "FTL.h"
+#include "dictionary.h"
+#include "api.h"
+#include "../log.h"
+// getstrpos()
+#include "../shmem.h"
+
+// Bulk msgpack responses can refer to strings (domains, clients, upstreams,
+// ...) by their index in this dictionary instead of repeating them in every
+// row. The dictionary is shared by all clients and only grows. Each response
+// contains all entries the client does not know yet, so clients can keep
+// their copy across calls as long as the generation does not change.
+//
+// Most strings live in the shared string buffer, they are identified by
+// their (stable) position therein. Other strings (e.g. "hidden" or query
+// types) are copied. The dictionary is accessed only while holding the shared
+// memory lock
+struct dict_slot {
+	uint64_t key;
+	uint32_t id;
+};
+
+struct dict_entry {
+	size_t pos;
+	// Non-NULL for strings outside of the shared string buffer
+	char *str;
+};
+
+static struct dict_slot *slots = NULL;
+static unsigned int nslots = 0;
+static struct dict_entry *entries = NULL;
+static unsigned int nentries = 0, capacity = 0;
+static int64_t generation = 0;
+// First entry to be sent to the client of the current request
+static unsigned int first_unknown = 0;
+
+// Strings outside of the shared string buffer get keys with the highest bit
+// set so they cannot collide with positions
+#define EXTERNAL_KEY (1ULL << 63)
+
+static void dict_reset(void)
+{
+	for(unsigned int i = 0; i < nentries; i++)
+		if(entries[i].str != NULL)
+			free(entries[i].str);
+	if(entries != NULL)
+		free(entries);
+	if(slots != NULL)
+		free(slots);
+
+	entries = NULL;
+	slots = NULL;
+	nentries = capacity = nslots = 0;
+
+	// Use the time as generation so clients notice a restart of FTL
+	generation = generation < (int64_t)time(NULL) ? (int64_t)time(NULL) : generation + 1;
+}
+
+static inline unsigned int hash_key(const uint64_t key)
+{
+	return (unsigned int)((key * 11400714819323198485ULL) >> 32);
+}
+
+static bool dict_grow(void)
+{
+	// Grow hash table to keep the load below 50%
+	const unsigned int newslots = nslots > 0 ? 2*nslots : 4096u;
+	struct dict_slot *new = calloc(newslots, sizeof(struct dict_slot));
+	if(new == NULL)
+		return false;
+
+	for(unsigned int i = 0; i < nslots; i++)
+	{
+		if(slots[i].key == 0)
+			continue;
+		unsigned int j = hash_key(slots[i].key) & (newslots - 1);
+		while(new[j].key != 0)
+			j = (j + 1) & (newslots - 1);
+		new[j] = slots[i];
+	}
+
+	if(slots != NULL)
+		free(slots);
+	slots = new;
+	nslots = newslots;
+	return true;
+}
+
+// Find the token "dict" or "dict=<generation>:<known>" in the request. Other
+// words starting with "dict" (e.g. a domain) do not count. Returns NULL if the
+// client did not ask for the dictionary format
+const char *dict_requested(const char *client_message)
+{
+	for(const char *ptr = client_message; (ptr = strstr(ptr, " dict")) != NULL; ptr += 5)
+	{
+		const char next = ptr[5];
+		if(next == '\0' || next == '=' || isspace((unsigned char)next))
+			return ptr;
+	}
+
+	return NULL;
+}
+
+// Parse the dictionary state of the client (if any). Clients send
+// "dict=<generation>:<number of known entries>"
+void dict_begin(const char *client_message)
+{
+	if(entries == NULL || nentries >= DICT_MAX_ENTRIES)
+		dict_reset();
+
+	long long client_generation = -1;
+	unsigned int known = 0;
+	const char *ptr = dict_requested(client_message);
+	if(ptr == NULL || sscanf(ptr, " dict=%lli:%u", &client_generation, &known) != 2 ||
+	   client_generation != generation || known > nentries)
+		known = 0;
+
+	first_unknown = known;
+}
+
+// Get the dictionary index of this string (adding it if necessary). Returns
+// DICT_INVALID_ID on failure
+uint32_t dict_id(const char *str)
+{
+	size_t pos = 0;
+	const bool internal = getstrpos(str, &pos);
+
+	// Position zero is the empty string, keys have to be non-zero
+	uint64_t key = internal ? pos + 1 : 0;
+	if(!internal)
+	{
+		// FNV-1a hash of the string
+		key = 14695981039346656037ULL;
+		for(const unsigned char *c = (const unsigned char *)str; *c; c++)
+			key = (key ^ *c) * 1099511628211ULL;
+		key |= EXTERNAL_KEY;
+	}
+
+	if(2*(nentries + 1) > nslots && !dict_grow())
+		return DICT_INVALID_ID;
+
+	unsigned int i = hash_key(key) & (nslots - 1);
+	while(slots[i].key != 0)
+	{
+		// External strings are compared as the hash may collide
+		if(slots[i].key == key &&
+		   (internal || strcmp(entries[slots[i].id].str, str) == 0))
+			return slots[i].id;
+		i = (i + 1) & (nslots - 1);
+	}
+
+	// Add new entry
+	if(nentries >= capacity)
+	{
+		const unsigned int newcapacity = capacity > 0 ? 2*capacity : 4096u;
+		struct dict_entry *new = realloc(entries, newcapacity*sizeof(struct dict_entry));
+		if(new == NULL)
+			return DICT_INVALID_ID;
+		entries = new;
+		capacity = newcapacity;
+	}
+	entries[nentries].pos = pos;
+	entries[nentries].str = NULL;
+	if(!internal && (entries[nentries].str = strdup(str)) == NULL)
+		return DICT_INVALID_ID;
+	slots[i].key = key;
+	slots[i].id = nentries;
+
+	return nentries++;
+}
+
+// Send generation and all entries unknown to the client
+void dict_send(const int sock)
+{
+	pack_int64(sock, generation);
+	pack_uint32(sock, first_unknown);
+	pack_uint32(sock, nentries - first_unknown);
+	for(unsigned int i = first_unknown; i < nentries; i++)
+		pack_str32(sock, entries[i].str != NULL ? entries[i].str : getstr(entries[i].pos));
+}
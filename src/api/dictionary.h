@@ -0,0 +1,33 @@
+/* Pi-hole: A black hole for Internet advertisements
+*  (c) 2023 Pi-hole, LLC (https://pi-hole.net)
+*  Network-wide ad blocking via your own hardware.
+*
+*  FTL Engine
+*  API string dictionary prototypes
+*
+*  This file is copyright under the latest version of the EUPL.
+*  Please see LICENSE file for your rights under this license. */
+#ifndef API_DICTIONARY_H
+#define API_DICTIONARY_H
+
+#include <stdint.h>
+
+// The dictionary is restarted (with a new generation) when it grows beyond
+// this number of entries
+#define DICT_MAX_ENTRIES (1u << 22)
+
+// Size of a dictionary-encoded row of >getallqueries: timestamp, query type,
+// domain, client (uint32 each), status, DNSSEC status (uint8 each) and two
+// reserved bytes
+#define DICT_ROW_SIZE 20u
+
+// Returned by dict_id() when the string cannot be added (out of memory). Zero
+// is the index of the first string so it cannot be used for this
+#define DICT_INVALID_ID UINT32_MAX
+
+const char *dict_requested(const char *client_message) __attribute__((pure));
+void dict_begin(const char *client_message);
+uint32_t dict_id(const char *str);
+void dict_send(const int sock);
+
+#endif //API_DICTIONARY_H
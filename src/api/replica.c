@@ -0,0 +1,264 @@
+/* Pi-hole: A black hole for Internet advertisements
+*  (c) 2023 Pi-hole, LLC (https://pi-hole.net)
+*  Network-wide ad blocking via your own hardware.
+*
+*  FTL Engine
+*  Read-only API replica
+*
+*  This file is copyright under the latest version of the EUPL.
+*  Please see LICENSE file for your rights under this license. */
+
+#include "FTL.h"
+#include "replica.h"
+#include "request.h"
+#include "socket.h"
+// pack_str32()
+#include "api.h"
+// api_cache_invalidate()
+#include "cache.h"
+#include "../shmem.h"
+#include "../log.h"
+// struct config
+#include "../config.h"
+// blockingstatus
+#include "../setupVars.h"
+// killed
+#include "../signals.h"
+// sleepms()
+#include "../timers.h"
+// gravityDB_open()
+#include "../database/gravity-db.h"
+
+// The replica (pihole-FTL api) maps the shared memory objects of the running
+// FTL instance read-only and answers API requests from there. It never takes
+// the shared memory lock so dashboard load does not compete with the resolver.
+// Instead, each response is built into a buffer and only sent once the
+// sequence counter in shared memory shows that no writer modified the objects
+// while the response was being built. Otherwise, the response is built again
+
+// Commands depending on the state of the resolver process or modifying it
+static const char *resolver_only[] = {
+	">cacheinfo",
+	">reresolve",
+	">recompile-regex",
+	">delete-lease",
+	">dns-port",
+	">dbwal",
+	">dbprofile",
+	">allocprofile",
+	">upstream-scores",
+	">tcp-pool",
+	">slow-queries",
+};
+
+// Response of this thread currently being built
+static __thread bool capturing = false, capture_failed = false;
+static __thread char *capture = NULL;
+static __thread size_t capture_len = 0, capture_size = 0;
+
+static void replica_terminate(int sig)
+{
+	killed = 1;
+}
+
+// The blocking status is a process-local variable of the resolver. We follow
+// its changes through setupVars.conf
+static void refresh_blocking_status(void)
+{
+	// Only read the file when it has been modified. Blocking is enabled
+	// if there is no such file
+	static time_t mtime = -1;
+	struct stat st;
+	const time_t new_mtime = stat(FTLfiles.setupVars, &st) == 0 ? st.st_mtime : 0;
+	if(new_mtime == mtime)
+		return;
+	mtime = new_mtime;
+
+	const char *blocking = new_mtime > 0 ? read_setupVarsconf("BLOCKING_ENABLED") : NULL;
+	const enum blocking_status status =
+		blocking == NULL || getSetupVarsBool(blocking) ? BLOCKING_ENABLED : BLOCKING_DISABLED;
+	clearSetupVarsArray();
+
+	if(status != blockingstatus)
+		logg("Blocking status is %s", status == BLOCKING_ENABLED ? "enabled" : "disabled");
+	blockingstatus = status;
+}
+
+// Get PID of the running FTL instance from its PID file (0 = unknown)
+static pid_t get_FTL_pid(void)
+{
+	FILE *fp = fopen(FTLfiles.pid, "r");
+	if(fp == NULL)
+		return 0;
+
+	int pid = 0;
+	if(fscanf(fp, "%d", &pid) != 1)
+		pid = 0;
+	fclose(fp);
+
+	return pid;
+}
+
+int run_api_replica(void)
+{
+	logg("Starting read-only API replica");
+
+	if(!attach_shmem())
+	{
+		logg("Cannot attach to shared memory, is pihole-FTL running?");
+		return EXIT_FAILURE;
+	}
+
+	// Terminate gracefully
+	signal(SIGTERM, replica_terminate);
+	signal(SIGINT, replica_terminate);
+	signal(SIGPIPE, SIG_IGN);
+
+	const pid_t ftl_pid = get_FTL_pid();
+
+	// The audit list is needed for >top-domains/ads (audit)
+	gravityDB_open();
+	lock_shm();
+	refresh_blocking_status();
+	unlock_shm();
+
+	// Listen on the ports of the replica instead of those of FTL
+	config.port = config.api_replica_port;
+	FTLfiles.socketfile = FTLfiles.api_socketfile;
+	listen_telnet(TELNETv4);
+	listen_telnet(TELNETv6);
+	listen_telnet(TELNET_SOCK);
+
+	while(!killed)
+	{
+		sleepms(1000);
+
+		// Our mappings become stale when FTL terminates or is restarted
+		// as it creates new objects. We terminate and let the service
+		// manager restart us
+		if(shm_replaced() || (ftl_pid > 0 && kill(ftl_pid, 0) != 0 && errno == ESRCH))
+		{
+			logg("FTL terminated or its shared memory has been replaced, terminating API replica");
+			unlink(FTLfiles.socketfile);
+			return EXIT_FAILURE;
+		}
+
+		// Settings are read under the (process-local) lock as the API
+		// threads use the same buffers
+		lock_shm();
+		refresh_blocking_status();
+		unlock_shm();
+	}
+
+	logg("Terminating read-only API replica");
+	unlink(FTLfiles.socketfile);
+	return EXIT_SUCCESS;
+}
+
+// Send a message in the format requested by the client
+static void send_message(const int sock, const bool istelnet, const char *message)
+{
+	if(istelnet)
+		ssend(sock, "%s\n", message);
+	else
+		pack_str32(sock, message);
+	seom(sock, istelnet);
+}
+
+// Build the response of this request. Returns true if it is complete and
+// consistent, it is in the buffer of this thread then
+static bool build_response(const char *client_message, const int sock, const bool istelnet, bool *eom)
+{
+	const unsigned int seq = shm_read_begin();
+	capturing = true;
+	capture_failed = false;
+	capture_len = 0;
+	*eom = process_request(client_message, sock, istelnet);
+	capturing = false;
+
+	if(!capture_failed && !shm_read_retry(seq))
+		return true;
+
+	// The response may be inconsistent, do not let other clients
+	// get it from the response cache
+	api_cache_invalidate();
+	return false;
+}
+
+// Process a request from a consistent snapshot of the shared memory objects
+bool replica_request(const char *client_message, const int sock, const bool istelnet)
+{
+	for(unsigned int i = 0; i < sizeof(resolver_only)/sizeof(resolver_only[0]); i++)
+	{
+		if(!command(client_message, resolver_only[i]))
+			continue;
+
+		char message[64];
+		snprintf(message, sizeof(message), "%s is not available in the API replica", resolver_only[i]);
+		send_message(sock, istelnet, message);
+		return command(client_message, ">quit");
+	}
+
+	bool eom = false, consistent = false;
+	for(unsigned int attempt = 1; attempt <= REPLICA_RETRIES && !consistent; attempt++)
+		consistent = build_response(client_message, sock, istelnet, &eom);
+
+	// FTL kept modifying the objects (or we ran out of memory), take its
+	// lock to get a consistent snapshot. The response is sent after the
+	// lock has been released
+	if(!consistent)
+	{
+		if(debug_enabled(DEBUG_API))
+			logg("API replica: No consistent snapshot, taking the lock of FTL");
+		shm_read_lock();
+		consistent = build_response(client_message, sock, istelnet, &eom);
+		shm_read_unlock();
+	}
+
+	if(!consistent)
+		send_message(sock, istelnet, "API replica: Response not available");
+	else if(capture_len > 0)
+		swrite(sock, capture, capture_len);
+
+	return eom;
+}
+
+// Append data to the response being built by this thread. Returns false if no
+// response is being built
+bool replica_capture(const void *buf, const size_t len)
+{
+	if(!capturing)
+		return false;
+	if(capture_failed)
+		return true;
+
+	if(capture_len + len > capture_size)
+	{
+		size_t size = capture_size > 0 ? capture_size : 4096u;
+		while(size < capture_len + len)
+			size *= 2;
+		char *new = realloc(capture, size);
+		if(new == NULL)
+		{
+			// Discard the remainder, the response is incomplete
+			capture_failed = true;
+			return true;
+		}
+		capture = new;
+		capture_size = size;
+	}
+
+	memcpy(capture + capture_len, buf, len);
+	capture_len += len;
+	return true;
+}
+
+// Free the response buffer of this thread. This has to be called when an API
+// thread terminates
+void replica_free_thread(void)
+{
+	if(capture != NULL)
+		free(capture);
+	capture = NULL;
+	capture_len = capture_size = 0;
+}
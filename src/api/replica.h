@@ -0,0 +1,22 @@
+/* Pi-hole: A black hole for Internet advertisements
+*  (c) 2023 Pi-hole, LLC (https://pi-hole.net)
+*  Network-wide ad blocking via your own hardware.
+*
+*  FTL Engine
+*  Read-only API replica prototypes
+*
+*  This file is copyright under the latest version of the EUPL.
+*  Please see LICENSE file for your rights under this license. */
+#ifndef API_REPLICA_H
+#define API_REPLICA_H
+
+// How often do we try to get a consistent snapshot before we take the lock of
+// FTL?
+#define REPLICA_RETRIES 5
+
+int run_api_replica(void);
+bool replica_request(const char *client_message, const int sock, const bool istelnet);
+bool replica_capture(const void *buf, const size_t len);
+void replica_free_thread(void);
+
+#endif //API_REPLICA_H
@@ -21,6 +21,8 @@
 // Eventqueue routines
 #include "../events.h"
 #include "../config.h"
+// api_cache_lookup()
+#include "cache.h"
 
 bool __attribute__((pure)) command(const char *client_message, const char* cmd) {
 	return strstr(client_message, cmd) != NULL;
@@ -36,51 +38,79 @@ bool process_request(const char *client_message, const int sock, const bool iste
 	if(command(client_message, ">stats"))
 	{
 		processed = true;
-		lock_shm();
-		getStats(sock, istelnet);
-		unlock_shm();
+		if(!api_cache_lookup(client_message, ">stats", sock, istelnet))
+		{
+			lock_shm();
+			getStats(sock, istelnet);
+			unlock_shm();
+			api_cache_store(sock);
+		}
 	}
 	else if(command(client_message, ">overTime"))
 	{
 		processed = true;
-		lock_shm();
-		getOverTime(sock, istelnet);
-		unlock_shm();
+		if(!api_cache_lookup(client_message, ">overTime", sock, istelnet))
+		{
+			lock_shm();
+			getOverTime(sock, istelnet);
+			unlock_shm();
+			api_cache_store(sock);
+		}
 	}
 	else if(command(client_message, ">top-domains") || command(client_message, ">top-ads"))
 	{
 		processed = true;
-		lock_shm();
-		getTopDomains(client_message, sock, istelnet);
-		unlock_shm();
+		if(!api_cache_lookup(client_message, command(client_message, ">top-ads") ? ">top-ads" : ">top-domains", sock, istelnet))
+		{
+			lock_shm();
+			getTopDomains(client_message, sock, istelnet);
+			unlock_shm();
+			api_cache_store(sock);
+		}
 	}
 	else if(command(client_message, ">top-clients"))
 	{
 		processed = true;
-		lock_shm();
-		getTopClients(client_message, sock, istelnet);
-		unlock_shm();
+		if(!api_cache_lookup(client_message, ">top-clients", sock, istelnet))
+		{
+			lock_shm();
+			getTopClients(client_message, sock, istelnet);
+			unlock_shm();
+			api_cache_store(sock);
+		}
 	}
 	else if(command(client_message, ">forward-dest"))
 	{
 		processed = true;
-		lock_shm();
-		getUpstreamDestinations(client_message, sock, istelnet);
-		unlock_shm();
+		if(!api_cache_lookup(client_message, ">forward-dest", sock, istelnet))
+		{
+			lock_shm();
+			getUpstreamDestinations(client_message, sock, istelnet);
+			unlock_shm();
+			api_cache_store(sock);
+		}
 	}
 	else if(command(client_message, ">forward-names"))
 	{
 		processed = true;
-		lock_shm();
-		getUpstreamDestinations(">forward-dest unsorted", sock, istelnet);
-		unlock_shm();
+		if(!api_cache_lookup(client_message, ">forward-names", sock, istelnet))
+		{
+			lock_shm();
+			getUpstreamDestinations(">forward-dest unsorted", sock, istelnet);
+			unlock_shm();
+			api_cache_store(sock);
+		}
 	}
 	else if(command(client_message, ">querytypes"))
 	{
 		processed = true;
-		lock_shm();
-		getQueryTypes(sock, istelnet);
-		unlock_shm();
+		if(!api_cache_lookup(client_message, ">querytypes", sock, istelnet))
+		{
+			lock_shm();
+			getQueryTypes(sock, istelnet);
+			unlock_shm();
+			api_cache_store(sock);
+		}
 	}
 	else if(command(client_message, ">getallqueries"))
 	{
@@ -116,6 +146,45 @@ bool process_request(const char *client_message, const int sock, const bool iste
 		// is guaranteed to be atomic
 		getDBstats(sock, istelnet);
 	}
+	else if(command(client_message, ">dbwal"))
+	{
+		processed = true;
+		// No lock required. Metrics are updated by the
+		// database thread only
+		getWALstats(sock, istelnet);
+	}
+	else if(command(client_message, ">dbprofile"))
+	{
+		processed = true;
+		// No lock required. Statistics are protected by their
+		// own mutex
+		getSQLprofile(client_message, sock, istelnet);
+	}
+	else if(command(client_message, ">allocprofile"))
+	{
+		processed = true;
+		// No lock required. Statistics are updated atomically
+		getAllocProfile(client_message, sock, istelnet);
+	}
+	else if(command(client_message, ">upstream-scores"))
+	{
+		processed = true;
+		// No lock required. Scores are protected by their own mutex
+		getUpstreamScores(sock, istelnet);
+	}
+	else if(command(client_message, ">tcp-pool"))
+	{
+		processed = true;
+		// No lock required. The pool is protected by its own mutex
+		getTCPpool(sock, istelnet);
+	}
+	else if(command(client_message, ">slow-queries"))
+	{
+		processed = true;
+		// No lock required. Slow queries are protected by their own
+		// mutex
+		getSlowQueries(sock, istelnet);
+	}
 	else if(command(client_message, ">ClientsoverTime"))
 	{
 		processed = true;
@@ -190,7 +259,7 @@ bool process_request(const char *client_message, const int sock, const bool iste
 	// so things can be processed before
 	if(command(client_message, ">quit") || command(client_message, EOT))
 	{
-		if(config.debug & DEBUG_API)
+		if(debug_enabled(DEBUG_API))
 			logg("Received >quit or EOT on socket %d", sock);
 		return true;
 	}
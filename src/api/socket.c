@@ -21,6 +21,14 @@
 // API thread storage
 #include "../daemon.h"
 #include "../shmem.h"
+// arena_strdup()
+#include "../arena.h"
+// api_cache_capture()
+#include "cache.h"
+// api_replica
+#include "../args.h"
+// replica_request()
+#include "replica.h"
 
 // The backlog argument defines the maximum length
 // to which the queue of pending connections for
@@ -140,7 +148,7 @@ static void *telnet_connection_handler_thread(void *args)
 	// cancellation points)
 	pthread_setcanceltype(PTHREAD_CANCEL_ASYNCHRONOUS, NULL);
 
-	if(config.debug & DEBUG_API)
+	if(debug_enabled(DEBUG_API))
 		logg("Started telnet thread %s", threadname);
 
 	// Listen as long as this thread is not canceled
@@ -169,10 +177,10 @@ static void *telnet_connection_handler_thread(void *args)
 			{
 				// Null-terminate client string
 				client_message[n] = '\0';
-				char *message = strdup(client_message);
+				char *message = arena_strdup(client_message);
 				if(message == NULL)
 				{
-					if(config.debug & DEBUG_API)
+					if(debug_enabled(DEBUG_API))
 						logg("Break in telnet thread for socket %d/%d: Memory error", tinfo->fd, csck);
 					break;
 				}
@@ -181,13 +189,16 @@ static void *telnet_connection_handler_thread(void *args)
 				memset(client_message, 0, sizeof client_message);
 
 				// Process received message
-				const bool eom = process_request(message, csck, tinfo->istelnet);
-				free(message);
+				const bool eom = api_replica ?
+					replica_request(message, csck, tinfo->istelnet) :
+					process_request(message, csck, tinfo->istelnet);
+				// Release all transient memory of this request
+				arena_reset();
 				if(eom) break;
 			}
 			else if(n == -1)
 			{
-				if(config.debug & DEBUG_API)
+				if(debug_enabled(DEBUG_API))
 					logg("Break in telnet thread for socket %d/%d: No data received", tinfo->fd, csck);
 				break;
 			}
@@ -197,11 +208,14 @@ static void *telnet_connection_handler_thread(void *args)
 		close(csck);
 	}
 
-	if(config.debug & DEBUG_API)
+	if(debug_enabled(DEBUG_API))
 		logg("Terminating telnet thread %s (%d errors)", threadname, errors);
 
 	// Free thread-private memory
 	free(tinfo);
+	arena_free();
+	api_cache_free_thread();
+	replica_free_thread();
 	return NULL;
 }
 
@@ -224,7 +238,7 @@ void listen_telnet(const enum telnet_type type)
 		return;
 	}
 
-	if(config.debug & DEBUG_API)
+	if(debug_enabled(DEBUG_API))
 		logg("Telnet-%s listener accepting on fd %d", stype, fd);
 
 	for(unsigned int i = 0; i < MAX_API_THREADS; i++)
@@ -257,15 +271,24 @@ void seom(const int sock, const bool istelnet)
 
 bool __attribute__ ((format (gnu_printf, 5, 6))) _ssend(const int sock, const char *file, const char *func, const int line, const char *format, ...)
 {
+	// Print into the arena, the buffer is reused for the next line
+	const size_t mark = arena_mark();
 	char *buffer;
 	va_list args;
 	va_start(args, format);
-	int bytes = vasprintf(&buffer, format, args);
+	int bytes = arena_vasprintf(&buffer, format, args);
 	va_end(args);
 	if(bytes > 0 && buffer != NULL)
-	{
-		FTLwrite(sock, buffer, bytes, short_path(file), func, line);
-		free(buffer);
-	}
+		_swrite(sock, buffer, bytes, file, func, line);
+	arena_release(mark);
 	return errno == 0;
 }
+
+// Send data to the client (or into the response cache or the replica's
+// response buffer if the response of this request is being captured)
+ssize_t _swrite(const int sock, const void *buf, const size_t len, const char *file, const char *func, const int line)
+{
+	if(api_cache_capture(buf, len) || replica_capture(buf, len))
+		return len;
+	return FTLwrite(sock, buf, len, short_path(file), func, line);
+}
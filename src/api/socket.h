@@ -24,6 +24,8 @@ void close_unix_socket(bool unlink_file);
 void seom(const int sock, const bool istelnet);
 #define ssend(sock, format, ...) _ssend(sock, __FILE__, __FUNCTION__,  __LINE__, format, ##__VA_ARGS__)
 bool _ssend(const int sock, const char *file, const char *func, const int line, const char *format, ...) __attribute__ ((format (gnu_printf, 5, 6)));
+#define swrite(sock, buf, len) _swrite(sock, buf, len, __FILE__, __FUNCTION__,  __LINE__)
+ssize_t _swrite(const int sock, const void *buf, const size_t len, const char *file, const char *func, const int line);
 void listen_telnet(const enum telnet_type type);
 
 #endif //SOCKET_H
@@ -0,0 +1,189 @@
+/* Pi-hole: A black hole for Internet advertisements
+*  (c) 2023 Pi-hole, LLC (https://pi-hole.net)
+*  Network-wide ad blocking via your own hardware.
+*
+*  FTL Engine
+*  Per-thread arena allocator
+*
+*  This file is copyright under the latest version of the EUPL.
+*  Please see LICENSE file for your rights under this license. */
+
+#include "FTL.h"
+#include "arena.h"
+// logg()
+#include "log.h"
+
+// Transient allocations (e.g., copies of the domain while a query is
+// analyzed or the lines of an API response) are taken from a per-thread
+// stack of memory chunks. Allocating is a pointer increment and releasing
+// everything allocated since a mark is a pointer decrement. This avoids
+// contention on the allocator lock between the threads and fragmentation of
+// the heap by many small, short-lived allocations
+struct arena_chunk {
+	struct arena_chunk *prev;
+	// Position of the first byte of this chunk in the arena
+	size_t base;
+	size_t size;
+	size_t used;
+	char data[];
+};
+
+// Allocations are aligned like malloc() would do it
+#define ARENA_ALIGN (2*sizeof(void*))
+
+static __thread struct arena_chunk *current = NULL;
+// Released chunk of the default size, we keep it to avoid allocating a new
+// chunk each time an allocation crosses the end of the current chunk
+static __thread struct arena_chunk *spare = NULL;
+
+static struct arena_chunk *new_chunk(const size_t size)
+{
+	struct arena_chunk *chunk = NULL;
+	if(spare != NULL && spare->size >= size)
+	{
+		chunk = spare;
+		spare = NULL;
+	}
+	else
+	{
+		const size_t chunksize = size > ARENA_CHUNK_SIZE ? size : ARENA_CHUNK_SIZE;
+		chunk = calloc(1, sizeof(struct arena_chunk) + chunksize);
+		if(chunk == NULL)
+			return NULL;
+		chunk->size = chunksize;
+	}
+
+	chunk->prev = current;
+	chunk->base = current != NULL ? current->base + current->size : 0u;
+	chunk->used = 0u;
+	return chunk;
+}
+
+static void drop_chunk(void)
+{
+	struct arena_chunk *chunk = current;
+	current = chunk->prev;
+
+	// Chunks of large allocations are returned to the system, the memory
+	// would otherwise be kept by this thread until it terminates
+	if(spare != NULL || chunk->size > ARENA_CHUNK_SIZE)
+	{
+		free(chunk);
+		return;
+	}
+	spare = chunk;
+}
+
+// Returns the current position in the arena. It changes with every allocation
+// of this thread, so this is deliberately not declared pure: calls must not be
+// merged or moved across allocations
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wsuggest-attribute=pure"
+#endif
+size_t arena_mark(void)
+{
+	return current != NULL ? current->base + current->used : 0u;
+}
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic pop
+#endif
+
+// Release all memory allocated since mark was obtained
+void arena_release(const size_t mark)
+{
+	while(current != NULL && current->base > mark)
+		drop_chunk();
+
+	if(current != NULL)
+		current->used = mark - current->base;
+}
+
+// Release all memory of the arena of this thread. This is done at the end of
+// each query or API request
+void arena_reset(void)
+{
+	arena_release(0u);
+
+	// The first chunk is kept, unless it is one of a large allocation
+	if(current != NULL && current->size > ARENA_CHUNK_SIZE)
+	{
+		free(current);
+		current = NULL;
+	}
+}
+
+// Return all memory to the system. This has to be called when a thread
+// terminates
+void arena_free(void)
+{
+	while(current != NULL)
+	{
+		struct arena_chunk *chunk = current;
+		current = chunk->prev;
+		free(chunk);
+	}
+	if(spare != NULL)
+	{
+		free(spare);
+		spare = NULL;
+	}
+}
+
+void *arena_alloc(const size_t size)
+{
+	const size_t aligned = (size + ARENA_ALIGN - 1) & ~(ARENA_ALIGN - 1);
+	if(current == NULL || current->size - current->used < aligned)
+	{
+		struct arena_chunk *chunk = new_chunk(aligned);
+		if(chunk == NULL)
+		{
+			logg("FATAL: Memory allocation (%zu bytes) failed in arena_alloc()", size);
+			return NULL;
+		}
+		current = chunk;
+	}
+
+	void *ptr = current->data + current->used;
+	current->used += aligned;
+	return ptr;
+}
+
+char *arena_strdup(const char *src)
+{
+	if(src == NULL)
+		return NULL;
+
+	const size_t len = strlen(src) + 1;
+	char *dest = arena_alloc(len);
+	if(dest != NULL)
+		memcpy(dest, src, len);
+	return dest;
+}
+
+// Print into the arena. We try the remaining space of the current chunk first
+// so a buffer has to be allocated only if the output does not fit
+int arena_vasprintf(char **buffer, const char *format, va_list args)
+{
+	*buffer = NULL;
+	char *ptr = current != NULL ? current->data + current->used : NULL;
+	const size_t avail = current != NULL ? current->size - current->used : 0u;
+
+	va_list args_copy;
+	va_copy(args_copy, args);
+	const int len = vsnprintf(ptr, avail, format, args_copy);
+	va_end(args_copy);
+	if(len < 0)
+		return len;
+
+	if((size_t)len < avail)
+	{
+		// Output fitted, claim the memory
+		*buffer = arena_alloc(len + 1);
+		return len;
+	}
+
+	if((*buffer = arena_alloc(len + 1)) == NULL)
+		return -1;
+	return vsnprintf(*buffer, len + 1, format, args);
+}
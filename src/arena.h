@@ -0,0 +1,32 @@
+/* Pi-hole: A black hole for Internet advertisements
+*  (c) 2023 Pi-hole, LLC (https://pi-hole.net)
+*  Network-wide ad blocking via your own hardware.
+*
+*  FTL Engine
+*  Per-thread arena allocator prototypes
+*
+*  This file is copyright under the latest version of the EUPL.
+*  Please see LICENSE file for your rights under this license. */
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <stddef.h>
+#include <stdarg.h>
+
+// Size of the memory chunks the arena is carved from. Larger allocations get
+// a chunk of their own
+#define ARENA_CHUNK_SIZE 16384u
+
+// All memory allocated after arena_mark() has been called becomes invalid
+// once arena_release() is called with the returned mark. Memory returned by
+// arena_*() must never be passed to free()
+size_t arena_mark(void);
+void arena_release(const size_t mark);
+void arena_reset(void);
+void arena_free(void);
+
+void *arena_alloc(const size_t size) __attribute__((malloc)) __attribute__((alloc_size(1)));
+char *arena_strdup(const char *src) __attribute__((malloc));
+int arena_vasprintf(char **buffer, const char *format, va_list args) __attribute__ ((format (gnu_printf, 2, 0)));
+
+#endif //ARENA_H
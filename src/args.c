@@ -38,6 +38,8 @@
 #include "tools/dhcp-discover.h"
 // run_arp_scan()
 #include "tools/arp-scan.h"
+// run_query_log()
+#include "tools/query-log.h"
 // defined in dnsmasq.c
 extern void print_dnsmasq_version(const char *yellow, const char *green, const char *bold, const char *normal);
 
@@ -45,7 +47,7 @@ extern void print_dnsmasq_version(const char *yellow, const char *green, const c
 extern int sqlite3_shell_main(int argc, char **argv);
 
 bool dnsmasq_debug = false;
-bool daemonmode = true, cli_mode = false;
+bool daemonmode = true, cli_mode = false, api_replica = false;
 int argc_dnsmasq = 0;
 const char** argv_dnsmasq = NULL;
 
@@ -208,6 +210,19 @@ void parse_args(int argc, char* argv[])
 		exit(run_arp_scan(scan_all, extreme_mode));
 	}
 
+	// Binary query log rendering mode
+	if(argc > 1 && strcmp(argv[1], "query-log") == 0)
+	{
+		if(argc != 3)
+		{
+			printf("Usage: %s query-log <file>\n", argv[0]);
+			exit(EXIT_FAILURE);
+		}
+		// Enable stdout printing
+		cli_mode = true;
+		exit(run_query_log(argv[2]));
+	}
+
 	// start from 1, as argv[0] is the executable name
 	for(int i = 1; i < argc; i++)
 	{
@@ -452,6 +467,14 @@ void parse_args(int argc, char* argv[])
 			ok = true;
 		}
 
+		// Read-only API replica
+		if(strcmp(argv[i], "api") == 0)
+		{
+			api_replica = true;
+			daemonmode = false;
+			ok = true;
+		}
+
 		// Quiet mode
 		if(strcmp(argv[i], "-q") == 0)
 		{
@@ -571,6 +594,12 @@ void parse_args(int argc, char* argv[])
 			printf("\t                    interfaces\n");
 			printf("\t                    Append %s-x%s to force scan on all\n", cyan, normal);
 			printf("\t                    interfaces and scan 10x more often\n");
+			printf("\t%squery-log %sfile%s      Print the binary query log %sfile%s\n", green, cyan, normal, cyan, normal);
+			printf("\t                    written by %slog-queries-binary%s\n", green, normal);
+			printf("\t                    as text (%s-%s = stdin)\n", cyan, normal);
+			printf("\t%sapi%s                 Serve read-only API requests from\n", green, normal);
+			printf("\t                    the shared memory of the running\n");
+			printf("\t                    pihole-FTL (port API_REPLICA_PORT)\n");
 			printf("\t%s-h%s, %shelp%s            Display this help and exit\n\n", green, normal, green, normal);
 			exit(EXIT_SUCCESS);
 		}
@@ -34,6 +34,8 @@ FTLFileNamesStruct FTLfiles = {
 	NULL,
 	NULL,
 	NULL,
+	NULL,
+	NULL,
 	NULL
 };
 
@@ -241,6 +243,18 @@ void read_FTLconf(void)
 		if(value > 0 && value <= 65535)
 			config.port = value;
 
+	// API_REPLICA_PORT
+	// On which port should the read-only API replica (pihole-FTL api) be
+	// listening?
+	// defaults to: 4712
+	config.api_replica_port = 4712;
+	buffer = parse_FTLconf(fp, "API_REPLICA_PORT");
+
+	value = 0;
+	if(buffer != NULL && sscanf(buffer, "%i", &value))
+		if(value > 0 && value <= 65535)
+			config.api_replica_port = value;
+
 	// MAXLOGAGE
 	// Up to how many hours in the past should queries be imported from the database?
 	// defaults to: 24.0 via MAXLOGAGE defined in FTL.h
@@ -341,6 +355,12 @@ void read_FTLconf(void)
 	// SOCKETFILE
 	getpath(fp, "SOCKETFILE", "/run/pihole/FTL.sock", &FTLfiles.socketfile);
 
+	// API_SOCKETFILE
+	getpath(fp, "API_SOCKETFILE", "/run/pihole/FTL-api.sock", &FTLfiles.api_socketfile);
+
+	// SLOWQUERYLOG
+	getpath(fp, "SLOWQUERYLOG", "/var/log/pihole/slow-queries.log", &FTLfiles.slowquerylog);
+
 	// SETUPVARSFILE
 	getpath(fp, "SETUPVARSFILE", "/etc/pihole/setupVars.conf", &FTLfiles.setupVars);
 
@@ -744,6 +764,209 @@ void read_FTLconf(void)
 	else
 		logg("   CHECK_LOAD: Disabled");
 
+	// DBWAL
+	// Should FTL use write-ahead logging for its long-term database and
+	// schedule checkpoints itself (instead of SQLite's automatic
+	// checkpointing inside arbitrary commits)?
+	// defaults to: true
+	buffer = parse_FTLconf(fp, "DBWAL");
+	config.DBwal = read_bool(buffer, true);
+
+	if(config.DBwal)
+		logg("   DBWAL: Enabled, checkpoints are run by the database thread");
+	else
+		logg("   DBWAL: Disabled, using rollback journal");
+
+	// DBWALSIZE
+	// Size of the write-ahead log [MiB] above which FTL escalates to a
+	// truncating checkpoint
+	// defaults to: 16 MiB
+	config.checkpoint.size = 16;
+	buffer = parse_FTLconf(fp, "DBWALSIZE");
+
+	if(buffer != NULL && sscanf(buffer, "%u", &uval) == 1 && uval > 0)
+		config.checkpoint.size = uval;
+
+	if(config.DBwal)
+		logg("   DBWALSIZE: Truncating WAL when it exceeds %u MiB", config.checkpoint.size);
+
+	// DBCHECKPOINT
+	// Maximum time between two full (restarting) checkpoints [seconds]
+	// defaults to: 300 seconds
+	config.checkpoint.interval = 300;
+	buffer = parse_FTLconf(fp, "DBCHECKPOINT");
+
+	if(buffer != NULL && sscanf(buffer, "%u", &uval) == 1 && uval > 0)
+		config.checkpoint.interval = uval;
+
+	if(config.DBwal)
+		logg("   DBCHECKPOINT: Full checkpoint at least every %u seconds", config.checkpoint.interval);
+
+	// DBPROFILE
+	// Should FTL collect per-statement timing statistics for all SQL
+	// statements run on its database connections?
+	// defaults to: false
+	buffer = parse_FTLconf(fp, "DBPROFILE");
+	config.DBprofile = read_bool(buffer, false);
+
+	if(config.DBprofile)
+		logg("   DBPROFILE: Collecting SQL statement statistics");
+	else
+		logg("   DBPROFILE: Inactive");
+
+	// DBSLOWQUERY
+	// Log SQL statements taking longer than this [milliseconds]
+	// defaults to: 0 (disabled)
+	config.DBslowquery = 0;
+	buffer = parse_FTLconf(fp, "DBSLOWQUERY");
+
+	if(buffer != NULL && sscanf(buffer, "%u", &uval) == 1)
+		config.DBslowquery = uval;
+
+	if(config.DBslowquery > 0)
+		logg("   DBSLOWQUERY: Logging SQL statements taking longer than %u ms", config.DBslowquery);
+	else
+		logg("   DBSLOWQUERY: Inactive");
+
+	// API_CACHE_MS
+	// For how long should responses of the dashboard API endpoints (>stats,
+	// >top-domains, ...) be shared between all clients? [milliseconds]
+	// defaults to: 250 (0 = disabled)
+	config.api_cache_ms = 250;
+	buffer = parse_FTLconf(fp, "API_CACHE_MS");
+
+	if(buffer != NULL && sscanf(buffer, "%u", &uval) == 1)
+		config.api_cache_ms = uval;
+
+	if(config.api_cache_ms > 0)
+		logg("   API_CACHE_MS: Caching API responses for %u ms", config.api_cache_ms);
+	else
+		logg("   API_CACHE_MS: Inactive");
+
+	// UPSTREAM_SCORING
+	// Should FTL send queries to the upstream server with the best recent
+	// response times instead of using dnsmasq's strategy (racing all
+	// servers from time to time and using the first one replying)? This
+	// has no effect with strict-order or all-servers
+	// defaults to: false
+	buffer = parse_FTLconf(fp, "UPSTREAM_SCORING");
+	config.upstream_scoring = read_bool(buffer, false);
+
+	if(config.upstream_scoring)
+		logg("   UPSTREAM_SCORING: Enabled");
+	else
+		logg("   UPSTREAM_SCORING: Disabled");
+
+	// UPSTREAM_PROBE
+	// Which share of the queries should be sent to other upstream servers
+	// than the best one to keep their scores up to date? [percent]
+	// defaults to: 5 (0 = never)
+	config.upstream_probe = 5;
+	buffer = parse_FTLconf(fp, "UPSTREAM_PROBE");
+
+	if(buffer != NULL && sscanf(buffer, "%u", &uval) == 1 && uval <= 50)
+		config.upstream_probe = uval;
+
+	if(config.upstream_scoring)
+		logg("   UPSTREAM_PROBE: Probing other upstream servers with %u%% of the queries", config.upstream_probe);
+
+	// TCP_POOL
+	// Should queries forwarded over TCP share persistent connections to
+	// the upstream servers instead of each TCP worker process opening its
+	// own? Queries from different workers are pipelined on the same
+	// connections
+	// defaults to: false
+	buffer = parse_FTLconf(fp, "TCP_POOL");
+	config.tcp_pool = read_bool(buffer, false);
+
+	if(config.tcp_pool)
+		logg("   TCP_POOL: Enabled");
+	else
+		logg("   TCP_POOL: Disabled");
+
+	// TCP_POOL_IDLE
+	// After how many seconds without queries should pooled upstream
+	// connections be closed?
+	// defaults to: 10 [seconds]
+	config.tcp_pool_idle = 10;
+	buffer = parse_FTLconf(fp, "TCP_POOL_IDLE");
+
+	if(buffer != NULL && sscanf(buffer, "%u", &uval) == 1 && uval > 0 && uval <= 300)
+		config.tcp_pool_idle = uval;
+
+	if(config.tcp_pool)
+		logg("   TCP_POOL_IDLE: Closing idle upstream connections after %u seconds", config.tcp_pool_idle);
+
+	// SLOW_QUERY_MS
+	// Queries taking longer than this are written into the slow query log
+	// (SLOWQUERYLOG) together with the time they reached each stage of
+	// their processing. The most recent ones can be requested through the
+	// API (>slow-queries) [milliseconds]
+	// defaults to: 0 (= disabled)
+	config.slow_query_ms = 0;
+	buffer = parse_FTLconf(fp, "SLOW_QUERY_MS");
+
+	if(buffer != NULL && sscanf(buffer, "%u", &uval) == 1 && uval <= 3600000)
+		config.slow_query_ms = uval;
+
+	if(config.slow_query_ms > 0)
+		logg("   SLOW_QUERY_MS: Logging queries taking longer than %u ms to %s",
+		     config.slow_query_ms, FTLfiles.slowquerylog);
+	else
+		logg("   SLOW_QUERY_MS: Inactive");
+
+	// SHMEM_HUGEPAGES
+	// Should FTL ask the kernel to back the large shared memory objects
+	// (queries, domains, clients, strings, DNS cache) with transparent
+	// huge pages? This needs shmem_enabled set to "advise" (or "always")
+	// in /sys/kernel/mm/transparent_hugepage
+	// defaults to: false
+	buffer = parse_FTLconf(fp, "SHMEM_HUGEPAGES");
+	config.shmem_hugepages = read_bool(buffer, false);
+
+	if(config.shmem_hugepages)
+		logg("   SHMEM_HUGEPAGES: Enabled (the read-only API replica is not available)");
+	else
+		logg("   SHMEM_HUGEPAGES: Disabled");
+
+	// Objects backed by huge pages are anonymous (memfd) objects which
+	// are not visible in /dev/shm. The replica cannot attach to them
+	if(config.shmem_hugepages && api_replica)
+	{
+		logg("FATAL: The read-only API replica (pihole-FTL api) cannot be used "
+		     "together with SHMEM_HUGEPAGES. Disable SHMEM_HUGEPAGES in %s and "
+		     "restart pihole-FTL to use the replica", FTLfiles.conf);
+		exit(EXIT_FAILURE);
+	}
+
+	// SHMEM_PREFAULT
+	// Should FTL map newly allocated shared memory into its page tables
+	// right away instead of page-faulting during the next query burst?
+	// defaults to: true
+	buffer = parse_FTLconf(fp, "SHMEM_PREFAULT");
+	config.shmem_prefault = read_bool(buffer, true);
+
+	if(config.shmem_prefault)
+		logg("   SHMEM_PREFAULT: Enabled");
+	else
+		logg("   SHMEM_PREFAULT: Disabled");
+
+	// ALLOC_PROFILE
+	// Should FTL aggregate heap allocations per call site? The profile can
+	// be requested through the API (>allocprofile) or written into the log
+	// by sending real-time signal 6
+	// defaults to: false
+	buffer = parse_FTLconf(fp, "ALLOC_PROFILE");
+	config.alloc_profile = read_bool(buffer, false);
+
+	if(config.alloc_profile)
+	{
+		alloc_profile_init();
+		logg("   ALLOC_PROFILE: Enabled");
+	}
+	else
+		logg("   ALLOC_PROFILE: Disabled");
+
 	// CHECK_SHMEM
 	// Limit above which FTL should complain about a shared-memory shortage
 	// defaults to: 90%
@@ -829,7 +1052,7 @@ static char *parse_FTLconf(FILE *fp, const char *key)
 
 	// Lock mutex
 	const int lret = pthread_mutex_lock(&lock);
-	if(config.debug & DEBUG_LOCKS)
+	if(debug_enabled(DEBUG_LOCKS))
 		logg("Obtained config lock");
 	if(lret != 0)
 		logg("Error when obtaining config lock: %s", strerror(lret));
@@ -868,7 +1091,7 @@ static char *parse_FTLconf(FILE *fp, const char *key)
 		trim_whitespace(value);
 
 		const int uret = pthread_mutex_unlock(&lock);
-		if(config.debug & DEBUG_LOCKS)
+		if(debug_enabled(DEBUG_LOCKS))
 			logg("Released config lock (match)");
 		if(uret != 0)
 			logg("Error when releasing config lock (match): %s", strerror(uret));
@@ -882,7 +1105,7 @@ static char *parse_FTLconf(FILE *fp, const char *key)
 		logg("WARN: parse_FTLconf failed: could not allocate memory for getline");
 
 	const int uret = pthread_mutex_unlock(&lock);
-	if(config.debug & DEBUG_LOCKS)
+	if(debug_enabled(DEBUG_LOCKS))
 		logg("Released config lock (no match)");
 	if(uret != 0)
 		logg("Error when releasing config lock (no match): %s", strerror(uret));
@@ -1092,6 +1315,14 @@ void read_debuging_settings(FILE *fp)
 	// defaults to: false
 	setDebugOption(fp, "DEBUG_EXTRA", DEBUG_EXTRA);
 
+#ifdef NO_DEBUG_LOGGING
+	if(config.debug)
+	{
+		logg("WARNING: Debug logging is not available in this build, ignoring DEBUG_* settings");
+		config.debug = 0;
+	}
+#endif
+
 	if(config.debug)
 	{
 		logg("*****************************");
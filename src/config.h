@@ -51,6 +51,13 @@ typedef struct {
 	bool edns0_ecs :1;
 	bool show_dnssec :1;
 	bool addr2line :1;
+	bool DBwal :1;
+	bool DBprofile :1;
+	bool shmem_hugepages :1;
+	bool shmem_prefault :1;
+	bool alloc_profile :1;
+	bool upstream_scoring :1;
+	bool tcp_pool :1;
 	struct {
 		bool mozilla_canary :1;
 		bool icloud_private_relay :1;
@@ -67,6 +74,7 @@ typedef struct {
 	enum ptr_type pihole_ptr;
 	int maxDBdays;
 	int port;
+	int api_replica_port;
 	int maxlogage;
 	int dns_port;
 	unsigned int delay_startup;
@@ -78,6 +86,15 @@ typedef struct {
 	} rate_limit;
 	enum debug_flags debug;
 	time_t DBinterval;
+	unsigned int DBslowquery;
+	unsigned int api_cache_ms;
+	unsigned int upstream_probe;
+	unsigned int tcp_pool_idle;
+	unsigned int slow_query_ms;
+	struct {
+		unsigned int size;
+		unsigned int interval;
+	} checkpoint;
 	struct {
 		struct {
 			bool overwrite_v4 :1;
@@ -101,6 +118,8 @@ typedef struct {
 	char* pid;
 	char* port;
 	char* socketfile;
+	char* api_socketfile;
+	char* slowquerylog;
 	char* FTL_db;
 	char* gravity_db;
 	char* macvendor_db;
@@ -111,4 +130,21 @@ typedef struct {
 extern ConfigStruct config;
 extern FTLFileNamesStruct FTLfiles;
 
+// Is debug logging enabled for any of these flags? Debug logging is the
+// exception, so the branch is marked as unlikely and the compiler lays out
+// the code without it first. Builds configured with -DDEBUG_LOGGING=false
+// do not contain debug logging at all (the code is still type checked)
+//
+// We deliberately do not select debug/non-debug variants of the hot
+// functions (_lock_shm(), _unlock_shm(), match_regex(),
+// _FTL_check_blocking()) through function pointers at runtime: the check
+// is a single load of config.debug and a well-predicted branch, while an
+// indirect call cannot be inlined or constant-folded and every function
+// would have to be maintained twice. Use -DDEBUG_LOGGING=false instead.
+#ifdef NO_DEBUG_LOGGING
+#define debug_enabled(flags) (false && (config.debug & (flags)))
+#else
+#define debug_enabled(flags) __builtin_expect((config.debug & (flags)) != 0, 0)
+#endif
+
 #endif //CONFIG_H
@@ -46,7 +46,7 @@ static void recompute_aliasclient(const int aliasclientID)
 {
 	clientsData *aliasclient = getClient(aliasclientID, true);
 
-	if(config.debug & DEBUG_ALIASCLIENTS)
+	if(debug_enabled(DEBUG_ALIASCLIENTS))
 	{
 		logg("Recomputing alias-client \"%s\" (%s)...",
 		     getstr(aliasclient->namepos), getstr(aliasclient->ippos));
@@ -69,7 +69,7 @@ static void recompute_aliasclient(const int aliasclientID)
 		// Skip clients that are not managed by this aliasclient
 		if(client->aliasclient_id != aliasclientID)
 		{
-			if(config.debug & DEBUG_ALIASCLIENTS)
+			if(debug_enabled(DEBUG_ALIASCLIENTS))
 			{
 				logg("Client \"%s\" (%s) NOT managed by this alias-client, skipping",
 				     getstr(client->namepos), getstr(client->ippos));
@@ -78,7 +78,7 @@ static void recompute_aliasclient(const int aliasclientID)
 		}
 
 		// Debug logging
-		if(config.debug & DEBUG_ALIASCLIENTS)
+		if(debug_enabled(DEBUG_ALIASCLIENTS))
 		{
 			logg("Client \"%s\" (%s) IS  managed by this alias-client, adding counts",
 					getstr(client->namepos), getstr(client->ippos));
@@ -159,7 +159,7 @@ bool import_aliasclients(sqlite3 *db)
 		client->aliasclient_id = aliasclient_id;
 
 		// Debug logging
-		if(config.debug & DEBUG_ALIASCLIENTS)
+		if(debug_enabled(DEBUG_ALIASCLIENTS))
 		{
 			logg("Added alias-client \"%s\" (%s) with FTL ID %i", name, aliasclient_str, clientID);
 		}
@@ -188,7 +188,7 @@ static int get_aliasclient_ID(sqlite3 *db, const clientsData *client)
 		return -1;
 
 	const char *clientIP = getstr(client->ippos);
-	if(config.debug & DEBUG_ALIASCLIENTS)
+	if(debug_enabled(DEBUG_ALIASCLIENTS))
 	{
 		logg("   Looking for the alias-client for client %s...",
 		     clientIP);
@@ -212,7 +212,7 @@ static int get_aliasclient_ID(sqlite3 *db, const clientsData *client)
 		// alias client candidate's MAC address
 		if(alias_client->aliasclient_id == aliasclient_DBid)
 		{
-			if(config.debug & DEBUG_ALIASCLIENTS)
+			if(debug_enabled(DEBUG_ALIASCLIENTS))
 			{
 				logg("   -> \"%s\" (%s)",
 				     getstr(alias_client->namepos),
@@ -223,7 +223,7 @@ static int get_aliasclient_ID(sqlite3 *db, const clientsData *client)
 		}
 	}
 
-	if(config.debug & DEBUG_ALIASCLIENTS && aliasclientID == counters->clients)
+	if(debug_enabled(DEBUG_ALIASCLIENTS) && aliasclientID == counters->clients)
 	{
 		logg("   -> not found");
 	}
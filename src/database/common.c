@@ -25,6 +25,10 @@
 #include "aliasclients.h"
 // add_additional_info_column()
 #include "query-table.h"
+// DB_wal_connection_setup()
+#include "wal.h"
+// DB_register_profiler()
+#include "sqlite3-profile.h"
 
 bool DBdeleteoldqueries = false;
 static bool DBerror = false;
@@ -60,7 +64,7 @@ void _dbclose(sqlite3 **db, const char *func, const int line, const char *file)
 	if(FTLDBerror())
 		return;
 
-	if(config.debug & DEBUG_DATABASE)
+	if(debug_enabled(DEBUG_DATABASE))
 		logg("Closing FTL database in %s() (%s:%i)", func, file, line);
 
 	// Only try to close an existing database connection
@@ -83,7 +87,7 @@ sqlite3* _dbopen(bool create, const char *func, const int line, const char *file
 		return NULL;
 
 	// Try to open database
-	if(config.debug & DEBUG_DATABASE)
+	if(debug_enabled(DEBUG_DATABASE))
 		logg("Opening FTL database in %s() (%s:%i)", func, file, line);
 
 	int flags = SQLITE_OPEN_READWRITE;
@@ -110,6 +114,12 @@ sqlite3* _dbopen(bool create, const char *func, const int line, const char *file
 		return NULL;
 	}
 
+	// Checkpoints are scheduled by the database thread
+	DB_wal_connection_setup(db);
+
+	// Register statement profiler (if enabled)
+	DB_register_profiler(db);
+
 	return db;
 }
 
@@ -139,7 +149,7 @@ int dbquery(sqlite3* db, const char *format, ...)
 		return SQLITE_ERROR;
 	}
 
-	if(config.debug & DEBUG_DATABASE)
+	if(debug_enabled(DEBUG_DATABASE))
 	{
 		logg("dbquery: \"%s\"", query);
 	}
@@ -156,7 +166,7 @@ int dbquery(sqlite3* db, const char *format, ...)
 	// Free allocated memory for query string
 	sqlite3_free(query);
 
-	if(config.debug & DEBUG_DATABASE)
+	if(debug_enabled(DEBUG_DATABASE))
 	{
 		logg("         ---> OK");
 	}
@@ -465,6 +475,24 @@ void db_init(void)
 		dbversion = db_get_int(db, DB_VERSION);
 	}
 
+	// Update to version 13 if lower
+	if(dbversion < 13)
+	{
+		// Update to version 13: Store number of queries in the counters table
+		logg("Updating long-term database to version 13");
+		if(!create_stored_queries_counter(db))
+		{
+			logg("Stored queries counter not initialized, database not available");
+			dbclose(&db);
+			return;
+		}
+		// Get updated version
+		dbversion = db_get_int(db, DB_VERSION);
+	}
+
+	// Set journal mode (WAL or rollback journal)
+	DB_set_journal_mode(db);
+
 	lock_shm();
 	import_aliasclients(db);
 	unlock_shm();
@@ -520,6 +548,24 @@ bool db_set_counter(sqlite3 *db, const enum counters_table_props ID, const long
 	return true;
 }
 
+int db_get_counter(sqlite3 *db, const enum counters_table_props ID)
+{
+	// Prepare SQL statement
+	char* querystr = NULL;
+	int ret = asprintf(&querystr, "SELECT value FROM counters WHERE id = %u;", ID);
+
+	if(querystr == NULL || ret < 0)
+	{
+		logg("Memory allocation failed in db_get_counter db, with ID = %u (%i)", ID, ret);
+		return DB_FAILED;
+	}
+
+	int value = db_query_int(db, querystr);
+	free(querystr);
+
+	return value;
+}
+
 bool db_update_counters(sqlite3 *db, const int total, const int blocked)
 {
 	int rc = dbquery(db, "UPDATE counters SET value = value + %i WHERE id = %i;", total, DB_TOTALQUERIES);
@@ -539,13 +585,27 @@ bool db_update_counters(sqlite3 *db, const int total, const int blocked)
 	return true;
 }
 
+// Keep the number of rows in query_storage up-to-date. This has to be called
+// in the same transaction inserting into or deleting from query_storage
+bool db_update_stored_queries(sqlite3 *db, const int delta)
+{
+	const int rc = dbquery(db, "UPDATE counters SET value = value + %i WHERE id = %i;", delta, DB_STOREDQUERIES);
+	if(rc != SQLITE_OK)
+	{
+		checkFTLDBrc(rc);
+		return false;
+	}
+
+	return true;
+}
+
 int db_query_int(sqlite3 *db, const char* querystr)
 {
 	// Return early if the database is known to be broken
 	if(FTLDBerror())
 		return DB_FAILED;
 
-	if(config.debug & DEBUG_DATABASE)
+	if(debug_enabled(DEBUG_DATABASE))
 	{
 		logg("dbquery: \"%s\"", querystr);
 	}
@@ -566,14 +626,14 @@ int db_query_int(sqlite3 *db, const char* querystr)
 	if( rc == SQLITE_ROW )
 	{
 		result = sqlite3_column_int(stmt, 0);
-		if(config.debug & DEBUG_DATABASE)
+		if(debug_enabled(DEBUG_DATABASE))
 			logg("         ---> Result %i (int)", result);
 	}
 	else if( rc == SQLITE_DONE )
 	{
 		// No rows available
 		result = DB_NODATA;
-		if(config.debug & DEBUG_DATABASE)
+		if(debug_enabled(DEBUG_DATABASE))
 			logg("         ---> No data");
 	}
 	else
@@ -594,7 +654,7 @@ long int get_max_query_ID(sqlite3 *db)
 		return DB_FAILED;
 
 	const char *sql = "SELECT MAX(ID) FROM queries";
-	if(config.debug & DEBUG_DATABASE)
+	if(debug_enabled(DEBUG_DATABASE))
 		logg("dbquery: \"%s\"", sql);
 
 	sqlite3_stmt* stmt = NULL;
@@ -620,7 +680,7 @@ long int get_max_query_ID(sqlite3 *db)
 	}
 
 	sqlite3_int64 result = sqlite3_column_int64(stmt, 0);
-	if(config.debug & DEBUG_DATABASE)
+	if(debug_enabled(DEBUG_DATABASE))
 	{
 		logg("         ---> Result %lli (long long int)", (long long int)result);
 	}
@@ -22,13 +22,15 @@ enum ftl_table_props {
 // Database table "counters"
 enum counters_table_props {
 	DB_TOTALQUERIES,
-	DB_BLOCKEDQUERIES
+	DB_BLOCKEDQUERIES,
+	DB_STOREDQUERIES
 } __attribute__ ((packed));
 
 void db_init(void);
 int db_get_int(sqlite3* db, const enum ftl_table_props ID);
 bool db_set_FTL_property(sqlite3 *db, const enum ftl_table_props ID, const long value);
 bool db_set_counter(sqlite3 *db, const enum counters_table_props ID, const long value);
+int db_get_counter(sqlite3 *db, const enum counters_table_props ID);
 
 /// Execute a formatted SQL query and get the return code
 int dbquery(sqlite3* db, const char *format, ...) __attribute__ ((format (gnu_printf, 2, 3)));;
@@ -42,6 +44,7 @@ int db_query_int(sqlite3 *db, const char *querystr);
 void SQLite3LogCallback(void *pArg, int iErrCode, const char *zMsg);
 long int get_max_query_ID(sqlite3 *db);
 bool db_update_counters(sqlite3 *db, const int total, const int blocked);
+bool db_update_stored_queries(sqlite3 *db, const int delta);
 const char *get_sqlite3_version(void);
 
 extern long int lastdbindex;
@@ -28,6 +28,10 @@
 #include "../events.h"
 // check_blocking_status()
 #include "../setupVars.h"
+// DB_checkpoint()
+#include "wal.h"
+// api_cache_invalidate()
+#include "../api/cache.h"
 
 #define DBOPEN_OR_AGAIN() { db = dbopen(false); if(db == NULL) { thread_sleepms(DB, 5000); continue; } }
 #define BREAK_IF_KILLED() { if(killed) break; }
@@ -42,6 +46,11 @@ void *DB_thread(void *val)
 	// Save timestamp as we do not want to store immediately
 	// to the database
 	time_t lastDBsave = time(NULL) - time(NULL)%config.DBinterval;
+	time_t lastCheckpointCheck = 0;
+
+	// Open the connection used for WAL checkpointing. It is kept open
+	// until this thread terminates
+	DB_wal_open();
 
 	// This thread runs until shutdown of the process. We keep this thread
 	// running when pihole-FTL.db is corrupted because reloading of privacy
@@ -72,6 +81,10 @@ void *DB_thread(void *val)
 				}
 
 				DBCLOSE_OR_BREAK();
+
+				// Checkpoint the WAL now that the shared memory
+				// lock has been released again
+				DB_checkpoint();
 			}
 
 			// Parse neighbor cache (fill network table) if enabled
@@ -79,6 +92,16 @@ void *DB_thread(void *val)
 				set_event(PARSE_NEIGHBOR_CACHE);
 		}
 
+		// Checkpoint the WAL in this idle window if it grew too
+		// large or if a full checkpoint is overdue (checked once
+		// per second)
+		if(now != lastCheckpointCheck)
+		{
+			lastCheckpointCheck = now;
+			if(DB_checkpoint_due(now))
+				DB_checkpoint();
+		}
+
 		// Update MAC vendor strings once a month (the MAC vendor
 		// database is not updated very often)
 		if(now % 2592000L == 0)
@@ -99,6 +122,8 @@ void *DB_thread(void *val)
 		// Import alias-clients
 		if(get_and_clear_event(REIMPORT_ALIASCLIENTS))
 		{
+			// Alias-clients may have been assigned to devices
+			network_cache_invalidate();
 			DBOPEN_OR_AGAIN();
 			lock_shm();
 			reimport_aliasclients(db);
@@ -108,19 +133,31 @@ void *DB_thread(void *val)
 
 		// Process database related event queue elements
 		if(get_and_clear_event(RELOAD_GRAVITY))
+		{
+			// Reload the network tables as well, they may have been
+			// modified by the user (e.g., through the web interface)
+			network_cache_invalidate();
 			FTL_reload_all_domainlists();
+			api_cache_invalidate();
+		}
 
 		BREAK_IF_KILLED();
 
 		// Reload privacy level from pihole-FTL.conf
 		if(get_and_clear_event(RELOAD_PRIVACY_LEVEL))
+		{
 			get_privacy_level(NULL);
+			api_cache_invalidate();
+		}
 
 		BREAK_IF_KILLED();
 
 		// Inspect setupVars.conf to see if Pi-hole blocking is enabled
 		if(get_and_clear_event(RELOAD_BLOCKINGSTATUS))
+		{
 			check_blocking_status();
+			api_cache_invalidate();
+		}
 
 		BREAK_IF_KILLED();
 
@@ -128,6 +165,9 @@ void *DB_thread(void *val)
 		thread_sleepms(DB, 100);
 	}
 
+	// Write back the WAL before terminating
+	DB_wal_close();
+
 	logg("Terminating database thread");
 	return NULL;
 }
@@ -31,6 +31,10 @@
 
 // Definition of struct regexData
 #include "../regex_r.h"
+// DB_register_profiler()
+#include "sqlite3-profile.h"
+// arena_strdup()
+#include "../arena.h"
 
 // Prefix of interface names in the client table
 #define INTERFACE_SEP ":"
@@ -143,12 +147,12 @@ bool gravityDB_open(void)
 
 	if(gravityDB_opened && gravity_db != NULL)
 	{
-		if(config.debug & DEBUG_DATABASE)
+		if(debug_enabled(DEBUG_DATABASE))
 			logg("gravityDB_open(): Database already connected");
 		return true;
 	}
 
-	if(config.debug & DEBUG_DATABASE)
+	if(debug_enabled(DEBUG_DATABASE))
 		logg("gravityDB_open(): Trying to open %s in read-only mode", FTLfiles.gravity_db);
 	int rc = sqlite3_open_v2(FTLfiles.gravity_db, &gravity_db, SQLITE_OPEN_READONLY, NULL);
 	if( rc != SQLITE_OK )
@@ -161,9 +165,12 @@ bool gravityDB_open(void)
 	// Database connection is now open
 	gravityDB_opened = true;
 
+	// Register statement profiler (if enabled)
+	DB_register_profiler(gravity_db);
+
 	// Tell SQLite3 to store temporary tables in memory. This speeds up read operations on
 	// temporary tables, indices, and views.
-	if(config.debug & DEBUG_DATABASE)
+	if(debug_enabled(DEBUG_DATABASE))
 		logg("gravityDB_open(): Setting location for temporary object to MEMORY");
 	char *zErrMsg = NULL;
 	rc = sqlite3_exec(gravity_db, "PRAGMA temp_store = MEMORY", NULL, NULL, &zErrMsg);
@@ -176,7 +183,7 @@ bool gravityDB_open(void)
 	}
 
 	// Prepare audit statement
-	if(config.debug & DEBUG_DATABASE)
+	if(debug_enabled(DEBUG_DATABASE))
 		logg("gravityDB_open(): Preparing audit query");
 
 	// We support adding audit domains with a wildcard character (*)
@@ -208,7 +215,7 @@ bool gravityDB_open(void)
 	// Set SQLite3 busy timeout to a user-defined value (defaults to 1 second)
 	// to avoid immediate failures when the gravity database is still busy
 	// writing the changes to disk
-	if(config.debug & DEBUG_DATABASE)
+	if(debug_enabled(DEBUG_DATABASE))
 		logg("gravityDB_open(): Setting busy timeout to %d", DATABASE_BUSY_TIMEOUT);
 	sqlite3_busy_timeout(gravity_db, DATABASE_BUSY_TIMEOUT);
 
@@ -221,7 +228,7 @@ bool gravityDB_open(void)
 		gravity_stmt = new_sqlite3_stmt_vec(counters->clients);
 
 	// Explicitly set busy handler to zero milliseconds
-	if(config.debug & DEBUG_DATABASE)
+	if(debug_enabled(DEBUG_DATABASE))
 		logg("gravityDB_open(): Setting busy timeout to zero");
 	rc = sqlite3_busy_timeout(gravity_db, 0);
 	if(rc != SQLITE_OK)
@@ -233,7 +240,7 @@ bool gravityDB_open(void)
 	// entries in the database
 	gravity_check_ABP_format();
 
-	if(config.debug & DEBUG_DATABASE)
+	if(debug_enabled(DEBUG_DATABASE))
 		logg("gravityDB_open(): Successfully opened gravity.db");
 	return true;
 }
@@ -257,7 +264,7 @@ static char* get_client_querystr(const char *table, const char *column, const ch
 		return NULL;
 	}
 
-	if(config.debug & DEBUG_DATABASE)
+	if(debug_enabled(DEBUG_DATABASE))
 		logg("get_client_querystr: %s", querystr);
 
 	return querystr;
@@ -297,7 +304,7 @@ static bool get_client_groupids(clientsData* client)
 		return false;
 	}
 
-	if(config.debug & DEBUG_CLIENTS)
+	if(debug_enabled(DEBUG_CLIENTS))
 		logg("Querying gravity database for client with IP %s...", ip);
 
 	// Check if client is configured through the client table
@@ -344,13 +351,13 @@ static bool get_client_groupids(clientsData* client)
 		matching_ids = strdup((const char*)sqlite3_column_text(table_stmt, 3));
 		matching_bits = sqlite3_column_int(table_stmt, 4);
 
-		if(config.debug & DEBUG_CLIENTS && matching_count == 1)
+		if(debug_enabled(DEBUG_CLIENTS) && matching_count == 1)
 			// Case matching_count > 1 handled below using logg_subnet_warning()
 			logg("--> Found record for %s in the client table (group ID %d)", ip, chosen_match_id);
 	}
 	else if(rc == SQLITE_DONE)
 	{
-		if(config.debug & DEBUG_CLIENTS)
+		if(debug_enabled(DEBUG_CLIENTS))
 			logg("--> No record for %s in the client table", ip);
 	}
 	else
@@ -397,13 +404,13 @@ static bool get_client_groupids(clientsData* client)
 	char *hwaddr = NULL;
 	if(chosen_match_id < 0)
 	{
-		if(config.debug & DEBUG_CLIENTS)
+		if(debug_enabled(DEBUG_CLIENTS))
 			logg("Querying gravity database for MAC address of %s...", ip);
 
 		// Do the lookup
 		hwaddr = getMACfromIP(NULL, ip);
 
-		if(hwaddr == NULL && config.debug & DEBUG_CLIENTS)
+		if(hwaddr == NULL && debug_enabled(DEBUG_CLIENTS))
 		{
 			logg("--> No result.");
 		}
@@ -412,7 +419,7 @@ static bool get_client_groupids(clientsData* client)
 			free(hwaddr);
 			hwaddr = NULL;
 
-			if(config.debug & DEBUG_CLIENTS)
+			if(debug_enabled(DEBUG_CLIENTS))
 				logg("Skipping mock-device hardware address lookup");
 		}
 		// Set MAC address from database information if available and the MAC address is not already set
@@ -441,7 +448,7 @@ static bool get_client_groupids(clientsData* client)
 			         client->hwaddr[0], client->hwaddr[1], client->hwaddr[2],
 			         client->hwaddr[3], client->hwaddr[4], client->hwaddr[5]);
 
-			if(config.debug & DEBUG_CLIENTS)
+			if(debug_enabled(DEBUG_CLIENTS))
 				logg("--> Obtained %s from internal ARP cache", hwaddr);
 		}
 	}
@@ -450,7 +457,7 @@ static bool get_client_groupids(clientsData* client)
 	// This ensures we skip mock hardware addresses such as "ip-127.0.0.1"
 	if(hwaddr != NULL)
 	{
-		if(config.debug & DEBUG_CLIENTS)
+		if(debug_enabled(DEBUG_CLIENTS))
 			logg("--> Querying client table for %s", hwaddr);
 
 		// Check if client is configured through the client table
@@ -487,12 +494,12 @@ static bool get_client_groupids(clientsData* client)
 			// extract the result (there can be at most one line)
 			chosen_match_id = sqlite3_column_int(table_stmt, 0);
 
-			if(config.debug & DEBUG_CLIENTS)
+			if(debug_enabled(DEBUG_CLIENTS))
 				logg("--> Found record for %s in the client table (group ID %d)", hwaddr, chosen_match_id);
 		}
 		else if(rc == SQLITE_DONE)
 		{
-			if(config.debug & DEBUG_CLIENTS)
+			if(debug_enabled(DEBUG_CLIENTS))
 				logg("--> There is no record for %s in the client table", hwaddr);
 		}
 		else
@@ -516,20 +523,20 @@ static bool get_client_groupids(clientsData* client)
 	char *hostname = NULL;
 	if(chosen_match_id < 0)
 	{
-		if(config.debug & DEBUG_CLIENTS)
+		if(debug_enabled(DEBUG_CLIENTS))
 			logg("Querying gravity database for host name of %s...", ip);
 
 		// Do the lookup
 		hostname = getNameFromIP(NULL, ip);
 
-		if(hostname == NULL && config.debug & DEBUG_CLIENTS)
+		if(hostname == NULL && debug_enabled(DEBUG_CLIENTS))
 			logg("--> No result.");
 
 		if(hostname != NULL && strlen(hostname) == 0)
 		{
 			free(hostname);
 			hostname = NULL;
-			if(config.debug & DEBUG_CLIENTS)
+			if(debug_enabled(DEBUG_CLIENTS))
 				logg("Skipping empty host name lookup");
 		}
 	}
@@ -538,7 +545,7 @@ static bool get_client_groupids(clientsData* client)
 	// This ensures we skip mock hardware addresses such as "ip-127.0.0.1"
 	if(hostname != NULL)
 	{
-		if(config.debug & DEBUG_CLIENTS)
+		if(debug_enabled(DEBUG_CLIENTS))
 			logg("--> Querying client table for %s", hostname);
 
 		// Check if client is configured through the client table
@@ -577,12 +584,12 @@ static bool get_client_groupids(clientsData* client)
 			// extract the result (there can be at most one line)
 			chosen_match_id = sqlite3_column_int(table_stmt, 0);
 
-			if(config.debug & DEBUG_CLIENTS)
+			if(debug_enabled(DEBUG_CLIENTS))
 				logg("--> Found record for %s in the client table (group ID %d)", hostname, chosen_match_id);
 		}
 		else if(rc == SQLITE_DONE)
 		{
-			if(config.debug & DEBUG_CLIENTS)
+			if(debug_enabled(DEBUG_CLIENTS))
 				logg("--> There is no record for %s in the client table", hostname);
 		}
 		else
@@ -608,20 +615,20 @@ static bool get_client_groupids(clientsData* client)
 	char *interface = NULL;
 	if(chosen_match_id < 0)
 	{
-		if(config.debug & DEBUG_CLIENTS)
+		if(debug_enabled(DEBUG_CLIENTS))
 			logg("Querying gravity database for interface of %s...", ip);
 
 		// Do the lookup
 		interface = getIfaceFromIP(NULL, ip);
 
-		if(interface == NULL && config.debug & DEBUG_CLIENTS)
+		if(interface == NULL && debug_enabled(DEBUG_CLIENTS))
 			logg("--> No result.");
 
 		if(interface != NULL && strlen(interface) == 0)
 		{
 			free(interface);
 			interface = 0;
-			if(config.debug & DEBUG_CLIENTS)
+			if(debug_enabled(DEBUG_CLIENTS))
 				logg("Skipping empty interface lookup");
 		}
 	}
@@ -629,7 +636,7 @@ static bool get_client_groupids(clientsData* client)
 	// Check if we received a valid interface
 	if(interface != NULL)
 	{
-		if(config.debug & DEBUG_CLIENTS)
+		if(debug_enabled(DEBUG_CLIENTS))
 			logg("Querying client table for interface "INTERFACE_SEP"%s", interface);
 
 		// Check if client is configured through the client table using its interface
@@ -671,12 +678,12 @@ static bool get_client_groupids(clientsData* client)
 			// extract the result (there can be at most one line)
 			chosen_match_id = sqlite3_column_int(table_stmt, 0);
 
-			if(config.debug & DEBUG_CLIENTS)
+			if(debug_enabled(DEBUG_CLIENTS))
 				logg("--> Found record for interface "INTERFACE_SEP"%s in the client table (group ID %d)", interface, chosen_match_id);
 		}
 		else if(rc == SQLITE_DONE)
 		{
-			if(config.debug & DEBUG_CLIENTS)
+			if(debug_enabled(DEBUG_CLIENTS))
 				logg("--> There is no record for interface "INTERFACE_SEP"%s in the client table", interface);
 		}
 		else
@@ -700,7 +707,7 @@ static bool get_client_groupids(clientsData* client)
 	// (the client is not configured through the client table)
 	if(chosen_match_id < 0)
 	{
-		if(config.debug & DEBUG_CLIENTS)
+		if(debug_enabled(DEBUG_CLIENTS))
 			logg("Gravity database: Client %s not found. Using default group.\n",
 			     show_client_string(hwaddr, hostname, ip));
 
@@ -736,7 +743,7 @@ static bool get_client_groupids(clientsData* client)
 	querystr = "SELECT GROUP_CONCAT(group_id) FROM client_by_group "
 	           "WHERE client_id = ?;";
 
-	if(config.debug & DEBUG_CLIENTS)
+	if(debug_enabled(DEBUG_CLIENTS))
 		logg("Querying gravity database for client %s (getting groups)", ip);
 
 	// Prepare query
@@ -788,7 +795,7 @@ static bool get_client_groupids(clientsData* client)
 	// Finalize statement
 	gravityDB_finalizeTable();
 
-	if(config.debug & DEBUG_CLIENTS)
+	if(debug_enabled(DEBUG_CLIENTS))
 	{
 		if(interface != NULL)
 		{
@@ -834,7 +841,7 @@ char* __attribute__ ((malloc)) get_client_names_from_ids(const char *group_ids)
 		return NULL;
 	}
 
-	if(config.debug & DEBUG_DATABASE)
+	if(debug_enabled(DEBUG_DATABASE))
 		logg("Querying group names for IDs (%s)", group_ids);
 
 	// Prepare query
@@ -886,7 +893,7 @@ bool gravityDB_prepare_client_statements(clientsData *client)
 
 	const char *clientip = getstr(client->ippos);
 
-	if(config.debug & DEBUG_DATABASE)
+	if(debug_enabled(DEBUG_DATABASE))
 		logg("Initializing gravity statements for %s", clientip);
 
 	// Get associated groups for this client (if defined)
@@ -895,7 +902,7 @@ bool gravityDB_prepare_client_statements(clientsData *client)
 		return false;
 
 	// Prepare whitelist statement
-	if(config.debug & DEBUG_DATABASE)
+	if(debug_enabled(DEBUG_DATABASE))
 		logg("gravityDB_open(): Preparing vw_whitelist statement for client %s", clientip);
 	querystr = get_client_querystr("vw_whitelist", "id", getstr(client->groupspos));
 	sqlite3_stmt* stmt = NULL;
@@ -910,7 +917,7 @@ bool gravityDB_prepare_client_statements(clientsData *client)
 	free(querystr);
 
 	// Prepare gravity statement
-	if(config.debug & DEBUG_DATABASE)
+	if(debug_enabled(DEBUG_DATABASE))
 		logg("gravityDB_open(): Preparing vw_gravity statement for client %s", clientip);
 	querystr = get_client_querystr("vw_gravity", "domain", getstr(client->groupspos));
 	rc = sqlite3_prepare_v3(gravity_db, querystr, -1, SQLITE_PREPARE_PERSISTENT, &stmt, NULL);
@@ -924,7 +931,7 @@ bool gravityDB_prepare_client_statements(clientsData *client)
 	free(querystr);
 
 	// Prepare blacklist statement
-	if(config.debug & DEBUG_DATABASE)
+	if(debug_enabled(DEBUG_DATABASE))
 		logg("gravityDB_open(): Preparing vw_blacklist statement for client %s", clientip);
 	querystr = get_client_querystr("vw_blacklist", "id", getstr(client->groupspos));
 	rc = sqlite3_prepare_v3(gravity_db, querystr, -1, SQLITE_PREPARE_PERSISTENT, &stmt, NULL);
@@ -943,7 +950,7 @@ bool gravityDB_prepare_client_statements(clientsData *client)
 // Finalize non-NULL prepared statements and set them to NULL for a given client
 static inline void gravityDB_finalize_client_statements(clientsData *client)
 {
-	if(config.debug & DEBUG_DATABASE)
+	if(debug_enabled(DEBUG_DATABASE))
 		logg("Finalizing gravity statements for %s", getstr(client->ippos));
 
 	if(whitelist_stmt != NULL &&
@@ -1136,7 +1143,7 @@ int gravityDB_count(const enum gravity_tables list)
 			return DB_FAILED;
 	}
 
-	if(config.debug & DEBUG_DATABASE)
+	if(debug_enabled(DEBUG_DATABASE))
 		logg("Querying count of distinct domains in gravity database table %s: %s",
 		     tablename[list], querystr);
 
@@ -1168,7 +1175,7 @@ int gravityDB_count(const enum gravity_tables list)
 	// Finalize statement
 	gravityDB_finalizeTable();
 
-	if(config.debug & DEBUG_DATABASE)
+	if(debug_enabled(DEBUG_DATABASE))
 	{
 		logg("gravityDB_count(%d): %i entries in %s",
 		     list, result, tablename[list]);
@@ -1228,7 +1235,7 @@ static enum db_result domain_in_list(const char *domain, sqlite3_stmt *stmt, con
 	if(domain_id != NULL)
 		*domain_id = result;
 
-	if(config.debug & DEBUG_DATABASE)
+	if(debug_enabled(DEBUG_DATABASE))
 		logg("domain_in_list(\"%s\", %p, %s): %d", domain, stmt, listname, result);
 
 	// The sqlite3_reset() function is called to reset a prepared statement
@@ -1265,7 +1272,7 @@ static void gravityDB_client_check_again(clientsData* client)
 	if(check_count <= NUM_RECHECKS && diff > check_count * RECHECK_DELAY)
 	{
 		const char *ord = get_ordinal_suffix(check_count);
-		if(config.debug & DEBUG_CLIENTS)
+		if(debug_enabled(DEBUG_CLIENTS))
 			logg("Reloading client groups after %u seconds (%u%s check)",
 			     (unsigned int)diff, check_count, ord);
 		client->reread_groups++;
@@ -1331,7 +1338,7 @@ enum db_result in_gravity(const char *domain, clientsData *client)
 
 	// Check if domain is exactly in gravity list
 	const enum db_result exact_match = domain_in_list(domain, stmt, "gravity", NULL);
-	if(config.debug & DEBUG_QUERIES)
+	if(debug_enabled(DEBUG_QUERIES))
 		logg("Checking if \"%s\" is in gravity: %s",
 		     domain, exact_match == FOUND ? "yes" : "no");
 	// Return for anything else than "not found" (e.g. "found" or "list not available")
@@ -1346,10 +1353,11 @@ enum db_result in_gravity(const char *domain, clientsData *client)
 
 	// Make a copy of the domain we will slowly truncate
 	// while extracting the individual components below
-	char *domainBuf = strdup(domain);
+	const size_t mark = arena_mark();
+	char *domainBuf = arena_strdup(domain);
 
 	// Buffer to hold the constructed (sub)domain in ABP format
-	char *abpDomain = calloc(strlen(domain) + 4, sizeof(char));
+	char *abpDomain = arena_alloc(strlen(domain) + 4);
 	// Prime abp matcher with minimal content
 	strcpy(abpDomain, "||^");
 
@@ -1394,14 +1402,13 @@ enum db_result in_gravity(const char *domain, clientsData *client)
 		}
 		// Check if the constructed ABP-style domain is in the gravity list
 		const enum db_result abp_match = domain_in_list(abpDomain, stmt, "gravity", NULL);
-		if(config.debug & DEBUG_QUERIES)
+		if(debug_enabled(DEBUG_QUERIES))
 			logg("Checking if \"%s\" is in gravity: %s",
 			     abpDomain, abp_match == FOUND ? "yes" : "no");
 		// Return for anything else than "not found" (e.g. "found" or "list not available")
 		if(abp_match != NOT_FOUND)
 		{
-			free(domainBuf);
-			free(abpDomain);
+			arena_release(mark);
 			return abp_match;
 		}
 		// Truncate the domain buffer to the left of the
@@ -1420,8 +1427,7 @@ enum db_result in_gravity(const char *domain, clientsData *client)
 		abpDomain[2] = '.';
 	}
 
-	free(domainBuf);
-	free(abpDomain);
+	arena_release(mark);
 
 	// Domain not found in gravity list
 	return NOT_FOUND;
@@ -1469,7 +1475,7 @@ bool in_auditlist(const char *domain)
 bool gravityDB_get_regex_client_groups(clientsData* client, const unsigned int numregex, const regexData *regex,
                                        const unsigned char type, const char* table)
 {
-	if(config.debug & DEBUG_REGEX)
+	if(debug_enabled(DEBUG_REGEX))
 		logg("Getting regex client groups for client with ID %i", client->id);
 
 	char *querystr = NULL;
@@ -1495,7 +1501,7 @@ bool gravityDB_get_regex_client_groups(clientsData* client, const unsigned int n
 	}
 
 	// Perform query
-	if(config.debug & DEBUG_REGEX)
+	if(debug_enabled(DEBUG_REGEX))
 		logg("Regex %s: Querying groups for client %s: \"%s\"", regextype[type], getstr(client->ippos), querystr);
 	while((rc = sqlite3_step(query_stmt)) == SQLITE_ROW)
 	{
@@ -1509,7 +1515,7 @@ bool gravityDB_get_regex_client_groups(clientsData* client, const unsigned int n
 					regexID += get_num_regex(REGEX_BLACKLIST);
 				set_per_client_regex(client->id, regexID, true);
 
-				if(config.debug & DEBUG_REGEX)
+				if(debug_enabled(DEBUG_REGEX))
 					logg("Regex %s: Enabling regex with DB ID %i for client %s", regextype[type], result, getstr(client->ippos));
 
 				break;
@@ -231,7 +231,7 @@ static int find_device_by_recent_ip(sqlite3 *db, const char *ipaddr)
 		return -1;
 	}
 
-	if(config.debug & DEBUG_ARP)
+	if(debug_enabled(DEBUG_ARP))
 		logg("APR: Identified device %s using most recently used IP address", ipaddr);
 
 	// Found network_id
@@ -336,7 +336,7 @@ static int update_netDB_name(sqlite3 *db, const char *ip, const char *name)
 		return rc;
 	}
 
-	if(config.debug & DEBUG_DATABASE)
+	if(debug_enabled(DEBUG_DATABASE))
 	{
 		logg("dbquery: \"%s\" with arguments 1 = \"%s\" and 2 = \"%s\"",
 		     querystr, name, ip);
@@ -459,7 +459,7 @@ static int add_netDB_network_address(sqlite3 *db, const int network_id, const ch
 		return rc;
 	}
 
-	if(config.debug & DEBUG_DATABASE)
+	if(debug_enabled(DEBUG_DATABASE))
 	{
 		logg("dbquery: \"%s\" with arguments ?1 = %i and ?2 = \"%s\"",
 		     querystr, network_id, ip);
@@ -529,7 +529,7 @@ static int insert_netDB_device(sqlite3 *db, const char *hwaddr, time_t now, time
 		return rc;
 	}
 
-	if(config.debug & DEBUG_DATABASE)
+	if(debug_enabled(DEBUG_DATABASE))
 	{
 		logg("dbquery: \"%s\" with arguments ?1-?5 = (\"%s\",%lu,%lu,%u,\"%s\")",
 		     querystr, hwaddr, now, lastQuery, numQueriesARP, macVendor);
@@ -628,7 +628,7 @@ static int unmock_netDB_device(sqlite3 *db, const char *hwaddr, const char *macV
 		return rc;
 	}
 
-	if(config.debug & DEBUG_DATABASE)
+	if(debug_enabled(DEBUG_DATABASE))
 	{
 		logg("dbquery: \"%s\" with arguments ?1 = \"%s\", ?2 = \"%s\", ?3 = %i",
 		     querystr, hwaddr, macVendor, dbID);
@@ -710,7 +710,7 @@ static int update_netDB_interface(sqlite3 *db, const int network_id, const char
 		return rc;
 	}
 
-	if(config.debug & DEBUG_DATABASE)
+	if(debug_enabled(DEBUG_DATABASE))
 	{
 		logg("dbquery: \"%s\" with arguments ?1 = \"%s\" and ?2 = %i",
 		     querystr, iface, network_id);
@@ -779,7 +779,7 @@ static bool add_FTL_clients_to_network_table(sqlite3 *db, enum arp_status *clien
 		clientsData *client = getClient(clientID, true);
 		if(client == NULL)
 		{
-			if(config.debug & DEBUG_ARP)
+			if(debug_enabled(DEBUG_ARP))
 				logg("Network table: Client %d returned NULL pointer", clientID);
 			unlock_shm();
 			continue;
@@ -802,7 +802,7 @@ static bool add_FTL_clients_to_network_table(sqlite3 *db, enum arp_status *clien
 		// more clients to FTL's memory herein (those known only from the database))
 		if(client_status[clientID] != CLIENT_NOT_HANDLED)
 		{
-			if(config.debug & DEBUG_ARP)
+			if(debug_enabled(DEBUG_ARP))
 				logg("Network table: Client %s known through ARP/neigh cache",
 				     ipaddr);
 			if(ipaddr) free(ipaddr);
@@ -811,7 +811,7 @@ static bool add_FTL_clients_to_network_table(sqlite3 *db, enum arp_status *clien
 			unlock_shm();
 			continue;
 		}
-		else if(config.debug & DEBUG_ARP)
+		else if(debug_enabled(DEBUG_ARP))
 		{
 			logg("Network table: %s NOT known through ARP/neigh cache", ipaddr);
 		}
@@ -835,7 +835,7 @@ static bool add_FTL_clients_to_network_table(sqlite3 *db, enum arp_status *clien
 			// Reacquire client pointer (if may have changed when unlocking above)
 			client = getClient(clientID, true);
 
-			if(config.debug & DEBUG_ARP && dbID >= 0)
+			if(debug_enabled(DEBUG_ARP) && dbID >= 0)
 				logg("Network table: Client with MAC %s is network ID %i", hwaddr, dbID);
 		}
 		else
@@ -851,7 +851,7 @@ static bool add_FTL_clients_to_network_table(sqlite3 *db, enum arp_status *clien
 			// Reacquire client pointer (if may have changed when unlocking above)
 			client = getClient(clientID, true);
 
-			if(config.debug & DEBUG_ARP && dbID >= 0)
+			if(debug_enabled(DEBUG_ARP) && dbID >= 0)
 				logg("Network table: Client with IP %s has no MAC info but was recently be seen for network ID %i",
 				     ipaddr, dbID);
 
@@ -868,7 +868,7 @@ static bool add_FTL_clients_to_network_table(sqlite3 *db, enum arp_status *clien
 				// Reacquire client pointer (if may have changed when unlocking above)
 				client = getClient(clientID, true);
 
-				if(config.debug & DEBUG_ARP && dbID >= 0)
+				if(debug_enabled(DEBUG_ARP) && dbID >= 0)
 					logg("Network table: Client with IP %s has no MAC info but is known as mock-hwaddr client with network ID %i",
 					     ipaddr, dbID);
 			}
@@ -902,7 +902,7 @@ static bool add_FTL_clients_to_network_table(sqlite3 *db, enum arp_status *clien
 				client = getClient(clientID, true);
 			}
 
-			if(config.debug & DEBUG_ARP)
+			if(debug_enabled(DEBUG_ARP))
 				logg("Network table: Creating new FTL device MAC = %s, IP = %s, hostname = \"%s\", vendor = \"%s\", interface = \"%s\"",
 				     hwaddr, ipaddr, hostname, macVendor, interface);
 
@@ -931,7 +931,7 @@ static bool add_FTL_clients_to_network_table(sqlite3 *db, enum arp_status *clien
 		}
 		else	// Device already in database
 		{
-			if(config.debug & DEBUG_ARP)
+			if(debug_enabled(DEBUG_ARP))
 			{
 				logg("Network table: Updating existing FTL device MAC = %s, IP = %s, hostname = \"%s\", interface = \"%s\"",
 				     hwaddr, ipaddr, hostname, interface);
@@ -1113,7 +1113,7 @@ static bool add_local_interfaces_to_network_table(sqlite3 *db, time_t now, unsig
 			}
 		}
 
-		if(config.debug & DEBUG_ARP)
+		if(debug_enabled(DEBUG_ARP))
 		{
 			logg("Network table: read interface details for interface %s (%s) with address %s",
 			     iface, hwaddr, ipaddr);
@@ -1121,7 +1121,7 @@ static bool add_local_interfaces_to_network_table(sqlite3 *db, time_t now, unsig
 
 		// Try to find the device we parsed above
 		int dbID = find_device_by_hwaddr(db, hwaddr);
-		if(config.debug & DEBUG_ARP && dbID >= 0)
+		if(debug_enabled(DEBUG_ARP) && dbID >= 0)
 		{
 			logg("Network table (ip a): Client with MAC %s was recently be seen for network ID %i",
 			     hwaddr, dbID);
@@ -1141,7 +1141,7 @@ static bool add_local_interfaces_to_network_table(sqlite3 *db, time_t now, unsig
 		if(dbID == DB_NODATA)
 		{
 
-			if(config.debug & DEBUG_ARP)
+			if(debug_enabled(DEBUG_ARP))
 			{
 				logg("Network table: Creating new ip a device MAC = %s, IP = %s, vendor = \"%s\", interface = \"%s\"",
 					hwaddr, ipaddr, macVendor, iface);
@@ -1186,7 +1186,7 @@ static bool add_local_interfaces_to_network_table(sqlite3 *db, time_t now, unsig
 		}
 		else	// Device already in database
 		{
-			if(config.debug & DEBUG_ARP)
+			if(debug_enabled(DEBUG_ARP))
 			{
 				logg("Network table: Updating existing ip a device MAC = %s, IP = %s, interface = \"%s\"",
 				     hwaddr, ipaddr, iface);
@@ -1236,7 +1236,7 @@ void parse_neighbor_cache(sqlite3* db)
 	}
 
 	// Start ARP timer
-	if(config.debug & DEBUG_ARP)
+	if(debug_enabled(DEBUG_ARP))
 		timer_start(ARP_TIMER);
 
 	// Prepare buffers
@@ -1399,7 +1399,7 @@ void parse_neighbor_cache(sqlite3* db)
 			if(dbID == DB_NODATA)
 			{
 				// Device not known AND no recent mock-device found ---> create new device record
-				if(config.debug & DEBUG_ARP)
+				if(debug_enabled(DEBUG_ARP))
 				{
 					logg("Network table: Creating new ARP device MAC = %s, IP = %s, hostname = \"%s\", vendor = \"%s\"",
 					     hwaddr, ip, hostname, macVendor);
@@ -1438,7 +1438,7 @@ void parse_neighbor_cache(sqlite3* db)
 			else
 			{
 				// Device is ALREADY KNOWN ---> convert mock-device to a "real" one
-				if(config.debug & DEBUG_ARP)
+				if(debug_enabled(DEBUG_ARP))
 				{
 					logg("Network table: Un-mocking ARP device MAC = %s, IP = %s, hostname = \"%s\", vendor = \"%s\"",
 					     hwaddr, ip, hostname, macVendor);
@@ -1457,7 +1457,7 @@ void parse_neighbor_cache(sqlite3* db)
 		// Device in database AND client known to Pi-hole
 		else if(client_valid)
 		{
-			if(config.debug & DEBUG_ARP)
+			if(debug_enabled(DEBUG_ARP))
 			{
 				logg("Network table: Updating existing ARP device MAC = %s, IP = %s, hostname = \"%s\"",
 				     hwaddr, ip, hostname);
@@ -1578,8 +1578,11 @@ void parse_neighbor_cache(sqlite3* db)
 		return;
 	}
 
+	// Update in-memory copy of the network tables
+	network_cache_reload(db);
+
 	// Debug logging
-	if(config.debug & DEBUG_ARP)
+	if(debug_enabled(DEBUG_ARP))
 	{
 		logg("ARP table processing (%i entries from ARP, %i from FTL's cache) took %.1f ms",
 		     entries, additional_entries, timer_elapsed_msec(ARP_TIMER));
@@ -1674,14 +1677,14 @@ static char * __attribute__ ((malloc)) getMACVendor(const char *hwaddr)
 	if(stat(FTLfiles.macvendor_db, &st) != 0)
 	{
 		// File does not exist
-		if(config.debug & DEBUG_ARP)
+		if(debug_enabled(DEBUG_ARP))
 			logg("getMACVenor(\"%s\"): %s does not exist", hwaddr, FTLfiles.macvendor_db);
 		return strdup("");
 	}
 	else if(strlen(hwaddr) != 17 || strstr(hwaddr, "ip-") != NULL)
 	{
 		// MAC address is incomplete or mock address (for distant clients)
-		if(config.debug & DEBUG_ARP)
+		if(debug_enabled(DEBUG_ARP))
 			logg("getMACVenor(\"%s\"): MAC invalid (length %zu)", hwaddr, strlen(hwaddr));
 		return strdup("");
 	}
@@ -1742,7 +1745,7 @@ static char * __attribute__ ((malloc)) getMACVendor(const char *hwaddr)
 	sqlite3_finalize(stmt);
 	sqlite3_close(macvendor_db);
 
-	if(config.debug & DEBUG_DATABASE)
+	if(debug_enabled(DEBUG_DATABASE))
 		logg("DEBUG: MAC Vendor lookup for %s returned \"%s\"", hwaddr, vendor);
 
 	return vendor;
@@ -1758,7 +1761,7 @@ void updateMACVendorRecords(sqlite3 *db)
 	if(stat(FTLfiles.macvendor_db, &st) != 0)
 	{
 		// File does not exist
-		if(config.debug & DEBUG_ARP)
+		if(debug_enabled(DEBUG_ARP))
 			logg("updateMACVendorRecords(): \"%s\" does not exist", FTLfiles.macvendor_db);
 		return;
 	}
@@ -1820,172 +1823,322 @@ void updateMACVendorRecords(sqlite3 *db)
 	sqlite3_finalize(stmt);
 }
 
-// Get hardware address of device identified by IP address
-char *__attribute__((malloc)) getMACfromIP(sqlite3* db, const char *ipaddr)
+// In-memory copy of the network tables used for client identification. The
+// lookup functions below are called very frequently (e.g., for every client
+// when the lists are reloaded). Instead of querying the database each time,
+// we keep a sorted copy of all addresses and devices. It is reloaded after
+// every neighbor cache pass (which is the only place FTL modifies the
+// network tables) and lazily after it has been invalidated due to external
+// changes (e.g., alias-clients added through the web interface)
+struct netcache_device {
+	int id;
+	int aliasclient_id;
+	char *hwaddr;
+	char *iface;
+	// Most recent host name of any address of this device
+	char *name;
+	time_t nameSeen;
+};
+
+struct netcache_address {
+	char *ip;
+	char *name;
+	time_t lastSeen;
+	// Index into the devices array, -1 if there is no such device
+	int device;
+};
+
+static struct {
+	bool valid;
+	unsigned int num_devices;
+	unsigned int num_addresses;
+	struct netcache_device *devices;
+	struct netcache_address *addresses;
+} netcache = { false, 0u, 0u, NULL, NULL };
+static pthread_mutex_t netcache_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static char *strdup_column(sqlite3_stmt *stmt, const int col)
 {
-	// Return early if database is known to be broken
-	if(FTLDBerror())
-		return NULL;
+	const char *text = (const char*)sqlite3_column_text(stmt, col);
+	return text != NULL ? strdup(text) : NULL;
+}
 
-	// Open pihole-FTL.db database file if needed
-	bool db_opened = false;
-	if(db == NULL)
-	{
-		if((db = dbopen(false)) == NULL)
-		{
-			logg("getMACfromIP(\"%s\") - Failed to open DB", ipaddr);
-			return NULL;
-		}
+// Free all cached records. Has to be called while holding the lock
+static void netcache_free(void)
+{
+	for(unsigned int i = 0; i < netcache.num_devices; i++)
+	{
+		if(netcache.devices[i].hwaddr != NULL)
+			free(netcache.devices[i].hwaddr);
+		if(netcache.devices[i].iface != NULL)
+			free(netcache.devices[i].iface);
+		if(netcache.devices[i].name != NULL)
+			free(netcache.devices[i].name);
+	}
+	for(unsigned int i = 0; i < netcache.num_addresses; i++)
+	{
+		if(netcache.addresses[i].ip != NULL)
+			free(netcache.addresses[i].ip);
+		if(netcache.addresses[i].name != NULL)
+			free(netcache.addresses[i].name);
+	}
+	if(netcache.devices != NULL)
+		free(netcache.devices);
+	if(netcache.addresses != NULL)
+		free(netcache.addresses);
+	netcache.devices = NULL;
+	netcache.addresses = NULL;
+	netcache.num_devices = 0u;
+	netcache.num_addresses = 0u;
+	netcache.valid = false;
+}
+
+static int cmp_device_id(const void *a, const void *b)
+{
+	const int id = *(const int*)a;
+	const struct netcache_device *dev = b;
+	return (id > dev->id) - (id < dev->id);
+}
 
-		// Successful
-		db_opened = true;
+static int cmp_address_ip(const void *a, const void *b)
+{
+	const struct netcache_address *addr = b;
+	return strcmp((const char*)a, addr->ip);
+}
+
+// Read both network tables into memory. Has to be called while holding the
+// lock. The rows are sorted by the database so we can use binary search on
+// them later. SQLite's default BINARY collation compares like strcmp()
+static bool netcache_load(sqlite3 *db)
+{
+	netcache_free();
+
+	// Get number of rows to allocate memory only once
+	const int num_devices = db_query_int(db, "SELECT COUNT(*) FROM network;");
+	const int num_addresses = db_query_int(db, "SELECT COUNT(*) FROM network_addresses;");
+	if(num_devices < 0 || num_addresses < 0)
+		return false;
+
+	netcache.devices = calloc(num_devices + 1, sizeof(struct netcache_device));
+	netcache.addresses = calloc(num_addresses + 1, sizeof(struct netcache_address));
+	if(netcache.devices == NULL || netcache.addresses == NULL)
+	{
+		netcache_free();
+		return false;
 	}
 
-	// Prepare SQLite statement
-	// We request the most recent IP entry in case there an IP appears
-	// multiple times in the network_addresses table
 	sqlite3_stmt *stmt = NULL;
-	const char *querystr = "SELECT hwaddr FROM network WHERE id = "
-	                       "(SELECT network_id FROM network_addresses "
-	                       "WHERE ip = ? GROUP BY ip HAVING max(lastSeen));";
-	int rc = sqlite3_prepare_v2(db, querystr, -1, &stmt, NULL);
+	int rc = sqlite3_prepare_v2(db, "SELECT id,hwaddr,interface,aliasclient_id "
+	                                "FROM network ORDER BY id;", -1, &stmt, NULL);
 	if(rc != SQLITE_OK)
 	{
-		logg("getMACfromIP(\"%s\") - SQL error prepare: %s",
-		     ipaddr, sqlite3_errstr(rc));
+		logg("netcache_load() - SQL error prepare (network): %s", sqlite3_errstr(rc));
 		checkFTLDBrc(rc);
-
-		if(db_opened) dbclose(&db);
-
-		return NULL;
+		netcache_free();
+		return false;
 	}
 
-	// Bind ipaddr to prepared statement
-	if((rc = sqlite3_bind_text(stmt, 1, ipaddr, -1, SQLITE_STATIC)) != SQLITE_OK)
+	while((rc = sqlite3_step(stmt)) == SQLITE_ROW && netcache.num_devices < (unsigned int)num_devices)
 	{
-		logg("getMACfromIP(\"%s\"): Failed to bind ip: %s",
-		     ipaddr, sqlite3_errstr(rc));
-		checkFTLDBrc(rc);
-		sqlite3_reset(stmt);
-		sqlite3_finalize(stmt);
+		struct netcache_device *dev = &netcache.devices[netcache.num_devices++];
+		dev->id = sqlite3_column_int(stmt, 0);
+		dev->hwaddr = strdup_column(stmt, 1);
 
-		if(db_opened) dbclose(&db);
+		// Interface "N/A" is used for devices not seen in the ARP cache
+		const char *iface = (const char*)sqlite3_column_text(stmt, 2);
+		if(iface != NULL && strcmp(iface, "N/A") != 0)
+			dev->iface = strdup(iface);
 
-		return NULL;
+		if(sqlite3_column_type(stmt, 3) == SQLITE_NULL)
+			dev->aliasclient_id = DB_NODATA;
+		else
+			dev->aliasclient_id = sqlite3_column_int(stmt, 3);
+	}
+	sqlite3_finalize(stmt);
+	if(rc != SQLITE_DONE && rc != SQLITE_ROW)
+	{
+		logg("netcache_load() - SQL error step (network): %s", sqlite3_errstr(rc));
+		checkFTLDBrc(rc);
+		netcache_free();
+		return false;
 	}
 
-	char *hwaddr = NULL;
-	rc = sqlite3_step(stmt);
-	if(rc == SQLITE_ROW)
+	rc = sqlite3_prepare_v2(db, "SELECT ip,network_id,name,lastSeen "
+	                            "FROM network_addresses ORDER BY ip;", -1, &stmt, NULL);
+	if(rc != SQLITE_OK)
 	{
-		// Database record found (result might be empty)
-		hwaddr = strdup((char*)sqlite3_column_text(stmt, 0));
+		logg("netcache_load() - SQL error prepare (network_addresses): %s", sqlite3_errstr(rc));
+		checkFTLDBrc(rc);
+		netcache_free();
+		return false;
 	}
-	else if(rc == SQLITE_DONE)
+
+	while((rc = sqlite3_step(stmt)) == SQLITE_ROW && netcache.num_addresses < (unsigned int)num_addresses)
 	{
-		// Not found
-		hwaddr = NULL;
+		const char *ip = (const char*)sqlite3_column_text(stmt, 0);
+		if(ip == NULL)
+			continue;
+
+		struct netcache_address *addr = &netcache.addresses[netcache.num_addresses++];
+		addr->ip = strdup(ip);
+		addr->name = strdup_column(stmt, 2);
+		addr->lastSeen = sqlite3_column_int64(stmt, 3);
+
+		// Link address to its device
+		const int network_id = sqlite3_column_int(stmt, 1);
+		const struct netcache_device *dev = bsearch(&network_id, netcache.devices, netcache.num_devices,
+		                                            sizeof(struct netcache_device), cmp_device_id);
+		addr->device = dev != NULL ? dev - netcache.devices : -1;
+
+		// Remember most recent host name of this device
+		if(dev != NULL && addr->name != NULL)
+		{
+			struct netcache_device *d = &netcache.devices[addr->device];
+			if(d->name == NULL || addr->lastSeen > d->nameSeen)
+			{
+				if(d->name != NULL)
+					free(d->name);
+				d->name = strdup(addr->name);
+				d->nameSeen = addr->lastSeen;
+			}
+		}
 	}
-	else
+	sqlite3_finalize(stmt);
+	if(rc != SQLITE_DONE && rc != SQLITE_ROW)
 	{
-		logg("getMACfromIP(\"%s\"): Failed step: %s",
-		     ipaddr, sqlite3_errstr(rc));
+		logg("netcache_load() - SQL error step (network_addresses): %s", sqlite3_errstr(rc));
 		checkFTLDBrc(rc);
-		return NULL;
+		netcache_free();
+		return false;
 	}
 
-	if(config.debug & DEBUG_DATABASE && hwaddr != NULL)
-		logg("Found database hardware address %s -> %s", ipaddr, hwaddr);
-
-	// Finalize statement and close database handle
-	sqlite3_reset(stmt);
-	sqlite3_finalize(stmt);
+	netcache.valid = true;
 
-	if(db_opened) dbclose(&db);
+	if(debug_enabled(DEBUG_DATABASE))
+		logg("Network table cache loaded: %u devices, %u addresses",
+		     netcache.num_devices, netcache.num_addresses);
 
-	return hwaddr;
+	return true;
 }
 
-// Get aliasclient ID of device identified by IP address (if available)
-int getAliasclientIDfromIP(sqlite3 *db, const char *ipaddr)
+// Ensure the cache is valid and find the record for this IP address. Has to
+// be called while holding the lock. Returns NULL if the address is unknown or
+// the cache cannot be loaded (*failed is set in this case)
+static const struct netcache_address *netcache_find(sqlite3 *db, const char *ipaddr, bool *failed)
 {
-	// Return early if database is known to be broken
-	if(FTLDBerror())
-		return DB_FAILED;
-
-	// Open pihole-FTL.db database file if needed
-	bool db_opened = false;
-	if(db == NULL)
+	*failed = false;
+	if(!netcache.valid)
 	{
-		if((db = dbopen(false)) == NULL)
+		// Open pihole-FTL.db database file if needed
+		bool db_opened = false;
+		if(db == NULL)
 		{
-			logg("getAliasclientIDfromIP(\"%s\") - Failed to open DB", ipaddr);
-			return DB_FAILED;
+			if((db = dbopen(false)) == NULL)
+			{
+				*failed = true;
+				return NULL;
+			}
+			db_opened = true;
 		}
 
-		// Successful
-		db_opened = true;
-	}
-
-	// Prepare SQLite statement
-	// We request the most recent IP entry in case there an IP appears
-	// multiple times in the network_addresses table
-	sqlite3_stmt *stmt = NULL;
-	const char *querystr = "SELECT aliasclient_id FROM network WHERE id = "
-	                       "(SELECT network_id FROM network_addresses "
-	                       "WHERE ip = ? "
-	                             "AND aliasclient_id IS NOT NULL "
-	                       "GROUP BY ip HAVING max(lastSeen));";
-	int rc = sqlite3_prepare_v2(db, querystr, -1, &stmt, NULL);
-	if(rc != SQLITE_OK)
-	{
-		logg("getAliasclientIDfromIP(\"%s\") - SQL error prepare: %s",
-		     ipaddr, sqlite3_errstr(rc));
-		checkFTLDBrc(rc);
+		const bool loaded = netcache_load(db);
 
 		if(db_opened) dbclose(&db);
 
-		return DB_FAILED;
+		if(!loaded)
+		{
+			*failed = true;
+			return NULL;
+		}
 	}
 
-	// Bind ipaddr to prepared statement
-	if((rc = sqlite3_bind_text(stmt, 1, ipaddr, -1, SQLITE_STATIC)) != SQLITE_OK)
-	{
-		logg("getAliasclientIDfromIP(\"%s\"): Failed to bind ip: %s",
-		     ipaddr, sqlite3_errstr(rc));
-		checkFTLDBrc(rc);
-		sqlite3_reset(stmt);
-		sqlite3_finalize(stmt);
+	return bsearch(ipaddr, netcache.addresses, netcache.num_addresses,
+	               sizeof(struct netcache_address), cmp_address_ip);
+}
 
-		if(db_opened) dbclose(&db);
+static const struct netcache_device * __attribute__((pure)) netcache_device(const struct netcache_address *addr)
+{
+	if(addr == NULL || addr->device < 0)
+		return NULL;
+	return &netcache.devices[addr->device];
+}
+
+// Reload the cache from the database (called after we modified the tables)
+void network_cache_reload(sqlite3 *db)
+{
+	pthread_mutex_lock(&netcache_lock);
+	if(!netcache_load(db))
+		logg("WARN: Cannot load network table into memory");
+	pthread_mutex_unlock(&netcache_lock);
+}
+
+// Mark cache as outdated, it will be reloaded on the next lookup (called
+// when the network tables may have been modified by another process)
+void network_cache_invalidate(void)
+{
+	pthread_mutex_lock(&netcache_lock);
+	netcache.valid = false;
+	pthread_mutex_unlock(&netcache_lock);
+}
 
+// The cache lock may have been held by another thread of the main process
+// when a TCP worker was forked. Reinitialize it in the fork
+void network_cache_forked(void)
+{
+	pthread_mutex_init(&netcache_lock, NULL);
+}
+
+// Get hardware address of device identified by IP address
+char *__attribute__((malloc)) getMACfromIP(sqlite3* db, const char *ipaddr)
+{
+	// Return early if database is known to be broken
+	if(FTLDBerror())
+		return NULL;
+
+	// We use the most recent IP entry in case there an IP appears multiple
+	// times in the network_addresses table
+	bool failed = false;
+	char *hwaddr = NULL;
+	pthread_mutex_lock(&netcache_lock);
+	const struct netcache_device *dev = netcache_device(netcache_find(db, ipaddr, &failed));
+	if(dev != NULL && dev->hwaddr != NULL)
+		hwaddr = strdup(dev->hwaddr);
+	pthread_mutex_unlock(&netcache_lock);
+
+	if(failed)
+		logg("getMACfromIP(\"%s\") - Failed to load network table", ipaddr);
+
+	if(debug_enabled(DEBUG_DATABASE) && hwaddr != NULL)
+		logg("Found database hardware address %s -> %s", ipaddr, hwaddr);
+
+	return hwaddr;
+}
+
+// Get aliasclient ID of device identified by IP address (if available)
+int getAliasclientIDfromIP(sqlite3 *db, const char *ipaddr)
+{
+	// Return early if database is known to be broken
+	if(FTLDBerror())
 		return DB_FAILED;
-	}
 
+	bool failed = false;
 	int aliasclient_id = DB_NODATA;
-	rc = sqlite3_step(stmt);
-	if(rc == SQLITE_ROW)
-	{
-		// Database record found
-		aliasclient_id = sqlite3_column_int(stmt, 0);
-	}
-	else if(rc != SQLITE_DONE)
+	pthread_mutex_lock(&netcache_lock);
+	const struct netcache_device *dev = netcache_device(netcache_find(db, ipaddr, &failed));
+	if(dev != NULL)
+		aliasclient_id = dev->aliasclient_id;
+	pthread_mutex_unlock(&netcache_lock);
+
+	if(failed)
 	{
-		// Error, check for database corruption
-		checkFTLDBrc(rc);
+		logg("getAliasclientIDfromIP(\"%s\") - Failed to load network table", ipaddr);
 		return DB_FAILED;
 	}
 
-	if(config.debug & DEBUG_ALIASCLIENTS)
+	if(debug_enabled(DEBUG_ALIASCLIENTS))
 		logg("   Aliasclient ID %s -> %i%s", ipaddr, aliasclient_id,
 		     (aliasclient_id == DB_NODATA) ? " (NOT FOUND)" : "");
 
-	// Finalize statement and close database handle
-	sqlite3_reset(stmt);
-	sqlite3_finalize(stmt);
-
-	if(db_opened) dbclose(&db);
-
 	return aliasclient_id;
 }
 
@@ -1999,142 +2152,42 @@ char *__attribute__((malloc)) getNameFromIP(sqlite3 *db, const char *ipaddr)
 	// Check if we want to resolve host names
 	if(!resolve_this_name(ipaddr))
 	{
-		if(config.debug & DEBUG_DATABASE)
+		if(debug_enabled(DEBUG_DATABASE))
 			logg("getNameFromIP(\"%s\") - configured to not resolve host name", ipaddr);
 		return NULL;
 	}
 
-	// Open pihole-FTL.db database file if needed
-	bool db_opened = false;
-	if(db == NULL)
-	{
-		if((db = dbopen(false)) == NULL)
-		{
-			logg("getNameFromIP(\"%s\") - Failed to open DB", ipaddr);
-			return NULL;
-		}
-
-		// Successful
-		db_opened = true;
-	}
-
-	// Check for a host name associated with the same IP address
-	sqlite3_stmt *stmt = NULL;
-	const char *querystr = "SELECT name FROM network_addresses WHERE name IS NOT NULL AND ip = ?;";
-	int rc = sqlite3_prepare_v2(db, querystr, -1, &stmt, NULL);
-	if(rc != SQLITE_OK)
-	{
-		logg("getNameFromIP(\"%s\") - SQL error prepare: %s",
-		     ipaddr, sqlite3_errstr(rc));
-		checkFTLDBrc(rc);
-
-		if(db_opened) dbclose(&db);
-
-		return NULL;
-	}
-
-	// Bind ipaddr to prepared statement
-	if((rc = sqlite3_bind_text(stmt, 1, ipaddr, -1, SQLITE_STATIC)) != SQLITE_OK)
-	{
-		logg("getNameFromIP(\"%s\"): Failed to bind ip: %s",
-		     ipaddr, sqlite3_errstr(rc));
-		checkFTLDBrc(rc);
-		sqlite3_reset(stmt);
-		sqlite3_finalize(stmt);
-
-		if(db_opened) dbclose(&db);
-
-		return NULL;
-	}
-
+	bool failed = false, same_device = false;
 	char *name = NULL;
-	rc = sqlite3_step(stmt);
-	if(rc == SQLITE_ROW)
+	pthread_mutex_lock(&netcache_lock);
+	const struct netcache_address *addr = netcache_find(db, ipaddr, &failed);
+	const struct netcache_device *dev = netcache_device(addr);
+	if(addr != NULL && addr->name != NULL)
 	{
-		// Database record found (result might be empty)
-		name = strdup((char*)sqlite3_column_text(stmt, 0));
-
-		if(config.debug & DEBUG_DATABASE)
-			logg("Found database host name (same address) %s -> %s", ipaddr, name);
-	}
-	else if(rc != SQLITE_DONE)
-	{
-		// Error
-		checkFTLDBrc(rc);
-		return NULL;
+		// Host name associated with the same IP address
+		name = strdup(addr->name);
 	}
-
-	// Finalize statement
-	sqlite3_reset(stmt);
-	sqlite3_finalize(stmt);
-
-	// Return here if we found the name
-	if(name != NULL)
-	{
-		if(db_opened) dbclose(&db);
-
-		return name;
-	}
-
-	// Nothing found for the exact IP address
-	// Check for a host name associated with the same device (but another IP address)
-	querystr = "SELECT name FROM network_addresses "
-	                       "WHERE name IS NOT NULL AND "
-	                             "network_id = (SELECT network_id FROM network_addresses "
-	                                                             "WHERE ip = ?) "
-	                       "ORDER BY lastSeen DESC LIMIT 1";
-	rc = sqlite3_prepare_v2(db, querystr, -1, &stmt, NULL);
-	if(rc != SQLITE_OK)
-	{
-		logg("getNameFromIP(\"%s\") - SQL error prepare: %s",
-		     ipaddr, sqlite3_errstr(rc));
-
-		if(db_opened) dbclose(&db);
-
-		return NULL;
-	}
-
-	// Bind ipaddr to prepared statement
-	if((rc = sqlite3_bind_text(stmt, 1, ipaddr, -1, SQLITE_STATIC)) != SQLITE_OK)
+	else if(dev != NULL && dev->name != NULL)
 	{
-		logg("getNameFromIP(\"%s\"): Failed to bind ip: %s",
-		     ipaddr, sqlite3_errstr(rc));
-		checkFTLDBrc(rc);
-		sqlite3_reset(stmt);
-		sqlite3_finalize(stmt);
-
-		if(db_opened) dbclose(&db);
-
-		return NULL;
+		// Host name associated with the same device (but another IP
+		// address)
+		name = strdup(dev->name);
+		same_device = true;
 	}
+	pthread_mutex_unlock(&netcache_lock);
 
-	rc = sqlite3_step(stmt);
-	if(rc == SQLITE_ROW)
-	{
-		// Database record found (result might be empty)
-		name = strdup((char*)sqlite3_column_text(stmt, 0));
-
-		if(config.debug & (DEBUG_DATABASE | DEBUG_RESOLVER))
-			logg("Found database host name (same device) %s -> %s", ipaddr, name);
-	}
-	else if(rc == SQLITE_DONE)
-	{
-		// Not found
-		if(config.debug & (DEBUG_DATABASE | DEBUG_RESOLVER))
-			logg(" ---> not found");
-	}
-	else
+	if(failed)
 	{
-		// Error
-		checkFTLDBrc(rc);
+		logg("getNameFromIP(\"%s\") - Failed to load network table", ipaddr);
 		return NULL;
 	}
 
-	// Finalize statement and close database handle
-	sqlite3_reset(stmt);
-	sqlite3_finalize(stmt);
-
-	if(db_opened) dbclose(&db);
+	if(name != NULL && !same_device && debug_enabled(DEBUG_DATABASE))
+		logg("Found database host name (same address) %s -> %s", ipaddr, name);
+	else if(name != NULL && same_device && debug_enabled(DEBUG_DATABASE | DEBUG_RESOLVER))
+		logg("Found database host name (same device) %s -> %s", ipaddr, name);
+	else if(name == NULL && debug_enabled(DEBUG_DATABASE | DEBUG_RESOLVER))
+		logg(" ---> not found");
 
 	return name;
 }
@@ -2146,81 +2199,19 @@ char *__attribute__((malloc)) getIfaceFromIP(sqlite3 *db, const char *ipaddr)
 	if(FTLDBerror())
 		return NULL;
 
-	// Open pihole-FTL.db database file if needed
-	bool db_opened = false;
-	if(db == NULL)
-	{
-		if((db = dbopen(false)) == NULL)
-		{
-			logg("getIfaceFromIP(\"%s\") - Failed to open DB", ipaddr);
-			return NULL;
-		}
-
-		// Successful
-		db_opened = true;
-	}
-
-	// Prepare SQLite statement
-	sqlite3_stmt *stmt = NULL;
-	const char *querystr = "SELECT interface FROM network "
-	                               "JOIN network_addresses "
-	                                    "ON network_addresses.network_id = network.id "
-	                               "WHERE network_addresses.ip = ? AND "
-	                                     "interface != 'N/A' AND "
-	                                     "interface IS NOT NULL;";
-	int rc = sqlite3_prepare_v2(db, querystr, -1, &stmt, NULL);
-	if(rc != SQLITE_OK)
-	{
-		logg("getIfaceFromIP(\"%s\") - SQL error prepare: %s",
-		     ipaddr, sqlite3_errstr(rc));
-
-		if(db_opened) dbclose(&db);
-
-		return NULL;
-	}
-
-	if(config.debug & (DEBUG_DATABASE | DEBUG_RESOLVER))
-	{
-		logg("getDatabaseHostname(): \"%s\" with ? = \"%s\"",
-		     querystr, ipaddr);
-	}
-
-	// Bind ipaddr to prepared statement
-	if((rc = sqlite3_bind_text(stmt, 1, ipaddr, -1, SQLITE_STATIC)) != SQLITE_OK)
-	{
-		logg("getIfaceFromIP(\"%s\"): Failed to bind ip: %s",
-		     ipaddr, sqlite3_errstr(rc));
-		checkFTLDBrc(rc);
-		sqlite3_reset(stmt);
-		sqlite3_finalize(stmt);
-
-		if(db_opened) dbclose(&db);
-
-		return NULL;
-	}
-
+	bool failed = false;
 	char *iface = NULL;
-	rc = sqlite3_step(stmt);
-	if(rc == SQLITE_ROW)
-	{
-		// Database record found (result might be empty)
-		iface = strdup((char*)sqlite3_column_text(stmt, 0));
-	}
-	else if(rc != SQLITE_DONE)
-	{
-		// Error
-		checkFTLDBrc(rc);
-		return NULL;
-	}
+	pthread_mutex_lock(&netcache_lock);
+	const struct netcache_device *dev = netcache_device(netcache_find(db, ipaddr, &failed));
+	if(dev != NULL && dev->iface != NULL)
+		iface = strdup(dev->iface);
+	pthread_mutex_unlock(&netcache_lock);
 
-	if(config.debug & DEBUG_DATABASE && iface != NULL)
-		logg("Found database interface %s -> %s", ipaddr, iface);
+	if(failed)
+		logg("getIfaceFromIP(\"%s\") - Failed to load network table", ipaddr);
 
-	// Finalize statement and close database handle
-	sqlite3_reset(stmt);
-	sqlite3_finalize(stmt);
-
-	if(db_opened) dbclose(&db);
+	if(debug_enabled(DEBUG_DATABASE) && iface != NULL)
+		logg("Found database interface %s -> %s", ipaddr, iface);
 
 	return iface;
 }
@@ -24,5 +24,8 @@ int getAliasclientIDfromIP(sqlite3 *db, const char *ipaddr);
 char* __attribute__((malloc)) getNameFromIP(sqlite3 *db, const char* ipaddr);
 char* __attribute__((malloc)) getIfaceFromIP(sqlite3 *db, const char* ipaddr);
 void resolveNetworkTableNames(void);
+void network_cache_reload(sqlite3 *db);
+void network_cache_invalidate(void);
+void network_cache_forked(void);
 
 #endif //NETWORKTABLE_H
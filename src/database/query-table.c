@@ -25,6 +25,8 @@
 #include "../config.h"
 // getstr()
 #include "../shmem.h"
+// PROBE*()
+#include "../probes.h"
 
 static bool saving_failed_before = false;
 
@@ -48,15 +50,17 @@ int get_number_of_queries_in_DB(sqlite3 *db)
 		db_opened = true;
 	}
 
-	// Count number of rows using the index timestamp is faster than select(*)
-	int result = db_query_int(db, "SELECT COUNT(timestamp) FROM query_storage");
+	// The number of rows is maintained in the counters table whenever
+	// queries are stored or deleted. This avoids scanning the (possibly
+	// very large) index on every request
+	int result = db_get_counter(db, DB_STOREDQUERIES);
 
 	if(db_opened) dbclose(&db);
 
 	return result;
 }
 
-int DB_save_queries(sqlite3 *db)
+static int save_queries(sqlite3 *db)
 {
 	// Return early if database is known to be broken
 	if(FTLDBerror())
@@ -480,13 +484,21 @@ int DB_save_queries(sqlite3 *db)
 		return DB_FAILED;
 	}
 
+	// Queries stored before an error occurred are committed below as well
+	// (they are marked as being in the database), count them
+	if(saved > 0)
+	{
+		db_update_counters(db, total, blocked);
+		if(!db_update_stored_queries(db, saved))
+			logg("Updating number of stored queries failed, will be corrected when old queries are deleted");
+	}
+
 	// Store index for next loop iteration round and update last time stamp
 	// in the database only if all queries have been saved successfully
 	if(saved > 0 && !error)
 	{
 		lastdbindex = queryID;
 		db_set_FTL_property(db, DB_LASTTIMESTAMP, newlasttimestamp);
-		db_update_counters(db, total, blocked);
 	}
 
 	// Finish prepared statement
@@ -506,7 +518,7 @@ int DB_save_queries(sqlite3 *db)
 		return DB_FAILED;
 	}
 
-	if(config.debug & DEBUG_DATABASE || saving_failed_before)
+	if(debug_enabled(DEBUG_DATABASE) || saving_failed_before)
 	{
 		logg("Notice: Queries stored in long-term database: %u (took %.1f ms, last SQLite ID %li)",
 		     saved, timer_elapsed_msec(DATABASE_WRITE_TIMER), lastID);
@@ -522,6 +534,16 @@ int DB_save_queries(sqlite3 *db)
 	return saved;
 }
 
+// Store new queries in the long-term database. Returns the number of queries
+// stored or DB_FAILED
+int DB_save_queries(sqlite3 *db)
+{
+	PROBE0(db_save_start);
+	const int saved = save_queries(db);
+	PROBE1(db_save_end, saved);
+	return saved;
+}
+
 void delete_old_queries_in_DB(sqlite3 *db)
 {
 	// Return early if database is known to be broken
@@ -530,17 +552,38 @@ void delete_old_queries_in_DB(sqlite3 *db)
 
 	int timestamp = time(NULL) - config.maxDBdays * 86400;
 
+	// Delete old queries and update the number of stored queries atomically
+	if(dbquery(db, "BEGIN TRANSACTION IMMEDIATE") != SQLITE_OK)
+	{
+		logg("delete_old_queries_in_DB(): Cannot start transaction");
+		return;
+	}
+
 	if(dbquery(db, "DELETE FROM query_storage WHERE timestamp <= %i", timestamp) != SQLITE_OK)
 	{
 		logg("delete_old_queries_in_DB(): Deleting queries due to age of entries failed!");
+		dbquery(db, "ROLLBACK TRANSACTION");
 		return;
 	}
 
 	// Get how many rows have been affected (deleted)
 	const int affected = sqlite3_changes(db);
 
+	if(!db_update_stored_queries(db, -affected))
+	{
+		logg("delete_old_queries_in_DB(): Updating number of stored queries failed!");
+		dbquery(db, "ROLLBACK TRANSACTION");
+		return;
+	}
+
+	if(dbquery(db, "END TRANSACTION") != SQLITE_OK)
+	{
+		logg("delete_old_queries_in_DB(): END TRANSACTION failed!");
+		return;
+	}
+
 	// Print final message only if there is a difference
-	if((config.debug & DEBUG_DATABASE) || affected)
+	if(debug_enabled(DEBUG_DATABASE) || affected)
 		logg("Notice: Database size is %.2f MB, deleted %i rows", 1e-6*get_FTL_db_filesize(), affected);
 }
 
@@ -705,7 +748,7 @@ void DB_read_queries(void)
 	const time_t mintime = now - config.maxlogage;
 	const char *querystr = "SELECT id,timestamp,type,status,domain,client,forward,additional_info,reply_type,reply_time,dnssec FROM queries WHERE timestamp >= ?";
 	// Log FTL_db query string in debug mode
-	if(config.debug & DEBUG_DATABASE)
+	if(debug_enabled(DEBUG_DATABASE))
 		logg("DB_read_queries(): \"%s\" with ? = %lli", querystr, (long long)mintime);
 
 	// Prepare SQLite3 statement
@@ -740,7 +783,7 @@ void DB_read_queries(void)
 		}
 		if(queryTimeStamp > now)
 		{
-			if(config.debug & DEBUG_DATABASE) logg("DB warn: Skipping query logged in the future (%lli)", (long long)queryTimeStamp);
+			if(debug_enabled(DEBUG_DATABASE)) logg("DB warn: Skipping query logged in the future (%lli)", (long long)queryTimeStamp);
 			continue;
 		}
 
@@ -1021,3 +1064,26 @@ void DB_read_queries(void)
 end_of_DB_read_queries:	// Close database here, we have to reopen it later (after forking)
 	dbclose(&db);
 }
+
+bool create_stored_queries_counter(sqlite3 *db)
+{
+	// Start transaction of database update
+	SQL_bool(db, "BEGIN TRANSACTION");
+
+	// Count the stored queries once. Afterwards, the counter is updated
+	// whenever queries are added to or deleted from the database
+	SQL_bool(db, "INSERT OR REPLACE INTO counters (id, value) "
+	               "SELECT %u, COUNT(timestamp) FROM query_storage;", DB_STOREDQUERIES);
+
+	// Update database version to 13
+	if(!db_set_FTL_property(db, DB_VERSION, 13))
+	{
+		logg("create_stored_queries_counter(): Failed to update database version!");
+		return false;
+	}
+
+	// Finish transaction
+	SQL_bool(db, "COMMIT");
+
+	return true;
+}
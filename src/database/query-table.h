@@ -20,5 +20,6 @@ bool create_addinfo_table(sqlite3 *db);
 int DB_save_queries(sqlite3 *db);
 void DB_read_queries(void);
 bool add_query_storage_columns(sqlite3 *db);
+bool create_stored_queries_counter(sqlite3 *db);
 
 #endif //DATABASE_QUERY_TABLE_H
@@ -0,0 +1,242 @@
+/* Pi-hole: A black hole for Internet advertisements
+*  (c) 2023 Pi-hole, LLC (https://pi-hole.net)
+*  Network-wide ad blocking via your own hardware.
+*
+*  FTL Engine
+*  SQLite3 statement profiler
+*
+*  This file is copyright under the latest version of the EUPL.
+*  Please see LICENSE file for your rights under this license. */
+
+#include "../FTL.h"
+#include "sqlite3-profile.h"
+// logg()
+#include "../log.h"
+// struct config
+#include "../config.h"
+
+// Statistics are collected per process. TCP workers (forks) use their own
+// copy of this table and their statistics are lost when they terminate
+struct profile_slot {
+	uint32_t hash;
+	struct sql_profile p;
+};
+
+static struct profile_slot profile[PROFILE_SLOTS] = {{ 0 }};
+static unsigned int profile_dropped = 0;
+static pthread_mutex_t profile_lock = PTHREAD_MUTEX_INITIALIZER;
+
+// FNV-1a hash of the normalized statement text
+static uint32_t __attribute__((pure)) hash_sql(const char *sql)
+{
+	uint32_t hash = 2166136261U;
+	for(const unsigned char *c = (const unsigned char *)sql; *c; c++)
+	{
+		hash ^= *c;
+		hash *= 16777619U;
+	}
+	return hash;
+}
+
+// Find (or add) the slot for this statement. Has to be called while holding
+// the profile lock. Returns NULL if the table is full
+static struct sql_profile *find_profile(const char *sql)
+{
+	const uint32_t hash = hash_sql(sql);
+	for(unsigned int i = 0; i < PROFILE_SLOTS; i++)
+	{
+		// Linear probing
+		struct profile_slot *slot = &profile[(hash + i) % PROFILE_SLOTS];
+		if(slot->p.sql == NULL)
+		{
+			// Free slot: add new statement
+			if((slot->p.sql = strdup(sql)) == NULL)
+				return NULL;
+			slot->hash = hash;
+			return &slot->p;
+		}
+		if(slot->hash == hash && strcmp(slot->p.sql, sql) == 0)
+			return &slot->p;
+	}
+
+	// Table is full
+	profile_dropped++;
+	return NULL;
+}
+
+// Rows are counted per running statement of this thread without locking.
+// They are added to the profile of the statement once it finishes
+// (SQLITE_TRACE_PROFILE) so the shared table is only updated once per run.
+// Only a few statements are stepped at the same time, rows of any further
+// statements are not counted
+#define ROW_COUNTERS 8
+static __thread struct row_counter {
+	sqlite3_stmt *stmt;
+	unsigned long long rows;
+} row_counters[ROW_COUNTERS] = {{ 0 }};
+
+static void count_row(sqlite3_stmt *stmt)
+{
+	struct row_counter *unused = NULL;
+	for(unsigned int i = 0; i < ROW_COUNTERS; i++)
+	{
+		if(row_counters[i].stmt == stmt)
+		{
+			row_counters[i].rows++;
+			return;
+		}
+		if(unused == NULL && row_counters[i].stmt == NULL)
+			unused = &row_counters[i];
+	}
+
+	if(unused != NULL)
+	{
+		unused->stmt = stmt;
+		unused->rows = 1;
+	}
+}
+
+// Get (and reset) the number of rows of a statement which just finished
+static unsigned long long finish_rows(sqlite3_stmt *stmt)
+{
+	for(unsigned int i = 0; i < ROW_COUNTERS; i++)
+	{
+		if(row_counters[i].stmt == stmt)
+		{
+			const unsigned long long rows = row_counters[i].rows;
+			row_counters[i].stmt = NULL;
+			row_counters[i].rows = 0;
+			return rows;
+		}
+	}
+	return 0;
+}
+
+static int profile_callback(unsigned int type, void *ctx, void *p, void *x)
+{
+	sqlite3_stmt *stmt = p;
+
+	if(type == SQLITE_TRACE_ROW)
+	{
+		count_row(stmt);
+		return 0;
+	}
+
+	if(type != SQLITE_TRACE_PROFILE)
+		return 0;
+
+	const unsigned long long rows = finish_rows(stmt);
+
+	// Use normalized SQL (literals replaced by "?") if available so
+	// statements generated by dbquery() are aggregated as well
+	const char *sql = sqlite3_normalized_sql(stmt);
+	if(sql == NULL)
+		sql = sqlite3_sql(stmt);
+	if(sql == NULL)
+		return 0;
+
+	// x points to the number of nanoseconds the statement took
+	const unsigned long long ns = *(sqlite3_int64*)x;
+	if(config.DBprofile)
+	{
+		pthread_mutex_lock(&profile_lock);
+		struct sql_profile *entry = find_profile(sql);
+		if(entry != NULL)
+		{
+			entry->count++;
+			entry->rows += rows;
+			entry->total_ns += ns;
+			if(ns > entry->max_ns)
+				entry->max_ns = ns;
+		}
+		pthread_mutex_unlock(&profile_lock);
+	}
+
+	// Log slow statements
+	const double ms = 1e-6*ns;
+	if(config.DBslowquery > 0 && ms >= config.DBslowquery)
+	{
+		const char *dbfile = sqlite3_db_filename(sqlite3_db_handle(stmt), "main");
+		logg("WARNING: Slow SQL statement on %s took %.1f ms: %s",
+		     dbfile != NULL ? dbfile : "(unknown)", ms, sql);
+	}
+
+	return 0;
+}
+
+// Register the profiling callbacks on a database connection
+void DB_register_profiler(sqlite3 *db)
+{
+	unsigned int mask = 0;
+	if(config.DBprofile)
+		mask |= SQLITE_TRACE_PROFILE | SQLITE_TRACE_ROW;
+	if(config.DBslowquery > 0)
+		mask |= SQLITE_TRACE_PROFILE;
+
+	if(mask == 0 || db == NULL)
+		return;
+
+	const int rc = sqlite3_trace_v2(db, mask, profile_callback, NULL);
+	if(rc != SQLITE_OK)
+		logg("WARNING: Cannot register SQLite3 profiler: %s", sqlite3_errstr(rc));
+}
+
+// The profile lock may have been held by another thread of the main process
+// when a TCP worker was forked. As this thread does not exist in the fork, we
+// have to reinitialize the lock there
+void DB_profiler_forked(void)
+{
+	pthread_mutex_init(&profile_lock, NULL);
+}
+
+static int profile_cmp(const void *a, const void *b)
+{
+	const struct sql_profile *pa = a, *pb = b;
+	if(pa->total_ns < pb->total_ns)
+		return 1;
+	if(pa->total_ns > pb->total_ns)
+		return -1;
+	return 0;
+}
+
+// Copy up to num profiles into out (sorted by total time, descending). The
+// SQL strings are duplicated and have to be freed by the caller
+unsigned int get_sql_profile(struct sql_profile *out, const unsigned int num, unsigned int *dropped)
+{
+	struct sql_profile *all = calloc(PROFILE_SLOTS, sizeof(struct sql_profile));
+	if(all == NULL)
+		return 0;
+
+	unsigned int n = 0;
+	pthread_mutex_lock(&profile_lock);
+	for(unsigned int i = 0; i < PROFILE_SLOTS; i++)
+		if(profile[i].p.sql != NULL)
+			all[n++] = profile[i].p;
+	*dropped = profile_dropped;
+
+	qsort(all, n, sizeof(struct sql_profile), profile_cmp);
+	if(n > num)
+		n = num;
+	for(unsigned int i = 0; i < n; i++)
+	{
+		out[i] = all[i];
+		out[i].sql = strdup(all[i].sql);
+	}
+	pthread_mutex_unlock(&profile_lock);
+
+	free(all);
+	return n;
+}
+
+void reset_sql_profile(void)
+{
+	pthread_mutex_lock(&profile_lock);
+	for(unsigned int i = 0; i < PROFILE_SLOTS; i++)
+	{
+		if(profile[i].p.sql != NULL)
+			free(profile[i].p.sql);
+		memset(&profile[i], 0, sizeof(profile[i]));
+	}
+	profile_dropped = 0;
+	pthread_mutex_unlock(&profile_lock);
+}
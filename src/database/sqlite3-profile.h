@@ -0,0 +1,31 @@
+/* Pi-hole: A black hole for Internet advertisements
+*  (c) 2023 Pi-hole, LLC (https://pi-hole.net)
+*  Network-wide ad blocking via your own hardware.
+*
+*  FTL Engine
+*  SQLite3 statement profiler prototypes
+*
+*  This file is copyright under the latest version of the EUPL.
+*  Please see LICENSE file for your rights under this license. */
+#ifndef SQLITE3_PROFILE_H
+#define SQLITE3_PROFILE_H
+
+#include "sqlite3.h"
+
+// How many distinct (normalized) statements do we profile at most?
+#define PROFILE_SLOTS 512
+
+struct sql_profile {
+	char *sql;
+	unsigned int count;
+	unsigned long long rows;
+	unsigned long long total_ns;
+	unsigned long long max_ns;
+};
+
+void DB_register_profiler(sqlite3 *db);
+void DB_profiler_forked(void);
+unsigned int get_sql_profile(struct sql_profile *out, const unsigned int num, unsigned int *dropped);
+void reset_sql_profile(void);
+
+#endif //SQLITE3_PROFILE_H
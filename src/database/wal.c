@@ -0,0 +1,226 @@
+/* Pi-hole: A black hole for Internet advertisements
+*  (c) 2023 Pi-hole, LLC (https://pi-hole.net)
+*  Network-wide ad blocking via your own hardware.
+*
+*  FTL Engine
+*  pihole-FTL.db write-ahead log checkpointing routines
+*
+*  This file is copyright under the latest version of the EUPL.
+*  Please see LICENSE file for your rights under this license. */
+
+#include "../FTL.h"
+#include "wal.h"
+#include "common.h"
+// logg()
+#include "../log.h"
+// struct config
+#include "../config.h"
+// timer_start()
+#include "../timers.h"
+
+static struct wal_stats wal = { 0 };
+static char *walfile = NULL;
+
+// Connection kept open by the database thread. It is used for running the
+// checkpoints and ensures the WAL index stays valid while all other
+// connections are opened and closed on demand. Otherwise, SQLite would have
+// to rebuild the WAL index each time the first connection is opened
+static sqlite3 *wal_db = NULL;
+
+static const char *checkpoint_names[CHECKPOINT_MAX] = { "PASSIVE", "RESTART", "TRUNCATE" };
+static const int checkpoint_sqlite_modes[CHECKPOINT_MAX] =
+	{ SQLITE_CHECKPOINT_PASSIVE, SQLITE_CHECKPOINT_RESTART, SQLITE_CHECKPOINT_TRUNCATE };
+
+static unsigned long long get_wal_filesize(void)
+{
+	// Build path of the WAL file only once
+	if(walfile == NULL && asprintf(&walfile, "%s-wal", FTLfiles.FTL_db) < 0)
+	{
+		walfile = NULL;
+		return 0;
+	}
+
+	struct stat st;
+	if(stat(walfile, &st) != 0)
+	{
+		// No WAL file (yet)
+		return 0;
+	}
+
+	return st.st_size;
+}
+
+// Switch pihole-FTL.db into the journal mode requested by the user. The
+// journal mode is persistent, it is stored in the database file itself
+bool DB_set_journal_mode(sqlite3 *db)
+{
+	const char *mode = config.DBwal ? "WAL" : "DELETE";
+	if(dbquery(db, "PRAGMA journal_mode=%s", mode) != SQLITE_OK)
+	{
+		logg("WARNING: Cannot set journal mode of long-term database to %s", mode);
+		return false;
+	}
+
+	// Remember when we started so the first full checkpoint happens
+	// only after the configured interval
+	wal.last_full = time(NULL);
+
+	return true;
+}
+
+// Disable SQLite's automatic checkpointing for this connection. Checkpoints
+// are exclusively scheduled by the database thread (see DB_checkpoint())
+void DB_wal_connection_setup(sqlite3 *db)
+{
+	if(!config.DBwal)
+		return;
+
+	// Do not run checkpoints inside of commits crossing the (default)
+	// threshold of 1000 pages
+	sqlite3_wal_autocheckpoint(db, 0);
+
+	// Do not checkpoint when the last connection to the database is
+	// closed. We open and close connections very frequently
+	sqlite3_db_config(db, SQLITE_DBCONFIG_NO_CKPT_ON_CLOSE, 1, NULL);
+}
+
+// Check if the WAL grew above the configured limit or if the last full
+// checkpoint is overdue. This does not need a database connection.
+bool DB_checkpoint_due(const time_t now)
+{
+	if(!config.DBwal || FTLDBerror())
+		return false;
+
+	const unsigned long long size = get_wal_filesize();
+	wal.size = size;
+	if(size > wal.max_size)
+		wal.max_size = size;
+
+	// Nothing to do for an empty WAL
+	if(size == 0)
+		return false;
+
+	// Do not run checkpoints back-to-back
+	if(now - wal.last < DATABASE_CHECKPOINT_DELAY)
+		return false;
+
+	return size >= 1024ULL*1024ULL*config.checkpoint.size ||
+	       now - wal.last_full >= (time_t)config.checkpoint.interval;
+}
+
+// Run a checkpoint on the long-term database. This has to be called from the
+// database thread while it is not holding the shared memory lock. We use
+// PASSIVE checkpoints by default (never blocking readers or writers) and
+// escalate to RESTART when the last full checkpoint is too long ago and to
+// TRUNCATE when the WAL exceeds the configured size
+void DB_checkpoint(void)
+{
+	if(!config.DBwal || FTLDBerror())
+		return;
+
+	// Open checkpointing connection if not already done
+	if(!DB_wal_open())
+		return;
+
+	const time_t now = time(NULL);
+	const unsigned long long size = get_wal_filesize();
+	if(size > wal.max_size)
+		wal.max_size = size;
+
+	// Skip if there is nothing to checkpoint
+	if(size == 0)
+	{
+		wal.size = 0;
+		return;
+	}
+
+	enum checkpoint_mode mode = CHECKPOINT_PASSIVE;
+	if(size >= 1024ULL*1024ULL*config.checkpoint.size)
+		mode = CHECKPOINT_TRUNCATE;
+	else if(now - wal.last_full >= (time_t)config.checkpoint.interval)
+		mode = CHECKPOINT_RESTART;
+
+	int nLog = -1, nCkpt = -1;
+	timer_start(DATABASE_CHECKPOINT_TIMER);
+	const int rc = sqlite3_wal_checkpoint_v2(wal_db, NULL, checkpoint_sqlite_modes[mode], &nLog, &nCkpt);
+	const double msec = timer_elapsed_msec(DATABASE_CHECKPOINT_TIMER);
+
+	// Update metrics
+	wal.checkpoints[mode]++;
+	wal.frames_log = nLog;
+	wal.frames_ckpt = nCkpt;
+	wal.last_msec = msec;
+	wal.total_msec += msec;
+	if(msec > wal.max_msec)
+		wal.max_msec = msec;
+	wal.last = now;
+	wal.size = get_wal_filesize();
+
+	if(rc == SQLITE_BUSY)
+	{
+		// A RESTART or TRUNCATE checkpoint could not complete because
+		// of concurrent readers (e.g., the web interface). We try
+		// again after DATABASE_CHECKPOINT_DELAY seconds
+		wal.busy++;
+		if(debug_enabled(DEBUG_DATABASE))
+			logg("WAL checkpoint (%s) busy after %.1f ms: %d/%d frames checkpointed",
+			     checkpoint_names[mode], msec, nCkpt, nLog);
+		return;
+	}
+	else if(rc != SQLITE_OK)
+	{
+		logg("WARNING: WAL checkpoint (%s) failed: %s",
+		     checkpoint_names[mode], sqlite3_errstr(rc));
+		checkFTLDBrc(rc);
+		return;
+	}
+
+	// Reset escalation timer when all frames have been written back
+	if(mode != CHECKPOINT_PASSIVE || nCkpt == nLog)
+		wal.last_full = now;
+
+	if(debug_enabled(DEBUG_DATABASE))
+		logg("WAL checkpoint (%s) took %.1f ms: %d/%d frames checkpointed, WAL size now %llu bytes",
+		     checkpoint_names[mode], msec, nCkpt, nLog, wal.size);
+}
+
+// Open the checkpointing connection (if not already open)
+bool DB_wal_open(void)
+{
+	if(!config.DBwal || FTLDBerror())
+		return false;
+
+	if(wal_db != NULL)
+		return true;
+
+	if((wal_db = dbopen(false)) == NULL)
+		return false;
+
+	// SQLite opens the WAL (and maps the WAL index) only when the
+	// database is read for the first time
+	if(db_query_int(wal_db, "SELECT COUNT(*) FROM ftl") == DB_FAILED)
+	{
+		dbclose(&wal_db);
+		return false;
+	}
+
+	return true;
+}
+
+// Write back and truncate the WAL and close the checkpointing connection.
+// This is called when the database thread terminates
+void DB_wal_close(void)
+{
+	if(wal_db == NULL)
+		return;
+
+	if(!FTLDBerror())
+		sqlite3_wal_checkpoint_v2(wal_db, NULL, SQLITE_CHECKPOINT_TRUNCATE, NULL, NULL);
+
+	dbclose(&wal_db);
+}
+
+void get_wal_stats(struct wal_stats *stats)
+{
+	memcpy(stats, &wal, sizeof(wal));
+}
@@ -0,0 +1,45 @@
+/* Pi-hole: A black hole for Internet advertisements
+*  (c) 2023 Pi-hole, LLC (https://pi-hole.net)
+*  Network-wide ad blocking via your own hardware.
+*
+*  FTL Engine
+*  pihole-FTL.db write-ahead log checkpointing prototypes
+*
+*  This file is copyright under the latest version of the EUPL.
+*  Please see LICENSE file for your rights under this license. */
+#ifndef DATABASE_WAL_H
+#define DATABASE_WAL_H
+
+#include "sqlite3.h"
+
+// Checkpoint modes used by FTL (escalating order)
+enum checkpoint_mode {
+	CHECKPOINT_PASSIVE,
+	CHECKPOINT_RESTART,
+	CHECKPOINT_TRUNCATE,
+	CHECKPOINT_MAX
+} __attribute__ ((packed));
+
+struct wal_stats {
+	unsigned long long size;
+	unsigned long long max_size;
+	unsigned int checkpoints[CHECKPOINT_MAX];
+	unsigned int busy;
+	int frames_log;
+	int frames_ckpt;
+	double last_msec;
+	double max_msec;
+	double total_msec;
+	time_t last;
+	time_t last_full;
+};
+
+bool DB_set_journal_mode(sqlite3 *db);
+void DB_wal_connection_setup(sqlite3 *db);
+bool DB_checkpoint_due(const time_t now);
+void DB_checkpoint(void);
+bool DB_wal_open(void);
+void DB_wal_close(void);
+void get_wal_stats(struct wal_stats *stats);
+
+#endif //DATABASE_WAL_H
@@ -479,7 +479,7 @@ const char *getClientNameString(const queriesData* query)
 
 void FTL_reset_per_client_domain_data(void)
 {
-	if(config.debug & DEBUG_DATABASE)
+	if(debug_enabled(DEBUG_DATABASE))
 		logg("Resetting per-client DNS cache, size is %i", counters->dns_cache_size);
 
 	for(int cacheID = 0; cacheID < counters->dns_cache_size; cacheID++)
@@ -550,7 +550,7 @@ bool __attribute__ ((const)) is_blocked(const enum query_status status)
 	}
 }
 
-static const char* __attribute__ ((const)) query_status_str(const enum query_status status)
+const char* __attribute__ ((const)) query_status_str(const enum query_status status)
 {
 	switch (status)
 	{
@@ -599,7 +599,7 @@ static const char* __attribute__ ((const)) query_status_str(const enum query_sta
 void _query_set_status(queriesData *query, const enum query_status new_status, const char *func, const int line, const char *file)
 {
 	// Debug logging
-	if(config.debug & DEBUG_STATUS)
+	if(debug_enabled(DEBUG_STATUS))
 	{
 		const char *oldstr = query->status < QUERY_STATUS_MAX ? query_status_str(query->status) : "INVALID";
 		if(query->status == new_status)
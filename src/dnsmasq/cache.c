@@ -25,6 +25,27 @@ static struct crec *new_chain = NULL;
 static int insert_error;
 static union bigname *big_free = NULL;
 static int bignames_left, hash_size;
+/* Pi-hole modification */
+/* The cache is a segmented LRU. New entries enter the probation list
+   (cache_head ... cache_tail) and move to the protected list when they are
+   looked up again. Only entries at the end of the probation list are
+   evicted so a burst of names looked up once (scanners, DGA malware) cannot
+   flush the names which are actually in use. The protected list may hold up
+   to CACHE_PROTECTED_PCT percent of the cache, its least recently used
+   entries are moved back to the probation list (demoted) beyond that.
+   Unused entries are kept in their own list. Optionally, the memory used by
+   the cache entries and their blockdata is limited to --cache-bytes. */
+static struct crec *prot_head = NULL, *prot_tail = NULL;
+static struct crec *free_head = NULL, *free_tail = NULL;
+static int prot_count = 0;
+static size_t cache_bytes = 0;
+static void cache_promote(struct crec *crecp);
+static void cache_rebalance(void);
+static void cache_shrink(size_t bytes, time_t now);
+static struct crec *cache_scan_free(char *name, union all_addr *addr, unsigned short class, time_t now,
+				    unsigned int flags, struct crec **target_crec, unsigned int *target_uid);
+static size_t cache_entry_bytes(char *name, union all_addr *addr, unsigned int flags);
+/************************/
 
 static void make_non_terminals(struct crec *source);
 static struct crec *really_insert(char *name, union all_addr *addr, unsigned short class,
@@ -191,9 +212,12 @@ void cache_init(void)
       
       for (i=0; i < daemon->cachesize; i++, crecp++)
 	{
-	  cache_link(crecp);
 	  crecp->flags = 0;
 	  crecp->uid = UID_NONE;
+	  /* Pi-hole modification */
+	  crecp->bytes = 0;
+	  cache_free(crecp);
+	  /************************/
 	}
     }
   
@@ -309,13 +333,19 @@ static void cache_free(struct crec *crecp)
   crecp->flags &= ~F_REVERSE;
   crecp->uid = UID_NONE; /* invalidate CNAMES pointing to this. */
 
-  if (cache_tail)
-    cache_tail->next = crecp;
+  /* Pi-hole modification */
+  if (free_tail)
+    free_tail->next = crecp;
   else
-    cache_head = crecp;
-  crecp->prev = cache_tail;
+    free_head = crecp;
+  crecp->prev = free_tail;
   crecp->next = NULL;
-  cache_tail = crecp;
+  free_tail = crecp;
+  crecp->segment = CACHE_FREE;
+
+  cache_bytes -= crecp->bytes;
+  crecp->bytes = 0;
+  /************************/
   
   /* retrieve big name for further use. */
   if (crecp->flags & F_BIGNAME)
@@ -338,22 +368,143 @@ static void cache_link(struct crec *crecp)
   cache_head = crecp;
   if (!cache_tail)
     cache_tail = crecp;
+  /* Pi-hole modification */
+  if (crecp->segment != CACHE_DEMOTED)
+    crecp->segment = CACHE_PROBATION;
+  /************************/
 }
 
 /* remove an arbitrary cache entry for promotion */ 
 static void cache_unlink (struct crec *crecp)
 {
+  /* Pi-hole modification */
+  struct crec **head = &cache_head, **tail = &cache_tail;
+
+  if (crecp->segment == CACHE_PROTECTED)
+    {
+      head = &prot_head;
+      tail = &prot_tail;
+      prot_count--;
+    }
+  else if (crecp->segment == CACHE_FREE)
+    {
+      head = &free_head;
+      tail = &free_tail;
+    }
+  /************************/
+
   if (crecp->prev)
     crecp->prev->next = crecp->next;
   else
-    cache_head = crecp->next;
+    *head = crecp->next;
 
   if (crecp->next)
     crecp->next->prev = crecp->prev;
   else
-    cache_tail = crecp->prev;
+    *tail = crecp->prev;
+}
+
+/* Pi-hole modification */
+/* A cache entry has been looked up: move it to the start of the protected
+   list */
+static void cache_promote(struct crec *crecp)
+{
+  if (crecp->segment == CACHE_PROTECTED)
+    daemon->metrics[METRIC_DNS_CACHE_HITS_PROTECTED]++;
+  else
+    {
+      daemon->metrics[METRIC_DNS_CACHE_HITS_PROBATION]++;
+      daemon->metrics[METRIC_DNS_CACHE_PROMOTED]++;
+    }
+
+  cache_unlink(crecp);
+
+  if (prot_head)
+    prot_head->prev = crecp;
+  crecp->next = prot_head;
+  crecp->prev = NULL;
+  prot_head = crecp;
+  if (!prot_tail)
+    prot_tail = crecp;
+  crecp->segment = CACHE_PROTECTED;
+  prot_count++;
+}
+
+static void cache_demote(void)
+{
+  struct crec *crecp = prot_tail;
+
+  cache_unlink(crecp);
+  crecp->segment = CACHE_DEMOTED;
+  cache_link(crecp);
+  daemon->metrics[METRIC_DNS_CACHE_DEMOTED]++;
+}
+
+/* Move the least recently used entries of the protected list back to the
+   probation list when it is larger than its share of the cache. This is
+   not done during lookups as the callers of cache_find_by_*() follow the
+   protected list while iterating over the results */
+static void cache_rebalance(void)
+{
+  const int max_protected = (int)((long long)daemon->cachesize * CACHE_PROTECTED_PCT / 100);
+
+  /* Also when there is nothing we could evict otherwise */
+  while (prot_tail && (prot_count > max_protected || (!cache_tail && !free_head)))
+    cache_demote();
+}
+
+/* Evict entries from the end of the probation list until an entry of the
+   given size fits into the memory limit */
+static void cache_shrink(size_t bytes, time_t now)
+{
+  while (cache_bytes + bytes > daemon->cache_max_bytes)
+    {
+      struct crec *crecp = cache_tail;
+
+      if (!crecp)
+	{
+	  if (!prot_tail)
+	    return;
+	  cache_demote();
+	  continue;
+	}
+
+      if (difftime(now, crecp->ttd) < 0)
+	daemon->metrics[METRIC_DNS_CACHE_EVICTED_MEMORY]++;
+
+      cache_scan_free(cache_get_name(crecp), &crecp->addr, crecp->uid, now, crecp->flags, NULL, NULL);
+
+      /* Do not loop forever if the entry could not be freed */
+      if (crecp->segment != CACHE_FREE)
+	return;
+    }
 }
 
+/* Memory used by a cache entry including its long name and blockdata */
+static size_t cache_entry_bytes(char *name, union all_addr *addr, unsigned int flags)
+{
+  size_t bytes = sizeof(struct crec), datalen = 0;
+
+  if (name && strlen(name) > SMALLDNAME-1)
+    bytes += sizeof(union bigname);
+
+  if (addr && !(flags & F_NEG))
+    {
+      if ((flags & F_RR) && (flags & F_KEYTAG))
+	datalen = addr->rrblock.datalen;
+#ifdef HAVE_DNSSEC
+      else if (flags & F_DNSKEY)
+	datalen = addr->key.keylen;
+      else if (flags & F_DS)
+	datalen = addr->ds.keylen;
+#endif
+    }
+
+  /* Blockdata is stored in chained blocks of KEYBLOCK_LEN bytes */
+  return bytes + (datalen + KEYBLOCK_LEN - 1) / KEYBLOCK_LEN * sizeof(struct blockdata);
+}
+/************************/
+
 char *cache_get_name(struct crec *crecp)
 {
   if (crecp->flags & F_BIGNAME)
@@ -679,9 +830,21 @@ static struct crec *really_insert(char *name, union all_addr *addr, unsigned sho
       return NULL;
     }
   
+  /************ Pi-hole modification ************/
+  /* Make room if the new entry would exceed the memory limit */
+  if (daemon->cache_max_bytes != 0)
+    cache_shrink(cache_entry_bytes(name, addr, flags), now);
+  /**********************************************/
+
   /* Now get a cache entry from the end of the LRU list */
   if (!target_crec)
     while (1) {
+      /************ Pi-hole modification ************/
+      cache_rebalance();
+      if ((new = free_head))
+	break;
+      /**********************************************/
+
       if (!(new = cache_tail)) /* no entries left - cache is too small, bail */
 	{
 	  insert_error = 1;
@@ -716,7 +879,13 @@ static struct crec *really_insert(char *name, union all_addr *addr, unsigned sho
 	  
 	  /* condition valid when stale-caching */
 	  if (difftime(now, new->ttd) < 0)
-	    daemon->metrics[METRIC_DNS_CACHE_LIVE_FREED]++;
+	    {
+	      daemon->metrics[METRIC_DNS_CACHE_LIVE_FREED]++;
+	      /* Pi-hole modification */
+	      daemon->metrics[new->segment == CACHE_DEMOTED ? METRIC_DNS_CACHE_EVICTED_DEMOTED :
+			      METRIC_DNS_CACHE_EVICTED_PROBATION]++;
+	      /************************/
+	    }
 	  
 	  cache_scan_free(cache_get_name(new), &new->addr, new->uid, now, new->flags, NULL, NULL); 
 	}
@@ -779,6 +948,9 @@ static struct crec *really_insert(char *name, union all_addr *addr, unsigned sho
     new->addr = *addr;	
 
   new->ttd = now + (time_t)ttl;
+  /* Pi-hole modification */
+  new->bytes = 0; /* accounted for when committed */
+  /************************/
   new->next = new_chain;
   new_chain = new;
   
@@ -802,6 +974,10 @@ void cache_end_insert(void)
 	  cache_hash(new_chain);
 	  cache_link(new_chain);
 	  daemon->metrics[METRIC_DNS_CACHE_INSERTED]++;
+	  /* Pi-hole modification */
+	  new_chain->bytes = cache_entry_bytes(cache_get_name(new_chain), &new_chain->addr, new_chain->flags);
+	  cache_bytes += new_chain->bytes;
+	  /************************/
 
 	  /* If we're a child process, send this cache entry up the pipe to the master.
 	     The marshalling process is rather nasty. */
@@ -1010,10 +1186,8 @@ struct crec *cache_find_by_name(struct crec *crecp, char *name, time_t now, unsi
 		      chainp = &crecp->next;
 		    }
 		  else
-		    {
-		      cache_unlink(crecp);
-		      cache_link(crecp);
-		    }
+		    /* Pi-hole modification */
+		    cache_promote(crecp);
 	      	      
 		  /* Move all but the first entry up the hash chain
 		     this implements round-robin. 
@@ -1053,7 +1227,8 @@ struct crec *cache_find_by_name(struct crec *crecp, char *name, time_t now, unsi
 	    }
 	}
 	  
-      *chainp = cache_head;
+      /* Pi-hole modification: entries found are at the start of the protected list */
+      *chainp = prot_head;
     }
 
   if (ans && 
@@ -1097,10 +1272,8 @@ struct crec *cache_find_by_addr(struct crec *crecp, union all_addr *addr,
 		       chainp = &crecp->next;
 		     }
 		   else
-		     {
-		       cache_unlink(crecp);
-		       cache_link(crecp);
-		     }
+		     /* Pi-hole modification */
+		     cache_promote(crecp);
 		 }
 	       up = &crecp->hash_next;
 	     }
@@ -1114,7 +1287,8 @@ struct crec *cache_find_by_addr(struct crec *crecp, union all_addr *addr,
 		 }
 	     }
        
-       *chainp = cache_head;
+       /* Pi-hole modification: entries found are at the start of the protected list */
+       *chainp = prot_head;
     }
   
   if (ans && 
@@ -1382,6 +1556,10 @@ void cache_reload(void)
 		big_free = cache->name.bname;
 	      }
 	    cache->flags = 0;
+	    /* Pi-hole modification */
+	    cache_unlink(cache);
+	    cache_free(cache);
+	    /************************/
 	  }
 	else
 	  up = &cache->hash_next;
@@ -1950,6 +2128,11 @@ void get_dnsmasq_cache_info(struct cache_info *ci)
       }
       else
 	ci->expired++;
+
+  for (struct crec *cache = cache_head; cache; cache = cache->next)
+    ci->probation++;
+  ci->protected = prot_count;
+  ci->bytes = cache_bytes;
 }
 /********************************************************/
 
@@ -1973,6 +2156,14 @@ void dump_cache(time_t now)
   my_syslog(LOG_INFO, _("DNSSEC per-RRSet signature fails HWM %u"), daemon->metrics[METRIC_SIG_FAIL_HWM]);
 #endif
 
+  /* Pi-hole modification */
+  my_syslog(LOG_INFO, _("cache hits %u (probation) / %u (protected), %u promoted, %u demoted"),
+	    daemon->metrics[METRIC_DNS_CACHE_HITS_PROBATION], daemon->metrics[METRIC_DNS_CACHE_HITS_PROTECTED],
+	    daemon->metrics[METRIC_DNS_CACHE_PROMOTED], daemon->metrics[METRIC_DNS_CACHE_DEMOTED]);
+  my_syslog(LOG_INFO, _("cache evictions %u (probation) / %u (demoted) / %u (memory limit), %zu bytes in use, limit %zu"),
+	    daemon->metrics[METRIC_DNS_CACHE_EVICTED_PROBATION], daemon->metrics[METRIC_DNS_CACHE_EVICTED_DEMOTED],
+	    daemon->metrics[METRIC_DNS_CACHE_EVICTED_MEMORY], cache_bytes, daemon->cache_max_bytes);
+  /************************/
   blockdata_report();
   my_syslog(LOG_INFO, _("child processes for TCP requests: in use %zu, highest since last SIGUSR1 %zu, max allowed %zu."),
 	    daemon->metrics[METRIC_TCP_CONNECTIONS],
@@ -2145,17 +2336,41 @@ const char *edestr(int ede)
 /**** P-hole modified: Added file and line and serve log_query via macro defined in dnsmasq.h ****/
 void _log_query(unsigned int flags, char *name, union all_addr *addr, char *arg, unsigned short type, const char *file, const int line)
 {
-  char *source, *dest;
-  char *verb = "is";
-  char *extra = "";
-  char *gap = " ";
-  char portstring[7]; /* space for #<portnum> */
+  /* Pi-hole modification */
+  static char *buff = NULL;
+  /************************/
 
   FTL_hook(flags, name, addr, arg, daemon->log_display_id, type, file, line);
   
   if (!option_bool(OPT_LOG))
     return;
 
+  /* Pi-hole modification: records of the binary query log are only
+     formatted when they are rendered */
+  if (log_query_binary(flags, name, addr, arg, type))
+    return;
+
+  if (!buff && !(buff = whine_malloc(QUERY_LOG_LINE)))
+    return;
+
+  format_log_query(buff, QUERY_LOG_LINE, flags, name, addr, arg, type,
+		   daemon->log_display_id, daemon->log_source_addr, option_bool(OPT_EXTRALOG));
+  my_syslog(LOG_INFO, "%s", buff);
+  /************************/
+}
+
+/* Pi-hole modification: split off _log_query() so records of the binary
+   query log are rendered exactly like the lines of the text log */
+void format_log_query(char *buff, size_t size, unsigned int flags, char *name, union all_addr *addr, char *arg,
+		      unsigned short type, unsigned int id, union mysockaddr *source, int extralog)
+{
+  char *source_str, *dest;
+  char *verb = "is";
+  char *extra = "";
+  char *gap = " ";
+  char portstring[7]; /* space for #<portnum> */
+  char addrbuff[ADDRSTRLEN], addrbuff2[ADDRSTRLEN], extrabuff[64];
+
   /* build query type string if requested */
   if (!(flags & (F_SERVER | F_IPSET)) && type > 0)
     arg = querystr(arg, type);
@@ -2163,7 +2378,7 @@ void _log_query(unsigned int flags, char *name, union all_addr *addr, char *arg,
   dest = arg;
 
 #ifdef HAVE_DNSSEC
-  if ((flags & F_DNSSECOK) && option_bool(OPT_EXTRALOG))
+  if ((flags & F_DNSSECOK) && extralog)
     extra = " (DNSSEC signed)";
 #endif
 
@@ -2171,7 +2386,7 @@ void _log_query(unsigned int flags, char *name, union all_addr *addr, char *arg,
 
   if (addr)
     {
-      dest = daemon->addrbuff;
+      dest = addrbuff;
 
        if (flags & F_RR)
 	 {
@@ -2181,7 +2396,7 @@ void _log_query(unsigned int flags, char *name, union all_addr *addr, char *arg,
 	     dest = querystr(NULL, addr->rrdata.rrtype);
 	 }
        else if (flags & F_KEYTAG)
-	sprintf(daemon->addrbuff, arg, addr->log.keytag, addr->log.algo, addr->log.digest);
+	snprintf(addrbuff, sizeof(addrbuff), arg, addr->log.keytag, addr->log.algo, addr->log.digest);
       else if (flags & F_RCODE)
 	{
 	  unsigned int rcode = addr->log.rcode;
@@ -2193,18 +2408,18 @@ void _log_query(unsigned int flags, char *name, union all_addr *addr, char *arg,
 	  else if (rcode == NOTIMP)
 	    dest = "not implemented";
 	  else
-	    sprintf(daemon->addrbuff, "%u", rcode);
+	    sprintf(addrbuff, "%u", rcode);
 
 	  if (addr->log.ede != EDE_UNSET)
 	    {
-	      extra = daemon->addrbuff;
-	      sprintf(extra, " (EDE: %s)", edestr(addr->log.ede));
+	      extra = extrabuff;
+	      snprintf(extra, sizeof(extrabuff), " (EDE: %s)", edestr(addr->log.ede));
 	    }
 	}
       else if (flags & (F_IPV4 | F_IPV6))
 	{
 	  inet_ntop(flags & F_IPV4 ? AF_INET : AF_INET6,
-		    addr, daemon->addrbuff, ADDRSTRLEN);
+		    addr, addrbuff, ADDRSTRLEN);
 	  if ((flags & F_SERVER) && type != NAMESERVER_PORT)
 	    {
 	      extra = portstring;
@@ -2218,7 +2433,7 @@ void _log_query(unsigned int flags, char *name, union all_addr *addr, char *arg,
   if (flags & F_REVERSE)
     {
       dest = name;
-      name = daemon->addrbuff;
+      name = addrbuff;
     }
   
   if (flags & F_NEG)
@@ -2241,67 +2456,67 @@ void _log_query(unsigned int flags, char *name, union all_addr *addr, char *arg,
     dest = arg;
     
   if (flags & F_CONFIG)
-    source = "config";
+    source_str = "config";
   else if (flags & F_DHCP)
-    source = "DHCP";
+    source_str = "DHCP";
   else if (flags & F_HOSTS)
-    source = arg;
+    source_str = arg;
   else if (flags & F_UPSTREAM)
-    source = "reply";
+    source_str = "reply";
   else if (flags & F_SECSTAT)
     {
-      if (addr && addr->log.ede != EDE_UNSET && option_bool(OPT_EXTRALOG))
+      if (addr && addr->log.ede != EDE_UNSET && extralog)
 	{
-	  extra = daemon->addrbuff;
-	  sprintf(extra, " (EDE: %s)", edestr(addr->log.ede));
+	  extra = extrabuff;
+	  snprintf(extra, sizeof(extrabuff), " (EDE: %s)", edestr(addr->log.ede));
 	}
-      source = "validation";
+      source_str = "validation";
       dest = arg;
     }
   else if (flags & F_AUTH)
-    source = "auth";
+    source_str = "auth";
    else if (flags & F_DNSSEC)
     {
-      source = arg;
+      source_str = arg;
       verb = "to";
     }
    else if (flags & F_SERVER)
     {
-      source = "forwarded";
+      source_str = "forwarded";
       verb = "to";
     }
   else if (flags & F_QUERY)
     {
-      source = arg;
+      source_str = arg;
       verb = "from";
     }
   else if (flags & F_IPSET)
     {
-      source = type ? "ipset add" : "nftset add";
+      source_str = type ? "ipset add" : "nftset add";
       dest = name;
       name = arg;
-      verb = daemon->addrbuff;
+      verb = addrbuff;
     }
   else if (flags & F_STALE)
-    source = "cached-stale";
+    source_str = "cached-stale";
   else
-    source = "cached";
+    source_str = "cached";
   
   if (!name)
     gap = name = "";
   else if (!name[0])
     name = ".";
   
-  if (option_bool(OPT_EXTRALOG))
+  if (extralog)
     {
-      if (flags & F_NOEXTRA)
-	my_syslog(LOG_INFO, "%u %s %s%s%s %s%s", daemon->log_display_id, source, name, gap, verb, dest, extra);
+      if ((flags & F_NOEXTRA) || !source)
+	snprintf(buff, size, "%u %s %s%s%s %s%s", id, source_str, name, gap, verb, dest, extra);
       else
 	{
-	   int port = prettyprint_addr(daemon->log_source_addr, daemon->addrbuff2);
-	   my_syslog(LOG_INFO, "%u %s/%u %s %s%s%s %s%s", daemon->log_display_id, daemon->addrbuff2, port, source, name, gap, verb, dest, extra);
+	   int port = prettyprint_addr(source, addrbuff2);
+	   snprintf(buff, size, "%u %s/%u %s %s%s%s %s%s", id, addrbuff2, port, source_str, name, gap, verb, dest, extra);
 	}
     }
   else
-    my_syslog(LOG_INFO, "%s %s%s%s %s%s", source, name, gap, verb, dest, extra);
+    snprintf(buff, size, "%s %s%s%s %s%s", source_str, name, gap, verb, dest, extra);
 }
@@ -35,6 +35,9 @@
 #define LOCALS_LOGGED 8 /* Only log this many local addresses when logging state */
 #define LEASE_RETRY 60 /* on error, retry writing leasefile after LEASE_RETRY seconds */
 #define CACHESIZ 150 /* default cache size */
+/* Pi-hole modification */
+#define CACHE_PROTECTED_PCT 80 /* share of the cache for names looked up more than once */
+/************************/
 #define TTL_FLOOR_LIMIT 3600 /* don't allow --min-cache-ttl to raise TTL above this under any circumstances */
 #define MAXLEASES 1000 /* maximum number of DHCP leases */
 #define PING_WAIT 3 /* wait for ping address-in-use test */
@@ -53,6 +56,9 @@
 #define CHGRP "root"
 /******************************/
 #define TFTP_MAX_CONNECTIONS 50 /* max simultaneous connections */
+/**** Pi-hole modification ****/
+#define TFTP_MAX_WINDOW 32 /* max blocks sent per ACK (RFC 7440) */
+/******************************/
 #define LOG_MAX 5 /* log-queue length */
 #define RANDFILE "/dev/urandom"
 #define DNSMASQ_SERVICE "uk.org.thekelleys.dnsmasq" /* Default - may be overridden by config */
@@ -344,6 +344,254 @@ static int is_config_in_context(struct dhcp_context *context, struct dhcp_config
   return 0;
 }
 
+/* Pi-hole modification */
+/* With thousands of dhcp-host lines, the walks through the config list below
+   dominate the time spent on every DHCP packet. We index the configs by exact
+   client-id, exact hardware address and hostname. Each hash chain keeps the
+   order of the config list, so the first entry matching context and tags is
+   the one the linear walk would have found. Configs with wildcard hardware
+   addresses go to a separate (short) list. The index is built on first use
+   and dropped whenever the config list is modified. */
+struct config_index_entry {
+  struct dhcp_config *config;
+  unsigned int posn; /* position in the config list */
+  struct config_index_entry *next;
+};
+
+#define INDEX_CLID   0
+#define INDEX_HWADDR 1
+#define INDEX_NAME   2
+#define INDEX_TABLES 3
+
+static struct {
+  int valid;
+  struct dhcp_config *configs;
+  unsigned int mask;
+  struct config_index_entry **buckets[INDEX_TABLES];
+  struct config_index_entry *entries;
+  struct dhcp_config **wildcards;
+  unsigned int wildcard_count;
+} config_index;
+
+void invalidate_config_index(void)
+{
+  config_index.valid = 0;
+}
+
+/* FNV-1a, optionally case-insensitive like hostname_isequal() */
+static unsigned int config_index_hash(const unsigned char *p, int len, int fold)
+{
+  unsigned int c, hash = 2166136261u;
+
+  for (; len > 0; len--)
+    {
+      c = *p++;
+      if (fold && c >= 'A' && c <= 'Z')
+	c += 'a' - 'A';
+      hash = (hash ^ c) * 16777619u;
+    }
+
+  return hash;
+}
+
+static void config_index_free(void)
+{
+  int i;
+
+  for (i = 0; i < INDEX_TABLES; i++)
+    {
+      free(config_index.buckets[i]);
+      config_index.buckets[i] = NULL;
+    }
+  free(config_index.entries);
+  free(config_index.wildcards);
+  config_index.entries = NULL;
+  config_index.wildcards = NULL;
+  config_index.wildcard_count = 0;
+  config_index.valid = 0;
+}
+
+static void config_index_add(int table, unsigned int hash, struct dhcp_config *config,
+			     unsigned int posn, struct config_index_entry **entry)
+{
+  struct config_index_entry **bucket = &config_index.buckets[table][hash & config_index.mask];
+
+  (*entry)->config = config;
+  (*entry)->posn = posn;
+  (*entry)->next = *bucket;
+  *bucket = (*entry)++;
+}
+
+/* Returns zero when the index cannot be used, callers fall back to the list walk then */
+static int config_index_build(struct dhcp_config *configs)
+{
+  struct dhcp_config *config, **list;
+  struct hwaddr_config *conf_addr;
+  struct config_index_entry *entry;
+  unsigned int count = 0, keys = 0, wildcards = 0, size = 16, i;
+  int t;
+
+  if (config_index.valid && config_index.configs == configs)
+    return 1;
+
+  config_index_free();
+
+  for (config = configs; config; config = config->next)
+    {
+      int wild = 0;
+
+      count++;
+      if (config->flags & CONFIG_CLID)
+	keys++;
+      if (config->flags & CONFIG_NAME)
+	keys++;
+      for (conf_addr = config->hwaddr; conf_addr; conf_addr = conf_addr->next)
+	if (conf_addr->wildcard_mask == 0)
+	  keys++;
+	else
+	  wild = 1;
+      wildcards += wild;
+    }
+
+  while (size < keys)
+    size <<= 1;
+
+  if (!(list = whine_malloc((count + 1) * sizeof(struct dhcp_config *))))
+    return 0;
+
+  for (t = 0; t < INDEX_TABLES; t++)
+    if (!(config_index.buckets[t] = whine_malloc(size * sizeof(struct config_index_entry *))))
+      break;
+
+  if (t != INDEX_TABLES ||
+      !(config_index.entries = whine_malloc((keys + 1) * sizeof(struct config_index_entry))) ||
+      !(config_index.wildcards = whine_malloc((wildcards + 1) * sizeof(struct dhcp_config *))))
+    {
+      free(list);
+      config_index_free();
+      return 0;
+    }
+
+  config_index.mask = size - 1;
+
+  for (i = 0, config = configs; config; config = config->next)
+    {
+      list[i++] = config;
+      for (conf_addr = config->hwaddr; conf_addr; conf_addr = conf_addr->next)
+	if (conf_addr->wildcard_mask != 0)
+	  {
+	    config_index.wildcards[config_index.wildcard_count++] = config;
+	    break;
+	  }
+    }
+
+  /* Walk backwards and prepend to get chains in list order */
+  for (entry = config_index.entries, i = count; i > 0; i--)
+    {
+      config = list[i - 1];
+
+      if (config->flags & CONFIG_CLID)
+	config_index_add(INDEX_CLID, config_index_hash(config->clid, config->clid_len, 0),
+			 config, i - 1, &entry);
+
+      if (config->flags & CONFIG_NAME)
+	config_index_add(INDEX_NAME, config_index_hash((unsigned char *)config->hostname,
+						       strlen(config->hostname), 1),
+			 config, i - 1, &entry);
+
+      for (conf_addr = config->hwaddr; conf_addr; conf_addr = conf_addr->next)
+	if (conf_addr->wildcard_mask == 0)
+	  config_index_add(INDEX_HWADDR, config_index_hash(conf_addr->hwaddr, conf_addr->hwaddr_len, 0),
+			   config, i - 1, &entry);
+    }
+
+  free(list);
+  config_index.configs = configs;
+  config_index.valid = 1;
+
+  return 1;
+}
+
+static struct dhcp_config *find_config_indexed(struct dhcp_context *context,
+					       unsigned char *clid, int clid_len,
+					       unsigned char *hwaddr, int hw_len, 
+					       int hw_type, char *hostname,
+					       struct dhcp_netid *tags, int tag_not_needed)
+{
+  struct config_index_entry *entry, *found = NULL;
+  struct dhcp_config *config, *candidate;
+  struct hwaddr_config *conf_addr;
+  unsigned int i;
+  int count, new;
+
+  if (clid)
+    {
+      for (entry = config_index.buckets[INDEX_CLID][config_index_hash(clid, clid_len, 0) & config_index.mask];
+	   entry; entry = entry->next)
+	if (entry->config->clid_len == clid_len &&
+	    memcmp(entry->config->clid, clid, clid_len) == 0 &&
+	    is_config_in_context(context, entry->config) &&
+	    match_netid(entry->config->filter, tags, tag_not_needed))
+	  {
+	    found = entry;
+	    break;
+	  }
+
+      /* dhcpcd zero-prefixed client-id, see find_config_match(). The list walk
+	 returns whichever of both matches comes first */
+      if ((!context || !(context->flags & CONTEXT_V6)) && clid_len > 0 && *clid == 0)
+	for (entry = config_index.buckets[INDEX_CLID][config_index_hash(clid+1, clid_len-1, 0) & config_index.mask];
+	     entry && (!found || entry->posn < found->posn); entry = entry->next)
+	  if (entry->config->clid_len == clid_len-1 &&
+	      memcmp(entry->config->clid, clid+1, clid_len-1) == 0 &&
+	      is_config_in_context(context, entry->config) &&
+	      match_netid(entry->config->filter, tags, tag_not_needed))
+	    {
+	      found = entry;
+	      break;
+	    }
+
+      if (found)
+	return found->config;
+    }
+
+  if (hwaddr)
+    for (entry = config_index.buckets[INDEX_HWADDR][config_index_hash(hwaddr, hw_len, 0) & config_index.mask];
+	 entry; entry = entry->next)
+      if (config_has_mac(entry->config, hwaddr, hw_len, hw_type) &&
+	  is_config_in_context(context, entry->config) &&
+	  match_netid(entry->config->filter, tags, tag_not_needed))
+	return entry->config;
+
+  if (hostname && context)
+    for (entry = config_index.buckets[INDEX_NAME][config_index_hash((unsigned char *)hostname, strlen(hostname), 1) & config_index.mask];
+	 entry; entry = entry->next)
+      if (hostname_isequal(entry->config->hostname, hostname) &&
+	  is_config_in_context(context, entry->config) &&
+	  match_netid(entry->config->filter, tags, tag_not_needed))
+	return entry->config;
+
+  if (!hwaddr)
+    return NULL;
+
+  /* use match with fewest wildcard octets */
+  for (candidate = NULL, count = 0, i = 0; i < config_index.wildcard_count; i++)
+    if (is_config_in_context(context, (config = config_index.wildcards[i])) &&
+	match_netid(config->filter, tags, tag_not_needed))
+      for (conf_addr = config->hwaddr; conf_addr; conf_addr = conf_addr->next)
+	if (conf_addr->wildcard_mask != 0 &&
+	    conf_addr->hwaddr_len == hw_len &&	
+	    (conf_addr->hwaddr_type == hw_type || conf_addr->hwaddr_type == 0) &&
+	    (new = memcmp_masked(conf_addr->hwaddr, hwaddr, hw_len, conf_addr->wildcard_mask)) > count)
+	  {
+	      count = new;
+	      candidate = config;
+	  }
+  
+  return candidate;
+}
+/************************/
+
 static struct dhcp_config *find_config_match(struct dhcp_config *configs,
 					     struct dhcp_context *context,
 					     unsigned char *clid, int clid_len,
@@ -355,6 +603,12 @@ static struct dhcp_config *find_config_match(struct dhcp_config *configs,
   struct dhcp_config *config, *candidate; 
   struct hwaddr_config *conf_addr;
 
+  /* Pi-hole modification */
+  if (configs == daemon->dhcp_conf && config_index_build(configs))
+    return find_config_indexed(context, clid, clid_len, hwaddr, hw_len, hw_type,
+			       hostname, tags, tag_not_needed);
+  /************************/
+
   if (clid)
     for (config = configs; config; config = config->next)
       if (config->flags & CONFIG_CLID)
@@ -893,6 +893,11 @@ void dhcp_read_ethers(void)
       return;
     }
 
+  /* Pi-hole modification */
+  /* Configs are removed, added and modified below */
+  invalidate_config_index();
+  /************************/
+
   /* This can be called again on SIGHUP, so remove entries created last time round. */
   for (up = &daemon->dhcp_conf, config = daemon->dhcp_conf; config; config = tmp)
     {
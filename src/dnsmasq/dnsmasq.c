@@ -1085,6 +1085,11 @@ int main_dnsmasq (int argc, char **argv)
       else if (is_dad_listeners() &&
 	       (timeout == -1 || timeout > 1000))
 	timeout = 1000;
+
+      /* Pi-hole modification: write the binary query log at least once a second */
+      if (binlog_pending() && (timeout == -1 || timeout > 1000))
+	timeout = 1000;
+      /************************/
       
       if (daemon->port != 0)
 	set_dns_listeners();
@@ -1146,7 +1151,12 @@ int main_dnsmasq (int argc, char **argv)
 
 #ifdef HAVE_SCRIPT
 #    ifdef HAVE_DHCP
-      while (helper_buf_empty() && do_script_run(now)); 
+      /* Pi-hole modification */
+      /* Pass as many lease events to the helper as the pipe takes, so it
+	 can process them in batches. helper_write() does not block */
+      while (helper_buf_empty() && do_script_run(now))
+	helper_write();
+      /************************/
 #    endif
 
       /* Refresh cache */
@@ -1597,6 +1607,11 @@ static void async_event(int pipe, time_t now)
 	if (daemon->log_file != NULL)
 	  log_reopen(daemon->log_file);
 
+	/* Pi-hole modification */
+	if (daemon->binlog_file != NULL && !binlog_reopen())
+	  my_syslog(LOG_ERR, _("cannot open log %s: %s"), daemon->binlog_file, strerror(errno));
+	/************************/
+
 	break;
 
       case EVENT_NEWADDR:
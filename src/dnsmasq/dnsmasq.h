@@ -487,6 +487,10 @@ struct crec {
   /* used as class if DNSKEY/DS, index to source for F_HOSTS */
   unsigned int uid; 
   unsigned int flags;
+  /* Pi-hole modification */
+  unsigned int bytes; /* memory accounted to this entry */
+  unsigned char segment; /* CACHE_FREE, CACHE_PROBATION, ... */
+  /************************/
   union {
     char sname[SMALLDNAME];
     union bigname *bname;
@@ -494,6 +498,14 @@ struct crec {
   } name;
 };
 
+/* Pi-hole modification */
+/* LRU list a cache entry is in, see cache.c */
+#define CACHE_FREE      0
+#define CACHE_PROBATION 1 /* not looked up since inserted */
+#define CACHE_PROTECTED 2
+#define CACHE_DEMOTED   3 /* moved back from protected to probation */
+/************************/
+
 #define SIZEOF_BARE_CREC (sizeof(struct crec) - SMALLDNAME)
 #define SIZEOF_POINTER_CREC (sizeof(struct crec) + sizeof(char *) - SMALLDNAME)
 
@@ -592,9 +604,15 @@ struct randfd_list {
 
 struct server {
   u16 flags, domain_len;
+  /* Pi-hole modification */
+  int arrayposn; /* moved here so local entries have it too */
+  /************************/
   char *domain;
   struct server *next;
-  int serial, arrayposn;
+  /* Pi-hole modification */
+  struct server *hash_next; /* chain of the domain index, see domain-match.c */
+  /************************/
+  int serial;
   int last_server;
   union mysockaddr addr, source_addr;
   char interface[IF_NAMESIZE+1];
@@ -611,25 +629,32 @@ struct server {
 #endif
 };
 
-/* First four fields must match struct server in next three definitions.. */
+/* First six fields must match struct server in next three definitions.. */
+/* Pi-hole modification: arrayposn and hash_next added */
 struct serv_addr4 {
   u16 flags, domain_len;
+  int arrayposn;
   char *domain;
   struct server *next;
+  struct server *hash_next;
   struct in_addr addr;
 };
 
 struct serv_addr6 {
   u16 flags, domain_len;
+  int arrayposn;
   char *domain;
   struct server *next;
+  struct server *hash_next;
   struct in6_addr addr;
 };
 
 struct serv_local {
   u16 flags, domain_len;
+  int arrayposn;
   char *domain;
   struct server *next;
+  struct server *hash_next;
 };
 
 struct rebind_domain {
@@ -1102,6 +1127,9 @@ struct tftp_file {
   off_t size;
   dev_t dev;
   ino_t inode;
+  /* Pi-hole modification */
+  unsigned char *map; /* NULL if not mapped */
+  /************************/
   char filename[];
 };
 
@@ -1115,6 +1143,10 @@ struct tftp_transfer {
   union all_addr source;
   int if_index;
   char opt_blocksize, opt_transize, netascii, carrylf;
+  /* Pi-hole modification */
+  char opt_windowsize;
+  unsigned int windowsize; /* RFC 7440 */
+  /************************/
   struct tftp_file *file;
   struct tftp_transfer *next;
 };
@@ -1189,9 +1221,15 @@ extern struct daemon {
   struct allowlist *allowlists;
   int log_fac; /* log facility */
   char *log_file; /* optional log file */
+  /* Pi-hole modification */
+  char *binlog_file; /* optional binary query log */
+  /************************/
   int max_logs;  /* queue limit */
   int randport_limit; /* Maximum number of source ports for query. */
   int cachesize, ftabsize;
+  /* Pi-hole modification */
+  size_t cache_max_bytes; /* 0 = no limit */
+  /************************/
   int port, query_port, min_port, max_port;
   unsigned long local_ttl, neg_ttl, max_ttl, min_cache_ttl, max_cache_ttl, auth_ttl, dhcp_ttl, use_dhcp_ttl;
   char *dns_client_id;
@@ -1222,6 +1260,9 @@ extern struct daemon {
   struct hostsfile *dhcp_hosts_file, *dhcp_opts_file;
   struct dyndir *dynamic_dirs;
   int dhcp_max, tftp_max, tftp_mtu;
+  /* Pi-hole modification */
+  int tftp_window; /* largest windowsize granted */
+  /************************/
   int dhcp_server_port, dhcp_client_port;
   int start_tftp_port, end_tftp_port; 
   unsigned int min_leasetime;
@@ -1339,6 +1380,38 @@ struct server_details {
   u16 *flags;
 };
 
+/* Pi-hole modification */
+/* Binary query log (--log-queries-binary), written by log.c and rendered by
+   pihole-FTL query-log. The file starts with a header, followed by records
+   in host byte order */
+#define BINLOG_MAGIC "PHQ1"
+struct binlog_header {
+  char magic[4];
+  u16 addr_size; /* sizeof(union all_addr) of the writer */
+  u16 record_size; /* sizeof(struct binlog_record) of the writer */
+};
+
+struct binlog_record {
+  u16 length; /* of the whole record, including address, name and arg */
+  u16 type;
+  u32 flags;
+  u32 id;
+  u32 pid;
+  u32 sec, usec;
+  u16 port; /* of the client */
+  u8 family; /* of the client: 0 (unknown), 4 or 6 */
+  u8 contents; /* BINLOG_* below */
+  u8 client[16];
+  /* followed by union all_addr (BINLOG_ADDR), name (BINLOG_NAME) and
+     arg (BINLOG_ARG) as zero-terminated strings */
+};
+
+#define BINLOG_EXTRA 1 /* log-queries=extra was set */
+#define BINLOG_ADDR  2
+#define BINLOG_NAME  4
+#define BINLOG_ARG   8
+/************************/
+
 /* cache.c */
 void cache_init(void);
 unsigned short rrtype(char *in);
@@ -1346,6 +1419,9 @@ void next_uid(struct crec *crecp);
 /********************************************* Pi-hole modification ***********************************************/
 #define log_query(flags,name,addr,arg,type) _log_query(flags, name, addr, arg, type, __FILE__, __LINE__)
 void _log_query(unsigned int flags, char *name, union all_addr *addr, char *arg, unsigned short type, const char* file, const int line); 
+#define QUERY_LOG_LINE (2*MAXDNAME + 256)
+void format_log_query(char *buff, size_t size, unsigned int flags, char *name, union all_addr *addr, char *arg,
+		      unsigned short type, unsigned int id, union mysockaddr *source, int extralog);
 struct cache_info {
   struct valid {
     int ipv4;
@@ -1358,6 +1434,9 @@ struct cache_info {
   } valid;
   int expired;
   int immortal;
+  int probation;
+  int protected;
+  size_t bytes;
 };
 void get_dnsmasq_cache_info(struct cache_info *ci);
 /******************************************************************************************************************/
@@ -1528,6 +1607,11 @@ void my_syslog(int priority, const char *format, ...);
 void set_log_writer(void);
 void check_log_writer(int force);
 void flush_log(void);
+/* Pi-hole modification */
+int log_query_binary(unsigned int flags, char *name, union all_addr *addr, char *arg, unsigned short type);
+int binlog_reopen(void);
+int binlog_pending(void);
+/************************/
 
 /* option.c */
 void read_opts (int argc, char **argv, char *compile_opts);
@@ -1824,6 +1908,9 @@ struct dhcp_config *find_config(struct dhcp_config *configs,
 				int hw_type, char *hostname,
 				struct dhcp_netid *filter);
 int config_has_mac(struct dhcp_config *config, unsigned char *hwaddr, int len, int type);
+/* Pi-hole modification */
+void invalidate_config_index(void);
+/************************/
 #ifdef HAVE_LINUX_NETWORK
 char *whichdevice(void);
 int bind_dhcp_devices(char *bound_device);
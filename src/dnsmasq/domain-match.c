@@ -15,6 +15,8 @@
 */
 
 #include "dnsmasq.h"
+#include "../dnsmasq_interface.h"
+#include "../upstream_score.h"
 
 static int order(char *qdomain, size_t qlen, struct server *serv);
 static int order_qsort(const void *a, const void *b);
@@ -23,10 +25,128 @@ static int order_servers(struct server *s, struct server *s2);
 /* If the server is USE_RESOLV or LITERAL_ADDRES, it lives on the local_domains chain. */
 #define SERV_IS_LOCAL (SERV_USE_RESOLV | SERV_LITERAL_ADDRESS)
 
+/* Pi-hole modification */
+/* Index of all server and local records by domain. It is maintained in place
+   by add_update_server(), mark_servers() and cleanup_servers() so reloads
+   never have to rebuild it. Each record remembers its position in
+   daemon->serverarray (arrayposn), so lookup_domain() can find the group of
+   records for the longest matching suffix of a name with one probe per label
+   instead of repeated binary searches. */
+static struct server **server_hash = NULL;
+static unsigned int server_hash_size = 0, server_hash_count = 0;
+
+/* Set when local records were added or removed. Otherwise, the local records
+   are still sorted in daemon->serverarray and only the (few) upstream servers
+   need to be sorted and merged in when the array is rebuilt. */
+static int locals_changed = 1;
+
+static unsigned int hash_domain(const char *domain)
+{
+  unsigned int c, val = 2166136261u;
+
+  while ((c = (unsigned char) *domain++))
+    {
+      /* don't use tolower and friends here - they may be messed up by LOCALE */
+      if (c >= 'A' && c <= 'Z')
+	c += 'a' - 'A';
+      val = (val ^ c) * 16777619u;
+    }
+
+  return val ^ (val >> 16);
+}
+
+static void server_hash_resize(unsigned int size)
+{
+  struct server **new, *serv, *tmp;
+  unsigned int i;
+
+  if (!(new = whine_malloc(size * sizeof(struct server *))))
+    return;
+
+  for (i = 0; i < server_hash_size; i++)
+    for (serv = server_hash[i]; serv; serv = tmp)
+      {
+	struct server **bucket = &new[hash_domain(serv->domain) & (size - 1)];
+	tmp = serv->hash_next;
+	serv->hash_next = *bucket;
+	*bucket = serv;
+      }
+
+  if (server_hash)
+    free(server_hash);
+  server_hash = new;
+  server_hash_size = size;
+}
+
+static void server_hash_add(struct server *serv)
+{
+  struct server **bucket;
+
+  /* Keep the load factor below one, the size is a power of two */
+  if (server_hash_count >= server_hash_size)
+    server_hash_resize(server_hash_size == 0 ? 64 : 2 * server_hash_size);
+
+  if (server_hash_size == 0)
+    return;
+
+  bucket = &server_hash[hash_domain(serv->domain) & (server_hash_size - 1)];
+  serv->hash_next = *bucket;
+  *bucket = serv;
+  server_hash_count++;
+}
+
+static void server_hash_del(struct server *serv)
+{
+  struct server **up;
+
+  if (server_hash_size == 0)
+    return;
+
+  for (up = &server_hash[hash_domain(serv->domain) & (server_hash_size - 1)]; *up; up = &(*up)->hash_next)
+    if (*up == serv)
+      {
+	*up = serv->hash_next;
+	server_hash_count--;
+	break;
+      }
+}
+
+/* Position in daemon->serverarray of the records for exactly this domain, or -1.
+   Only wildcard records match names which do not start at a label boundary,
+   otherwise plain records are preferred, as *example.com is sorted after
+   example.com */
+static int find_server(const char *qdomain, int boundary)
+{
+  struct server *serv;
+  int wildcard = -1;
+
+  if (server_hash_size == 0)
+    return -1;
+
+  for (serv = server_hash[hash_domain(qdomain) & (server_hash_size - 1)]; serv; serv = serv->hash_next)
+    {
+      /* Records not (yet) in the array, e.g. servers in a loop */
+      if (serv->arrayposn < 0 || serv->arrayposn >= daemon->serverarraysz ||
+	  daemon->serverarray[serv->arrayposn] != serv)
+	continue;
+
+      if ((serv->flags & SERV_FOR_NODOTS) || !hostname_isequal(qdomain, serv->domain))
+	continue;
+
+      if (serv->flags & SERV_WILDCARD)
+	wildcard = serv->arrayposn;
+      else if (boundary)
+	return serv->arrayposn;
+    }
+
+  return wildcard;
+}
+/************************/
+
 void build_server_array(void)
 {
   struct server *serv;
-  int count = 0;
+  int count = 0, nlocal = 0, oldsz = daemon->serverarraysz;
   
   for (serv = daemon->servers; serv; serv = serv->next)
 #ifdef HAVE_LOOP
@@ -40,11 +160,12 @@ void build_server_array(void)
   
   for (serv = daemon->local_domains; serv; serv = serv->next)
     {
-      count++;
+      nlocal++;
       if (serv->flags & SERV_WILDCARD)
 	daemon->server_has_wildcard = 1;
     }
   
+  count += nlocal;
   daemon->serverarraysz = count;
 
   if (count > daemon->serverarrayhwm)
@@ -56,36 +177,90 @@ void build_server_array(void)
       if ((new = whine_malloc(count * sizeof(struct server *))))
 	{
 	  if (daemon->serverarray)
-	    free(daemon->serverarray);
+	    {
+	      /* Pi-hole modification: keep the sorted local records */
+	      memcpy(new, daemon->serverarray, oldsz * sizeof(struct server *));
+	      free(daemon->serverarray);
+	    }
 	  
 	  daemon->serverarray = new;
 	  daemon->serverarrayhwm = count;
 	}
     }
 
-  count = 0;
+  /* Pi-hole modification */
+  if (!locals_changed)
+    {
+      /* Only upstream servers changed. Collect the local records, which
+	 are still in order, at the start of the array. cleanup_servers()
+	 cleared the slots of deleted servers. */
+      int i;
+
+      for (count = 0, i = 0; i < oldsz && count < nlocal; i++)
+	if ((serv = daemon->serverarray[i]) && (serv->flags & SERV_IS_LOCAL))
+	  daemon->serverarray[count++] = serv;
+
+      if (count != nlocal)
+	locals_changed = 1;
+    }
   
+  if (locals_changed)
+    {
+      /* Sort everything */
+      for (count = 0, serv = daemon->local_domains; serv; serv = serv->next, count++)
+	daemon->serverarray[count] = serv;
+    }
+
   for (serv = daemon->servers; serv; serv = serv->next)
 #ifdef HAVE_LOOP
     if (!(serv->flags & SERV_LOOP))
 #endif
       {
 	daemon->serverarray[count] = serv;
-	serv->serial = count;
+	serv->serial = count - nlocal;
 	serv->last_server = -1;
 	count++;
       }
   
-  for (serv = daemon->local_domains; serv; serv = serv->next, count++)
-    daemon->serverarray[count] = serv;
-  
-  qsort(daemon->serverarray, daemon->serverarraysz, sizeof(struct server *), order_qsort);
+  if (locals_changed)
+    qsort(daemon->serverarray, daemon->serverarraysz, sizeof(struct server *), order_qsort);
+  else
+    {
+      /* Sort the upstream servers and merge them with the local records
+	 from the back, which keeps this linear in the number of local
+	 records. */
+      int nserv = daemon->serverarraysz - nlocal;
+      struct server **up;
+
+      qsort(&daemon->serverarray[nlocal], nserv, sizeof(struct server *), order_qsort);
+
+      if (nserv > 0 && nlocal > 0 && (up = whine_malloc(nserv * sizeof(struct server *))))
+	{
+	  int i = nlocal - 1, j = nserv - 1, k = daemon->serverarraysz - 1;
+
+	  memcpy(up, &daemon->serverarray[nlocal], nserv * sizeof(struct server *));
+	  while (j >= 0)
+	    if (i >= 0 && order_qsort(&daemon->serverarray[i], &up[j]) > 0)
+	      daemon->serverarray[k--] = daemon->serverarray[i--];
+	    else
+	      daemon->serverarray[k--] = up[j--];
+
+	  free(up);
+	}
+      else if (nserv > 0 && nlocal > 0)
+	qsort(daemon->serverarray, daemon->serverarraysz, sizeof(struct server *), order_qsort);
+    }
+
+  locals_changed = 0;
   
   /* servers need the location in the array to find all the whole
-     set of equivalent servers from a pointer to a single one. */
+     set of equivalent servers from a pointer to a single one.
+     Local records need it for lookups through the index. */
   for (count = 0; count < daemon->serverarraysz; count++)
-    if (!(daemon->serverarray[count]->flags & SERV_IS_LOCAL))
-      daemon->serverarray[count]->arrayposn = count;
+    daemon->serverarray[count]->arrayposn = count;
+
+  upstream_scores_prune();
+  /************************/
 }
 
 /* we're looking for the server whose domain is the longest exact match
@@ -103,9 +278,9 @@ void build_server_array(void)
 */
 int lookup_domain(char *domain, int flags, int *lowout, int *highout)
 {
-  int rc, crop_query, nodots;
+  int crop_query, nodots;
   ssize_t qlen;
-  int try, high, low = 0;
+  int try;
   int nlow = 0, nhigh = 0;
   char *cp, *qdomain = domain;
 
@@ -126,112 +301,36 @@ int lookup_domain(char *domain, int flags, int *lowout, int *highout)
   /* Search shorter and shorter RHS substrings for a match */
   while (qlen >= 0)
     {
-      /* Note that when we chop off a label, all the possible matches
-	 MUST be at a larger index than the nearest failing match with one more
-	 character, since the array is sorted longest to smallest. Hence 
-	 we don't reset low to zero here, we can go further below and crop the 
-	 search string to the size of the largest remaining server
-	 when this match fails. */
-      high = daemon->serverarraysz;
+      /* Pi-hole modification: one probe of the domain index per label
+	 (or per character with wildcard domains) */
       crop_query = 1;
       
-      /* binary search */
-      while (1) 
+      if ((try = find_server(qdomain, qdomain == domain || *qdomain == 0 || *(qdomain-1) == '.')) != -1 &&
+	  filter_servers(try, flags, &nlow, &nhigh))
+      /************************/
+	/* We have a match, but it may only be (say) an IPv6 address, and
+	   if the query wasn't for an AAAA record, it's no good, and we need
+	   to continue generalising */
 	{
-	  try = (low + high)/2;
-
-	  if ((rc = order(qdomain, qlen, daemon->serverarray[try])) == 0)
-	    break;
-	  
-	  if (rc < 0)
+	  /* We've matched a setting which says to use servers without a domain.
+	     Continue the search with empty query. We set the F_SERVER flag
+	     so that --address=/#/... doesn't match. */
+	  if (daemon->serverarray[nlow]->flags & SERV_USE_RESOLV)
 	    {
-	      if (high == try)
-		{
-		  /* qdomain is longer or same length as longest domain, and try == 0 
-		     crop the query to the longest domain. */
-		  crop_query = qlen - daemon->serverarray[try]->domain_len;
-		  break;
-		}
-	      high = try;
+	      crop_query = qlen;
+	      flags |= F_SERVER;
 	    }
 	  else
-	    {
-	      if (low == try)
-		{
-		  /* try now points to the last domain that sorts before the query, so 
-		     we know that a substring of the query shorter than it is required to match, so
-		     find the largest domain that's shorter than try. Note that just going to
-		     try+1 is not optimal, consider searching bbb in (aaa,ccc,bb). try will point
-		     to aaa, since ccc sorts after bbb, but the first domain that has a chance to 
-		     match is bb. So find the length of the first domain later than try which is
-		     is shorter than it. 
-		     There's a nasty edge case when qdomain sorts before _any_ of the 
-		     server domains, where try _doesn't point_ to the last domain that sorts
-		     before the query, since no such domain exists. In that case, the loop 
-		     exits via the rc < 0 && high == try path above and this code is
-		     not executed. */
-		  ssize_t len, old = daemon->serverarray[try]->domain_len;
-		  while (++try != daemon->serverarraysz)
-		    {
-		      if (old != (len = daemon->serverarray[try]->domain_len))
-			{
-			  crop_query = qlen - len;
-			  break;
-			}
-		    }
-		  break;
-		}
-	      low = try;
-	    }
-	};
-      
-      if (rc == 0)
-	{
-	  int found = 1;
-
-	  if (daemon->server_has_wildcard)
-	    {
-	      /* if we have example.com and *example.com we need to check against *example.com, 
-		 but the binary search may have found either. Use the fact that example.com is sorted before *example.com
-		 We favour example.com in the case that both match (ie www.example.com) */
-	      while (try != 0 && order(qdomain, qlen, daemon->serverarray[try-1]) == 0)
-		try--;
-	      
-	      if (!(qdomain == domain || *qdomain == 0 || *(qdomain-1) == '.'))
-		{
-		  while (try < daemon->serverarraysz-1 && order(qdomain, qlen, daemon->serverarray[try+1]) == 0)
-		    try++;
-		  
-		  if (!(daemon->serverarray[try]->flags & SERV_WILDCARD))
-		     found = 0;
-		}
-	    }
-	  
-	  if (found && filter_servers(try, flags, &nlow, &nhigh))
-	    /* We have a match, but it may only be (say) an IPv6 address, and
-	       if the query wasn't for an AAAA record, it's no good, and we need
-	       to continue generalising */
-	    {
-	      /* We've matched a setting which says to use servers without a domain.
-		 Continue the search with empty query. We set the F_SERVER flag
-		 so that --address=/#/... doesn't match. */
-	      if (daemon->serverarray[nlow]->flags & SERV_USE_RESOLV)
-		{
-		  crop_query = qlen;
-		  flags |= F_SERVER;
-		}
-	      else
-		break;
-	    }
+	    break;
 	}
       
       /* crop_query must be at least one always. */
       if (crop_query == 0)
 	crop_query = 1;
 
-      /* strip chars off the query based on the largest possible remaining match,
-	 then continue to the start of the next label unless we have a wildcard
-	 domain somewhere, in which case we have to go one at a time. */
+      /* strip chars off the query, then continue to the start of the next
+	 label unless we have a wildcard domain somewhere, in which case we
+	 have to go one at a time. */
       qlen -= crop_query;
       qdomain += crop_query;
       if (!daemon->server_has_wildcard)
@@ -588,6 +687,10 @@ void mark_servers(int flag)
 	if (serv->flags & flag)
 	  {
 	    *up = next;
+	    /* Pi-hole modification */
+	    server_hash_del(serv);
+	    locals_changed = 1;
+	    /************************/
 	    free(serv->domain);
 	    free(serv);
 	  }
@@ -608,6 +711,12 @@ void cleanup_servers(void)
        {
          server_gone(serv);
          *up = serv->next;
+	 /* Pi-hole modification: forget it in the index and the array */
+	 server_hash_del(serv);
+	 if (serv->arrayposn >= 0 && serv->arrayposn < daemon->serverarraysz &&
+	     daemon->serverarray[serv->arrayposn] == serv)
+	   daemon->serverarray[serv->arrayposn] = NULL;
+	 /************************/
 	 free(serv->domain);
 	 free(serv);
        }
@@ -669,6 +778,9 @@ int add_update_server(int flags,
       
       serv->next = daemon->local_domains;
       daemon->local_domains = serv;
+      /* Pi-hole modification */
+      locals_changed = 1;
+      /************************/
       
       if (flags & SERV_4ADDR)
 	((struct serv_addr4*)serv)->addr = local_addr->addr4;
@@ -720,6 +832,9 @@ int add_update_server(int flags,
 	    }
 	  
 	  memset(serv, 0, sizeof(struct server));
+	  /* Pi-hole modification */
+	  serv->arrayposn = -1;
+	  /************************/
 	  
 	  /* Add to the end of the chain, for order */
 	  if (daemon->servers_tail)
@@ -741,8 +856,16 @@ int add_update_server(int flags,
 	serv->source_addr = *source_addr;
     }
     
+  /* Pi-hole modification: reused servers are already in the index */
+  if (serv->domain != alloc_domain)
+    {
+      serv->domain = alloc_domain;
+      if (flags & SERV_IS_LOCAL)
+	serv->arrayposn = -1;
+      server_hash_add(serv);
+    }
+  /************************/
   serv->flags = flags;
-  serv->domain = alloc_domain;
   serv->domain_len = strlen(alloc_domain);
   
   return 1;
@@ -16,6 +16,9 @@
 
 #include "dnsmasq.h"
 #include "../dnsmasq_interface.h"
+#include "../upstream_score.h"
+#include "../tcp_pool.h"
+#include "../probes.h"
 
 static struct frec *get_new_frec(time_t now, struct server *serv, int force);
 static struct frec *lookup_frec(unsigned short id, int fd, void *hash, int *firstp, int *lastp);
@@ -28,7 +31,8 @@ static unsigned short get_id(void);
 static void free_frec(struct frec *f);
 static void query_full(time_t now, char *domain);
 
-static void return_reply(time_t now, struct frec *forward, struct dns_header *header, ssize_t n, int status);
+static void return_reply(time_t now, struct frec *forward, struct dns_header *header, ssize_t n, int status,
+			 const struct packet_meta *meta);
 
 /* Send a UDP packet with its source address set as "source" 
    unless nowild is true, when we just send it with the kernel default */
@@ -186,6 +190,9 @@ static int forward_query(int udpfd, union mysockaddr *udpaddr,
   int first, last, start = 0;
   int cacheable, forwarded = 0;
   size_t edns0_len;
+  /************ Pi-hole modification ************/
+  int fwd_start;
+  /**********************************************/
   unsigned char *pheader;
   int ede = EDE_UNSET;
   (void)do_bit;
@@ -254,7 +261,12 @@ static int forward_query(int udpfd, union mysockaddr *udpaddr,
 		 is a bit of a DoS vuln. Avoid by explicitly deleting the
 		 frec once it expires. */
 	      if (difftime(now, forward->time) >= TIMEOUT)
-		free_frec(forward);
+		{
+		  /************ Pi-hole modification ************/
+		  upstream_failed(forward->sentto);
+		  /**********************************************/
+		  free_frec(forward);
+		}
 	      goto reply;
 	    }
 	  
@@ -355,6 +367,12 @@ static int forward_query(int udpfd, union mysockaddr *udpaddr,
       if (option_bool(OPT_ALL_SERVERS))
 	forward->forwardall = 1;
 
+      /************ Pi-hole modification ************/
+      if (!option_bool(OPT_ORDER) && !forward->forwardall &&
+	  (fwd_start = FTL_select_upstream(first, last, gotname)) != -1)
+	start = fwd_start;
+      else
+      /**********************************************/
       if (!option_bool(OPT_ORDER))
 	{
 	  if (master->forwardcount++ > FORWARD_TEST ||
@@ -694,7 +712,8 @@ static struct ipsets *domain_find_sets(struct ipsets *setlist, const char *domai
 
 static size_t process_reply(struct dns_header *header, time_t now, struct server *server, size_t n, int check_rebind, 
 			    int no_cache, int cache_secure, int bogusanswer, int ad_reqd, int do_bit, int added_pheader, 
-			    union mysockaddr *query_source, unsigned char *limit, int ede)
+			    union mysockaddr *query_source, unsigned char *limit, int ede,
+			    const struct packet_meta *meta)
 {
   unsigned char *pheader, *sizep;
   struct ipsets *ipsets = NULL, *nftsets = NULL;
@@ -703,10 +722,22 @@ static size_t process_reply(struct dns_header *header, time_t now, struct server
   size_t plen; 
   /******** Pi-hole modification ********/
   unsigned char *pheader_copy = NULL;
+  struct packet_meta local_meta;
   /**************************************/
     
   (void)ad_reqd;
   (void)do_bit;
+
+  /******** Pi-hole modification ********/
+  // Interpret the packet before the pseudoheader might get stripped off
+  // below (added_pheader == true) unless this has already been done when
+  // the reply was received
+  if (!meta)
+    {
+      FTL_packet_meta(header, n, &local_meta);
+      meta = &local_meta;
+    }
+  /**************************************/
  
 #ifdef HAVE_IPSET
   if (daemon->ipsets && extract_request(header, n, daemon->namebuff, NULL))
@@ -723,10 +754,6 @@ static size_t process_reply(struct dns_header *header, time_t now, struct server
       /* Get extended RCODE. */
       rcode |= sizep[2] << 4;
 
-      // Pi-hole modification: Interpret the pseudoheader before
-      // it might get stripped off below (added_pheader == true)
-      FTL_parse_pseudoheaders(pheader, (size_t)plen);
-
       if (option_bool(OPT_CLIENT_SUBNET) && !check_source(header, plen, pheader, query_source))
 	{
 	  my_syslog(LOG_WARNING, _("discarding DNS reply: subnet option mismatch"));
@@ -770,7 +797,7 @@ static size_t process_reply(struct dns_header *header, time_t now, struct server
 	}
     }
   
-  FTL_header_analysis(header->hb4, rcode, server, daemon->log_display_id);
+  FTL_header_analysis(meta, server, daemon->log_display_id);
   
   /* RFC 4035 sect 4.6 para 3 */
   if (!is_sign && !option_bool(OPT_DNSSEC_PROXY))
@@ -1131,7 +1158,7 @@ static void dnssec_validate(struct frec *forward, struct dns_header *header,
   
   /* Validated original answer, all done. */
   if (!forward->dependent)
-    return_reply(now, forward, header, plen, status);
+    return_reply(now, forward, header, plen, status, NULL);
   else
     {
       /* validated subsidiary query/queries, (and cached result)
@@ -1165,6 +1192,9 @@ void reply_query(int fd, time_t now)
   struct server *server;
   void *hash;
   int first, last, c;
+  /******** Pi-hole modification ********/
+  struct packet_meta meta;
+  /**************************************/
     
   /* packet buffer overwritten */
   daemon->srv_save = NULL;
@@ -1195,7 +1225,10 @@ void reply_query(int fd, time_t now)
 
   server = daemon->serverarray[c];
 
-  FTL_header_analysis(header->hb4, RCODE(header), server, daemon->log_display_id);
+  /******** Pi-hole modification ********/
+  FTL_packet_meta(header, n, &meta);
+  FTL_header_analysis(&meta, server, daemon->log_display_id);
+  /**************************************/
 
   if (RCODE(header) != REFUSED)
     daemon->serverarray[first]->last_server = c;
@@ -1305,7 +1338,12 @@ void reply_query(int fd, time_t now)
 
   /* decrement count of replies recieved if we sent to more than one server. */
   if (forward->forwardall && (--forward->forwardall > 1) && RCODE(header) == REFUSED)
-    return;
+    {
+      /************ Pi-hole modification ************/
+      upstream_failed(server);
+      /**********************************************/
+      return;
+    }
 
   /* We tried resending to this server with a smaller maximum size and got an answer.
      Make that permanent. To avoid reduxing the packet size for a single dropped packet,
@@ -1335,6 +1373,12 @@ void reply_query(int fd, time_t now)
     server->mma_latency += dnsmasq_milliseconds() - forward->forward_timestamp - server->query_latency;
   /* denominator controls how many queries we average over. */
   server->query_latency = server->mma_latency/128;
+
+  /************ Pi-hole modification ************/
+  /* A server failing fast must not look like a fast server */
+  upstream_reply(server, meta.qtype, dnsmasq_milliseconds() - forward->forward_timestamp,
+		 RCODE(header) == SERVFAIL || RCODE(header) == REFUSED);
+  /**********************************************/
   
   
 #ifdef HAVE_DNSSEC
@@ -1344,10 +1388,11 @@ void reply_query(int fd, time_t now)
     dnssec_validate(forward, header, n, STAT_OK, now);
   else
 #endif
-    return_reply(now, forward, header, n, STAT_OK); 
+    return_reply(now, forward, header, n, STAT_OK, &meta); 
 }
 
-static void return_reply(time_t now, struct frec *forward, struct dns_header *header, ssize_t n, int status)
+static void return_reply(time_t now, struct frec *forward, struct dns_header *header, ssize_t n, int status,
+			 const struct packet_meta *meta)
 {
   int check_rebind = 0, no_cache_dnssec = 0, cache_secure = 0, bogusanswer = 0;
   size_t nn;
@@ -1428,7 +1473,7 @@ static void return_reply(time_t now, struct frec *forward, struct dns_header *he
   if ((nn = process_reply(header, now, forward->sentto, (size_t)n, check_rebind, no_cache_dnssec, cache_secure, bogusanswer, 
 			  forward->flags & FREC_AD_QUESTION, forward->flags & FREC_DO_QUESTION, 
 			  forward->flags & FREC_ADDED_PHEADER, &forward->frec_src.source,
-			  ((unsigned char *)header) + daemon->edns_pktsz, ede)))
+			  ((unsigned char *)header) + daemon->edns_pktsz, ede, meta)))
     {
       struct frec_src *src;
       
@@ -1447,6 +1492,11 @@ static void return_reply(time_t now, struct frec *forward, struct dns_header *he
 	}
 #endif
       
+      /************ Pi-hole modification ************/
+      /* The first source holds the query all others are duplicates of */
+      int first_ID = -1;
+      /**********************************************/
+
       for (src = &forward->frec_src; src; src = src->next)
 	{
 	  header->id = htons(src->orig_id);
@@ -1461,9 +1511,6 @@ static void return_reply(time_t now, struct frec *forward, struct dns_header *he
 	    }
 #endif
 	  
-	  /* Pi-hole modification */
-	  int first_ID = -1;
-	  
 	  if (src->fd != -1)
 	    {
 #ifdef HAVE_DUMPFILE
@@ -1572,6 +1619,7 @@ void receive_query(struct listener *listen, time_t now)
 
   /************ Pi-hole modification ************/
   bool piholeblocked = false;
+  struct packet_meta meta;
   /**********************************************/
   
   /* packet buffer overwritten */
@@ -1790,8 +1838,7 @@ void receive_query(struct listener *listen, time_t now)
     have_mark = get_incoming_mark(&source_addr, &dst_addr, /* istcp: */ 0, &mark);
 #endif
   //********************** Pi-hole modification **********************//
-  pheader = find_pseudoheader(header, (size_t)n, NULL, &pheader, NULL, NULL);
-  FTL_parse_pseudoheaders(pheader, (size_t)n);
+  FTL_packet_meta(header, (size_t)n, &meta);
   //******************************************************************//
 	  
   if (extract_request(header, (size_t)n, daemon->namebuff, &type))
@@ -1802,7 +1849,7 @@ void receive_query(struct listener *listen, time_t now)
       log_query_mysockaddr(F_QUERY | F_FORWARD, daemon->namebuff,
 			   &source_addr, auth_dns ? "auth" : "query", type);
       piholeblocked = FTL_new_query(F_QUERY | F_FORWARD , daemon->namebuff,
-				    &source_addr, auth_dns ? "auth" : "query", type, daemon->log_display_id, UDP);
+				    &source_addr, auth_dns ? "auth" : "query", type, daemon->log_display_id, UDP, &meta);
       
 #ifdef HAVE_CONNTRACK
       is_single_query = 1;
@@ -1947,6 +1994,9 @@ void receive_query(struct listener *listen, time_t now)
       
       m = answer_request(header, ((char *) header) + udp_size, (size_t)n, 
 			 dst_addr_4, netmask, now, ad_reqd, do_bit, have_pseudoheader, &stale, &filtered);
+      /* Pi-hole modification */
+      PROBE3(cache, daemon->log_display_id, m > 0, stale);
+      /************************/
       
       if (m >= 1)
 	{
@@ -2054,6 +2104,23 @@ static ssize_t tcp_talk(int first, int last, int start, unsigned char *packet,
     retry:
       *length = htons(qsize);
       
+      /************ Pi-hole modification ************/
+      /* Use a connection shared with the other TCP workers if possible */
+      if (serv->tcpfd == -1 && !have_mark)
+	{
+	  ssize_t pooled;
+	  
+	  if ((pooled = FTL_tcp_pool_query(serv, payload, qsize)) > 0)
+	    {
+	      if (!(hashp = hash_questions(header, (unsigned int)pooled, daemon->namebuff)) || memcmp(hash, hashp, HASH_SIZE) != 0)
+		continue;
+	      
+	      *servp = serv;
+	      return pooled;
+	    }
+	}
+      /**********************************************/
+      
       if (serv->tcpfd == -1)
 	{
 	  if ((serv->tcpfd = socket(serv->addr.sa.sa_family, SOCK_STREAM, 0)) == -1)
@@ -2143,8 +2210,11 @@ static int tcp_key_recurse(time_t now, int status, struct dns_header *header, si
   int first, last, start, new_status;
   unsigned char *packet = NULL;
   struct dns_header *new_header = NULL;
-  
-  FTL_header_analysis(header->hb4, RCODE(header), server, daemon->log_display_id);
+  /******** Pi-hole modification ********/
+  struct packet_meta meta;
+  FTL_packet_meta(header, n, &meta);
+  FTL_header_analysis(&meta, server, daemon->log_display_id);
+  /**************************************/
 
   while (1)
     {
@@ -2268,6 +2338,7 @@ unsigned char *tcp_request(int confd, time_t now,
     
   /************ Pi-hole modification ************/
   bool piholeblocked = false;
+  struct packet_meta meta;
   /**********************************************/
 
   if (!packet || getpeername(confd, (struct sockaddr *)&peer_addr, &peer_len) == -1)
@@ -2353,8 +2424,7 @@ unsigned char *tcp_request(int confd, time_t now,
 	no_cache_dnssec = 1;
 
       //********************** Pi-hole modification **********************//
-      pheader = find_pseudoheader(header, (size_t)size, NULL, &pheader, NULL, NULL);
-      FTL_parse_pseudoheaders(pheader, (size_t)size);
+      FTL_packet_meta(header, (size_t)size, &meta);
       //******************************************************************//
        
       if ((gotname = extract_request(header, (unsigned int)size, daemon->namebuff, &qtype)))
@@ -2374,7 +2444,7 @@ unsigned char *tcp_request(int confd, time_t now,
 				   &peer_addr, auth_dns ? "auth" : "query", qtype);
 	      
 	      piholeblocked = FTL_new_query(F_QUERY | F_FORWARD, daemon->namebuff,
-					    &peer_addr, auth_dns ? "auth" : "query", qtype, daemon->log_display_id, TCP);
+					    &peer_addr, auth_dns ? "auth" : "query", qtype, daemon->log_display_id, TCP, &meta);
 
 #ifdef HAVE_AUTH
 	      /* find queries for zones we're authoritative for, and answer them directly */
@@ -2482,6 +2552,9 @@ unsigned char *tcp_request(int confd, time_t now,
 	       /* m > 0 if answered from cache */
 	       m = answer_request(header, ((char *) header) + 65536, (size_t)size, 
 				  dst_addr_4, netmask, now, ad_reqd, do_bit, have_pseudoheader, &stale, &filtered);
+	       /* Pi-hole modification */
+	       PROBE3(cache, daemon->log_display_id, m > 0, stale);
+	       /************************/
 	     }
 	  /* Do this by steam now we're not in the select() loop */
 	  check_log_writer(1); 
@@ -2605,7 +2678,7 @@ unsigned char *tcp_request(int confd, time_t now,
 		  
 		  m = process_reply(header, now, serv, (unsigned int)m, 
 				    option_bool(OPT_NO_REBIND) && !norebind, no_cache_dnssec, cache_secure, bogusanswer,
-				    ad_reqd, do_bit, added_pheader, &peer_addr, ((unsigned char *)header) + 65536, ede); 
+				    ad_reqd, do_bit, added_pheader, &peer_addr, ((unsigned char *)header) + 65536, ede, NULL); 
 		}
 	    }
 	  /************ Pi-hole modification ************/
@@ -3040,6 +3113,9 @@ static struct frec *get_new_frec(time_t now, struct server *master, int force)
 	      if (difftime(now, f->time) >= 4*TIMEOUT)
 		{
 		  daemon->metrics[METRIC_DNS_UNANSWERED_QUERY]++;
+		  /************ Pi-hole modification ************/
+		  upstream_failed(f->sentto);
+		  /**********************************************/
 		  free_frec(f);
 		  target = f;
 		}
@@ -3062,6 +3138,9 @@ static struct frec *get_new_frec(time_t now, struct server *master, int force)
     { 
       /* can't find empty one, use oldest if there is one and it's older than timeout */
       daemon->metrics[METRIC_DNS_UNANSWERED_QUERY]++;
+      /************ Pi-hole modification ************/
+      upstream_failed(oldest->sentto);
+      /**********************************************/
       free_frec(oldest);
       target = oldest;
     }
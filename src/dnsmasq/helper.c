@@ -47,6 +47,16 @@ static unsigned char *grab_extradata(unsigned char *buf, unsigned char *end,  ch
 lua_State *lua;
 
 static unsigned char *grab_extradata_lua(unsigned char *buf, unsigned char *end, char *field);
+
+/* Pi-hole modification */
+/* If the script defines leases(), lease events are collected into an array
+   of tables (the same fields as for lease() plus "action") which is passed
+   to leases() once no further event is waiting in the pipe, or once
+   LUA_BATCH_MAX events have been collected */
+#define LUA_BATCH_MAX 1024
+static int lua_batch = 0, batch_ref = LUA_NOREF, batch_count = 0;
+static void lua_flush_batch(void);
+/************************/
 #endif
 
 
@@ -151,8 +161,13 @@ int create_helper(int event_fd, int err_fd, uid_t uid, gid_t gid, long max_fd)
       else
 	{
 	  lua_getglobal(lua, "lease");
-	  if (lua_type(lua, -1) != LUA_TFUNCTION) 
-	    lua_err = _("lease() function missing in Lua script");
+	  /* Pi-hole modification */
+	  lua_getglobal(lua, "leases");
+	  lua_batch = lua_type(lua, -1) == LUA_TFUNCTION;
+	  lua_pop(lua, 1);
+	  if (lua_type(lua, -1) != LUA_TFUNCTION && !lua_batch)
+	    lua_err = _("lease() or leases() function missing in Lua script");
+	  /************************/
 	}
       
       if (lua_err)
@@ -171,6 +186,15 @@ int create_helper(int event_fd, int err_fd, uid_t uid, gid_t gid, long max_fd)
 	}
       
       lua_pop(lua, 1);  /* remove nil from stack */
+
+      /* Pi-hole modification */
+      if (lua_batch)
+	{
+	  lua_newtable(lua);
+	  batch_ref = luaL_ref(lua, LUA_REGISTRYINDEX);
+	}
+      /************************/
+
       lua_getglobal(lua, "init");
       if (lua_type(lua, -1) == LUA_TFUNCTION)
 	lua_call(lua, 0, 0);
@@ -206,6 +230,9 @@ int create_helper(int event_fd, int err_fd, uid_t uid, gid_t gid, long max_fd)
 #ifdef HAVE_LUASCRIPT
 	  if (daemon->luascript)
 	    {
+	      /* Pi-hole modification */
+	      lua_flush_batch();
+	      /************************/
 	      lua_getglobal(lua, "shutdown");
 	      if (lua_type(lua, -1) == LUA_TFUNCTION)
 		lua_call(lua, 0, 0);
@@ -328,6 +355,12 @@ int create_helper(int event_fd, int err_fd, uid_t uid, gid_t gid, long max_fd)
 #ifdef HAVE_LUASCRIPT
       if (daemon->luascript)
 	{
+	  /* Pi-hole modification */
+	  /* Keep the order of lease and other events */
+	  if (data.action == ACTION_TFTP || data.action == ACTION_RELAY_SNOOP || data.action == ACTION_ARP)
+	    lua_flush_batch();
+	  /************************/
+
 	  if (data.action == ACTION_TFTP)
 	    {
 	      lua_getglobal(lua, "tftp"); 
@@ -382,9 +415,23 @@ int create_helper(int event_fd, int err_fd, uid_t uid, gid_t gid, long max_fd)
 	    }
 	  else
 	    {
+	      /* Pi-hole modification */
+	      if (lua_batch)
+		{
+		  lua_rawgeti(lua, LUA_REGISTRYINDEX, batch_ref); /* batch array */
+		  lua_newtable(lua);                              /* event */
+		  lua_pushstring(lua, action_str);
+		  lua_setfield(lua, -2, "action");
+		}
+	      else
+		{
+	      /************************/
 	      lua_getglobal(lua, "lease");     /* function to call */
 	      lua_pushstring(lua, action_str); /* arg1 - action */
 	      lua_newtable(lua);               /* arg2 - data table */
+	      /* Pi-hole modification */
+		}
+	      /************************/
 	      
 	      if (is6)
 		{
@@ -501,6 +548,22 @@ int create_helper(int event_fd, int err_fd, uid_t uid, gid_t gid, long max_fd)
 	      lua_pushstring(lua, daemon->addrbuff);
 	      lua_setfield(lua, -2, "ip_address");
 	    
+	      /* Pi-hole modification */
+	      if (lua_batch)
+		{
+		  struct pollfd pfd;
+
+		  lua_rawseti(lua, -2, ++batch_count); /* append event */
+		  lua_pop(lua, 1);                     /* batch array */
+
+		  /* Hand over what we have once the pipe is drained */
+		  pfd.fd = pipefd[0];
+		  pfd.events = POLLIN;
+		  if (batch_count >= LUA_BATCH_MAX || poll(&pfd, 1, 0) <= 0)
+		    lua_flush_batch();
+		}
+	      else
+	      /************************/
 	      lua_call(lua, 2, 0);	/* pass 2 values, expect 0 */
 	    }
 	}
@@ -770,6 +833,25 @@ static unsigned char *grab_extradata_lua(unsigned char *buf, unsigned char *end,
 
   return next + 1;
 }
+
+/* Pi-hole modification */
+/* Call leases() with the events collected so far. The script may keep the
+   array, so we start a new one */
+static void lua_flush_batch(void)
+{
+  if (!lua_batch || batch_count == 0)
+    return;
+
+  lua_getglobal(lua, "leases");
+  lua_rawgeti(lua, LUA_REGISTRYINDEX, batch_ref);
+  luaL_unref(lua, LUA_REGISTRYINDEX, batch_ref);
+  lua_newtable(lua);
+  batch_ref = luaL_ref(lua, LUA_REGISTRYINDEX);
+  batch_count = 0;
+
+  lua_call(lua, 1, 0);	/* pass 1 value, expect 0 */
+}
+/************************/
 #endif
 
 static void buff_alloc(size_t size)
@@ -952,7 +1034,9 @@ void helper_write(void)
   if ((rc = write(daemon->helperfd, buf, bytes_in_buf)) != -1)
     {
       if (bytes_in_buf != (size_t)rc)
-	memmove(buf, buf + rc, bytes_in_buf - rc); 
+	/* Pi-hole modification */
+	memmove(buf, (unsigned char *)buf + rc, bytes_in_buf - rc); 
+	/************************/
       bytes_in_buf -= rc;
     }
   else
@@ -19,6 +19,14 @@
 
 static struct dhcp_lease *leases = NULL, *old_leases = NULL;
 static int dns_dirty, file_dirty, leases_left;
+/* Pi-hole modification */
+/* do_script_run() is called once per lease event. Rescanning all leases for
+   every event made announcing many changes (e.g. all leases at startup)
+   quadratic. The scan for changed leases resumes after the lease found last
+   time, the scan for old hostnames only runs when there may be one */
+static struct dhcp_lease *script_next = NULL;
+static int old_hostname_pending = 0;
+/************************/
 
 static int read_leases(time_t now, FILE *leasestream)
 {
@@ -562,6 +570,9 @@ void lease_prune(struct dhcp_lease *target, time_t now)
 	  daemon->metrics[lease->addr.s_addr ? METRIC_LEASES_PRUNED_4 : METRIC_LEASES_PRUNED_6]++;
 
  	  *up = lease->next; /* unlink */
+	  /* Pi-hole modification */
+	  script_next = NULL;
+	  /************************/
 	  
 	  /* Put on old_leases list 'till we
 	     can run the script */
@@ -939,6 +950,10 @@ static void kill_name(struct dhcp_lease *lease)
     lease->old_hostname = lease->hostname;
 
   lease->hostname = lease->fqdn = NULL;
+
+  /* Pi-hole modification */
+  old_hostname_pending = 1;
+  /************************/
 }
 
 void lease_calc_fqdns(void)
@@ -1149,6 +1164,9 @@ int do_script_run(time_t now)
     }
   
   /* make sure we announce the loss of a hostname before its new location. */
+  /* Pi-hole modification */
+  if (old_hostname_pending)
+  /************************/
   for (lease = leases; lease; lease = lease->next)
     if (lease->old_hostname)
       {	
@@ -1159,8 +1177,14 @@ int do_script_run(time_t now)
 	lease->old_hostname = NULL;
 	return 1;
       }
-  
-  for (lease = leases; lease; lease = lease->next)
+  /* Pi-hole modification */
+  old_hostname_pending = 0;
+
+  /* Scan from where we stopped last time to the end, then from the start */
+  struct dhcp_lease *start = script_next ? script_next : leases;
+  for (lease = start; lease; lease = lease->next ? lease->next : leases)
+  /************************/
+  {
     if ((lease->flags & (LEASE_NEW | LEASE_CHANGED)) || 
 	((lease->flags & LEASE_AUX_CHANGED) && option_bool(OPT_LEASE_RO)) ||
 	((lease->flags & LEASE_EXP_CHANGED) && option_bool(OPT_LEASE_RENEW)))
@@ -1179,8 +1203,17 @@ int do_script_run(time_t now)
 	free(lease->extradata);
 	lease->extradata = NULL;
 	
+	/* Pi-hole modification */
+	script_next = lease->next;
+	/************************/
 	return 1;
       }
+    /* Pi-hole modification */
+    if ((lease->next ? lease->next : leases) == start)
+      break;
+  }
+  script_next = NULL;
+  /************************/
 
   return 0; /* nothing to do */
 }
@@ -59,6 +59,23 @@ struct log_entry {
 static struct log_entry *entries = NULL;
 static struct log_entry *free_entries = NULL;
 
+/* Pi-hole modification */
+/* Binary query log. Records are collected in a buffer and written in batches
+   from the main loop (see check_log_writer()), at the latest when
+   BINLOG_FLUSH bytes are pending or after a second. Forked TCP workers use
+   their own buffer and write it before every reply. */
+#define BINLOG_BUFFER 65536
+#define BINLOG_FLUSH  32768
+
+static int binlog_fd = -1;
+static unsigned char *binlog_buf = NULL;
+static size_t binlog_len = 0;
+static pid_t binlog_pid = 0;
+static time_t binlog_oldest = 0;
+
+static void binlog_write(void);
+/************************/
+
 
 int log_start(struct passwd *ent_pw, int errfd)
 {
@@ -93,6 +110,14 @@ int log_start(struct passwd *ent_pw, int errfd)
       _exit(0);
     }
 
+  /* Pi-hole modification */
+  if (daemon->binlog_file && !binlog_reopen())
+    {
+      send_event(errfd, EVENT_LOG_ERR, errno, daemon->binlog_file);
+      _exit(0);
+    }
+  /************************/
+
   /* if queuing is inhibited, make sure we allocate
      the one required buffer now. */
   if (max_logs == 0)
@@ -123,6 +148,12 @@ int log_start(struct passwd *ent_pw, int errfd)
 	ret = errno;
     }
 
+  /* Pi-hole modification */
+  if (binlog_fd != -1 && ent_pw && ent_pw->pw_uid != 0 &&
+      fchown(binlog_fd, ent_pw->pw_uid, -1) != 0)
+    ret = errno;
+  /************************/
+
   return ret;
 }
 
@@ -158,6 +189,170 @@ int log_reopen(char *log_file)
   return log_fd != -1;
 }
 
+/* Pi-hole modification */
+/* (Re-)open the binary query log, e.g. after it has been rotated. A header
+   is written to new files */
+int binlog_reopen(void)
+{
+  struct stat st;
+
+  if (binlog_fd != -1)
+    {
+      binlog_write();
+      close(binlog_fd);
+    }
+
+  if (!binlog_buf && !(binlog_buf = whine_malloc(BINLOG_BUFFER)))
+    return 0;
+
+  /* NOTE: umask is set to 022 by the time this gets called */
+  if ((binlog_fd = open(daemon->binlog_file, O_WRONLY|O_CREAT|O_APPEND, S_IRUSR|S_IWUSR|S_IRGRP)) == -1)
+    return 0;
+
+  if (fstat(binlog_fd, &st) == 0 && st.st_size == 0)
+    {
+      struct binlog_header header;
+
+      memcpy(header.magic, BINLOG_MAGIC, sizeof(header.magic));
+      header.addr_size = sizeof(union all_addr);
+      header.record_size = sizeof(struct binlog_record);
+      if (write(binlog_fd, &header, sizeof(header)) != sizeof(header))
+	{
+	  close(binlog_fd);
+	  binlog_fd = -1;
+	  return 0;
+	}
+    }
+
+  return 1;
+}
+
+/* Records still have to be written */
+int binlog_pending(void)
+{
+  return binlog_fd != -1 && binlog_len != 0;
+}
+
+static void binlog_write(void)
+{
+  size_t done = 0;
+
+  /* Avoid duplicates over a fork() */
+  if (binlog_pid != getpid())
+    {
+      binlog_len = 0;
+      return;
+    }
+
+  while (done < binlog_len)
+    {
+      ssize_t rc = write(binlog_fd, binlog_buf + done, binlog_len - done);
+
+      if (rc != -1)
+	done += rc;
+      else if (errno != EINTR)
+	break;
+    }
+
+  if (done < binlog_len)
+    {
+      /* Fall back to the text log - this handles out-of-space, for instance. */
+      int fd = binlog_fd, errsave = errno;
+
+      binlog_fd = -1;
+      binlog_len = 0;
+      close(fd);
+      my_syslog(LOG_ERR, _("binary query log failed: %s"), strerror(errsave));
+      return;
+    }
+
+  binlog_len = 0;
+}
+
+/* Append a record to the binary query log. Returns zero if there is no
+   binary query log and the query has to be logged as text */
+int log_query_binary(unsigned int flags, char *name, union all_addr *addr, char *arg, unsigned short type)
+{
+  struct binlog_record record;
+  size_t namelen = name ? strlen(name) + 1 : 0, arglen = arg ? strlen(arg) + 1 : 0;
+  size_t len = sizeof(record) + (addr ? sizeof(union all_addr) : 0) + namelen + arglen;
+  unsigned char *p;
+  struct timeval tv;
+  pid_t pid = getpid();
+
+  if (binlog_fd == -1 || len > UINT16_MAX)
+    return 0;
+
+  /* Do not write what the parent collected before we were forked */
+  if (binlog_pid != pid)
+    {
+      binlog_len = 0;
+      binlog_pid = pid;
+    }
+
+  if (binlog_len + len > BINLOG_BUFFER)
+    {
+      binlog_write();
+      if (binlog_fd == -1)
+	return 0;
+    }
+
+  gettimeofday(&tv, NULL);
+  if (binlog_len == 0)
+    binlog_oldest = tv.tv_sec;
+
+  memset(&record, 0, sizeof(record));
+  record.length = len;
+  record.type = type;
+  record.flags = flags;
+  record.id = daemon->log_display_id;
+  record.pid = pid;
+  record.sec = tv.tv_sec;
+  record.usec = tv.tv_usec;
+  if (option_bool(OPT_EXTRALOG))
+    record.contents |= BINLOG_EXTRA;
+  if (addr)
+    record.contents |= BINLOG_ADDR;
+  if (name)
+    record.contents |= BINLOG_NAME;
+  if (arg)
+    record.contents |= BINLOG_ARG;
+
+  if (daemon->log_source_addr && daemon->log_source_addr->sa.sa_family == AF_INET)
+    {
+      record.family = 4;
+      record.port = ntohs(daemon->log_source_addr->in.sin_port);
+      memcpy(record.client, &daemon->log_source_addr->in.sin_addr, INADDRSZ);
+    }
+  else if (daemon->log_source_addr && daemon->log_source_addr->sa.sa_family == AF_INET6)
+    {
+      record.family = 6;
+      record.port = ntohs(daemon->log_source_addr->in6.sin6_port);
+      memcpy(record.client, &daemon->log_source_addr->in6.sin6_addr, IN6ADDRSZ);
+    }
+
+  p = binlog_buf + binlog_len;
+  memcpy(p, &record, sizeof(record));
+  p += sizeof(record);
+  if (addr)
+    {
+      memcpy(p, addr, sizeof(union all_addr));
+      p += sizeof(union all_addr);
+    }
+  if (name)
+    {
+      memcpy(p, name, namelen);
+      p += namelen;
+    }
+  if (arg)
+    memcpy(p, arg, arglen);
+
+  binlog_len += len;
+
+  return 1;
+}
+/************************/
+
 static void free_entry(void)
 {
   struct log_entry *tmp = entries;
@@ -470,10 +665,26 @@ void check_log_writer(int force)
 {
   if (log_fd != -1 && (force || poll_check(log_fd, POLLOUT)))
     log_write();
+
+  /* Pi-hole modification */
+  if (binlog_pending() &&
+      (force || binlog_len >= BINLOG_FLUSH || time(NULL) - binlog_oldest >= 1))
+    binlog_write();
+  /************************/
 }
 
 void flush_log(void)
 {
+  /* Pi-hole modification */
+  if (binlog_fd != -1)
+    {
+      binlog_write();
+      if (binlog_fd != -1)
+	close(binlog_fd);
+      binlog_fd = -1;
+    }
+  /************************/
+
   /* write until queue empty, but don't loop forever if there's
    no connection to the syslog in existence */
   while (log_fd != -1)
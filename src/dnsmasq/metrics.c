@@ -43,6 +43,15 @@ const char * metric_names[] = {
     "leases_allocated_6",
     "leases_pruned_6",
     "tcp_connections",
+    /* Pi-hole modification */
+    "dns_cache_hits_probation",
+    "dns_cache_hits_protected",
+    "dns_cache_promoted",
+    "dns_cache_demoted",
+    "dns_cache_evicted_probation",
+    "dns_cache_evicted_demoted",
+    "dns_cache_evicted_memory",
+    /************************/
 };
 
 const char* get_metric_name(int i) {
@@ -42,6 +42,15 @@ enum {
   METRIC_LEASES_ALLOCATED_6,
   METRIC_LEASES_PRUNED_6,
   METRIC_TCP_CONNECTIONS,
+  /* Pi-hole modification */
+  METRIC_DNS_CACHE_HITS_PROBATION,
+  METRIC_DNS_CACHE_HITS_PROTECTED,
+  METRIC_DNS_CACHE_PROMOTED,
+  METRIC_DNS_CACHE_DEMOTED,
+  METRIC_DNS_CACHE_EVICTED_PROBATION,
+  METRIC_DNS_CACHE_EVICTED_DEMOTED,
+  METRIC_DNS_CACHE_EVICTED_MEMORY,
+  /************************/
   
   __METRIC_MAX,
 };
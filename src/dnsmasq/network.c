@@ -884,6 +884,9 @@ again:
 
   errno = errsave;
   spare = param.spare;
+
+  // Pi-hole modification
+  FTL_interfaces_enumerated();
   
   return ret;
 }
@@ -196,6 +196,11 @@ struct myoption {
 #define LOPT_NO_DHCP4      383
 #define LOPT_MAX_PROCS     384
 #define LOPT_DNSSEC_LIMITS 385
+/* Pi-hole modification */
+#define LOPT_CACHE_BYTES   386
+#define LOPT_LOG_BINARY    387
+#define LOPT_TFTP_WINDOW   388
+/************************/
 
 #ifdef HAVE_GETOPT_LONG
 static const struct option opts[] =  
@@ -392,6 +397,11 @@ static const struct myoption opts[] =
     { "use-stale-cache", 2, 0 , LOPT_STALE_CACHE },
     { "no-ident", 0, 0, LOPT_NO_IDENT },
     { "max-tcp-connections", 1, 0, LOPT_MAX_PROCS },
+    /* Pi-hole modification */
+    { "cache-bytes", 1, 0, LOPT_CACHE_BYTES },
+    { "log-queries-binary", 1, 0, LOPT_LOG_BINARY },
+    { "tftp-windowsize", 1, 0, LOPT_TFTP_WINDOW },
+    /************************/
     { NULL, 0, 0, 0 }
   };
 
@@ -595,6 +605,11 @@ static struct {
   { LOPT_NO_IDENT, OPT_NO_IDENT, NULL, gettext_noop("Do not add CHAOS TXT records."), NULL },
   { LOPT_CACHE_RR, ARG_DUP, "<RR-type>", gettext_noop("Cache this DNS resource record type."), NULL },
   { LOPT_MAX_PROCS, ARG_ONE, "<integer>", gettext_noop("Maximum number of concurrent tcp connections."), NULL },
+  /* Pi-hole modification */
+  { LOPT_CACHE_BYTES, ARG_ONE, "<integer>[k|m]", gettext_noop("Limit the memory used by the cache (bytes)."), NULL },
+  { LOPT_LOG_BINARY, ARG_ONE, "<path>", gettext_noop("Write the query log to a binary file instead of the log."), NULL },
+  { LOPT_TFTP_WINDOW, ARG_ONE, "<integer>", gettext_noop("Maximum number of TFTP blocks sent per ACK (1 disables windowsize)."), NULL },
+  /************************/
   { 0, 0, NULL, NULL, NULL }
 }; 
 
@@ -3570,6 +3585,15 @@ static int one_opt(int option, char *arg, char *errstr, char *gen_err, int comma
 	ret_err(gen_err);
       break;
 
+      /* Pi-hole modification */
+    case LOPT_TFTP_WINDOW:  /*  --tftp-windowsize */
+      if (!atoi_check(arg, &daemon->tftp_window) || daemon->tftp_window < 1)
+	ret_err(gen_err);
+      if (daemon->tftp_window > 65535)
+	daemon->tftp_window = 65535;
+      break;
+      /************************/
+
     case LOPT_PREFIX: /* --tftp-prefix */
       comma = split(arg);
       if (comma)
@@ -4170,6 +4194,9 @@ static int one_opt(int option, char *arg, char *errstr, char *gen_err, int comma
 	  }
 
 	daemon->dhcp_conf = new;
+	/* Pi-hole modification */
+	invalidate_config_index();
+	/************************/
 	break;
       }
       
@@ -5365,6 +5392,33 @@ err:
 	break;
       }
 
+      /* Pi-hole modification */
+    case LOPT_CACHE_BYTES: /* --cache-bytes */
+      {
+	int size;
+	char *end = arg + strlen(arg);
+	size_t unit = 1;
+
+	if (end > arg && (end[-1] == 'k' || end[-1] == 'K'))
+	  unit = 1024;
+	else if (end > arg && (end[-1] == 'm' || end[-1] == 'M'))
+	  unit = 1024*1024;
+	if (unit != 1)
+	  end[-1] = 0;
+
+	/* zero means no limit besides --cache-size */
+	if (!atoi_check(arg, &size) || size < 0)
+	  ret_err(gen_err);
+	daemon->cache_max_bytes = (size_t)size * unit;
+	break;
+      }
+
+    case LOPT_LOG_BINARY: /* --log-queries-binary */
+      daemon->binlog_file = opt_string_alloc(arg);
+      set_option_bool(OPT_LOG);
+      break;
+      /************************/
+
     default:
       ret_err(_("unsupported option (check that dnsmasq was compiled with DHCP/TFTP/DNSSEC/DBus support)"));
       
@@ -5783,6 +5837,10 @@ static void clear_dynamic_conf(void)
       else
 	up = &configs->next;
     }
+
+  /* Pi-hole modification */
+  invalidate_config_index();
+  /************************/
 }
 
 static void clear_dhcp_opt(struct dhcp_opt **dhcp_opts)
@@ -5885,6 +5943,9 @@ void read_opts(int argc, char **argv, char *compile_opts)
   daemon->runfile =  RUNFILE;
   daemon->dhcp_max = MAXLEASES;
   daemon->tftp_max = TFTP_MAX_CONNECTIONS;
+  /* Pi-hole modification */
+  daemon->tftp_window = TFTP_MAX_WINDOW;
+  /************************/
   daemon->edns_pktsz = EDNS_PKTSZ;
   daemon->log_fac = -1;
   daemon->auth_ttl = AUTH_TTL; 
@@ -18,6 +18,10 @@
 
 #ifdef HAVE_TFTP
 
+/* Pi-hole modification */
+#include <sys/mman.h>
+/************************/
+
 static void handle_tftp(time_t now, struct tftp_transfer *transfer, ssize_t len);
 static struct tftp_file *check_tftp_fileperm(ssize_t *len, char *prefix, char *client);
 static void free_transfer(struct tftp_transfer *transfer);
@@ -26,6 +30,11 @@ static ssize_t tftp_err_oops(char *packet, const char *file);
 static ssize_t get_block(char *packet, struct tftp_transfer *transfer);
 static char *next(char **p, char *end);
 static void sanitise(char *buf);
+/* Pi-hole modification */
+static int send_window(struct tftp_transfer *transfer);
+static size_t data_len(struct tftp_transfer *transfer, unsigned int n);
+static int window_has_last(struct tftp_transfer *transfer);
+/************************/
 
 #define OP_RRQ  1
 #define OP_WRQ  2
@@ -328,6 +337,10 @@ void tftp_request(struct listener *listen, time_t now)
   transfer->file = NULL;
   transfer->opt_blocksize = transfer->opt_transize = 0;
   transfer->netascii = transfer->carrylf = 0;
+  /* Pi-hole modification */
+  transfer->opt_windowsize = 0;
+  transfer->windowsize = 1;
+  /************************/
  
   (void)prettyprint_addr(&peer, daemon->addrbuff);
   
@@ -399,6 +412,22 @@ void tftp_request(struct listener *listen, time_t now)
 	      transfer->opt_transize = 1;
 	      transfer->block = 0;
 	    }
+	  /* Pi-hole modification */
+	  /* RFC 7440, not in netascii mode as block offsets depend on the expansion */
+	  else if (strcasecmp(opt, "windowsize") == 0)
+	    {
+	      if ((opt = next(&p, end)) && !transfer->netascii && daemon->tftp_window > 1)
+		{
+		  int window = atoi(opt);
+		  if (window >= 1)
+		    {
+		      transfer->windowsize = window < daemon->tftp_window ? (unsigned)window : (unsigned)daemon->tftp_window;
+		      transfer->opt_windowsize = 1;
+		      transfer->block = 0;
+		    }
+		}
+	    }
+	  /************************/
 	}
 
       /* cope with backslashes from windows boxen. */
@@ -568,6 +597,22 @@ static struct tftp_file *check_tftp_fileperm(ssize_t *len, char *prefix, char *c
   file->inode = statbuf.st_ino;
   file->refcount = 1;
   strcpy(file->filename, namebuff);
+
+  /* Pi-hole modification */
+  /* Transfers of this file share the mapping, DATA blocks are handed to
+     the kernel straight from the page cache. The map is only ever read by
+     the kernel (see send_window()) so a file truncated while it is being
+     sent results in EFAULT rather than SIGBUS */
+  file->map = NULL;
+  if (statbuf.st_size > 0 && (uintmax_t)statbuf.st_size <= SIZE_MAX &&
+      (file->map = mmap(NULL, (size_t)statbuf.st_size, PROT_READ, MAP_SHARED, fd, 0)) == MAP_FAILED)
+    file->map = NULL;
+#ifdef POSIX_MADV_SEQUENTIAL
+  if (file->map)
+    posix_madvise(file->map, (size_t)statbuf.st_size, POSIX_MADV_SEQUENTIAL);
+#endif
+  /************************/
+
   return file;
   
  perm:
@@ -630,6 +675,9 @@ void check_tftp_listeners(time_t now)
 	{
 	  int endcon = 0;
 	  ssize_t len;
+	  /* Pi-hole modification */
+	  int window;
+	  /************************/
 
 	  /* timeout, retransmit */
 	  transfer->timeout += 1 + (1<<(transfer->backoff/2));
@@ -637,7 +685,16 @@ void check_tftp_listeners(time_t now)
 	  /* we overwrote the buffer... */
 	  daemon->srv_save = NULL;
 
-	  if ((len = get_block(daemon->packet, transfer)) == -1)
+	  /* Pi-hole modification */
+	  /* DATA blocks of octet transfers are sent as a window below */
+	  window = transfer->block != 0 && !transfer->netascii;
+	  if (window)
+	    len = data_len(transfer, 0);
+	  else
+	  /************************/
+	  len = get_block(daemon->packet, transfer);
+
+	  if (len == -1)
 	    {
 	      len = tftp_err_oops(daemon->packet, transfer->file->filename);
 	      endcon = 1;
@@ -646,12 +703,22 @@ void check_tftp_listeners(time_t now)
 	    {
 	      /* don't complain about timeout when we're awaiting the last
 		 ACK, some clients never send it */
-	      if ((unsigned)len == transfer->blocksize + 4)
+	      /* Pi-hole modification */
+	      if ((unsigned)len == transfer->blocksize + 4 && !window_has_last(transfer))
+	      /************************/
 		endcon = 1;
 	      len = 0;
 	    }
 
-	  if (len != 0)
+	  /* Pi-hole modification */
+	  if (len != 0 && window && !endcon && !send_window(transfer))
+	    {
+	      len = tftp_err_oops(daemon->packet, transfer->file->filename);
+	      endcon = 1;
+	    }
+
+	  if (len != 0 && (!window || endcon))
+	  /************************/
 	    {
 	      send_from(transfer->sockfd, !option_bool(OPT_SINGLE_PORT), daemon->packet, len,
 			&transfer->peer, &transfer->source, transfer->if_index);
@@ -691,16 +758,35 @@ static void handle_tftp(time_t now, struct tftp_transfer *transfer, ssize_t len)
     unsigned short op, block;
   } *mess = (struct ack *)daemon->packet;
   
+  /* Pi-hole modification */
+  /* RFC 7440: an ACK covers all blocks of the window up to the one it
+     names. After a gap, the client acknowledges the last block received
+     in order and we continue from there */
+  unsigned short acked = (unsigned short)(ntohs(mess->block) - (unsigned short)(transfer->block - 1));
+  /************************/
+  
   if (len >= (ssize_t)sizeof(struct ack))
     {
-      if (ntohs(mess->op) == OP_ACK && ntohs(mess->block) == (unsigned short)transfer->block) 
+      /* Pi-hole modification */
+      if (ntohs(mess->op) == OP_ACK && acked >= 1 && acked <= transfer->windowsize)
+      /************************/
 	{
 	  /* Got ack, ensure we take the (re)transmit path */
 	  transfer->timeout = now;
 	  transfer->backoff = 0;
+	  /* Pi-hole modification */
+	  for (; acked > 0; acked--)
+	  /************************/
 	  if (transfer->block++ != 0)
 	    transfer->offset += transfer->blocksize - transfer->expansion;
 	}
+      /* Pi-hole modification */
+      /* A repeated ACK for the block before the window tells us the client
+	 lost its first block. Resend the window now instead of waiting for
+	 the timeout. Not in lock-step mode (sorcerer's apprentice) */
+      else if (ntohs(mess->op) == OP_ACK && acked == 0 && transfer->windowsize > 1 && transfer->block != 0)
+	transfer->timeout = now;
+      /************************/
       else if (ntohs(mess->op) == OP_ERR)
 	{
 	  char *p = daemon->packet + sizeof(struct ack);
@@ -733,6 +819,10 @@ static void free_transfer(struct tftp_transfer *transfer)
 
   if (transfer->file && (--transfer->file->refcount) == 0)
     {
+      /* Pi-hole modification */
+      if (transfer->file->map)
+	munmap(transfer->file->map, (size_t)transfer->file->size);
+      /************************/
       close(transfer->file->fd);
       free(transfer->file);
     }
@@ -822,6 +912,13 @@ static ssize_t get_block(char *packet, struct tftp_transfer *transfer)
 	  p += (sprintf(p,"tsize") + 1);
 	  p += (sprintf(p, "%u", (unsigned int)transfer->file->size) + 1);
 	}
+      /* Pi-hole modification */
+      if (transfer->opt_windowsize)
+	{
+	  p += (sprintf(p, "windowsize") + 1);
+	  p += (sprintf(p, "%u", transfer->windowsize) + 1);
+	}
+      /************************/
 
       return p - packet;
     }
@@ -881,6 +978,133 @@ static ssize_t get_block(char *packet, struct tftp_transfer *transfer)
 }
 
 
+/* Pi-hole modification */
+/* Length of the n-th DATA packet of the current window, zero past the end
+   of the file. Octet mode only, so there is no netascii expansion */
+static size_t data_len(struct tftp_transfer *transfer, unsigned int n)
+{
+  off_t offset = transfer->offset + (off_t)n * transfer->blocksize;
+  size_t size;
+
+  if (offset > transfer->file->size)
+    return 0;
+
+  size = transfer->file->size - offset;
+  if (size > transfer->blocksize)
+    size = transfer->blocksize;
+
+  return size + 4;
+}
+
+/* Is the last block of the file part of the current window? */
+static int window_has_last(struct tftp_transfer *transfer)
+{
+  return transfer->block != 0 && !transfer->netascii &&
+    data_len(transfer, transfer->windowsize - 1) < transfer->blocksize + 4;
+}
+
+#define WINDOW_BATCH 16 /* DATA packets per sendmmsg() */
+
+/* Send all DATA blocks of the current window. The blocks of mapped files
+   are passed to the kernel straight from the mapping, WINDOW_BATCH at a
+   time. Otherwise, and in single-port mode where the source address is set
+   per packet, each block is read into daemon->packet and sent on its own.
+   Returns zero if the file cannot be read. */
+static int send_window(struct tftp_transfer *transfer)
+{
+  unsigned int n;
+
+#ifdef HAVE_LINUX_NETWORK
+  if (transfer->file->map && !option_bool(OPT_SINGLE_PORT))
+    {
+      struct datahdr {
+	unsigned short op, block;
+      } hdr[WINDOW_BATCH];
+      struct iovec iov[WINDOW_BATCH][2];
+      struct mmsghdr mmsg[WINDOW_BATCH];
+      unsigned int batch, sent;
+      size_t len;
+      int rc;
+
+      for (n = 0; n < transfer->windowsize; n += batch)
+	{
+	  for (batch = 0; batch < WINDOW_BATCH && n + batch < transfer->windowsize &&
+		 (len = data_len(transfer, n + batch)) != 0; batch++)
+	    {
+	      hdr[batch].op = htons(OP_DATA);
+	      hdr[batch].block = htons((unsigned short)(transfer->block + n + batch));
+	      iov[batch][0].iov_base = &hdr[batch];
+	      iov[batch][0].iov_len = sizeof(struct datahdr);
+	      iov[batch][1].iov_base = transfer->file->map + transfer->offset + (off_t)(n + batch) * transfer->blocksize;
+	      iov[batch][1].iov_len = len - sizeof(struct datahdr);
+	      memset(&mmsg[batch], 0, sizeof(mmsg[batch]));
+	      mmsg[batch].msg_hdr.msg_name = &transfer->peer;
+	      mmsg[batch].msg_hdr.msg_namelen = sa_len(&transfer->peer);
+	      mmsg[batch].msg_hdr.msg_iov = iov[batch];
+	      mmsg[batch].msg_hdr.msg_iovlen = 2;
+	    }
+
+	  for (sent = 0; sent < batch; sent += rc)
+	    {
+	      while (retry_send(rc = sendmmsg(transfer->sockfd, &mmsg[sent], batch - sent, 0)));
+	      
+	      if (rc == -1)
+		{
+		  /* The file was truncated under the mapping */
+		  if (errno == EFAULT)
+		    return 0;
+		  /* Otherwise the client asks for the rest again */
+		  my_syslog(MS_TFTP | LOG_ERR, _("failed to send packet: %s"), strerror(errno));
+		  return 1;
+		}
+	    }
+
+#ifdef HAVE_DUMPFILE
+	  if (daemon->dumpfd != -1 && (daemon->dump_mask & DUMP_TFTP))
+	    for (sent = 0; sent < batch; sent++)
+	      {
+		memcpy(daemon->packet, &hdr[sent], sizeof(struct datahdr));
+		if (pread(transfer->file->fd, daemon->packet + sizeof(struct datahdr), iov[sent][1].iov_len,
+			  transfer->offset + (off_t)(n + sent) * transfer->blocksize) == (ssize_t)iov[sent][1].iov_len)
+		  dump_packet_udp(DUMP_TFTP, (void *)daemon->packet, iov[sent][1].iov_len + sizeof(struct datahdr),
+				  NULL, (union mysockaddr *)&transfer->peer, transfer->sockfd);
+	      }
+#endif
+
+	  if (batch < WINDOW_BATCH)
+	    break;
+	}
+
+      return 1;
+    }
+#endif
+
+  for (n = 0; n < transfer->windowsize && data_len(transfer, n) != 0; n++)
+    {
+      unsigned int block = transfer->block;
+      off_t offset = transfer->offset;
+      ssize_t len;
+
+      transfer->block += n;
+      transfer->offset += (off_t)n * transfer->blocksize;
+      len = get_block(daemon->packet, transfer);
+      transfer->block = block;
+      transfer->offset = offset;
+
+      if (len == -1)
+	return 0;
+
+      send_from(transfer->sockfd, !option_bool(OPT_SINGLE_PORT), daemon->packet, len,
+		&transfer->peer, &transfer->source, transfer->if_index);
+#ifdef HAVE_DUMPFILE
+      dump_packet_udp(DUMP_TFTP, (void *)daemon->packet, len, NULL, (union mysockaddr *)&transfer->peer, transfer->sockfd);
+#endif
+    }
+
+  return 1;
+}
+/************************/
+
 int do_tftp_script_run(void)
 {
   struct tftp_transfer *transfer;
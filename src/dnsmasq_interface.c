@@ -48,10 +48,23 @@
 #include "api/api_helper.h"
 // logg_rate_limit_message()
 #include "database/message-table.h"
+// DB_profiler_forked()
+#include "database/sqlite3-profile.h"
+// network_cache_forked()
+#include "database/network-table.h"
 // type struct sqlite3_stmt_vec
 #include "vector.h"
 // check_one_struct()
 #include "struct_size.h"
+// arena_strdup()
+#include "arena.h"
+// upstream_failed()
+#include "upstream_score.h"
+// listen_tcp_pool(), TCPpool_thread()
+#include "tcp_pool.h"
+#include "flight.h"
+// PROBE*()
+#include "probes.h"
 
 // Private prototypes
 static void print_flags(const unsigned int flags);
@@ -95,6 +108,9 @@ static struct {
 // Fork-private copy of the server data the most recent reply came from
 static union mysockaddr last_server = {{ 0 }};
 
+// Extended DNS error (EDNS(0) EDE option) of the most recent reply
+static int last_ede = EDE_UNSET;
+
 unsigned char* pihole_privacylevel = &config.privacylevel;
 const char *flagnames[] = {"F_IMMORTAL ", "F_NAMEP ", "F_REVERSE ", "F_FORWARD ", "F_DHCP ", "F_NEG ", "F_HOSTS ", "F_IPV4 ", "F_IPV6 ", "F_BIGNAME ", "F_NXDOMAIN ", "F_CNAME ", "F_DNSKEY ", "F_CONFIG ", "F_DS ", "F_DNSSECOK ", "F_UPSTREAM ", "F_RRNAME ", "F_SERVER ", "F_QUERY ", "F_NOERR ", "F_AUTH ", "F_DNSSEC ", "F_KEYTAG ", "F_SECSTAT ", "F_NO_RR ", "F_IPSET ", "F_NOEXTRA ", "F_SERVFAIL", "F_RCODE", "F_SRV", "F_STALE" };
 
@@ -102,7 +118,7 @@ void FTL_hook(unsigned int flags, const char *name, union all_addr *addr, char *
 {
 	// Extract filename from path
 	const char *path = short_path(file);
-	if(config.debug & DEBUG_FLAGS)
+	if(debug_enabled(DEBUG_FLAGS))
 	{
 		logg("Processing FTL hook from %s:%d (name: \"%s\")...", path, line, name);
 		print_flags(flags);
@@ -157,7 +173,7 @@ void FTL_hook(unsigned int flags, const char *name, union all_addr *addr, char *
 			arg = (char*)"dnssec-unknown";
 		}
 
-		_FTL_new_query(flags, name, NULL, arg, qtype, id, INTERNAL, file, line);
+		_FTL_new_query(flags, name, NULL, arg, qtype, id, INTERNAL, NULL, file, line);
 		// forwarded upstream (type is used to store the upstream port)
 		FTL_forwarded(flags, name, addr, type, id, path, line);
 	}
@@ -177,10 +193,78 @@ void FTL_hook(unsigned int flags, const char *name, union all_addr *addr, char *
 		FTL_reply(flags, name, addr, arg, id, path, line);
 }
 
+// Answers generated by FTL (blocked domains, pi.hole, the hostname) are
+// precomputed as complete resource records. They only differ in type, TTL and
+// address so we keep a few of them around and copy them into the reply instead
+// of encoding each record field by field
+#define ANSWER_TEMPLATES 8
+struct answer_template {
+	unsigned short type;
+	unsigned long ttl;
+	union all_addr addr;
+	size_t len;
+	// Name (compression pointer), type, class, TTL, RDLENGTH, RDATA
+	unsigned char rr[2 + 10 + IN6ADDRSZ];
+};
+static struct answer_template templates[ANSWER_TEMPLATES] = {{ 0 }};
+static unsigned int next_template = 0u;
+
+static const struct answer_template *get_answer_template(const unsigned short type, const unsigned long ttl,
+                                                         const union all_addr *addr)
+{
+	const size_t addrlen = type == T_A ? INADDRSZ : IN6ADDRSZ;
+	for(unsigned int i = 0; i < ANSWER_TEMPLATES; i++)
+	{
+		const struct answer_template *t = &templates[i];
+		if(t->len > 0 && t->type == type && t->ttl == ttl &&
+		   memcmp(&t->addr, addr, addrlen) == 0)
+			return t;
+	}
+
+	// Not found, replace the oldest template
+	struct answer_template *t = &templates[next_template];
+	next_template = (next_template + 1) % ANSWER_TEMPLATES;
+	memset(t, 0, sizeof(*t));
+	t->type = type;
+	t->ttl = ttl;
+	memcpy(&t->addr, addr, addrlen);
+
+	// The name is always a pointer to the question right after the header
+	unsigned char *p = t->rr;
+	PUTSHORT(0xC000 | sizeof(struct dns_header), p);
+	PUTSHORT(type, p);
+	PUTSHORT(C_IN, p);
+	PUTLONG(ttl, p);
+	PUTSHORT(addrlen, p);
+	memcpy(p, addr, addrlen);
+	p += addrlen;
+	t->len = p - t->rr;
+
+	return t;
+}
+
+// Append an A or AAAA answer to the reply. Returns false if there is not
+// enough space left in the packet
+static bool add_answer(struct dns_header *header, char *limit, int *trunc, unsigned char **pp,
+                       const unsigned short type, const unsigned long ttl, const union all_addr *addr)
+{
+	const struct answer_template *t = get_answer_template(type, ttl, addr);
+	if(limit != NULL && *pp + t->len > (unsigned char *)limit)
+	{
+		*trunc = 1;
+		return false;
+	}
+
+	memcpy(*pp, t->rr, t->len);
+	*pp += t->len;
+	header->ancount = htons(ntohs(header->ancount) + 1);
+	return true;
+}
+
 // This is inspired by make_local_answer()
 size_t _FTL_make_answer(struct dns_header *header, char *limit, const size_t len, int *ede, const char *file, const int line)
 {
-	if(config.debug & DEBUG_FLAGS)
+	if(debug_enabled(DEBUG_FLAGS))
 		logg("FTL_make_answer() called from %s:%d", short_path(file), line);
 	// Exit early if there are no questions in this query
 	if(ntohs(header->qdcount) == 0)
@@ -193,7 +277,7 @@ size_t _FTL_make_answer(struct dns_header *header, char *limit, const size_t len
 		return 0;
 
 	// Debug logging
-	if(config.debug & DEBUG_FLAGS)
+	if(debug_enabled(DEBUG_FLAGS))
 	{
 		if(*ede != EDE_UNSET)
 			logg("Preparing reply for \"%s\", EDE: %s (%d)", name, edestr(*ede), *ede);
@@ -227,7 +311,7 @@ size_t _FTL_make_answer(struct dns_header *header, char *limit, const size_t len
 		force_next_DNS_reply = REPLY_UNKNOWN;
 
 		// Debug logging
-		if(config.debug & DEBUG_FLAGS)
+		if(debug_enabled(DEBUG_FLAGS))
 			logg("Forced DNS reply to NXDOMAIN");
 	}
 	else if(force_next_DNS_reply == REPLY_NODATA)
@@ -237,7 +321,7 @@ size_t _FTL_make_answer(struct dns_header *header, char *limit, const size_t len
 		force_next_DNS_reply = REPLY_UNKNOWN;
 
 		// Debug logging
-		if(config.debug & DEBUG_FLAGS)
+		if(debug_enabled(DEBUG_FLAGS))
 			logg("Forced DNS reply to NODATA");
 	}
 	else if(force_next_DNS_reply == REPLY_REFUSED)
@@ -248,7 +332,7 @@ size_t _FTL_make_answer(struct dns_header *header, char *limit, const size_t len
 		force_next_DNS_reply = REPLY_UNKNOWN;
 
 		// Debug logging
-		if(config.debug & DEBUG_FLAGS)
+		if(debug_enabled(DEBUG_FLAGS))
 			logg("Forced DNS reply to REFUSED");
 
 		// Set EDE code to blocked
@@ -264,7 +348,7 @@ size_t _FTL_make_answer(struct dns_header *header, char *limit, const size_t len
 		force_next_DNS_reply = REPLY_UNKNOWN;
 
 		// Debug logging
-		if(config.debug & DEBUG_FLAGS)
+		if(debug_enabled(DEBUG_FLAGS))
 			logg("Forced DNS reply to IP");
 	}
 	else if(force_next_DNS_reply == REPLY_NONE)
@@ -273,7 +357,7 @@ size_t _FTL_make_answer(struct dns_header *header, char *limit, const size_t len
 		force_next_DNS_reply = REPLY_UNKNOWN;
 
 		// Debug logging
-		if(config.debug & DEBUG_FLAGS)
+		if(debug_enabled(DEBUG_FLAGS))
 			logg("Forced DNS reply to NONE - dropping this query");
 
 		return 0;
@@ -286,7 +370,7 @@ size_t _FTL_make_answer(struct dns_header *header, char *limit, const size_t len
 			// If we block in NXDOMAIN mode, we set flags to NXDOMAIN
 			// (NEG will be added after setup_reply() below)
 			flags = F_NXDOMAIN;
-			if(config.debug & DEBUG_FLAGS)
+			if(debug_enabled(DEBUG_FLAGS))
 				logg("Configured blocking mode is NXDOMAIN");
 		}
 		else if(config.blockingmode == MODE_NODATA ||
@@ -295,7 +379,7 @@ size_t _FTL_make_answer(struct dns_header *header, char *limit, const size_t len
 			// If we block in NODATA mode or NODATA for AAAA queries, we apply
 			// the NOERROR response flag. This ensures we're sending an empty response
 			flags = F_NOERR;
-			if(config.debug & DEBUG_FLAGS)
+			if(debug_enabled(DEBUG_FLAGS))
 				logg("Configured blocking mode is NODATA%s",
 				     config.blockingmode == MODE_IP_NODATA_AAAA ? "-IPv6" : "");
 		}
@@ -311,12 +395,12 @@ size_t _FTL_make_answer(struct dns_header *header, char *limit, const size_t len
 		last_regex_idx = -1;
 
 		// Debug logging
-		if(config.debug & DEBUG_FLAGS)
+		if(debug_enabled(DEBUG_FLAGS))
 			logg("Regex match is %sredirected", redirecting ? "" : "NOT ");
 	}
 
 	// Debug logging
-	if(config.debug & DEBUG_FLAGS)
+	if(debug_enabled(DEBUG_FLAGS))
 		print_flags(flags);
 
 	// Setup reply header
@@ -366,7 +450,7 @@ size_t _FTL_make_answer(struct dns_header *header, char *limit, const size_t len
 		}
 
 		// Debug logging
-		if(config.debug & DEBUG_QUERIES)
+		if(debug_enabled(DEBUG_QUERIES))
 		{
 			char ip[ADDRSTRLEN+1] = { 0 };
 			alladdr_extract_ip(&addr, AF_INET, ip);
@@ -374,10 +458,8 @@ size_t _FTL_make_answer(struct dns_header *header, char *limit, const size_t len
 		}
 
 		// Add A resource record
-		header->ancount = htons(ntohs(header->ancount) + 1);
-		if(add_resource_record(header, limit, &trunc, sizeof(struct dns_header),
-		                       &p, hostname ? daemon->local_ttl : config.block_ttl,
-		                       NULL, T_A, C_IN, (char*)"4", &addr.addr4))
+		if(add_answer(header, limit, &trunc, &p, T_A,
+		              hostname ? daemon->local_ttl : config.block_ttl, &addr))
 			log_query(flags & ~F_IPV6, name, &addr, (char*)blockingreason, 0);
 	}
 
@@ -401,7 +483,7 @@ size_t _FTL_make_answer(struct dns_header *header, char *limit, const size_t len
 		}
 
 		// Debug logging
-		if(config.debug & DEBUG_QUERIES)
+		if(debug_enabled(DEBUG_QUERIES))
 		{
 			char ip[ADDRSTRLEN+1] = { 0 };
 			alladdr_extract_ip(&addr, AF_INET6, ip);
@@ -409,10 +491,8 @@ size_t _FTL_make_answer(struct dns_header *header, char *limit, const size_t len
 		}
 
 		// Add AAAA resource record
-		header->ancount = htons(ntohs(header->ancount) + 1);
-		if(add_resource_record(header, limit, &trunc, sizeof(struct dns_header),
-		                       &p, hostname ? daemon->local_ttl : config.block_ttl,
-		                       NULL, T_AAAA, C_IN, (char*)"6", &addr.addr6))
+		if(add_answer(header, limit, &trunc, &p, T_AAAA,
+		              hostname ? daemon->local_ttl : config.block_ttl, &addr))
 			log_query(flags & ~F_IPV4, name, &addr, (char*)blockingreason, 0);
 	}
 
@@ -442,36 +522,211 @@ size_t _FTL_make_answer(struct dns_header *header, char *limit, const size_t len
 	return p - (unsigned char *)header;
 }
 
-static bool is_pihole_domain(const char *domain)
+// Special names (pi.hole, the hostname, the Mozilla canary and iCloud Private
+// Relay domains and the reverse names of the local interface addresses) are
+// looked up in one hash table instead of comparing each query against all of
+// them. The table is (re)built when it is first needed and after the
+// interfaces changed
+enum special_name {
+	SPECIAL_NONE = 0,
+	SPECIAL_PIHOLE,
+	SPECIAL_MOZILLA_CANARY,
+	SPECIAL_ICLOUD_RELAY,
+	SPECIAL_PTR_IPV4,
+	SPECIAL_PTR_IPV6
+};
+
+struct special_name_entry {
+	uint32_t hash;
+	enum special_name kind;
+	char *name;
+	union all_addr addr;
+};
+
+static struct special_name_entry *special_names = NULL;
+static unsigned int special_names_slots = 0u;
+static bool special_names_valid = false;
+static uint32_t interfaces_hash = 0u;
+
+// Case-insensitive FNV-1a hash
+static uint32_t __attribute__((pure)) special_name_hash(const char *name)
+{
+	uint32_t hash = 2166136261U;
+	for(const unsigned char *c = (const unsigned char *)name; *c; c++)
+	{
+		hash ^= tolower(*c);
+		hash *= 16777619U;
+	}
+	return hash;
+}
+
+static void add_special_name(const char *name, const enum special_name kind, const union all_addr *addr)
+{
+	const uint32_t hash = special_name_hash(name);
+	for(unsigned int i = 0; i < special_names_slots; i++)
+	{
+		// Linear probing, the table is at most half full
+		struct special_name_entry *entry = &special_names[(hash + i) & (special_names_slots - 1)];
+		if(entry->name != NULL)
+		{
+			// Keep the first entry for duplicates
+			if(entry->hash == hash && strcasecmp(entry->name, name) == 0)
+				return;
+			continue;
+		}
+
+		entry->hash = hash;
+		entry->kind = kind;
+		entry->name = strdup(name);
+		if(addr != NULL)
+			memcpy(&entry->addr, addr, sizeof(entry->addr));
+		return;
+	}
+}
+
+// Add reverse names of a local interface address (x.x.x.x.in-addr.arpa or
+// x.x.[...].x.ip6.arpa and x.x.[...].x.ip6.int)
+static void add_special_ptr(const sa_family_t family, const union all_addr *addr)
+{
+	char name[128];
+	if(family == AF_INET)
+	{
+		const unsigned char *a = (const unsigned char *)&addr->addr4;
+		snprintf(name, sizeof(name), "%u.%u.%u.%u.in-addr.arpa", a[3], a[2], a[1], a[0]);
+		add_special_name(name, SPECIAL_PTR_IPV4, addr);
+		return;
+	}
+
+	const unsigned char *a = (const unsigned char *)&addr->addr6;
+	char *p = name;
+	for(int i = IN6ADDRSZ - 1; i >= 0; i--)
+	{
+		*p++ = "0123456789abcdef"[a[i] & 0x0f];
+		*p++ = '.';
+		*p++ = "0123456789abcdef"[a[i] >> 4];
+		*p++ = '.';
+	}
+	strcpy(p, "ip6.arpa");
+	add_special_name(name, SPECIAL_PTR_IPV6, addr);
+	strcpy(p, "ip6.int");
+	add_special_name(name, SPECIAL_PTR_IPV6, addr);
+}
+
+static void build_special_names(void)
 {
-	static char *pihole_suffix = NULL;
-	if(!pihole_suffix && daemon->domain_suffix)
-	{
-		// Build "pi.hole.<local suffix>" domain
-		pihole_suffix = calloc(strlen(daemon->domain_suffix) + 9, sizeof(char));
-		strcpy(pihole_suffix, "pi.hole.");
-		strcat(pihole_suffix, daemon->domain_suffix);
-		if(config.debug & DEBUG_QUERIES)
+	// Free previous table
+	for(unsigned int i = 0; i < special_names_slots; i++)
+		if(special_names[i].name != NULL)
+			free(special_names[i].name);
+	if(special_names != NULL)
+		free(special_names);
+
+	// Size the table such that it is at most half full
+	unsigned int num = 7;
+	for(struct irec *iface = daemon->interfaces; iface != NULL; iface = iface->next)
+		num += 2;
+	special_names_slots = 16u;
+	while(special_names_slots < 2*num)
+		special_names_slots *= 2;
+	special_names = calloc(special_names_slots, sizeof(struct special_name_entry));
+	if(special_names == NULL)
+	{
+		special_names_slots = 0u;
+		return;
+	}
+
+	// pi.hole and the hostname, also with the local domain suffix
+	add_special_name("pi.hole", SPECIAL_PIHOLE, NULL);
+	add_special_name(hostname(), SPECIAL_PIHOLE, NULL);
+	if(daemon->domain_suffix)
+	{
+		if(debug_enabled(DEBUG_QUERIES))
 			logg("Domain suffix is \"%s\"", daemon->domain_suffix);
+
+		char name[MAXDNAME];
+		snprintf(name, sizeof(name), "pi.hole.%s", daemon->domain_suffix);
+		add_special_name(name, SPECIAL_PIHOLE, NULL);
+		snprintf(name, sizeof(name), "%s.%s", hostname(), daemon->domain_suffix);
+		add_special_name(name, SPECIAL_PIHOLE, NULL);
+	}
+
+	add_special_name("use-application-dns.net", SPECIAL_MOZILLA_CANARY, NULL);
+	add_special_name("mask.icloud.com", SPECIAL_ICLOUD_RELAY, NULL);
+	add_special_name("mask-h2.icloud.com", SPECIAL_ICLOUD_RELAY, NULL);
+
+	// Reverse names of all local interface addresses. We do not want to
+	// reply with "pi.hole" to loopback PTRs
+	for(struct irec *iface = daemon->interfaces; iface != NULL; iface = iface->next)
+	{
+		union all_addr addr = {{ 0 }};
+		const sa_family_t family = iface->addr.sa.sa_family;
+		if(family == AF_INET && iface->addr.in.sin_addr.s_addr != htonl(INADDR_LOOPBACK))
+		{
+			addr.addr4 = iface->addr.in.sin_addr;
+			add_special_ptr(family, &addr);
+		}
+		else if(family == AF_INET6 && !IN6_IS_ADDR_LOOPBACK(&iface->addr.in6.sin6_addr))
+		{
+			addr.addr6 = iface->addr.in6.sin6_addr;
+			add_special_ptr(family, &addr);
+		}
 	}
-	static char *hostname_suffix = NULL;
-	if(!hostname_suffix && daemon->domain_suffix)
+
+	special_names_valid = true;
+}
+
+// Look up a special name. addr is set to the interface address for PTR names
+static enum special_name lookup_special_name(const char *name, union all_addr *addr)
+{
+	if(!special_names_valid)
+		build_special_names();
+
+	const uint32_t hash = special_name_hash(name);
+	for(unsigned int i = 0; i < special_names_slots; i++)
+	{
+		const struct special_name_entry *entry = &special_names[(hash + i) & (special_names_slots - 1)];
+		if(entry->name == NULL)
+			break;
+		if(entry->hash != hash || strcasecmp(entry->name, name) != 0)
+			continue;
+
+		if(addr != NULL)
+			memcpy(addr, &entry->addr, sizeof(*addr));
+		return entry->kind;
+	}
+
+	return SPECIAL_NONE;
+}
+
+// Called by dnsmasq after it (re-)enumerated the local interfaces. The table
+// of special names is rebuilt when their addresses changed
+void FTL_interfaces_enumerated(void)
+{
+	uint32_t hash = 2166136261U;
+	for(struct irec *iface = daemon->interfaces; iface != NULL; iface = iface->next)
 	{
-		// Build "<hostname>.<local suffix>" domain
-		hostname_suffix = calloc(strlen(hostname()) + strlen(daemon->domain_suffix) + 2, sizeof(char));
-		strcpy(hostname_suffix, hostname());
-		strcat(hostname_suffix, ".");
-		strcat(hostname_suffix, daemon->domain_suffix);
+		const unsigned char *a = (const unsigned char *)&iface->addr;
+		for(size_t i = 0; i < sizeof(iface->addr); i++)
+		{
+			hash ^= a[i];
+			hash *= 16777619U;
+		}
 	}
-	return strcasecmp(domain, "pi.hole") == 0 || strcasecmp(domain, hostname()) == 0 ||
-	       (pihole_suffix && strcasecmp(domain, pihole_suffix) == 0) ||
-	       (hostname_suffix && strcasecmp(domain, hostname_suffix) == 0);
+
+	if(hash != interfaces_hash)
+		special_names_valid = false;
+	interfaces_hash = hash;
+}
+
+static bool is_pihole_domain(const char *domain)
+{
+	return lookup_special_name(domain, NULL) == SPECIAL_PIHOLE;
 }
 
 bool _FTL_new_query(const unsigned int flags, const char *name,
                     union mysockaddr *addr, char *arg,
                     const unsigned short qtype, const int id,
-                    const enum protocol proto,
+                    const enum protocol proto, const struct packet_meta *meta,
                     const char* file, const int line)
 {
 	// Create new query in data structure
@@ -482,6 +737,12 @@ bool _FTL_new_query(const unsigned int flags, const char *name,
 	// Save request time
 	struct timeval request;
 	gettimeofday(&request, 0);
+	struct timespec arrival;
+	clock_gettime(CLOCK_MONOTONIC, &arrival);
+	PROBE4(query_received, id, name, qtype, proto);
+
+	// Forget the EDE of an earlier reply nobody consumed
+	last_ede = EDE_UNSET;
 
 	// Determine query type
 	enum query_types querytype;
@@ -561,7 +822,7 @@ bool _FTL_new_query(const unsigned int flags, const char *name,
 				force_next_DNS_reply = REPLY_IP;
 
 			blockingreason = HOSTNAME;
-			if(config.debug & DEBUG_QUERIES)
+			if(debug_enabled(DEBUG_QUERIES))
 			{
 				logg("Replying to %s with %s", name,
 				     force_next_DNS_reply == REPLY_IP ?
@@ -585,13 +846,14 @@ bool _FTL_new_query(const unsigned int flags, const char *name,
 	// Skip AAAA queries if user doesn't want to have them analyzed
 	if(!config.analyze_AAAA && querytype == TYPE_AAAA)
 	{
-		if(config.debug & DEBUG_QUERIES)
+		if(debug_enabled(DEBUG_QUERIES))
 			logg("Not analyzing AAAA query");
 		return false;
 	}
 
 	// Convert domain to lower case
-	char *domainString = strdup(name);
+	const size_t mark = arena_mark();
+	char *domainString = arena_strdup(name);
 	strtolower(domainString);
 
 	// Get client IP address
@@ -603,11 +865,10 @@ bool _FTL_new_query(const unsigned int flags, const char *name,
 	in_port_t clientPort = daemon->port;
 	bool internal_query = false;
 	char clientIP[ADDRSTRLEN+1] = { 0 };
-	ednsData *edns = getEDNS();
-	if(config.edns0_ecs && edns && edns->client_set)
+	if(config.edns0_ecs && meta && meta->client_set)
 	{
 		// Use ECS provided client
-		strncpy(clientIP, edns->client, ADDRSTRLEN);
+		strncpy(clientIP, meta->client, ADDRSTRLEN);
 		clientIP[ADDRSTRLEN] = '\0';
 	}
 	else if(addr)
@@ -627,13 +888,14 @@ bool _FTL_new_query(const unsigned int flags, const char *name,
 	if(config.ignore_localhost &&
 	   (strcmp(clientIP, "127.0.0.1") == 0 || strcmp(clientIP, "::1") == 0))
 	{
-		free(domainString);
+		arena_release(mark);
 		return false;
 	}
 
 	// Lock shared memory
 	lock_shm();
 	const int queryID = counters->queries;
+	flight_new(queryID, &arrival);
 
 	// Find client IP
 	const int clientID = findClientID(clientIP, true, false);
@@ -644,7 +906,7 @@ bool _FTL_new_query(const unsigned int flags, const char *name,
 	{
 		// Encountered memory error, skip query
 		// Free allocated memory
-		free(domainString);
+		arena_release(mark);
 		// Release thread lock
 		unlock_shm();
 		return false;
@@ -677,7 +939,7 @@ bool _FTL_new_query(const unsigned int flags, const char *name,
 		blockingreason = "Rate-limiting";
 
 		// Free allocated memory
-		free(domainString);
+		arena_release(mark);
 
 		// Do not further process this query, Pi-hole has never seen it
 		unlock_shm();
@@ -685,7 +947,7 @@ bool _FTL_new_query(const unsigned int flags, const char *name,
 	}
 
 	// Log new query if in debug mode
-	if(config.debug & DEBUG_QUERIES)
+	if(debug_enabled(DEBUG_QUERIES))
 	{
 		const char *types = querystr(arg, qtype);
 		logg("**** new %sIPv%d %s query \"%s\" from %s/%s#%d (ID %i, FTL %i, %s:%i)",
@@ -703,12 +965,12 @@ bool _FTL_new_query(const unsigned int flags, const char *name,
 	if(config.analyze_only_A_AAAA && querytype != TYPE_A && querytype != TYPE_AAAA)
 	{
 		// Don't process this query further here, we already counted it
-		if(config.debug & DEBUG_QUERIES)
+		if(debug_enabled(DEBUG_QUERIES))
 		{
 			const char *types = querystr(arg, qtype);
 			logg("Notice: Skipping new query: %s (%i)", types, id);
 		}
-		free(domainString);
+		arena_release(mark);
 		unlock_shm();
 		return false;
 	}
@@ -723,7 +985,7 @@ bool _FTL_new_query(const unsigned int flags, const char *name,
 		// Encountered memory error, skip query
 		logg("WARN: No memory available, skipping query analysis");
 		// Free allocated memory
-		free(domainString);
+		arena_release(mark);
 		// Release thread lock
 		unlock_shm();
 		return false;
@@ -801,7 +1063,7 @@ bool _FTL_new_query(const unsigned int flags, const char *name,
 			const char *oldiface = getstr(client->ifacepos);
 			if(strcasecmp(oldiface, interface) != 0)
 			{
-				if(config.debug & DEBUG_CLIENTS)
+				if(debug_enabled(DEBUG_CLIENTS))
 				{
 					const char *clientName = getstr(client->namepos);
 					logg("Client %s (%s) changed interface: %s -> %s",
@@ -814,9 +1076,9 @@ bool _FTL_new_query(const unsigned int flags, const char *name,
 	}
 
 	// Set client MAC address from EDNS(0) information (if available)
-	if(config.edns0_ecs && edns && edns->mac_set)
+	if(config.edns0_ecs && meta && meta->mac_set)
 	{
-		memcpy(client->hwaddr, edns->mac_byte, 6);
+		memcpy(client->hwaddr, meta->mac_byte, 6);
 		client->hwlen = 6;
 	}
 
@@ -824,7 +1086,7 @@ bool _FTL_new_query(const unsigned int flags, const char *name,
 	if(client->hwlen < 1)
 	{
 		client->hwlen = find_mac(addr, client->hwaddr, 1, time(NULL));
-		if(config.debug & DEBUG_ARP)
+		if(debug_enabled(DEBUG_ARP))
 		{
 			if(client->hwlen == 6)
 				logg("find_mac(\"%s\") returned hardware address "
@@ -841,10 +1103,16 @@ bool _FTL_new_query(const unsigned int flags, const char *name,
 	// Check if this should be blocked only for active queries
 	// (skipped for internally generated ones, e.g., DNSSEC)
 	if(!internal_query)
+	{
+		flight_stage(queryID, FLIGHT_BLOCKING_START);
 		blockDomain = FTL_check_blocking(queryID, domainID, clientID);
+		flight_stage(queryID, FLIGHT_BLOCKING_END);
+		PROBE4(verdict, id, blockDomain, query->status,
+		       blockDomain ? blockingreason : query->flags.whitelisted ? "whitelisted" : "not blocked");
+	}
 
 	// Free allocated memory
-	free(domainString);
+	arena_release(mark);
 
 	// Release thread lock
 	unlock_shm();
@@ -862,7 +1130,7 @@ void _FTL_iface(struct irec *recviface, const union all_addr *addr, const sa_fam
 	next_iface.haveIPv4 = next_iface.haveIPv6 = false;
 
 	// Debug logging
-	if(config.debug & DEBUG_NETWORKING)
+	if(debug_enabled(DEBUG_NETWORKING))
 		logg("Interfaces: Called from %s:%d", short_path(file), line);
 
 	// Use dummy when interface record is not available
@@ -874,7 +1142,7 @@ void _FTL_iface(struct irec *recviface, const union all_addr *addr, const sa_fam
 	   ((addrfamily == AF_INET && addr->addr4.s_addr != INADDR_ANY) ||
 	    (addrfamily == AF_INET6 && !IN6_IS_ADDR_UNSPECIFIED(&addr->addr6))))
 	{
-		if(config.debug & DEBUG_NETWORKING)
+		if(debug_enabled(DEBUG_NETWORKING))
 		{
 			char addrstr[INET6_ADDRSTRLEN] = { 0 };
 			if(addrfamily == AF_INET)
@@ -892,7 +1160,7 @@ void _FTL_iface(struct irec *recviface, const union all_addr *addr, const sa_fam
 			if(iface->addr.sa.sa_family == AF_INET)
 			{
 				inet_ntop(AF_INET, &iface->addr.in.sin_addr, addrstr, INET6_ADDRSTRLEN);
-				if(config.debug & DEBUG_NETWORKING)
+				if(debug_enabled(DEBUG_NETWORKING))
 				{
 					logg("  - IPv4 interface %s (%d,%d) is %s",
 					     iname, iface->index, iface->label, addrstr);
@@ -907,7 +1175,7 @@ void _FTL_iface(struct irec *recviface, const union all_addr *addr, const sa_fam
 			else if(iface->addr.sa.sa_family == AF_INET6)
 			{
 				inet_ntop(AF_INET6, &iface->addr.in6.sin6_addr, addrstr, INET6_ADDRSTRLEN);
-				if(config.debug & DEBUG_NETWORKING)
+				if(debug_enabled(DEBUG_NETWORKING))
 				{
 					logg("  - IPv6 interface %s (%d,%d) is %s",
 					     iname, iface->index, iface->label, addrstr);
@@ -920,7 +1188,7 @@ void _FTL_iface(struct irec *recviface, const union all_addr *addr, const sa_fam
 				}
 			}
 		}
-		if(config.debug & DEBUG_NETWORKING)
+		if(debug_enabled(DEBUG_NETWORKING))
 		{
 			if(recviface)
 				logg("    ^^^ MATCH ^^^");
@@ -933,7 +1201,7 @@ void _FTL_iface(struct irec *recviface, const union all_addr *addr, const sa_fam
 	// This means we didn't get one passed + we didn't find one above
 	if(!recviface)
 	{
-		if(config.debug & DEBUG_NETWORKING)
+		if(debug_enabled(DEBUG_NETWORKING))
 			logg("No receiving interface available at this point");
 		return;
 	}
@@ -941,7 +1209,7 @@ void _FTL_iface(struct irec *recviface, const union all_addr *addr, const sa_fam
 	// Determine addresses of this interface, we have to loop over all interfaces as
 	// recviface will always only contain *either* IPv4 or IPv6 information
 	bool haveGUAv6 = false, haveULAv6 = false;
-	if(config.debug & DEBUG_NETWORKING)
+	if(debug_enabled(DEBUG_NETWORKING))
 		logg("Analyzing interfaces:");
 	for (struct irec *iface = daemon->interfaces; iface != NULL; iface = iface->next)
 	{
@@ -950,7 +1218,7 @@ void _FTL_iface(struct irec *recviface, const union all_addr *addr, const sa_fam
 		// If this interface has no name, we skip it
 		if(iname == NULL)
 		{
-			if(config.debug & DEBUG_NETWORKING)
+			if(debug_enabled(DEBUG_NETWORKING))
 				logg("  - SKIP IPv%d interface (%d,%d): no name",
 				     family == AF_INET ? 4 : 6, iface->index, iface->label);
 			continue;
@@ -959,7 +1227,7 @@ void _FTL_iface(struct irec *recviface, const union all_addr *addr, const sa_fam
 		// Check if this is the interface we want
 		if(iface->index != recviface->index || iface->label != recviface->label)
 		{
-			if(config.debug & DEBUG_NETWORKING)
+			if(debug_enabled(DEBUG_NETWORKING))
 				logg("  - SKIP IPv%d interface %s: (%d,%d) != (%d,%d)",
 				     family == AF_INET ? 4 : 6, iname, iface->index, iface->label,
 				     recviface->index, recviface->label);
@@ -1012,7 +1280,7 @@ void _FTL_iface(struct irec *recviface, const union all_addr *addr, const sa_fam
 		}
 
 		// Debug logging
-		if(config.debug & DEBUG_NETWORKING)
+		if(debug_enabled(DEBUG_NETWORKING))
 		{
 			char buffer[ADDRSTRLEN+1] = { 0 };
 			if(family == AF_INET)
@@ -1030,7 +1298,7 @@ void _FTL_iface(struct irec *recviface, const union all_addr *addr, const sa_fam
 		// (a valid IPv4 address + a valid ULA IPv6 address)
 		if(next_iface.haveIPv4 && haveULAv6)
 		{
-			if(config.debug & DEBUG_NETWORKING)
+			if(debug_enabled(DEBUG_NETWORKING))
 				logg("Exiting interface analysis early (have IPv4 + ULAv6)");
 			break;
 		}
@@ -1043,52 +1311,31 @@ static void check_pihole_PTR(char *domain)
 	if(pihole_ptr == NULL)
 		return;
 
-	// Convert PTR request into numeric form
+	// Check if this is the in-addr.arpa (IPv4) or ip6.[int|arpa] (IPv6)
+	// name of one of the addresses of the local interfaces. If not, nothing
+	// is to be done here and we return early
 	union all_addr addr = {{ 0 }};
-	const int flags = in_arpa_name_2_addr(domain, &addr);
-
-	// Check if this is a valid in-addr.arpa (IPv4) or ip6.[int|arpa] (IPv6)
-	// specifier. If not, nothing is to be done here and we return early
-	if(flags == 0)
-		return;
-
-	// We do not want to reply with "pi.hole" to loopback PTRs
-	if((flags == F_IPV4 && addr.addr4.s_addr == htonl(INADDR_LOOPBACK)) ||
-	   (flags == F_IPV6 && IN6_IS_ADDR_LOOPBACK(&addr.addr6)))
+	const enum special_name kind = lookup_special_name(domain, &addr);
+	if(kind != SPECIAL_PTR_IPV4 && kind != SPECIAL_PTR_IPV6)
 		return;
 
-	// If we reached this point, addr contains the address the client requested
-	// a name for. We compare this address against all addresses of the local
-	// interfaces to see if we should reply with "pi.hole"
-	for (struct irec *iface = daemon->interfaces; iface != NULL; iface = iface->next)
+	// The last PTR record in daemon->ptr is reserved for Pi-hole
+	free(pihole_ptr->name);
+	pihole_ptr->name = strdup(domain);
+	if(kind == SPECIAL_PTR_IPV4)
 	{
-		const sa_family_t family = iface->addr.sa.sa_family;
-		if((family == AF_INET && flags == F_IPV4 && iface->addr.in.sin_addr.s_addr == addr.addr4.s_addr) ||
-		   (family == AF_INET6 && flags == F_IPV6 && IN6_ARE_ADDR_EQUAL(&iface->addr.in6.sin6_addr, &addr.addr6)))
-		{
-			// The last PTR record in daemon->ptr is reserved for Pi-hole
-			free(pihole_ptr->name);
-			pihole_ptr->name = strdup(domain);
-			if(family == AF_INET)
-			{
-				// IPv4 supports conditional domains
-				struct in_addr addrv4 = { 0 };
-				addrv4.s_addr = iface->addr.in.sin_addr.s_addr;
-				pihole_ptr->ptr = get_ptrname(&addrv4);
-			}
-			else
-			{
-				// IPv6 does not support conditional domains
-				pihole_ptr->ptr = get_ptrname(NULL);
-			}
-
-			// Debug logging
-			if(config.debug & DEBUG_QUERIES)
-				logg("Generating PTR response: %s -> %s", pihole_ptr->name, pihole_ptr->ptr);
-
-			return;
-		}
+		// IPv4 supports conditional domains
+		pihole_ptr->ptr = get_ptrname(&addr.addr4);
+	}
+	else
+	{
+		// IPv6 does not support conditional domains
+		pihole_ptr->ptr = get_ptrname(NULL);
 	}
+
+	// Debug logging
+	if(debug_enabled(DEBUG_QUERIES))
+		logg("Generating PTR response: %s -> %s", pihole_ptr->name, pihole_ptr->ptr);
 }
 
 inline static void set_dnscache_blockingstatus(DNSCacheData * dns_cache, clientsData *client,
@@ -1097,7 +1344,7 @@ inline static void set_dnscache_blockingstatus(DNSCacheData * dns_cache, clients
 	// Memorize blocking status DNS cache for the domain/client combination
 	dns_cache->blocking_status = new_status;
 
-	if(config.debug & DEBUG_QUERIES)
+	if(debug_enabled(DEBUG_QUERIES))
 	{
 		const char *clientip = client ? getstr(client->ippos) : "N/A";
 		logg("DNS cache: %s/%s is %s", clientip, domain, blockingreason);
@@ -1128,7 +1375,9 @@ static bool check_domain_blocked(const char *domain, const int clientID,
 	}
 
 	// Check domains against gravity domains
+	PROBE1(gravity_start, domain);
 	enum db_result gravity = in_gravity(domain, client);
+	PROBE2(gravity_end, domain, gravity);
 	if(gravity == FOUND)
 	{
 		// Set new status
@@ -1150,7 +1399,7 @@ static bool check_domain_blocked(const char *domain, const int clientID,
 		// Handle reply to this query as configured
 		if(config.reply_when_busy == BUSY_ALLOW)
 		{
-			if(config.debug & DEBUG_QUERIES)
+			if(debug_enabled(DEBUG_QUERIES))
 				logg("Allowing query as gravity database is not available");
 
 			// Permit this query
@@ -1218,8 +1467,9 @@ static bool special_domain(const queriesData *query, const char *domain)
 	// than NOERROR, such as NXDOMAIN (non-existent domain) or SERVFAIL; or
 	// respond with NOERROR, but return no A or AAAA records.
 	// https://support.mozilla.org/en-US/kb/configuring-networks-disable-dns-over-https
+	const enum special_name kind = lookup_special_name(domain, NULL);
 	if(config.special_domains.mozilla_canary &&
-	   strcasecmp(domain, "use-application-dns.net") == 0 &&
+	   kind == SPECIAL_MOZILLA_CANARY &&
 	   (query->type == TYPE_A || query->type == TYPE_AAAA))
 	{
 		blockingreason = "Mozilla canary domain";
@@ -1243,8 +1493,7 @@ static bool special_domain(const queriesData *query, const char *domain)
 	// > mask-h2.icloud.com
 	// https://developer.apple.com/support/prepare-your-network-for-icloud-private-relay
 	if(config.special_domains.icloud_private_relay &&
-	   (strcasecmp(domain, "mask.icloud.com") == 0 ||
-	    strcasecmp(domain, "mask-h2.icloud.com") == 0))
+	   kind == SPECIAL_ICLOUD_RELAY)
 	{
 		blockingreason = "Apple iCloud Private Relay domain";
 		force_next_DNS_reply = REPLY_NXDOMAIN;
@@ -1285,12 +1534,13 @@ static bool _FTL_check_blocking(int queryID, int domainID, int clientID, const c
 	// particular client
 	unsigned char blockingStatus = dns_cache->blocking_status;
 	char *domainstr = (char*)getstr(domain->domainpos);
+	PROBE2(blocking_cache, query->id, blockingStatus != UNKNOWN_BLOCKED);
 	switch(blockingStatus)
 	{
 		case UNKNOWN_BLOCKED:
 			// New domain/client combination.
 			// We have to go through all the tests below
-			if(config.debug & DEBUG_QUERIES)
+			if(debug_enabled(DEBUG_QUERIES))
 			{
 				logg("%s is not known", domainstr);
 			}
@@ -1302,7 +1552,7 @@ static bool _FTL_check_blocking(int queryID, int domainID, int clientID, const c
 			// return this result early, skipping
 			// all the lengthy tests below
 			blockingreason = "exactly blacklisted";
-			if(config.debug & DEBUG_QUERIES)
+			if(debug_enabled(DEBUG_QUERIES))
 			{
 				logg("%s is known as %s", domainstr, blockingreason);
 			}
@@ -1322,7 +1572,7 @@ static bool _FTL_check_blocking(int queryID, int domainID, int clientID, const c
 			// return this result early, skipping
 			// all the lengthy tests below
 			blockingreason = "gravity blocked";
-			if(config.debug & DEBUG_QUERIES)
+			if(debug_enabled(DEBUG_QUERIES))
 			{
 				logg("%s is known as %s", domainstr, blockingreason);
 			}
@@ -1342,7 +1592,7 @@ static bool _FTL_check_blocking(int queryID, int domainID, int clientID, const c
 			// return this result early, skipping
 			// all the lengthy tests below
 			blockingreason = "regex blacklisted";
-			if(config.debug & DEBUG_QUERIES)
+			if(debug_enabled(DEBUG_QUERIES))
 			{
 				logg("%s is known as %s", domainstr, blockingreason);
 			}
@@ -1362,7 +1612,7 @@ static bool _FTL_check_blocking(int queryID, int domainID, int clientID, const c
 			// Known as whitelisted, we
 			// return this result early, skipping
 			// all the lengthy tests below
-			if(config.debug & DEBUG_QUERIES)
+			if(debug_enabled(DEBUG_QUERIES))
 			{
 				logg("%s is known as not to be blocked (whitelisted)", domainstr);
 			}
@@ -1377,7 +1627,7 @@ static bool _FTL_check_blocking(int queryID, int domainID, int clientID, const c
 			// return this result early, skipping
 			// all the lengthy tests below
 			blockingreason = "special domain";
-			if(config.debug & DEBUG_QUERIES)
+			if(debug_enabled(DEBUG_QUERIES))
 			{
 				logg("%s is known as special domain", domainstr);;
 			}
@@ -1391,7 +1641,7 @@ static bool _FTL_check_blocking(int queryID, int domainID, int clientID, const c
 			// Known as not blocked, we
 			// return this result early, skipping
 			// all the lengthy tests below
-			if(config.debug & DEBUG_QUERIES)
+			if(debug_enabled(DEBUG_QUERIES))
 			{
 				logg("%s is known as not to be blocked", domainstr);
 			}
@@ -1403,7 +1653,7 @@ static bool _FTL_check_blocking(int queryID, int domainID, int clientID, const c
 	// Skip all checks and continue if we hit already at least one whitelist in the chain
 	if(query->flags.whitelisted)
 	{
-		if(config.debug & DEBUG_QUERIES)
+		if(debug_enabled(DEBUG_QUERIES))
 		{
 			logg("Query is permitted as at least one whitelist entry matched");
 		}
@@ -1415,7 +1665,8 @@ static bool _FTL_check_blocking(int queryID, int domainID, int clientID, const c
 	// Make a local copy of the domain string. The string memory may get
 	// reorganized in the following. We cannot expect domainstr to remain
 	// valid for all time.
-	domainstr = strdup(domainstr);
+	const size_t mark = arena_mark();
+	domainstr = arena_strdup(domainstr);
 	const char *blockedDomain = domainstr;
 
 	// Check exact whitelist for match
@@ -1436,9 +1687,10 @@ static bool _FTL_check_blocking(int queryID, int domainID, int clientID, const c
 		query_blocked(query, domain, client, QUERY_SPECIAL_DOMAIN);
 
 		// Debug output
-		if(config.debug & DEBUG_QUERIES)
+		if(debug_enabled(DEBUG_QUERIES))
 			logg("Special domain: %s is %s", domainstr, blockingreason);
 
+		arena_release(mark);
 		return true;
 	}
 
@@ -1477,7 +1729,7 @@ static bool _FTL_check_blocking(int queryID, int domainID, int clientID, const c
 		query_blocked(query, domain, client, new_status);
 
 		// Debug output
-		if(config.debug & DEBUG_QUERIES)
+		if(debug_enabled(DEBUG_QUERIES))
 		{
 			logg("Blocking %s as %s is %s", domainstr, blockedDomain, blockingreason);
 			if(force_next_DNS_reply != 0)
@@ -1492,26 +1744,26 @@ static bool _FTL_check_blocking(int queryID, int domainID, int clientID, const c
 		dns_cache->blocking_status = query->flags.whitelisted ? WHITELISTED : NOT_BLOCKED;
 
 		// Debug output
-		if(config.debug & DEBUG_QUERIES)
+		if(debug_enabled(DEBUG_QUERIES))
 			// client is guaranteed to be non-NULL above
 			logg("DNS cache: %s/%s is %s", getstr(client->ippos), domainstr,
 			     query->flags.whitelisted ? "whitelisted" : "not blocked");
 	}
 
-	free(domainstr);
+	arena_release(mark);
 	return blockDomain;
 }
 
 
 bool _FTL_CNAME(const char *dst, const char *src, const int id, const char* file, const int line)
 {
-	if(config.debug & DEBUG_QUERIES)
+	if(debug_enabled(DEBUG_QUERIES))
 		logg("FTL_CNAME called with: src = %s, dst = %s, id = %d", src, dst, id);
 
 	// Does the user want to skip deep CNAME inspection?
 	if(!config.cname_inspection)
 	{
-		if(config.debug & DEBUG_QUERIES)
+		if(debug_enabled(DEBUG_QUERIES))
 			logg("Skipping analysis as cname inspection is disabled");
 		return false;
 	}
@@ -1526,7 +1778,7 @@ bool _FTL_CNAME(const char *dst, const char *src, const int id, const char* file
 		// This may happen e.g. if the original query was a PTR query
 		// or "pi.hole" and we ignored them altogether
 		unlock_shm();
-		if(config.debug & DEBUG_QUERIES)
+		if(debug_enabled(DEBUG_QUERIES))
 			logg("Skipping analysis as parent query is not found");
 		return false;
 	}
@@ -1538,7 +1790,7 @@ bool _FTL_CNAME(const char *dst, const char *src, const int id, const char* file
 	{
 		// Nothing to be done here
 		unlock_shm();
-		if(config.debug & DEBUG_QUERIES)
+		if(debug_enabled(DEBUG_QUERIES))
 			logg("Skipping analysis as parent query is not valid");
 		return false;
 	}
@@ -1556,7 +1808,8 @@ bool _FTL_CNAME(const char *dst, const char *src, const int id, const char* file
 
 	// child_domain = Intermediate domain in CNAME path
 	// This is the domain which was queried later in this chain
-	char *child_domain = strdup(dst);
+	const size_t mark = arena_mark();
+	char *child_domain = arena_strdup(dst);
 	// Convert to lowercase for matching
 	strtolower(child_domain);
 	const int child_domainID = findDomainID(child_domain, false);
@@ -1578,7 +1831,7 @@ bool _FTL_CNAME(const char *dst, const char *src, const int id, const char* file
 		if(parent_domain == NULL)
 		{
 			// Memory error, return
-			free(child_domain);
+			arena_release(mark);
 			unlock_shm();
 			return false;
 		}
@@ -1592,6 +1845,10 @@ bool _FTL_CNAME(const char *dst, const char *src, const int id, const char* file
 		// Store domain that was the reason for blocking the entire chain
 		query->CNAME_domainID = child_domainID;
 
+		// dnsmasq replies right away, the remainder of the chain is
+		// not processed
+		flight_complete(queryID);
+
 		// Change blocking reason into CNAME-caused blocking
 		if(query->status == QUERY_GRAVITY)
 		{
@@ -1624,11 +1881,11 @@ bool _FTL_CNAME(const char *dst, const char *src, const int id, const char* file
 	}
 
 	// Debug logging for deep CNAME inspection (if enabled)
-	if(config.debug & DEBUG_QUERIES)
+	if(debug_enabled(DEBUG_QUERIES))
 		logg("Query %d: CNAME %s ---> %s", id, src, dst);
 
 	// Return result
-	free(child_domain);
+	arena_release(mark);
 	unlock_shm();
 	return block;
 }
@@ -1673,11 +1930,13 @@ static void FTL_forwarded(const unsigned int flags, const char *name, const unio
 	}
 
 	// Convert upstreamIP to lower case
-	char *upstreamIP = strdup(dest);
+	const size_t mark = arena_mark();
+	char *upstreamIP = arena_strdup(dest);
 	strtolower(upstreamIP);
+	PROBE3(forward, id, upstreamIP, upstreamPort);
 
 	// Debug logging
-	if(config.debug & DEBUG_QUERIES)
+	if(debug_enabled(DEBUG_QUERIES))
 	{
 		logg("**** forwarded %s to %s#%u (ID %i, %s:%i)",
 		     name, upstreamIP, upstreamPort, id, file, line);
@@ -1689,16 +1948,17 @@ static void FTL_forwarded(const unsigned int flags, const char *name, const unio
 	{
 		// This may happen e.g. if the original query was a PTR query or "pi.hole"
 		// as we ignore them altogether
-		free(upstreamIP);
+		arena_release(mark);
 		unlock_shm();
 		return;
 	}
+	flight_stage(queryID, FLIGHT_FORWARDED);
 
 	// Get query pointer
 	queriesData* query = getQuery(queryID, true);
 	if(query == NULL)
 	{
-		free(upstreamIP);
+		arena_release(mark);
 		unlock_shm();
 		return;
 	}
@@ -1726,7 +1986,7 @@ static void FTL_forwarded(const unsigned int flags, const char *name, const unio
 	//   (this is a special case further described below)
 	if(query->flags.complete && query->status != QUERY_CACHE)
 	{
-		free(upstreamIP);
+		arena_release(mark);
 		unlock_shm();
 		return;
 	}
@@ -1775,7 +2035,7 @@ static void FTL_forwarded(const unsigned int flags, const char *name, const unio
 	query_set_status(query, QUERY_FORWARDED);
 
 	// Release allocated memory
-	free(upstreamIP);
+	arena_release(mark);
 
 	// Unlock shared memory
 	unlock_shm();
@@ -1788,6 +2048,10 @@ void FTL_dnsmasq_reload(void)
 	logg("Reloading DNS cache");
 	lock_shm();
 
+	// Rebuild the table of special names as the local domain or the
+	// hostname may have changed
+	special_names_valid = false;
+
 	// Request reload the privacy level and blocking status
 	set_event(RELOAD_PRIVACY_LEVEL);
 	set_event(RELOAD_BLOCKINGSTATUS);
@@ -1811,7 +2075,7 @@ void FTL_dnsmasq_reload(void)
 	set_event(RELOAD_GRAVITY);
 
 	// Print current set of capabilities if requested via debug flag
-	if(config.debug & DEBUG_CAPS)
+	if(debug_enabled(DEBUG_CAPS))
 		check_capabilities();
 
 	unlock_shm();
@@ -1876,7 +2140,7 @@ static void update_upstream(queriesData *query, const int id)
 	int upstreamID = findUpstreamID(ip, port);
 	if(upstreamID != query->upstreamID)
 	{
-		if(config.debug & DEBUG_QUERIES)
+		if(debug_enabled(DEBUG_QUERIES))
 		{
 			upstreamsData *upstream = getUpstream(query->upstreamID, true);
 			if(upstream)
@@ -1918,7 +2182,7 @@ static void FTL_reply(const unsigned int flags, const char *name, const union al
 	if(queryID < 0)
 	{
 		// This may happen e.g. if the original query was "pi.hole"
-		if(config.debug & DEBUG_QUERIES) logg("FTL_reply(): Query %i has not been found", id);
+		if(debug_enabled(DEBUG_QUERIES)) logg("FTL_reply(): Query %i has not been found", id);
 		unlock_shm();
 		return;
 	}
@@ -1936,15 +2200,16 @@ static void FTL_reply(const unsigned int flags, const char *name, const union al
 		{
 			; // Okay
 		}
-		else if(config.debug & DEBUG_FLAGS)
+		else if(debug_enabled(DEBUG_FLAGS))
 			logg("***** Unknown cache query");
 	}
 
 	// Is this a stale reply?
 	const bool stale = flags & F_STALE;
+	PROBE3(reply, id, name, cached);
 
 	// Possible debugging output
-	if(config.debug & DEBUG_QUERIES)
+	if(debug_enabled(DEBUG_QUERIES))
 	{
 		// Human-readable answer may be provided by arg
 		// (e.g. for non-cached queries such as SOA)
@@ -2022,20 +2287,23 @@ static void FTL_reply(const unsigned int flags, const char *name, const union al
 	if(addr && flags & (F_RCODE | F_SECSTAT) && addr->log.ede != EDE_UNSET)
 	{
 		query->ede = addr->log.ede;
-		if(config.debug & DEBUG_QUERIES)
+		if(debug_enabled(DEBUG_QUERIES))
 			logg("     EDE: %s (%d)", edestr(addr->log.ede), addr->log.ede);
 	}
-	ednsData *edns = getEDNS();
-	if(edns != NULL && edns->ede != EDE_UNSET)
+	if(last_ede != EDE_UNSET)
 	{
-		query->ede = edns->ede;
-		if(config.debug & DEBUG_QUERIES)
-			logg("     EDE: %s (%d)", edestr(edns->ede), edns->ede);
+		query->ede = last_ede;
+		if(debug_enabled(DEBUG_QUERIES))
+			logg("     EDE: %s (%d)", edestr(last_ede), last_ede);
+		last_ede = EDE_UNSET;
 	}
 
 	// Update upstream server (if applicable)
 	if(!cached)
+	{
 		update_upstream(query, id);
+		flight_stage(queryID, FLIGHT_UPSTREAM);
+	}
 
 	// Reset last_server to avoid possibly changing the upstream server
 	// again in the next query
@@ -2049,7 +2317,9 @@ static void FTL_reply(const unsigned int flags, const char *name, const union al
 	// Check if reply type is still UNKNOWN
 	if(query->reply != REPLY_UNKNOWN)
 	{
-		// Nothing to be done here
+		// The reply is known already, e.g., because the query has
+		// been blocked during CNAME inspection. It is sent now
+		flight_complete(queryID);
 		unlock_shm();
 		return;
 	}
@@ -2101,6 +2371,7 @@ static void FTL_reply(const unsigned int flags, const char *name, const union al
 		// Hereby, this query is now fully determined
 		query->flags.complete = true;
 
+		flight_complete(queryID);
 		unlock_shm();
 		return;
 	}
@@ -2211,7 +2482,7 @@ static void FTL_reply(const unsigned int flags, const char *name, const union al
 	{
 		logg("*************************** unknown REPLY ***************************");
 	}
-	else if(config.debug & DEBUG_FLAGS)
+	else if(debug_enabled(DEBUG_FLAGS))
 	{
 		logg("***** Unknown upstream REPLY");
 	}
@@ -2223,6 +2494,7 @@ static void FTL_reply(const unsigned int flags, const char *name, const union al
 		query_set_dnssec(query, adbit ? DNSSEC_SECURE : DNSSEC_INSECURE);
 	}
 
+	flight_complete(queryID);
 	unlock_shm();
 }
 
@@ -2241,7 +2513,7 @@ static enum query_status detect_blocked_IP(const unsigned short flags, const uni
 		// Skip replies which originated locally. Otherwise, we would
 		// count gravity.list blocked queries as externally blocked.
 		// Also: Do not mark responses of PTR requests as externally blocked.
-		if(config.debug & DEBUG_QUERIES)
+		if(debug_enabled(DEBUG_QUERIES))
 		{
 			const char *cause = (flags & F_HOSTS) ? "origin is HOSTS" : "query is PTR";
 			logg("Skipping detection of external blocking IP for ID %i as %s", query->id, cause);
@@ -2260,7 +2532,7 @@ static enum query_status detect_blocked_IP(const unsigned short flags, const uni
 	// Check for IP block 146.112.61.104 - 146.112.61.110
 	if((flags & F_IPV4) && ipv4Addr >= 0x92703d68 && ipv4Addr <= 0x92703d6e)
 	{
-		if(config.debug & DEBUG_QUERIES)
+		if(debug_enabled(DEBUG_QUERIES))
 		{
 			char answer[ADDRSTRLEN]; answer[0] = '\0';
 			inet_ntop(AF_INET, addr, answer, ADDRSTRLEN);
@@ -2278,7 +2550,7 @@ static enum query_status detect_blocked_IP(const unsigned short flags, const uni
 	        addr->addr6.s6_addr32[2] == 0xffff0000 &&
 	        ipv6Addr >= 0x92703d68 && ipv6Addr <= 0x92703d6e)
 	{
-		if(config.debug & DEBUG_QUERIES)
+		if(debug_enabled(DEBUG_QUERIES))
 		{
 			char answer[ADDRSTRLEN]; answer[0] = '\0';
 			inet_ntop(AF_INET6, addr, answer, ADDRSTRLEN);
@@ -2295,7 +2567,7 @@ static enum query_status detect_blocked_IP(const unsigned short flags, const uni
 	// nothing is reachable under these addresses
 	else if(flags & F_IPV4 && ipv4Addr == 0)
 	{
-		if(config.debug & DEBUG_QUERIES)
+		if(debug_enabled(DEBUG_QUERIES))
 		{
 			logg("Upstream responded with 0.0.0.0, ID %i:\n\t\"%s\" -> \"0.0.0.0\"",
 			     query->id, getstr(domain->domainpos));
@@ -2310,7 +2582,7 @@ static enum query_status detect_blocked_IP(const unsigned short flags, const uni
 	        addr->addr6.s6_addr32[2] == 0 &&
 	        addr->addr6.s6_addr32[3] == 0)
 	{
-		if(config.debug & DEBUG_QUERIES)
+		if(debug_enabled(DEBUG_QUERIES))
 		{
 			logg("Upstream responded with ::, ID %i:\n\t\"%s\" -> \"::\"",
 			     query->id, getstr(domain->domainpos));
@@ -2388,7 +2660,7 @@ static void FTL_dnssec(const char *arg, const union all_addr *addr, const int id
 	}
 
 	// Debug logging
-	if(config.debug & DEBUG_QUERIES)
+	if(debug_enabled(DEBUG_QUERIES))
 	{
 		// Get domain pointer
 		const domainsData* domain = getDomain(query->domainID, true);
@@ -2402,6 +2674,8 @@ static void FTL_dnssec(const char *arg, const union all_addr *addr, const int id
 	if(addr && addr->log.ede != EDE_UNSET)
 		query->ede = addr->log.ede;
 
+	flight_stage(queryID, FLIGHT_DNSSEC);
+
 	// Iterate through possible values
 	if(strcmp(arg, "SECURE") == 0)
 		query_set_dnssec(query, DNSSEC_SECURE);
@@ -2479,11 +2753,12 @@ static void FTL_upstream_error(const union all_addr *addr, const unsigned int fl
 			break;
 	}
 
-	// Get EDNS data (if available)
-	ednsData *edns = getEDNS();
+	// Get EDE of this reply (if available)
+	const int ede = last_ede;
+	last_ede = EDE_UNSET;
 
 	// Debug logging
-	if(config.debug & DEBUG_QUERIES)
+	if(debug_enabled(DEBUG_QUERIES))
 	{
 		// Get domain pointer
 		const domainsData* domain = getDomain(query->domainID, true);
@@ -2528,15 +2803,15 @@ static void FTL_upstream_error(const union all_addr *addr, const unsigned int fl
 			logg("     EDE: %s (%d)", edestr(addr->log.ede), addr->log.ede);
 		}
 
-		if(edns != NULL && edns->ede != EDE_UNSET)
+		if(ede != EDE_UNSET)
 		{
-			query->ede = edns->ede;
-			logg("     EDE: %s (%d)", edestr(edns->ede), edns->ede);
+			query->ede = ede;
+			logg("     EDE: %s (%d)", edestr(ede), ede);
 		}
 	}
 	// Check EDNS EDE for DNSSEC status in DNSSEC proxy mode
 	if(option_bool(OPT_DNSSEC_PROXY) &&
-	   edns && edns->ede >= EDE_DNSSEC_BOGUS && edns->ede <= EDE_NO_NSEC)
+	   ede >= EDE_DNSSEC_BOGUS && ede <= EDE_NO_NSEC)
 	{
 		// DNSSEC proxy mode is enabled and we received a valid DNSSEC
 		// status from the upstream server through ENDS EDE. We need to
@@ -2545,6 +2820,7 @@ static void FTL_upstream_error(const union all_addr *addr, const unsigned int fl
 	}
 	// Set query reply
 	query_set_reply(0, reply, addr, query, response);
+	flight_complete(queryID);
 
 	// Reset last_server
 	memset(&last_server, 0, sizeof(last_server));
@@ -2586,7 +2862,7 @@ static void FTL_mark_externally_blocked(const int id, const char* file, const in
 	}
 
 	// Possible debugging information
-	if(config.debug & DEBUG_QUERIES)
+	if(debug_enabled(DEBUG_QUERIES))
 	{
 		// Get domain name (domain cannot be NULL here)
 		const char *domainname = getstr(domain->domainpos);
@@ -2604,15 +2880,22 @@ static void FTL_mark_externally_blocked(const int id, const char* file, const in
 
 	// Store reply type as replied with NXDOMAIN
 	query_set_reply(F_NEG | F_NXDOMAIN, 0, NULL, query, response);
+	flight_stage(queryID, FLIGHT_UPSTREAM);
+	flight_complete(queryID);
 
 	// Unlock shared memory
 	unlock_shm();
 }
 
-void _FTL_header_analysis(const unsigned char header4, const unsigned int rcode, const struct server *server,
+void _FTL_header_analysis(const struct packet_meta *meta, const struct server *server,
                           const int id, const char* file, const int line)
 {
+	// Remember when this reply arrived
+	flight_upstream_reply();
+
 	// Analyze DNS header bits
+	const unsigned char header4 = meta->hb4;
+	const unsigned int rcode = meta->rcode;
 
 	// Check if RA bit is unset in DNS header and rcode is NXDOMAIN
 	// If the response code (rcode) is NXDOMAIN, we may be seeing a response from
@@ -2628,11 +2911,14 @@ void _FTL_header_analysis(const unsigned char header4, const unsigned int rcode,
 	// Check if AD bit is set in DNS header
 	adbit = header4 & HB4_AD;
 
+	// Remember EDE (if any) for the reply hooks
+	last_ede = meta->ede;
+
 	// Store server which sent this reply
 	if(server)
 	{
 		memcpy(&last_server, &server->addr, sizeof(last_server));
-		if(config.debug & DEBUG_EXTRA)
+		if(debug_enabled(DEBUG_EXTRA))
 		{
 			char ip[ADDRSTRLEN+1] = { 0 };
 			in_port_t port = 0;
@@ -2643,7 +2929,7 @@ void _FTL_header_analysis(const unsigned char header4, const unsigned int rcode,
 	else
 	{
 		memset(&last_server, 0, sizeof(last_server));
-		if(config.debug & DEBUG_EXTRA)
+		if(debug_enabled(DEBUG_EXTRA))
 			logg("Got forward address: NO");
 	}
 }
@@ -2654,7 +2940,7 @@ void print_flags(const unsigned int flags)
 	// e.g. "Flags: F_FORWARD F_NEG F_IPV6"
 
 	// Only print flags if corresponding debugging flag is set
-	if(!(config.debug & DEBUG_FLAGS))
+	if(!debug_enabled(DEBUG_FLAGS))
 		return;
 
 	char *flagstr = calloc(sizeof(flagnames) + 1, sizeof(char));
@@ -2729,7 +3015,7 @@ static void _query_set_reply(const unsigned int flags, const enum reply_type rep
 		new_reply = REPLY_BLOB;
 	}
 
-	if(config.debug & DEBUG_QUERIES)
+	if(debug_enabled(DEBUG_QUERIES))
 	{
 		const char *path = short_path(file);
 		logg("Set reply to %s (%d) in %s:%d", get_query_reply_str(new_reply), new_reply, path, line);
@@ -2801,6 +3087,15 @@ void FTL_fork_and_bind_sockets(struct passwd *ent_pw)
 		exit(EXIT_FAILURE);
 	}
 
+	// Start thread keeping persistent TCP connections to the upstream
+	// servers. It terminates right away if TCP_POOL is disabled
+	listen_tcp_pool();
+	if(pthread_create( &threads[TCPpool], &attr, TCPpool_thread, NULL ) != 0)
+	{
+		logg("Unable to open TCP pool thread. Exiting...");
+		exit(EXIT_FAILURE);
+	}
+
 	// Chown files if FTL started as user root but a dnsmasq config
 	// option states to run as a different user/group (e.g. "nobody")
 	if(getuid() == 0)
@@ -2941,6 +3236,18 @@ void getCacheInformation(const int sock)
 	            ci.valid.other,
 	            ci.expired,
 	            ci.immortal);
+	ssend(sock, "probation: %i\nprotected: %i\nhits-probation: %u\nhits-protected: %u\npromoted: %u\ndemoted: %u\nevicted-probation: %u\nevicted-demoted: %u\nevicted-memory: %u\nbytes: %zu\nbytes-limit: %zu\n",
+	            ci.probation,
+	            ci.protected,
+	            daemon->metrics[METRIC_DNS_CACHE_HITS_PROBATION],
+	            daemon->metrics[METRIC_DNS_CACHE_HITS_PROTECTED],
+	            daemon->metrics[METRIC_DNS_CACHE_PROMOTED],
+	            daemon->metrics[METRIC_DNS_CACHE_DEMOTED],
+	            daemon->metrics[METRIC_DNS_CACHE_EVICTED_PROBATION],
+	            daemon->metrics[METRIC_DNS_CACHE_EVICTED_DEMOTED],
+	            daemon->metrics[METRIC_DNS_CACHE_EVICTED_MEMORY],
+	            ci.bytes,
+	            daemon->cache_max_bytes);
 	// <cache-size> is obvious
 	// It means the resolver handled <cache-inserted> names lookups that
 	// needed to be sent to upstream servers and that <cache-live-freed>
@@ -2953,15 +3260,22 @@ void getCacheInformation(const int sock)
 	// <valid> are cache entries with positive remaining TTL
 	// <expired> cache entries (to be removed when space is needed)
 	// <immortal> cache records never expire (e.g. from /etc/hosts)
+	// <probation> entries have not been looked up since they were
+	// inserted, <protected> ones have. Only entries at the end of the
+	// probation list are evicted, <demoted> protected entries move
+	// back to the probation list when the protected list is full.
+	// <bytes> is the memory used by the cache entries in use, it is
+	// kept below <bytes-limit> if set (--cache-bytes)
 }
 
 void FTL_forwarding_retried(const struct server *serv, const int oldID, const int newID, const bool dnssec)
 {
 	// Forwarding to upstream server failed
+	upstream_failed(serv);
 
 	if(oldID == newID)
 	{
-		if(config.debug & DEBUG_QUERIES)
+		if(debug_enabled(DEBUG_QUERIES))
 			logg("%d: Ignoring self-retry", oldID);
 		return;
 	}
@@ -2988,14 +3302,15 @@ void FTL_forwarding_retried(const struct server *serv, const int oldID, const in
 	}
 
 	// Convert upstream to lower case
-	char *upstreamIP = strdup(dest);
+	const size_t mark = arena_mark();
+	char *upstreamIP = arena_strdup(dest);
 	strtolower(upstreamIP);
 
 	// Get upstream ID
 	const int upstreamID = findUpstreamID(upstreamIP, upstreamPort);
 
 	// Possible debugging information
-	if(config.debug & DEBUG_QUERIES)
+	if(debug_enabled(DEBUG_QUERIES))
 	{
 		logg("**** RETRIED%s query %i as %i to %s#%d",
 		     dnssec ? " DNSSEC" : "", oldID, newID,
@@ -3013,6 +3328,7 @@ void FTL_forwarding_retried(const struct server *serv, const int oldID, const in
 	// Retried DNSSEC queries are ignored, we have to flag themselves (newID)
 	// Retried normal queries take over, we have to flag the original query (oldID)
 	const int queryID = findQueryID(dnssec ? newID : oldID);
+	flight_stage(queryID, FLIGHT_RETRIED);
 	if(queryID >= 0)
 	{
 		// Get query pointer
@@ -3040,7 +3356,7 @@ void FTL_forwarding_retried(const struct server *serv, const int oldID, const in
 	}
 
 	// Clean up and unlock shared memory
-	free(upstreamIP);
+	arena_release(mark);
 	unlock_shm();
 	return;
 }
@@ -3052,56 +3368,6 @@ static unsigned long __attribute__((const)) converttimeval(const struct timeval
 	return time.tv_sec*10000 + time.tv_usec/100;
 }
 
-unsigned int FTL_extract_question_flags(struct dns_header *header, const size_t qlen)
-{
-	// Create working pointer
-	unsigned char *p = (unsigned char *)(header+1);
-	uint16_t qtype, qclass;
-
-	// Go through the questions
-	for (uint16_t i = ntohs(header->qdcount); i != 0; i--)
-	{
-		// Prime dnsmasq flags
-		int flags = RCODE(header) == NXDOMAIN ? F_NXDOMAIN : 0;
-
-		// Extract name from this question
-		char name[MAXDNAME];
-		if (!extract_name(header, qlen, &p, name, 1, 4))
-			break; // bad packet, go to fallback solution
-
-		// Extract query type
-		GETSHORT(qtype, p);
-		GETSHORT(qclass, p);
-
-		// Only further analyze IN questions here (not CHAOS, etc.)
-		if (qclass != C_IN)
-			continue;
-
-		// Very simple decision: If the question is AAAA, the reply
-		// should be IPv6. We use IPv4 in all other cases
-		if(qtype == T_AAAA)
-			flags |= F_IPV6;
-		else
-			flags |= F_IPV4;
-
-		// Debug logging if enabled
-		if(config.debug & DEBUG_QUERIES)
-		{
-			char *qtype_str = querystr(NULL, qtype);
-			logg("CNAME header: Question was <IN> %s %s", qtype_str, name);
-		}
-
-		return flags;
-	}
-
-	// Fall back to IPv4 (type A) when for the unlikely event that we cannot
-	// find any questions in this header
-	if(config.debug & DEBUG_QUERIES)
-		logg("CNAME header: No valid IN question found in header");
-
-	return F_IPV4;
-}
-
 // Called when a (forked) TCP worker is terminated by receiving SIGALRM
 // We close the dedicated database connection this client had opened
 // to avoid dangling database locks
@@ -3142,6 +3408,9 @@ void FTL_TCP_worker_terminating(bool finished)
 	// Close dedicated database connections of this fork
 	gravityDB_close();
 	unlock_shm();
+
+	// Write slow queries of this fork to the log file
+	flight_flush();
 }
 
 // Called when a (forked) TCP worker is created
@@ -3206,6 +3475,12 @@ void FTL_TCP_worker_created(const int confd)
 	if(config.debug != 0)
 		logg("Reopening Gravity database for this fork");
 	gravityDB_forked();
+
+	// Locks held by other threads of the main process are never released
+	// in this fork
+	DB_profiler_forked();
+	flight_forked();
+	network_cache_forked();
 }
 
 bool FTL_unlink_DHCP_lease(const char *ipaddr)
@@ -3275,7 +3550,7 @@ void FTL_query_in_progress(const int id)
 	}
 
 	// Debug logging
-	if(config.debug & DEBUG_QUERIES)
+	if(debug_enabled(DEBUG_QUERIES))
 	{
 		// Get domain pointer
 		const domainsData* domain = getDomain(query->domainID, true);
@@ -3344,7 +3619,7 @@ void FTL_multiple_replies(const int id, int *firstID)
 	}
 
 	// Debug logging
-	if(config.debug & DEBUG_QUERIES)
+	if(debug_enabled(DEBUG_QUERIES))
 	{
 		logg("**** sending reply %d also to %d", *firstID, queryID);
 	}
@@ -3354,6 +3629,7 @@ void FTL_multiple_replies(const int id, int *firstID)
 	duplicated_query->dnssec = source_query->dnssec;
 	duplicated_query->flags.complete = true;
 	duplicated_query->CNAME_domainID = source_query->CNAME_domainID;
+	flight_complete(queryID);
 
 	// The original query may have been blocked during CNAME inspection,
 	// correct status in this case
@@ -3375,7 +3651,7 @@ static void _query_set_dnssec(queriesData *query, const enum dnssec_status dnsse
 	if(!option_bool(OPT_DNSSEC_VALID) && !option_bool(OPT_DNSSEC_PROXY))
 		return;
 
-	if(config.debug & DEBUG_DNSSEC)
+	if(debug_enabled(DEBUG_DNSSEC))
 	{
 		const char *status = "unknown";
 		switch(dnssec)
@@ -3410,16 +3686,16 @@ static void _query_set_dnssec(queriesData *query, const enum dnssec_status dnsse
 int check_struct_sizes(void)
 {
 	int result = 0;
-	result += check_one_struct("ConfigStruct", sizeof(ConfigStruct), 112, 104);
+	result += check_one_struct("ConfigStruct", sizeof(ConfigStruct), 144, 136);
 	result += check_one_struct("queriesData", sizeof(queriesData), 56, 44);
 	result += check_one_struct("upstreamsData", sizeof(upstreamsData), 616, 604);
 	result += check_one_struct("clientsData", sizeof(clientsData), 672, 648);
 	result += check_one_struct("domainsData", sizeof(domainsData), 24, 20);
 	result += check_one_struct("DNSCacheData", sizeof(DNSCacheData), 16, 16);
-	result += check_one_struct("ednsData", sizeof(ednsData), 76, 76);
+	result += check_one_struct("packet_meta", sizeof(struct packet_meta), 96, 96);
 	result += check_one_struct("overTimeData", sizeof(overTimeData), 32, 24);
 	result += check_one_struct("regexData", sizeof(regexData), 64, 48);
-	result += check_one_struct("SharedMemory", sizeof(SharedMemory), 24, 12);
+	result += check_one_struct("SharedMemory", sizeof(SharedMemory), 40, 20);
 	result += check_one_struct("ShmSettings", sizeof(ShmSettings), 16, 16);
 	result += check_one_struct("countersStruct", sizeof(countersStruct), 248, 248);
 	result += check_one_struct("sqlite3_stmt_vec", sizeof(sqlite3_stmt_vec), 32, 16);
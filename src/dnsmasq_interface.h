@@ -23,11 +23,11 @@ void FTL_hook(unsigned int flags, const char *name, union all_addr *addr, char *
 #define FTL_iface(iface, addr, addrfamily) _FTL_iface(iface, addr, addrfamily, __FILE__, __LINE__)
 void _FTL_iface(struct irec *recviface, const union all_addr *addr, const sa_family_t addrfamily, const char* file, const int line);
 
-#define FTL_new_query(flags, name, addr, arg, qtype, id, proto) _FTL_new_query(flags, name, addr, arg, qtype, id, proto, __FILE__, __LINE__)
-bool _FTL_new_query(const unsigned int flags, const char *name, union mysockaddr *addr, char *arg, const unsigned short qtype, const int id, enum protocol proto, const char* file, const int line);
+#define FTL_new_query(flags, name, addr, arg, qtype, id, proto, meta) _FTL_new_query(flags, name, addr, arg, qtype, id, proto, meta, __FILE__, __LINE__)
+bool _FTL_new_query(const unsigned int flags, const char *name, union mysockaddr *addr, char *arg, const unsigned short qtype, const int id, enum protocol proto, const struct packet_meta *meta, const char* file, const int line);
 
-#define FTL_header_analysis(header4, rcode, server, id) _FTL_header_analysis(header4, rcode, server, id, __FILE__, __LINE__)
-void _FTL_header_analysis(const unsigned char header4, const unsigned int rcode, const struct server *server, const int id, const char* file, const int line);
+#define FTL_header_analysis(meta, server, id) _FTL_header_analysis(meta, server, id, __FILE__, __LINE__)
+void _FTL_header_analysis(const struct packet_meta *meta, const struct server *server, const int id, const char* file, const int line);
 
 void FTL_forwarding_retried(const struct server *server, const int oldID, const int newID, const bool dnssec);
 
@@ -37,11 +37,11 @@ size_t _FTL_make_answer(struct dns_header *header, char *limit, const size_t len
 #define FTL_CNAME(dst, src, id) _FTL_CNAME(dst, src, id, __FILE__, __LINE__)
 bool _FTL_CNAME(const char *dst, const char *src, const int id, const char* file, const int line);
 
-unsigned int FTL_extract_question_flags(struct dns_header *header, const size_t qlen);
 void FTL_query_in_progress(const int id);
 void FTL_multiple_replies(const int id, int *firstID);
 
 void FTL_dnsmasq_reload(void);
+void FTL_interfaces_enumerated(void);
 void FTL_fork_and_bind_sockets(struct passwd *ent_pw);
 void FTL_TCP_worker_created(const int confd);
 void FTL_TCP_worker_terminating(bool finished);
@@ -41,34 +41,10 @@
 // dnsmasq option: --add-cpe-id=...
 #define EDNS0_CPE_ID EDNS0_OPTION_NOMCPEID
 
-static ednsData edns = { 0 };
-
-ednsData *getEDNS(void)
-{
-	if(edns.valid)
-	{
-		// Return pointer to ednsData structure and reset it for the
-		// next query
-		edns.valid = false;
-		return &edns;
-	}
-
-	// No valid EDNS data available
-	return NULL;
-}
-
-void FTL_parse_pseudoheaders(unsigned char *pheader, const size_t plen)
+static void parse_pseudoheader(unsigned char *pheader, const size_t plen, struct packet_meta *meta)
 {
-	// Return early if we have no pseudoheader (a.k.a. additional records)
-	if (!pheader)
-	{
-		if(config.debug & DEBUG_EDNS0)
-			logg("EDNS(0) pheader is NULL");
-		return;
-	}
-
 	// Debug logging
-	if(config.debug & DEBUG_EDNS0)
+	if(debug_enabled(DEBUG_EDNS0))
 		for(unsigned int i = 0; i < plen; i++)
 			logg("EDNS(0) pheader[%i] = 0x%02x", i, pheader[i]);
 
@@ -101,12 +77,15 @@ void FTL_parse_pseudoheaders(unsigned char *pheader, const size_t plen)
 //        | CLASS      | u_int16_t    | requestor's UDP payload size |
 	unsigned short class;
 	GETSHORT(class, p);
-	if(config.debug & DEBUG_EDNS0)
+	if(debug_enabled(DEBUG_EDNS0))
 		logg("EDNS(0) requestor's UDP payload size: %u bytes", class);
 //        +------------+--------------+------------------------------+
 //        | TTL        | u_int32_t    | extended RCODE and flags     |
 	unsigned long ttl;
 	GETLONG(ttl, p);
+	meta->udp_size = class;
+	meta->rcode |= (ttl >> 24) << 4;
+	meta->do_bit = (ttl & 0x8000) != 0;
 //        +------------+--------------+------------------------------+
 //        | RDLEN      | u_int16_t    | length of all RDATA          |
 	unsigned short rdlen;
@@ -168,10 +147,7 @@ void FTL_parse_pseudoheaders(unsigned char *pheader, const size_t plen)
 	if(edns0_version != 0x00)
 		return;
 
-	// Reset EDNS(0) data
-	memset(&edns, 0, sizeof(ednsData));
-	edns.ede = EDE_UNSET;
-	edns.valid = true;
+	meta->edns = true;
 
 	size_t offset; // The header is 11 bytes before the beginning of OPTION-DATA
 	while ((offset = (p - pheader - 11u)) < rdlen && rdlen < UINT16_MAX)
@@ -184,13 +160,13 @@ void FTL_parse_pseudoheaders(unsigned char *pheader, const size_t plen)
 		// Avoid buffer overflow due to an malicious packet
 		if(offset + optlen > rdlen)
 		{
-			if(config.debug & DEBUG_EDNS0)
+			if(debug_enabled(DEBUG_EDNS0))
 				logg("Found malicious EDNS payload, skipping record.");
 			break;
 		}
 
 		// Debug logging
-		if(config.debug & DEBUG_EDNS0)
+		if(debug_enabled(DEBUG_EDNS0))
 			logg("EDNS(0) code %u, optlen %u (bytes %zu - %zu of %u)",
 			     code, optlen, offset, offset + optlen, rdlen);
 
@@ -227,7 +203,10 @@ void FTL_parse_pseudoheaders(unsigned char *pheader, const size_t plen)
 			else if(family == 2 && addrlen <= sizeof(addr.addr6.s6_addr)) // IPv6
 				memcpy(addr.addr6.s6_addr, p, addrlen);
 			else
+			{
+				p += optlen - 4;
 				continue;
+			}
 
 			// Advance working pointer (we already walked 4 bytes above)
 			p += optlen - 4;
@@ -239,29 +218,29 @@ void FTL_parse_pseudoheaders(unsigned char *pheader, const size_t plen)
 			if(!(family == 1 && source_netmask == 32) &&
 			   !(family == 2 && source_netmask == 128))
 			{
-				if(config.debug & DEBUG_EDNS0)
+				if(debug_enabled(DEBUG_EDNS0))
 					logg("EDNS(0) CLIENT SUBNET: %s/%u found (IPv%u)",
 					     ipaddr, source_netmask, family == 1 ? 4 : 6);
 				continue;
 			}
 
-			// Copy data to edns struct
-			strncpy(edns.client, ipaddr, ADDRSTRLEN);
-			edns.client[ADDRSTRLEN-1] = '\0';
+			// Copy data to packet metadata
+			strncpy(meta->client, ipaddr, ADDRSTRLEN);
+			meta->client[ADDRSTRLEN-1] = '\0';
 
 			// Only set the address as useful when it is not the
 			// loopback address of the distant machine (127.0.0.0/8 or ::1)
 			if((family == 1 && (ntohl(addr.addr4.s_addr) & 0xFF000000) == 0x7F000000) ||
 			   (family == 2 && IN6_IS_ADDR_LOOPBACK(&addr.addr6)))
 			{
-				if(config.debug & DEBUG_EDNS0)
+				if(debug_enabled(DEBUG_EDNS0))
 					logg("EDNS(0) CLIENT SUBNET: Skipped %s/%u (IPv%u loopback address)",
 					     ipaddr, source_netmask, family == 1 ? 4 : 6);
 			}
 			else
 			{
-				edns.client_set = true;
-				if(config.debug & DEBUG_EDNS0)
+				meta->client_set = true;
+				if(debug_enabled(DEBUG_EDNS0))
 					logg("EDNS(0) CLIENT SUBNET: %s/%u - OK (IPv%u)",
 					     ipaddr, source_netmask, family == 1 ? 4 : 6);
 			}
@@ -271,7 +250,7 @@ void FTL_parse_pseudoheaders(unsigned char *pheader, const size_t plen)
 			// EDNS(0) COOKIE client
 			unsigned char client_cookie[8];
 			memcpy(client_cookie, p, 8);
-			if(config.debug & DEBUG_EDNS0)
+			if(debug_enabled(DEBUG_EDNS0))
 			{
 				char pretty_client_cookie[8*2 + 1]; // client: fixed length
 				char *pp = pretty_client_cookie;
@@ -293,7 +272,7 @@ void FTL_parse_pseudoheaders(unsigned char *pheader, const size_t plen)
 			unsigned short server_cookie_len = optlen - 8;
 			unsigned char server_cookie[server_cookie_len];
 			memcpy(server_cookie, p + 8u, server_cookie_len);
-			if(config.debug & DEBUG_EDNS0)
+			if(debug_enabled(DEBUG_EDNS0))
 			{
 				char pretty_client_cookie[8*2 + 1]; // client: fixed length
 				char *pp = pretty_client_cookie;
@@ -313,11 +292,11 @@ void FTL_parse_pseudoheaders(unsigned char *pheader, const size_t plen)
 		else if(code == EDNS0_MAC_ADDR_BYTE && optlen == 6)
 		{
 			// EDNS(0) MAC address (BYTE format)
-			memcpy(edns.mac_byte, p, sizeof(edns.mac_byte));
-			print_mac(edns.mac_text, (unsigned char*)edns.mac_byte, sizeof(edns.mac_byte));
-			edns.mac_set = true;
-			if(config.debug & DEBUG_EDNS0)
-				logg("EDNS(0) MAC address (BYTE format): %s", edns.mac_text);
+			memcpy(meta->mac_byte, p, sizeof(meta->mac_byte));
+			print_mac(meta->mac_text, (unsigned char*)meta->mac_byte, sizeof(meta->mac_byte));
+			meta->mac_set = true;
+			if(debug_enabled(DEBUG_EDNS0))
+				logg("EDNS(0) MAC address (BYTE format): %s", meta->mac_text);
 
 			// Advance working pointer
 			p += 6;
@@ -325,21 +304,21 @@ void FTL_parse_pseudoheaders(unsigned char *pheader, const size_t plen)
 		else if(code == EDNS0_MAC_ADDR_TEXT && optlen == 17)
 		{
 			// EDNS(0) MAC address (TEXT format)
-			memcpy(edns.mac_text, p, 17);
-			edns.mac_text[17] = '\0';
-			if(sscanf(edns.mac_text, "%hhx:%hhx:%hhx:%hhx:%hhx:%hhx",
-			          (unsigned char*)&edns.mac_byte[0],
-			          (unsigned char*)&edns.mac_byte[1],
-			          (unsigned char*)&edns.mac_byte[2],
-			          (unsigned char*)&edns.mac_byte[3],
-			          (unsigned char*)&edns.mac_byte[4],
-			          (unsigned char*)&edns.mac_byte[5]) == 6)
+			memcpy(meta->mac_text, p, 17);
+			meta->mac_text[17] = '\0';
+			if(sscanf(meta->mac_text, "%hhx:%hhx:%hhx:%hhx:%hhx:%hhx",
+			          (unsigned char*)&meta->mac_byte[0],
+			          (unsigned char*)&meta->mac_byte[1],
+			          (unsigned char*)&meta->mac_byte[2],
+			          (unsigned char*)&meta->mac_byte[3],
+			          (unsigned char*)&meta->mac_byte[4],
+			          (unsigned char*)&meta->mac_byte[5]) == 6)
 			{
-				edns.mac_set = true;
-				if(config.debug & DEBUG_EDNS0)
-					logg("EDNS(0) MAC address (TEXT format): %s", edns.mac_text);
+				meta->mac_set = true;
+				if(debug_enabled(DEBUG_EDNS0))
+					logg("EDNS(0) MAC address (TEXT format): %s", meta->mac_text);
 			}
-			else if(config.debug & DEBUG_EDNS0)
+			else if(debug_enabled(DEBUG_EDNS0))
 			{
 				logg("         Received MAC address has invalid format!");
 			}
@@ -350,7 +329,7 @@ void FTL_parse_pseudoheaders(unsigned char *pheader, const size_t plen)
 		else if(code == EDNS0_MAC_ADDR_BASE64 && optlen == 8)
 		{
 			// EDNS(0) MAC address (BASE format)
-			if(config.debug & DEBUG_EDNS0)
+			if(debug_enabled(DEBUG_EDNS0))
 				logg("EDNS(0) MAC address (BASE64 format): NOT IMPLEMENTED");
 
 			// Advance working pointer
@@ -362,7 +341,7 @@ void FTL_parse_pseudoheaders(unsigned char *pheader, const size_t plen)
 			unsigned char payload[optlen + 1u]; // variable length
 			memcpy(payload, p, optlen);
 			payload[optlen] = '\0';
-			if(config.debug & DEBUG_EDNS0)
+			if(debug_enabled(DEBUG_EDNS0))
 			{
 				char pretty_payload[optlen*5 + 1u];
 				char *pp = pretty_payload;
@@ -389,7 +368,7 @@ void FTL_parse_pseudoheaders(unsigned char *pheader, const size_t plen)
 			//   2: |                           OPTION-LENGTH                       |
 			//      +---+---+---+---+---+---+---+---+---+---+---+---+---+---+---+---+
 			//   4: | INFO-CODE                                                     |
-			edns.ede = ntohs(((int)p[1] << 8) | p[0]);
+			meta->ede = ntohs(((int)p[1] << 8) | p[0]);
 			//      +---+---+---+---+---+---+---+---+---+---+---+---+---+---+---+---+
 			//   6: / EXTRA-TEXT ...                                                /
 			//      +---+---+---+---+---+---+---+---+---+---+---+---+---+---+---+---+
@@ -405,15 +384,15 @@ void FTL_parse_pseudoheaders(unsigned char *pheader, const size_t plen)
 			// FTL
 
 			// Debug output
-			if(config.debug & DEBUG_EDNS0)
-				logg("EDNS(0) EDE: %s (code %d)", edestr(edns.ede), edns.ede);
+			if(debug_enabled(DEBUG_EDNS0))
+				logg("EDNS(0) EDE: %s (code %d)", edestr(meta->ede), meta->ede);
 
 			// Advance working pointer
 			p += optlen;
 		}
 		else
 		{
-			if(config.debug & DEBUG_EDNS0)
+			if(debug_enabled(DEBUG_EDNS0))
 				logg("EDNS(0): option %u with length %u", code, optlen);
 			// Not implemented, skip this record
 
@@ -421,4 +400,51 @@ void FTL_parse_pseudoheaders(unsigned char *pheader, const size_t plen)
 			p += optlen;
 		}
 	}
-}
\ No newline at end of file
+}
+
+// Extract the metadata FTL needs from a DNS packet: header flags, the first
+// question and the EDNS(0) pseudo-header (if any)
+void FTL_packet_meta(struct dns_header *header, const size_t plen, struct packet_meta *meta)
+{
+	memset(meta, 0, sizeof(*meta));
+	meta->ede = EDE_UNSET;
+	if(plen < sizeof(struct dns_header))
+		return;
+
+	meta->hb3 = header->hb3;
+	meta->hb4 = header->hb4;
+	meta->rcode = RCODE(header);
+	meta->qdcount = ntohs(header->qdcount);
+
+	// Walk the name of the first question. Names in the question section
+	// may be compressed in replies, in which case the name ends with a
+	// pointer
+	unsigned char *p = (unsigned char *)(header+1);
+	unsigned char *end = (unsigned char *)header + plen;
+	if(meta->qdcount > 0)
+	{
+		while(p < end && *p != 0 && (*p & 0xC0) == 0)
+			p += *p + 1;
+		if(p < end && *p == 0)
+			p++;
+		else if(p + 1 < end && (*p & 0xC0) == 0xC0)
+			p += 2;
+		else
+			p = end;
+
+		if(p + 4 <= end)
+		{
+			meta->qname_len = p - (unsigned char *)(header+1);
+			GETSHORT(meta->qtype, p);
+			GETSHORT(meta->qclass, p);
+		}
+	}
+
+	// Interpret the pseudo-header
+	size_t optlen = 0;
+	unsigned char *pheader = find_pseudoheader(header, plen, &optlen, NULL, NULL, NULL);
+	if(pheader != NULL)
+		parse_pseudoheader(pheader, optlen, meta);
+	else if(debug_enabled(DEBUG_EDNS0))
+		logg("EDNS(0) pheader is NULL");
+}
@@ -3,24 +3,37 @@
 *  Network-wide ad blocking via your own hardware.
 *
 *  FTL Engine
-*  EDNS0 parsing prototypes
+*  EDNS0 and packet metadata parsing prototypes
 *
 *  This file is copyright under the latest version of the EUPL.
 *  Please see LICENSE file for your rights under this license. */
 #ifndef EDNS0_HEADER
 #define EDNS0_HEADER
 
-typedef struct {
+// Metadata of a DNS packet. It is extracted once when the packet is received
+// and handed to the FTL hooks so they do not have to parse the packet again
+struct packet_meta {
+	bool edns :1;
 	bool client_set :1;
 	bool mac_set :1;
-	bool valid :1;
+	bool do_bit :1;
+	unsigned char hb3;
+	unsigned char hb4;
+	unsigned short qdcount;
+	// Question (first one only)
+	unsigned short qtype;
+	unsigned short qclass;
+	unsigned short qname_len;
+	// EDNS(0) pseudo-header
+	unsigned short udp_size;
+	unsigned int rcode;
 	char client[ADDRSTRLEN];
 	char mac_byte[6];
 	char mac_text[18];
 	int ede;
-} ednsData;
+};
 
-ednsData *getEDNS(void);
-void FTL_parse_pseudoheaders(unsigned char *pheader, const size_t plen);
+struct dns_header;
+void FTL_packet_meta(struct dns_header *header, const size_t plen, struct packet_meta *meta);
 
 #endif // EDNS0_HEADER
@@ -163,6 +163,7 @@ enum events {
 	REIMPORT_ALIASCLIENTS,
 	PARSE_NEIGHBOR_CACHE,
 	RELOAD_BLOCKINGSTATUS,
+	DUMP_ALLOC_PROFILE,
 	EVENTS_MAX
 } __attribute__ ((packed));
 
@@ -190,6 +191,7 @@ enum thread_types {
 	DB,
 	GC,
 	DNSclient,
+	TCPpool,
 	THREADS_MAX
 } __attribute__ ((packed));
 
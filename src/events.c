@@ -37,7 +37,7 @@ void _set_event(const enum events event, int line, const char *function, const c
 		is_set = true;
 
 	// Possible debug logging
-	if(config.debug & DEBUG_EVENTS)
+	if(debug_enabled(DEBUG_EVENTS))
 	{
 		logg("Event %s -> %s    called from %s() (%s:%i)",
 		     eventtext(event),
@@ -68,7 +68,7 @@ bool _get_and_clear_event(const enum events event, int line, const char *functio
 		is_set = true;
 
 	// Possible debug logging only for SET status, to avoid log file flooding with NOT SET messages
-	if(is_set && config.debug & DEBUG_EVENTS)
+	if(is_set && debug_enabled(DEBUG_EVENTS))
 	{
 		logg("Event %s -> was SET, now CLEARED    called from %s() (%s:%i)",
 		     eventtext(event), function, file, line);
@@ -102,6 +102,8 @@ static const char *eventtext(const enum events event)
 			return "RESOLVE_NEW_HOSTNAMES";
 		case RELOAD_BLOCKINGSTATUS:
 			return "RELOAD_BLOCKINGSTATUS";
+		case DUMP_ALLOC_PROFILE:
+			return "DUMP_ALLOC_PROFILE";
 		case EVENTS_MAX: // fall through
 		default:
 			return "UNKNOWN";
@@ -0,0 +1,345 @@
+/* Pi-hole: A black hole for Internet advertisements
+*  (c) 2023 Pi-hole, LLC (https://pi-hole.net)
+*  Network-wide ad blocking via your own hardware.
+*
+*  FTL Engine
+*  Query flight recorder
+*
+*  This file is copyright under the latest version of the EUPL.
+*  Please see LICENSE file for your rights under this license. */
+
+#include "FTL.h"
+#include "flight.h"
+// logg()
+#include "log.h"
+// struct config
+#include "config.h"
+// getQuery()
+#include "datastructure.h"
+// counters
+#include "shmem.h"
+// O_APPEND
+#include <fcntl.h>
+
+// The hooks in dnsmasq_interface.c record when each query reaches the stages
+// of its processing (shared memory lock acquired, blocking checks, forwarded,
+// retried, upstream reply, DNSSEC validation, reply sent). Records live in a
+// ring indexed by the FTL query ID. They are written only by the thread
+// running the resolver and only while it holds the shared memory lock anyway,
+// so recording a stage is a clock read and a store. Queries taking longer than
+// SLOW_QUERY_MS are promoted: they are kept in memory for the API
+// (>slow-queries) and queued for the slow query log. Queries which do not get
+// a reply are promoted once they exceed the threshold, either when their slot
+// is reused or by the periodic sweep of the GC thread. The queued lines are
+// written by the GC thread after it released the shared memory lock.
+//
+// TCP workers (forks) record into their own copy. Their slow queries go to
+// the log file only, they are written when the worker terminates
+
+struct flight_record {
+	// Query occupying this slot (query ID plus the number of queries
+	// removed by the garbage collector so far), -1 = none
+	long key;
+	bool promoted;
+	unsigned int retries;
+	struct timespec arrival;
+	unsigned int stage[FLIGHT_STAGES];
+};
+
+static struct flight_record ring[FLIGHT_SLOTS];
+static long id_offset = 0;
+static bool ring_initialized = false;
+
+// Time the last reply from upstream arrived
+static struct timespec upstream_reply = { 0 };
+
+// Promoted slow queries
+static struct slow_query slow[FLIGHT_SLOW_KEEP];
+static unsigned int slow_next = 0, num_slow = 0;
+// Number of slow queries promoted and written to the log file so far
+static unsigned long slow_promoted = 0, slow_logged = 0;
+static pthread_mutex_t slow_lock = PTHREAD_MUTEX_INITIALIZER;
+static int slow_fd = -1;
+static bool slow_fd_failed = false;
+
+static const char *stage_name[FLIGHT_STAGES] = {
+	"locked", "check-start", "check-end", "forwarded", "retried", "upstream", "dnssec", "complete"
+};
+
+static unsigned int usec_since(const struct timespec *start, const struct timespec *now)
+{
+	const long long usec = (long long)(now->tv_sec - start->tv_sec) * 1000000 +
+	                       (now->tv_nsec - start->tv_nsec) / 1000;
+	if(usec < 0)
+		return 0;
+	if(usec >= FLIGHT_NONE)
+		return FLIGHT_NONE - 1;
+	return usec;
+}
+
+// Get the record of this query, NULL if it has been overwritten in the
+// meantime or the recorder is disabled
+static struct flight_record *get_record(const int queryID)
+{
+	if(config.slow_query_ms == 0 || !ring_initialized || queryID < 0)
+		return NULL;
+
+	const long key = queryID + id_offset;
+	struct flight_record *record = &ring[key & (FLIGHT_SLOTS - 1)];
+	return record->key == key ? record : NULL;
+}
+
+// Promote a slow query: keep it for the API and queue it for the log file.
+// elapsed is the time between arrival and reply (or now if there was no
+// reply) [microseconds]
+static void promote(struct flight_record *record, const int queryID, const unsigned int elapsed)
+{
+	const queriesData *query = getQuery(queryID, true);
+	if(query == NULL)
+		return;
+	record->promoted = true;
+
+	struct slow_query new = { 0 };
+	new.queryID = queryID;
+	new.timestamp = query->timestamp;
+	new.retries = record->retries;
+	new.elapsed = elapsed;
+	memcpy(new.stage, record->stage, sizeof(new.stage));
+	new.type = query->type < TYPE_MAX ? querytypes[query->type] : "?";
+	new.status = query_status_str(query->status);
+	new.reply = get_query_reply_str(query->reply);
+	strncpy(new.domain, getDomainString(query), sizeof(new.domain) - 1);
+	strncpy(new.client, getClientIPString(query), sizeof(new.client) - 1);
+	const upstreamsData *upstream = getUpstream(query->upstreamID, true);
+	if(upstream != NULL)
+	{
+		strncpy(new.upstream, getstr(upstream->ippos), sizeof(new.upstream) - 1);
+		new.port = upstream->port;
+	}
+
+	pthread_mutex_lock(&slow_lock);
+	slow[slow_next] = new;
+	slow_next = (slow_next + 1) % FLIGHT_SLOW_KEEP;
+	if(num_slow < FLIGHT_SLOW_KEEP)
+		num_slow++;
+	slow_promoted++;
+	pthread_mutex_unlock(&slow_lock);
+}
+
+// Promote the query in this slot if it has not been answered (yet) but is
+// already slow. A reply arriving later is not recorded
+static void promote_unanswered(struct flight_record *record, const struct timespec *now)
+{
+	if(record->key < 0 || record->promoted || record->stage[FLIGHT_COMPLETE] != FLIGHT_NONE)
+		return;
+
+	const unsigned int elapsed = usec_since(&record->arrival, now);
+	if(elapsed < 1000u*config.slow_query_ms)
+		return;
+
+	// Skip queries which have been removed by the garbage collector
+	const long queryID = record->key - id_offset;
+	if(queryID < 0 || queryID >= counters->queries)
+		return;
+
+	promote(record, (int)queryID, elapsed);
+}
+
+// Start recording a new query. This is called once the shared memory lock
+// has been acquired, the time it took to get it is recorded as first stage
+void flight_new(const int queryID, const struct timespec *arrival)
+{
+	if(config.slow_query_ms == 0 || queryID < 0)
+		return;
+
+	if(!ring_initialized)
+	{
+		for(unsigned int i = 0; i < FLIGHT_SLOTS; i++)
+			ring[i].key = -1;
+		ring_initialized = true;
+	}
+
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+
+	// The query previously occupying this slot may never have been answered
+	const long key = queryID + id_offset;
+	struct flight_record *record = &ring[key & (FLIGHT_SLOTS - 1)];
+	promote_unanswered(record, &now);
+
+	record->key = key;
+	record->promoted = false;
+	record->retries = 0;
+	record->arrival = *arrival;
+	for(unsigned int i = 0; i < FLIGHT_STAGES; i++)
+		record->stage[i] = FLIGHT_NONE;
+	record->stage[FLIGHT_LOCKED] = usec_since(arrival, &now);
+}
+
+// Record that a query reached a stage. Retries are counted and the time of
+// the last one is kept, all other stages keep the time they were first
+// reached. FLIGHT_UPSTREAM uses the time the last upstream reply arrived
+void flight_stage(const int queryID, const enum flight_stage stage)
+{
+	struct flight_record *record = get_record(queryID);
+	if(record == NULL)
+		return;
+
+	if(stage == FLIGHT_RETRIED)
+		record->retries++;
+	else if(record->stage[stage] != FLIGHT_NONE)
+		return;
+
+	struct timespec now;
+	if(stage == FLIGHT_UPSTREAM && upstream_reply.tv_sec != 0)
+		now = upstream_reply;
+	else
+		clock_gettime(CLOCK_MONOTONIC, &now);
+	record->stage[stage] = usec_since(&record->arrival, &now);
+}
+
+// A reply from upstream arrived. dnsmasq may validate it (and ask further
+// queries) before the reply hook of the query is called
+void flight_upstream_reply(void)
+{
+	if(config.slow_query_ms > 0)
+		clock_gettime(CLOCK_MONOTONIC, &upstream_reply);
+}
+
+// The garbage collector removed the oldest queries, the IDs of the queries in
+// flight went down by this amount
+void flight_gc(const int removed)
+{
+	id_offset += removed;
+}
+
+void format_slow_query(char *buffer, const size_t size, const struct slow_query *query)
+{
+	char timestr[84] = { 0 };
+	get_timestr(timestr, query->timestamp, false);
+
+	int len = snprintf(buffer, size, "%s %s %s from %s (ID %i): %.1f ms, %s, %s",
+	                   timestr, query->type, query->domain, query->client, query->queryID,
+	                   1e-3*query->elapsed, query->status, query->reply);
+	if(query->upstream[0] != '\0' && len >= 0 && (size_t)len < size)
+		len += snprintf(buffer + len, size - len, " from %s#%u", query->upstream, query->port);
+	if(query->stage[FLIGHT_COMPLETE] == FLIGHT_NONE && len >= 0 && (size_t)len < size)
+		len += snprintf(buffer + len, size - len, ", no reply");
+	if(query->retries > 0 && len >= 0 && (size_t)len < size)
+		len += snprintf(buffer + len, size - len, ", %u retr%s", query->retries,
+		                query->retries > 1 ? "ies" : "y");
+
+	for(unsigned int i = 0; i < FLIGHT_STAGES && len >= 0 && (size_t)len < size; i++)
+	{
+		if(query->stage[i] == FLIGHT_NONE)
+			len += snprintf(buffer + len, size - len, " %s -", stage_name[i]);
+		else
+			len += snprintf(buffer + len, size - len, " %s %.1f", stage_name[i], 1e-3*query->stage[i]);
+	}
+}
+
+// The reply to this query has been sent. Promote the query if it was slow
+void flight_complete(const int queryID)
+{
+	struct flight_record *record = get_record(queryID);
+	if(record == NULL || record->promoted)
+		return;
+
+	flight_stage(queryID, FLIGHT_COMPLETE);
+	if(record->stage[FLIGHT_COMPLETE] < 1000u*config.slow_query_ms)
+		return;
+
+	promote(record, queryID, record->stage[FLIGHT_COMPLETE]);
+}
+
+// Promote queries which are still waiting for a reply but are already slow.
+// This has to be called while holding the shared memory lock
+void flight_sweep(void)
+{
+	if(config.slow_query_ms == 0 || !ring_initialized)
+		return;
+
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	for(unsigned int i = 0; i < FLIGHT_SLOTS; i++)
+		promote_unanswered(&ring[i], &now);
+}
+
+static void write_slow_query(const struct slow_query *query)
+{
+	if(slow_fd < 0 && !slow_fd_failed)
+	{
+		slow_fd = open(FTLfiles.slowquerylog, O_WRONLY | O_APPEND | O_CREAT | O_CLOEXEC, 0644);
+		if(slow_fd < 0)
+		{
+			slow_fd_failed = true;
+			logg("WARNING: Cannot open slow query log %s: %s",
+			     FTLfiles.slowquerylog, strerror(errno));
+			return;
+		}
+	}
+	if(slow_fd < 0)
+		return;
+
+	// One write() per line so lines of TCP workers do not interleave
+	char line[1024];
+	format_slow_query(line, sizeof(line) - 1, query);
+	size_t len = strlen(line);
+	line[len++] = '\n';
+	if(write(slow_fd, line, len) < 0 && debug_enabled(DEBUG_QUERIES))
+		logg("Cannot write to slow query log: %s", strerror(errno));
+}
+
+// Write the slow queries promoted since the last call to the log file. This
+// must not be called while holding the shared memory lock
+void flight_flush(void)
+{
+	struct slow_query *queued = NULL;
+	unsigned int n = 0;
+
+	pthread_mutex_lock(&slow_lock);
+	unsigned long pending = slow_promoted - slow_logged;
+	if(pending > FLIGHT_SLOW_KEEP)
+	{
+		// Older entries have been overwritten in the meantime
+		logg("WARNING: %lu slow queries have not been written to %s",
+		     pending - FLIGHT_SLOW_KEEP, FTLfiles.slowquerylog);
+		pending = FLIGHT_SLOW_KEEP;
+	}
+	if(pending > 0 && (queued = calloc(pending, sizeof(struct slow_query))) != NULL)
+	{
+		// Oldest first
+		for(; n < pending; n++)
+			queued[n] = slow[(slow_next + FLIGHT_SLOW_KEEP - pending + n) % FLIGHT_SLOW_KEEP];
+	}
+	slow_logged = slow_promoted;
+	pthread_mutex_unlock(&slow_lock);
+
+	if(queued == NULL)
+		return;
+
+	for(unsigned int i = 0; i < n; i++)
+		write_slow_query(&queued[i]);
+	free(queued);
+}
+
+// A TCP worker inherits the slow queries of the main process which are still
+// queued, only the main process writes them. The lock may have been held by
+// another thread of the main process, this thread does not exist in the fork
+void flight_forked(void)
+{
+	pthread_mutex_init(&slow_lock, NULL);
+	slow_logged = slow_promoted;
+}
+
+// Copy the most recent slow queries into out (newest first)
+unsigned int get_slow_queries(struct slow_query *out, const unsigned int num)
+{
+	pthread_mutex_lock(&slow_lock);
+	unsigned int n = 0;
+	for(; n < num && n < num_slow; n++)
+		out[n] = slow[(slow_next + FLIGHT_SLOW_KEEP - 1 - n) % FLIGHT_SLOW_KEEP];
+	pthread_mutex_unlock(&slow_lock);
+
+	return n;
+}
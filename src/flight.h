@@ -0,0 +1,66 @@
+/* Pi-hole: A black hole for Internet advertisements
+*  (c) 2023 Pi-hole, LLC (https://pi-hole.net)
+*  Network-wide ad blocking via your own hardware.
+*
+*  FTL Engine
+*  Query flight recorder prototypes
+*
+*  This file is copyright under the latest version of the EUPL.
+*  Please see LICENSE file for your rights under this license. */
+#ifndef FLIGHT_H
+#define FLIGHT_H
+
+// UINT_MAX
+#include <limits.h>
+
+// How many queries can be in flight at the same time? Older queries are
+// overwritten by newer ones. This has to be a power of two
+#define FLIGHT_SLOTS 4096
+// How many slow queries do we keep for the API?
+#define FLIGHT_SLOW_KEEP 100
+// Stage has not been reached
+#define FLIGHT_NONE UINT_MAX
+
+// Stages of a query we record the time of. The query arrived at time zero
+enum flight_stage {
+	FLIGHT_LOCKED = 0,
+	FLIGHT_BLOCKING_START,
+	FLIGHT_BLOCKING_END,
+	FLIGHT_FORWARDED,
+	FLIGHT_RETRIED,
+	FLIGHT_UPSTREAM,
+	FLIGHT_DNSSEC,
+	FLIGHT_COMPLETE,
+	FLIGHT_STAGES
+};
+
+struct slow_query {
+	int queryID;
+	time_t timestamp;
+	in_port_t port;
+	unsigned int retries;
+	const char *type;
+	const char *status;
+	const char *reply;
+	char domain[256];
+	char client[INET6_ADDRSTRLEN+1];
+	char upstream[INET6_ADDRSTRLEN+1];
+	// Time until the reply was sent or, without reply, until the query was
+	// promoted [microseconds]
+	unsigned int elapsed;
+	// Time of each stage after the query arrived [microseconds]
+	unsigned int stage[FLIGHT_STAGES];
+};
+
+void flight_new(const int queryID, const struct timespec *arrival);
+void flight_stage(const int queryID, const enum flight_stage stage);
+void flight_upstream_reply(void);
+void flight_complete(const int queryID);
+void flight_sweep(void);
+void flight_flush(void);
+void flight_forked(void);
+void flight_gc(const int removed);
+unsigned int get_slow_queries(struct slow_query *out, const unsigned int num);
+void format_slow_query(char *buffer, const size_t size, const struct slow_query *slow);
+
+#endif //FLIGHT_H
@@ -26,11 +26,21 @@
 #include <sys/sysinfo.h>
 // get_filepath_usage()
 #include "files.h"
+// get_and_clear_event()
+#include "events.h"
+// api_cache_invalidate()
+#include "api/cache.h"
+// flight_gc(), flight_sweep(), flight_flush()
+#include "flight.h"
 
 // Resource checking interval
 // default: 300 seconds
 #define RCinterval 300
 
+// Number of call sites written into the log when the allocation profile is
+// requested by real-time signal 6
+#define ALLOC_PROFILE_LOG_SITES 50
+
 bool doGC = false;
 
 // Subtract rate-limitation count from individual client counters
@@ -142,6 +152,20 @@ void *GC_thread(void *val)
 		if(killed)
 			break;
 
+		// Record slow queries which are still waiting for a reply and
+		// write all slow queries to the log file after releasing the lock
+		if(config.slow_query_ms > 0)
+		{
+			lock_shm();
+			flight_sweep();
+			unlock_shm();
+			flight_flush();
+		}
+
+		// Write allocation profile into the log if requested
+		if(get_and_clear_event(DUMP_ALLOC_PROFILE))
+			log_alloc_profile(ALLOC_PROFILE_LOG_SITES);
+
 		// Check available resources
 		if(now - lastResourceCheck >= RCinterval)
 		{
@@ -168,7 +192,7 @@ void *GC_thread(void *val)
 			// oldest overTime interval after GC is done.
 			mintime -= mintime % GCinterval;
 
-			if(config.debug & DEBUG_GC)
+			if(debug_enabled(DEBUG_GC))
 			{
 				timer_start(GC_TIMER);
 				char timestring[84] = "";
@@ -277,6 +301,8 @@ void *GC_thread(void *val)
 				counters->queries -= removed;
 				// Update DB index as total number of queries reduced
 				lastdbindex -= removed;
+				// Queries in flight have new IDs now
+				flight_gc(removed);
 
 				// ensure remaining memory is zeroed out (marked as "F" in the above example)
 				queriesData *tail = getQuery(counters->queries, true);
@@ -287,12 +313,15 @@ void *GC_thread(void *val)
 			// Determine if overTime memory needs to get moved
 			moveOverTimeMemory(mintime);
 
-			if(config.debug & DEBUG_GC)
+			if(debug_enabled(DEBUG_GC))
 				logg("Notice: GC removed %i queries (took %.2f ms)", removed, timer_elapsed_msec(GC_TIMER));
 
 			// Release thread lock
 			unlock_shm();
 
+			// Cached API responses may contain removed queries
+			api_cache_invalidate();
+
 			// After storing data in the database for the next time,
 			// we should scan for old entries, which will then be deleted
 			// to free up pages in the database and prevent it from growing
@@ -155,7 +155,7 @@ void _FTL_log(const bool newline, const bool debug, const char *format, ...)
 void FTL_log_helper(const unsigned char n, ...)
 {
 	// Only log helper debug messages if enabled
-	if(!(config.debug & DEBUG_HELPER))
+	if(!debug_enabled(DEBUG_HELPER))
 		return;
 
 	// Extract all variable arguments
@@ -28,6 +28,8 @@
 #include "overTime.h"
 // flush_message_table()
 #include "database/message-table.h"
+// run_api_replica()
+#include "api/replica.h"
 
 char * username;
 bool needGC = false;
@@ -62,6 +64,11 @@ int main (int argc, char* argv[])
 	// We configure real-time signals later (after dnsmasq has forked)
 	handle_signals();
 
+	// Serve read-only API requests from the shared memory of the running
+	// FTL instance instead of starting the resolver
+	if(api_replica)
+		return run_api_replica();
+
 	// Initialize shared memory
 	if(!init_shmem())
 	{
@@ -103,7 +110,7 @@ int main (int argc, char* argv[])
 	check_setupVarsconf();
 
 	// Check for availability of capabilities in debug mode
-	if(config.debug & DEBUG_CAPS)
+	if(debug_enabled(DEBUG_CAPS))
 		check_capabilities();
 
 	// Start the resolver
@@ -27,7 +27,7 @@ overTimeData *overTime = NULL;
 static void initSlot(const unsigned int index, const time_t timestamp)
 {
 	// Possible debug printing
-	if(config.debug & DEBUG_OVERTIME)
+	if(debug_enabled(DEBUG_OVERTIME))
 	{
 		char timestr[20];
 		strftime(timestr, 20, "%Y-%m-%d %H:%M:%S", localtime(&timestamp));
@@ -82,7 +82,7 @@ void initOverTime(void)
 	// Oldest timestamp is (OVERTIME_SLOTS-1) times the OVERTIME_INTERVAL in the past
 	const time_t oldest = newest - (OVERTIME_SLOTS-1) * OVERTIME_INTERVAL;
 
-	if(config.debug & DEBUG_OVERTIME)
+	if(debug_enabled(DEBUG_OVERTIME))
 	{
 		char first[20], last[20];
 		strftime(first, 20, "%Y-%m-%d %H:%M:%S", localtime(&oldest));
@@ -149,7 +149,7 @@ unsigned int _getOverTimeID(time_t timestamp, const char *file, const int line)
 		return OVERTIME_SLOTS-1;
 	}
 
-	if(config.debug & DEBUG_OVERTIME)
+	if(debug_enabled(DEBUG_OVERTIME))
 	{
 		// Debug output
 		logg("getOverTimeID(%llu): %i", (long long)timestamp, id);
@@ -176,7 +176,7 @@ void moveOverTimeMemory(const time_t mintime)
 	// The number of slots which will be moved (not garbage collected)
 	const unsigned int remainingSlots = OVERTIME_SLOTS - moveOverTime;
 
-	if(config.debug & DEBUG_OVERTIME)
+	if(debug_enabled(DEBUG_OVERTIME))
 	{
 		logg("moveOverTimeMemory(): IS: %llu, SHOULD: %llu, MOVING: %u",
 		     (long long)oldestOverTimeIS, (long long)oldestOverTimeSHOULD, moveOverTime);
@@ -188,7 +188,7 @@ void moveOverTimeMemory(const time_t mintime)
 		return;
 
 	// Move overTime memory
-	if(config.debug & DEBUG_OVERTIME)
+	if(debug_enabled(DEBUG_OVERTIME))
 	{
 		logg("moveOverTimeMemory(): Moving overTime %u - %u to 0 - %u",
 			moveOverTime, moveOverTime+remainingSlots, remainingSlots);
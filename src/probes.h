@@ -0,0 +1,93 @@
+/* Pi-hole: A black hole for Internet advertisements
+*  (c) 2023 Pi-hole, LLC (https://pi-hole.net)
+*  Network-wide ad blocking via your own hardware.
+*
+*  FTL Engine
+*  USDT probe definitions
+*
+*  This file is copyright under the latest version of the EUPL.
+*  Please see LICENSE file for your rights under this license. */
+#ifndef PROBES_H
+#define PROBES_H
+
+// Statically defined tracing probes (USDT) of the provider "pihole". A probe
+// compiles to a single nop plus an ELF note (.note.stapsdt) describing where
+// its arguments can be found. Nothing happens at runtime until a tracer such
+// as bpftrace attaches to it, e.g.
+//   bpftrace -l 'usdt:/usr/bin/pihole-FTL:pihole:*'
+// Example scripts are in tools/bpftrace/
+//
+// We use the macros of SystemTap's <sys/sdt.h> when available. Otherwise, we
+// emit the same notes ourselves on the architectures we know the assembler
+// syntax of. Arguments are passed as long (pointers are converted) there. On
+// all other systems, probes compile to nothing
+
+#if defined(HAVE_SYS_SDT_H)
+
+#include <sys/sdt.h>
+#define PROBE0(name) DTRACE_PROBE(pihole, name)
+#define PROBE1(name, a1) DTRACE_PROBE1(pihole, name, a1)
+#define PROBE2(name, a1, a2) DTRACE_PROBE2(pihole, name, a1, a2)
+#define PROBE3(name, a1, a2, a3) DTRACE_PROBE3(pihole, name, a1, a2, a3)
+#define PROBE4(name, a1, a2, a3, a4) DTRACE_PROBE4(pihole, name, a1, a2, a3, a4)
+
+#elif defined(__GNUC__) && (defined(__x86_64__) || defined(__aarch64__))
+
+// Note layout as expected by tracers: address of the probe, address of the
+// _.stapsdt.base section (to detect prelinking), address of the semaphore
+// (we do not use any), provider, name and argument description. Each
+// argument is described as <size>@<location>, negative sizes are signed
+#define PROBE_NOTE(name, args) \
+	"990: nop\n" \
+	".pushsection .note.stapsdt,\"\",\"note\"\n" \
+	".balign 4\n" \
+	".4byte 992f-991f, 994f-993f, 3\n" \
+	"991: .asciz \"stapsdt\"\n" \
+	"992: .balign 4\n" \
+	"993: .8byte 990b\n" \
+	".8byte _.stapsdt.base\n" \
+	".8byte 0\n" \
+	".asciz \"pihole\"\n" \
+	".asciz \"" #name "\"\n" \
+	".asciz \"" args "\"\n" \
+	"994: .balign 4\n" \
+	".popsection\n" \
+	".ifndef _.stapsdt.base\n" \
+	".pushsection .stapsdt.base,\"aG\",\"progbits\",.stapsdt.base,comdat\n" \
+	".weak _.stapsdt.base\n" \
+	".hidden _.stapsdt.base\n" \
+	"_.stapsdt.base: .space 1\n" \
+	".size _.stapsdt.base, 1\n" \
+	".popsection\n" \
+	".endif\n"
+
+// "nor": the argument may be an immediate, a memory operand or a register
+#define PROBE_ARG(n) "-8@%[arg" #n "]"
+#define PROBE_OP(n, x) [arg##n] "nor" ((long)(x))
+
+#define PROBE0(name) \
+	__asm__ __volatile__(PROBE_NOTE(name, ""))
+#define PROBE1(name, a1) \
+	__asm__ __volatile__(PROBE_NOTE(name, PROBE_ARG(1)) \
+	                     :: PROBE_OP(1, a1))
+#define PROBE2(name, a1, a2) \
+	__asm__ __volatile__(PROBE_NOTE(name, PROBE_ARG(1) " " PROBE_ARG(2)) \
+	                     :: PROBE_OP(1, a1), PROBE_OP(2, a2))
+#define PROBE3(name, a1, a2, a3) \
+	__asm__ __volatile__(PROBE_NOTE(name, PROBE_ARG(1) " " PROBE_ARG(2) " " PROBE_ARG(3)) \
+	                     :: PROBE_OP(1, a1), PROBE_OP(2, a2), PROBE_OP(3, a3))
+#define PROBE4(name, a1, a2, a3, a4) \
+	__asm__ __volatile__(PROBE_NOTE(name, PROBE_ARG(1) " " PROBE_ARG(2) " " PROBE_ARG(3) " " PROBE_ARG(4)) \
+	                     :: PROBE_OP(1, a1), PROBE_OP(2, a2), PROBE_OP(3, a3), PROBE_OP(4, a4))
+
+#else
+
+#define PROBE0(name) do {} while(0)
+#define PROBE1(name, a1) do {} while(0)
+#define PROBE2(name, a1, a2) do {} while(0)
+#define PROBE3(name, a1, a2, a3) do {} while(0)
+#define PROBE4(name, a1, a2, a3, a4) do {} while(0)
+
+#endif
+
+#endif //PROBES_H
@@ -25,6 +25,8 @@
 #include "config.h"
 // cli_stuff()
 #include "args.h"
+// PROBE*()
+#include "probes.h"
 
 // Safety-measure for future extensions
 #if TYPE_MAX > 30
@@ -219,7 +221,7 @@ static bool compile_regex(const char *regexin, const enum regex_type regexid, co
 				if(inverted)
 					regex[index].ext.query_type = ~regex[index].ext.query_type;
 
-				if(regex[index].ext.query_type != 0 && config.debug & DEBUG_REGEX)
+				if(regex[index].ext.query_type != 0 && debug_enabled(DEBUG_REGEX))
 				{
 					logg("    Hint: This regex matches only specific query types:");
 					for(int i = TYPE_A; i < TYPE_MAX; i++)
@@ -235,7 +237,7 @@ static bool compile_regex(const char *regexin, const enum regex_type regexid, co
 				regex[index].ext.inverted = true;
 
 				// Debug output
-				if(config.debug & DEBUG_REGEX)
+				if(debug_enabled(DEBUG_REGEX))
 				{
 					logg("   This regex will match in inverted mode.");
 				}
@@ -292,7 +294,7 @@ static bool compile_regex(const char *regexin, const enum regex_type regexid, co
 				}
 
 				// Debug output
-				if(config.debug & DEBUG_REGEX && regex[index].ext.reply != REPLY_UNKNOWN)
+				if(debug_enabled(DEBUG_REGEX) && regex[index].ext.reply != REPLY_UNKNOWN)
 					logg("   This regex will result in a custom reply: %s", type);
 			}
 			else
@@ -354,13 +356,17 @@ static int match_regex(const char *input, DNSCacheData* dns_cache, const int cli
 		regex = get_regex_ptr(regexid);
 	}
 
+	// Check only once, the compiler has to assume that regexec() modifies
+	// the config and would load the debug flags again for every regex
+	const bool debug_regex = debug_enabled(DEBUG_REGEX);
+
 	// Loop over all configured regex filters of this type
 	for(unsigned int index = 0; index < num_regex[regexid]; index++)
 	{
 		// Only check regex which have been successfully compiled ...
 		if(!regex[index].available)
 		{
-			if(config.debug & DEBUG_REGEX)
+			if(debug_regex)
 			{
 				logg("Regex %s (%u, DB ID %d) \"%s\" is NOT AVAILABLE",
 				     regextype[regexid], index, regex[index].database_id,
@@ -380,7 +386,7 @@ static int match_regex(const char *input, DNSCacheData* dns_cache, const int cli
 		// We allow clientID = -1 to get all regex (for testing)
 		if(clientID >= 0 && !get_per_client_regex(clientID, regexID))
 		{
-			if(config.debug & DEBUG_REGEX)
+			if(debug_regex)
 			{
 				clientsData* client = getClient(clientID, true);
 				if(client != NULL)
@@ -394,7 +400,7 @@ static int match_regex(const char *input, DNSCacheData* dns_cache, const int cli
 		}
 
 		// Try to match the compiled regular expression against input
-		if(config.debug & DEBUG_REGEX)
+		if(debug_regex)
 			logg("Executing: index = %d, preg = %p, str = \"%s\", pmatch = %p", index, &regex[index].regex, input, &match);
 #ifdef USE_TRE_REGEX
 		int retval = tre_regexec(&regex[index].regex, input, 0, match, 0);
@@ -413,7 +419,7 @@ static int match_regex(const char *input, DNSCacheData* dns_cache, const int cli
 				{
 					if(!(regex[index].ext.query_type & (1 << dns_cache->query_type)))
 					{
-						if(config.debug & DEBUG_REGEX)
+						if(debug_regex)
 						{
 							logg("Regex %s (%u, DB ID %i) NO match: \"%s\" vs. \"%s\""
 								" (skipped because of query type mismatch)",
@@ -432,7 +438,7 @@ static int match_regex(const char *input, DNSCacheData* dns_cache, const int cli
 			match_idx = regex[index].database_id;
 
 			// Print match message when in regex debug mode
-			if(config.debug & DEBUG_REGEX)
+			if(debug_regex)
 			{
 				// Approximate regex matching mode
 				logg("Regex %s (%u, DB ID %i) >> MATCH: \"%s\" vs. \"%s\"",
@@ -496,7 +502,7 @@ static int match_regex(const char *input, DNSCacheData* dns_cache, const int cli
 		}
 
 		// Print no match message when in regex debug mode
-		if(config.debug & DEBUG_REGEX && match_idx == -1)
+		if(debug_regex && match_idx == -1)
 		{
 			logg("Regex %s (%u, DB ID %i) NO match: \"%s\" vs. \"%s\"",
 			     regextype[regexid], index, regex[index].database_id,
@@ -515,7 +521,9 @@ bool in_regex(const char *domain, DNSCacheData *dns_cache, const int clientID, c
 	// optimization as the database lookup will most likely hit (a) more domains
 	// and (b) will be faster (given a sufficiently large number of regex
 	// whitelisting filters).
+	PROBE2(regex_start, domain, regexid);
 	const int regex_id = match_regex(domain, dns_cache, clientID, regexid, false);
+	PROBE3(regex_end, domain, regexid, regex_id);
 	if(regex_id != -1)
 	{
 		// We found a match
@@ -533,13 +541,13 @@ static void free_regex(void)
 	   black_regex == NULL &&
 	     cli_regex == NULL)
 	{
-		if(config.debug & DEBUG_DATABASE)
+		if(debug_enabled(DEBUG_DATABASE))
 			logg("Not using any regex filters, nothing to free or reset");
 		return;
 	}
 
 	// Reset client configuration
-	if(config.debug & DEBUG_DATABASE)
+	if(debug_enabled(DEBUG_DATABASE))
 		logg("Resetting per-client regex settings");
 	for(int clientID = 0; clientID < counters->clients; clientID++)
 	{
@@ -560,7 +568,7 @@ static void free_regex(void)
 		if(regex == NULL)
 			continue;
 
-		if(config.debug & DEBUG_DATABASE)
+		if(debug_enabled(DEBUG_DATABASE))
 		{
 			logg("Going to free %i entries in %s regex struct",
 			     oldcount, regextype[regexid]);
@@ -582,7 +590,7 @@ static void free_regex(void)
 			}
 		}
 
-		if(config.debug & DEBUG_DATABASE)
+		if(debug_enabled(DEBUG_DATABASE))
 		{
 			logg("Loop done, freeing regex pointer (%p)", regex);
 		}
@@ -622,7 +630,7 @@ static void read_regex_table(const enum regex_type regexid)
 	// Get table ID
 	const enum gravity_tables tableID = (regexid == REGEX_BLACKLIST) ? REGEX_BLACKLIST_TABLE : REGEX_WHITELIST_TABLE;
 
-	if(config.debug & DEBUG_DATABASE)
+	if(debug_enabled(DEBUG_DATABASE))
 		logg("Reading regex %s from database", regextype[regexid]);
 
 	// Get number of lines in the regex table
@@ -684,7 +692,7 @@ static void read_regex_table(const enum regex_type regexid)
 			continue;
 
 		// Compile this regex
-		if(config.debug & DEBUG_REGEX)
+		if(debug_enabled(DEBUG_REGEX))
 		{
 			logg("Compiling %s regex %i (DB ID %i): %s",
 			     regextype[regexid], num_regex[regexid], rowid, domain);
@@ -700,7 +708,7 @@ static void read_regex_table(const enum regex_type regexid)
 	// Finalize statement and close gravity database handle
 	gravityDB_finalizeTable();
 
-	if(config.debug & DEBUG_DATABASE)
+	if(debug_enabled(DEBUG_DATABASE))
 	{
 		logg("Read %i %s regex entries",
 		     num_regex[regexid],
@@ -727,7 +735,7 @@ void read_regex_from_database(void)
 	// Loop over all clients and ensure we have enough space and load
 	// per-client regex data, not all of the regex read and compiled above
 	// will also be used by all clients
-	if(config.debug & DEBUG_DATABASE)
+	if(debug_enabled(DEBUG_DATABASE))
 		logg("Loading per-client regex data");
 	for(int clientID = 0; clientID < counters->clients; clientID++)
 	{
@@ -848,7 +856,7 @@ bool regex_get_redirect(const int dbID, struct in_addr *addr4, struct in6_addr *
 	// Get internal regex ID from database regex ID
 	const int regexID = regex_id_from_database_id(dbID);
 
-	if(config.debug & DEBUG_REGEX)
+	if(debug_enabled(DEBUG_REGEX))
 		logg("Regex: %d (database) -> %d (internal)", dbID, regexID);
 
 	// Check internal regex ID for validity, return early if negative
@@ -142,7 +142,7 @@ char *resolveHostname(const char *addr)
 	// Get host name
 	char *hostname = NULL;
 
-	if(config.debug & DEBUG_RESOLVER)
+	if(debug_enabled(DEBUG_RESOLVER))
 		logg("Trying to resolve %s", addr);
 
 	// Check if this is a hidden client
@@ -150,7 +150,7 @@ char *resolveHostname(const char *addr)
 	if(strcmp(addr, "0.0.0.0") == 0)
 	{
 		hostname = strdup("hidden");
-		if(config.debug & DEBUG_RESOLVER)
+		if(debug_enabled(DEBUG_RESOLVER))
 			logg("---> \"%s\" (privacy settings)", hostname);
 		return hostname;
 	}
@@ -160,7 +160,7 @@ char *resolveHostname(const char *addr)
 	if(strcmp(addr, "::") == 0)
 	{
 		hostname = strdup("pi.hole");
-		if(config.debug & DEBUG_RESOLVER)
+		if(debug_enabled(DEBUG_RESOLVER))
 			logg("---> \"%s\" (special)", hostname);
 		return hostname;
 	}
@@ -168,7 +168,7 @@ char *resolveHostname(const char *addr)
 	// Check if we want to resolve host names
 	if(!resolve_this_name(addr))
 	{
-		if(config.debug & DEBUG_RESOLVER)
+		if(debug_enabled(DEBUG_RESOLVER))
 			logg("Configured to not resolve host name for %s", addr);
 
 		// Return an empty host name
@@ -236,7 +236,7 @@ char *resolveHostname(const char *addr)
 		// Set resolver port
 		_res.nsaddr_list[0].sin_port = FTLport;
 
-		if(config.debug & DEBUG_RESOLVER)
+		if(debug_enabled(DEBUG_RESOLVER))
 			print_used_resolvers("Setting nameservers to:");
 
 		// Try to resolve address
@@ -256,10 +256,10 @@ char *resolveHostname(const char *addr)
 				hostname = strdup("[invalid host name]");
 			}
 
-			if(config.debug & DEBUG_RESOLVER)
+			if(debug_enabled(DEBUG_RESOLVER))
 				logg(" ---> \"%s\" (found internally)", hostname);
 		}
-		else if(config.debug & DEBUG_RESOLVER)
+		else if(debug_enabled(DEBUG_RESOLVER))
 		{
 			logg(" ---> \"\" (not found internally: %s", gai_strerror(ret));
 		}
@@ -270,10 +270,10 @@ char *resolveHostname(const char *addr)
 			_res.nsaddr_list[i].sin_addr = ns_addr_bck[i];
 			_res.nsaddr_list[i].sin_port = ns_port_bck[i];
 		}
-		if(config.debug & DEBUG_RESOLVER)
+		if(debug_enabled(DEBUG_RESOLVER))
 			print_used_resolvers("Setting nameservers back to default:");
 	}
-	else if(config.debug & DEBUG_RESOLVER)
+	else if(debug_enabled(DEBUG_RESOLVER))
 		print_used_resolvers("FTL already primary nameserver:");
 
 	// If no host name was found before, try again with system-configured
@@ -298,7 +298,7 @@ char *resolveHostname(const char *addr)
 				hostname = strdup("[invalid host name]");
 			}
 
-			if(config.debug & DEBUG_RESOLVER)
+			if(debug_enabled(DEBUG_RESOLVER))
 				logg(" ---> \"%s\" (found externally)", hostname);
 		}
 		else
@@ -306,7 +306,7 @@ char *resolveHostname(const char *addr)
 			// No hostname found (empty PTR)
 			hostname = strdup("");
 
-			if(config.debug & DEBUG_RESOLVER)
+			if(debug_enabled(DEBUG_RESOLVER))
 			{
 				logg(" ---> \"\" (not found externally: %s)", gai_strerror(ret));
 			}
@@ -331,7 +331,7 @@ static size_t resolveAndAddHostname(size_t ippos, size_t oldnamepos)
 	// and getNameFromIP() can be skipped as they will all return empty names (= no records)
 	if(!resolve_this_name(ipaddr))
 	{
-		if(config.debug & DEBUG_RESOLVER)
+		if(debug_enabled(DEBUG_RESOLVER))
 			logg(" ---> \"\" (configured to not resolve host name)");
 
 		// Free allocated memory
@@ -352,7 +352,7 @@ static size_t resolveAndAddHostname(size_t ippos, size_t oldnamepos)
 	{
 		free(newname);
 		newname = getNameFromIP(NULL, ipaddr);
-		if(newname != NULL && config.debug & DEBUG_RESOLVER)
+		if(newname != NULL && debug_enabled(DEBUG_RESOLVER))
 			logg(" ---> \"%s\" (provided by database)", newname);
 	}
 
@@ -371,7 +371,7 @@ static size_t resolveAndAddHostname(size_t ippos, size_t oldnamepos)
 		unlock_shm();
 		return newnamepos;
 	}
-	else if(config.debug & DEBUG_SHMEM)
+	else if(debug_enabled(DEBUG_SHMEM))
 	{
 		// Debugging output
 		logg("Not adding \"%s\" to buffer (unchanged)", oldname);
@@ -425,7 +425,7 @@ static void resolveClients(const bool onlynew, const bool force_refreshing)
 		// Limit for a "recently active" client is two hours ago
 		if(!force_refreshing && !onlynew && client->lastQuery < now - 2*60*60)
 		{
-			if(config.debug & DEBUG_RESOLVER)
+			if(debug_enabled(DEBUG_RESOLVER))
 			{
 				logg("Skipping client %s (%s) because it was inactive for %i seconds",
 				     getstr(ippos), getstr(oldnamepos), (int)(now - client->lastQuery));
@@ -440,7 +440,7 @@ static void resolveClients(const bool onlynew, const bool force_refreshing)
 		// If not, we will try to re-resolve all known clients
 		if(!force_refreshing && onlynew && !newflag)
 		{
-			if(config.debug & DEBUG_RESOLVER)
+			if(debug_enabled(DEBUG_RESOLVER))
 			{
 				logg("Skipping client %s (%s) because it is not new",
 				     getstr(ippos), getstr(oldnamepos));
@@ -465,7 +465,7 @@ static void resolveClients(const bool onlynew, const bool force_refreshing)
 		   (config.refresh_hostnames == REFRESH_IPV4_ONLY && IPv6) ||
 		   (config.refresh_hostnames == REFRESH_UNKNOWN && oldnamepos != 0)))
 		{
-			if(config.debug & DEBUG_RESOLVER)
+			if(debug_enabled(DEBUG_RESOLVER))
 			{
 				const char *reason = "N/A";
 				if(config.refresh_hostnames == REFRESH_NONE)
@@ -479,7 +479,7 @@ static void resolveClients(const bool onlynew, const bool force_refreshing)
 				     getstr(ippos), getstr(oldnamepos), reason);
 			}
 			skipped++;
-			if(config.debug & DEBUG_RESOLVER)
+			if(debug_enabled(DEBUG_RESOLVER))
 			{
 				lock_shm();
 				logg("Client %s -> \"%s\" already known", getstr(ippos), getstr(oldnamepos));
@@ -510,13 +510,13 @@ static void resolveClients(const bool onlynew, const bool force_refreshing)
 		// Mark entry as not new
 		client->flags.new = false;
 
-		if(config.debug & DEBUG_RESOLVER)
+		if(debug_enabled(DEBUG_RESOLVER))
 			logg("Client %s -> \"%s\" is new", getstr(ippos), getstr(newnamepos));
 
 		unlock_shm();
 	}
 
-	if(config.debug & DEBUG_RESOLVER)
+	if(debug_enabled(DEBUG_RESOLVER))
 	{
 		logg("%i / %i client host names resolved",
 		     clientscount-skipped, clientscount);
@@ -555,7 +555,7 @@ static void resolveUpstreams(const bool onlynew)
 		// Limit for a "recently active" upstream server is two hours ago
 		if(upstream->lastQuery < now - 2*60*60)
 		{
-			if(config.debug & DEBUG_RESOLVER)
+			if(debug_enabled(DEBUG_RESOLVER))
 			{
 				logg("Skipping upstream %s (%s) because it was inactive for %i seconds",
 				     getstr(ippos), getstr(oldnamepos), (int)(now - upstream->lastQuery));
@@ -570,7 +570,7 @@ static void resolveUpstreams(const bool onlynew)
 		if(onlynew && !newflag)
 		{
 			skipped++;
-			if(config.debug & DEBUG_RESOLVER)
+			if(debug_enabled(DEBUG_RESOLVER))
 			{
 				lock_shm();
 				logg("Upstream %s -> \"%s\" already known", getstr(ippos), getstr(oldnamepos));
@@ -601,13 +601,13 @@ static void resolveUpstreams(const bool onlynew)
 		// Mark entry as not new
 		upstream->new = false;
 
-		if(config.debug & DEBUG_RESOLVER)
+		if(debug_enabled(DEBUG_RESOLVER))
 			logg("Upstream %s -> \"%s\" is new", getstr(ippos), getstr(newnamepos));
 
 		unlock_shm();
 	}
 
-	if(config.debug & DEBUG_RESOLVER)
+	if(debug_enabled(DEBUG_RESOLVER))
 	{
 		logg("%i / %i upstream server host names resolved",
 		     upstreams-skipped, upstreams);
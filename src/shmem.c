@@ -30,9 +30,15 @@
 #include "database/message-table.h"
 // check_running_FTL()
 #include "procps.h"
+// sleepms()
+#include "timers.h"
+// atomic_uint
+#include <stdatomic.h>
+// PROBE3()
+#include "probes.h"
 
 /// The version of shared memory used
-#define SHARED_MEMORY_VERSION 14
+#define SHARED_MEMORY_VERSION 15
 
 /// The name of the shared memory. Use this when connecting to the shared memory.
 #define SHMEM_PATH "/dev/shm"
@@ -55,6 +61,32 @@
 // the next lock round
 #define STRINGS_ALLOC_STEP (10*pagesize)
 
+// Size of the virtual address ranges reserved for the growing shared memory
+// objects. The objects are mapped with this size right from the start and
+// only the backing files are extended when they grow. Hence, their addresses
+// never change and the forks do not need to remap them. The reservation does
+// not consume any memory. Objects growing beyond their reservation are
+// remapped as before. We are more conservative on 32bit systems where the
+// address space is much smaller
+#define MiB (1024ULL*1024ULL)
+#if UINTPTR_MAX > 0xFFFFFFFFUL
+#define SHM_RESERVE_QUERIES     (4096*MiB)
+#define SHM_RESERVE_STRINGS     (1024*MiB)
+#define SHM_RESERVE_DOMAINS     (1024*MiB)
+#define SHM_RESERVE_CLIENTS     (256*MiB)
+#define SHM_RESERVE_UPSTREAMS   (64*MiB)
+#define SHM_RESERVE_DNS_CACHE   (1024*MiB)
+#define SHM_RESERVE_CLIENTREGEX (256*MiB)
+#else
+#define SHM_RESERVE_QUERIES     (256*MiB)
+#define SHM_RESERVE_STRINGS     (64*MiB)
+#define SHM_RESERVE_DOMAINS     (64*MiB)
+#define SHM_RESERVE_CLIENTS     (16*MiB)
+#define SHM_RESERVE_UPSTREAMS   (4*MiB)
+#define SHM_RESERVE_DNS_CACHE   (64*MiB)
+#define SHM_RESERVE_CLIENTREGEX (16*MiB)
+#endif
+
 // Global counters struct
 countersStruct *counters = NULL;
 
@@ -100,14 +132,38 @@ typedef struct {
 		volatile pid_t pid;
 		volatile pid_t tid;
 	} owner;
+	// Sequence counter for readers not taking the lock (API replica). It
+	// is odd while a writer holds the lock
+	atomic_uint seq;
 } ShmLock;
 static ShmLock *shmLock = NULL;
 static ShmSettings *shmSettings = NULL;
 
 static int pagesize;
+// Size of transparent huge pages (0 = not used)
+static size_t hugepagesize = 0u;
+// Newly allocated range to be prefaulted after releasing the lock (per thread
+// as the lock is per thread as well)
+static __thread struct {
+	SharedMemory *shm;
+	size_t from;
+	size_t to;
+} prefault = { NULL, 0u, 0u };
+// The deferred prefault runs without holding the lock. Meanwhile, another
+// thread of this process may grow the object beyond its reserved address range
+// and mremap() may move it. Remapping waits for deferred prefaults of this
+// process to finish, these read the address of the object only while holding
+// this lock
+static pthread_rwlock_t remap_lock = PTHREAD_RWLOCK_INITIALIZER;
 static unsigned int local_shm_counter = 0;
 static pid_t shmem_pid = 0;
 static size_t used_shmem = 0u;
+// Objects are mapped read-only by the API replica (see attach_shmem()). It does
+// not take the lock in shared memory, a process-local lock serializes the
+// readers of this process instead
+static bool shm_readonly = false;
+static pthread_mutex_t readonly_lock = PTHREAD_MUTEX_INITIALIZER;
+static ino_t settings_inode = 0;
 static size_t get_optimal_object_size(const size_t objsize, const size_t minsize);
 
 // Private prototypes
@@ -169,6 +225,10 @@ static void verify_shmem_pid(void)
 // chown_shmem() changes the file ownership of a given shared memory object
 static bool chown_shmem(SharedMemory *sharedMemory, struct passwd *ent_pw)
 {
+	// Anonymous objects cannot be opened by anyone else
+	if(sharedMemory->memfd)
+		return true;
+
 	// Open shared memory object
 	const int fd = shm_open(sharedMemory->name, O_RDWR, S_IRUSR | S_IWUSR);
 	if(fd == -1)
@@ -229,32 +289,25 @@ char *__attribute__ ((malloc)) str_escape(const char *input, unsigned int *N)
 	return strdup(input);
 }
 
-bool strcmp_escaped(const char *a, const char *b)
+// Escape a character the same way str_escape() does
+static inline int escaped_char(const char c)
 {
-	unsigned int Na, Nb;
+	return c == ' ' ? '~' : tolower((unsigned char)c);
+}
 
+bool strcmp_escaped(const char *a, const char *b)
+{
 	// Input check
 	if(a == NULL || b == NULL)
 		return false;
 
-	// Escape both inputs
-	char *aa = str_escape(a, &Na);
-	char *bb = str_escape(b, &Nb);
+	// Compare both inputs as if they were escaped (case-insensitive). This
+	// avoids creating escaped copies of both strings
+	for(; *a != '\0' && *b != '\0'; a++, b++)
+		if(escaped_char(*a) != escaped_char(*b))
+			return false;
 
-	// Check for memory errors
-	if(!aa || !bb)
-	{
-		if(aa) free(aa);
-		if(bb) free(bb);
-		return false;
-	}
-
-	const char result = strcasecmp(aa, bb) == 0;
-
-	free(aa);
-	free(bb);
-
-	return result;
+	return *a == *b;
 }
 
 
@@ -289,19 +342,27 @@ size_t addstr(const char *input)
 		len = avail_mem;
 	}
 
+	// Copy the C string pointed by input into the shared string buffer
+	char *str = &((char*)shm_strings.ptr)[shmSettings->next_str_pos];
+	strncpy(str, input, len);
+
+	// Escape the string in place (see str_escape())
 	unsigned int N = 0;
-	char *str = str_escape(input, &N);
+	for(size_t i = 0; i < len && str[i] != '\0'; i++)
+	{
+		if(str[i] == ' ')
+		{
+			str[i] = '~';
+			N++;
+		}
+	}
 
 	if(N > 0)
-		logg("INFO: FTL replaced %u invalid characters with ~ in the query \"%s\"", N, str);
+		logg("INFO: FTL replaced %u invalid characters with ~ in the query \"%.*s\"", N, (int)len, str);
 
 	// Debugging output
-	if(config.debug & DEBUG_SHMEM)
-		logg("Adding \"%s\" (len %zu) to buffer. next_str_pos is %u", str, len, shmSettings->next_str_pos);
-
-	// Copy the C string pointed by str into the shared string buffer
-	strncpy(&((char*)shm_strings.ptr)[shmSettings->next_str_pos], str, len);
-	free(str);
+	if(debug_enabled(DEBUG_SHMEM))
+		logg("Adding \"%.*s\" (len %zu) to buffer. next_str_pos is %u", (int)len, str, len, shmSettings->next_str_pos);
 
 	// Increment string length counter
 	shmSettings->next_str_pos += len;
@@ -322,6 +383,18 @@ const char *_getstr(const size_t pos, const char *func, const int line, const ch
 	}
 }
 
+// Get the position of a string returned by getstr() in the shared string
+// buffer. Returns false if str does not point into the buffer. Positions are
+// stable for the lifetime of the process (strings are never removed)
+bool getstrpos(const char *str, size_t *pos)
+{
+	const char *base = shm_strings.ptr;
+	if(str < base || str >= base + shmSettings->next_str_pos)
+		return false;
+	*pos = str - base;
+	return true;
+}
+
 /// Create a mutex for shared memory
 static pthread_mutex_t create_mutex(void) {
 	logg("Creating mutex");
@@ -346,9 +419,118 @@ static pthread_mutex_t create_mutex(void) {
 	return lock;
 }
 
+// Large objects which may benefit from huge pages
+static bool __attribute__((pure)) is_large_shm(const char *name)
+{
+	return strcmp(name, SHARED_QUERIES_NAME) == 0 || strcmp(name, SHARED_DOMAINS_NAME) == 0 ||
+	       strcmp(name, SHARED_CLIENTS_NAME) == 0 || strcmp(name, SHARED_STRINGS_NAME) == 0 ||
+	       strcmp(name, SHARED_DNS_CACHE) == 0;
+}
+
+// Check if the kernel can back shared memory with transparent huge pages and
+// get their size
+static size_t get_hugepagesize(void)
+{
+	char buffer[64] = { 0 };
+	FILE *fp = fopen("/sys/kernel/mm/transparent_hugepage/shmem_enabled", "r");
+	if(fp == NULL)
+	{
+		logg("WARN: Transparent huge pages are not supported by the kernel");
+		return 0u;
+	}
+	if(fgets(buffer, sizeof(buffer), fp) == NULL)
+		buffer[0] = '\0';
+	fclose(fp);
+
+	// The active setting is enclosed in brackets, e.g.
+	// "always within_size advise [never] deny force"
+	if(strstr(buffer, "[never]") != NULL || strstr(buffer, "[deny]") != NULL)
+	{
+		logg("WARN: Transparent huge pages are disabled for shared memory, set "
+		     "/sys/kernel/mm/transparent_hugepage/shmem_enabled to \"advise\"");
+		return 0u;
+	}
+
+	size_t size = 2*1024*1024;
+	if((fp = fopen("/sys/kernel/mm/transparent_hugepage/hpage_pmd_size", "r")) != NULL)
+	{
+		if(fscanf(fp, "%zu", &size) != 1)
+			size = 2*1024*1024;
+		fclose(fp);
+	}
+
+	return size;
+}
+
+// The kernel can only use huge pages for our objects if the mappings are
+// aligned to the huge page size. We get such an address by reserving a
+// slightly larger anonymous range and trimming it. The returned range is
+// replaced by the actual mapping (MAP_FIXED) afterwards
+static void *get_aligned_address(const size_t len)
+{
+	if(hugepagesize == 0)
+		return NULL;
+
+	const size_t total = len + hugepagesize;
+	char *area = mmap(NULL, total, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+	if(area == MAP_FAILED)
+		return NULL;
+
+	char *aligned = area + (hugepagesize - (uintptr_t)area % hugepagesize) % hugepagesize;
+	if(aligned > area)
+		munmap(area, aligned - area);
+	if(area + total > aligned + len)
+		munmap(aligned + len, area + total - (aligned + len));
+
+	return aligned;
+}
+
+// Map the given range of a shared memory object into our page tables now,
+// so that we do not page-fault on it later
+static void prefault_shm(SharedMemory *sharedMemory, const size_t from, const size_t to)
+{
+	if(to <= from || sharedMemory->ptr == NULL)
+		return;
+
+	// Start at the beginning of the first page of the range
+	const size_t start = from - from % pagesize;
+	char *ptr = (char*)sharedMemory->ptr + start;
+	const size_t len = to - start;
+#ifdef MADV_POPULATE_WRITE
+	if(madvise(ptr, len, MADV_POPULATE_WRITE) == 0)
+		return;
+	// Fall through to manual prefaulting if the kernel is too old
+#endif
+	// Read one byte of each page
+	for(size_t i = 0; i < len; i += pagesize)
+		(void)*(volatile char*)(ptr + i);
+}
+
+// Allocate the pages of an anonymous object between from and to. They are
+// allocated through the mapping so the kernel can use huge pages (fallocate()
+// does not know about our mapping and always uses small pages). This fails
+// instead of raising SIGBUS later if there is not enough memory
+static int allocate_shm(SharedMemory *sharedMemory, const size_t from, const size_t to)
+{
+	if(to <= from)
+		return 0;
+
+	const size_t start = from - from % pagesize;
+#ifdef MADV_POPULATE_WRITE
+	if(madvise((char*)sharedMemory->ptr + start, to - start, MADV_POPULATE_WRITE) == 0)
+		return 0;
+	if(errno != EINVAL)
+		return -1;
+	// else: Kernel too old, fall through
+#endif
+	// Let the pages be allocated on first access
+	return 0;
+}
+
 static void remap_shm(void)
 {
-	// Remap shared object pointers which might have changed
+	// Remap shared object pointers which might have changed. This is cheap
+	// for all objects still fitting into their reserved address ranges
 	realloc_shm(&shm_queries, counters->queries_MAX, sizeof(queriesData), false);
 	queries = (queriesData*)shm_queries.ptr;
 
@@ -377,8 +559,19 @@ static void remap_shm(void)
 // Obtain SHMEM lock
 void _lock_shm(const char *func, const int line, const char *file)
 {
-	if(config.debug & DEBUG_LOCKS)
+	// Read-only processes do not take the lock. They use shm_read_begin()
+	// and shm_read_retry() to detect concurrent modifications instead
+	if(shm_readonly)
+	{
+		pthread_mutex_lock(&readonly_lock);
+		// Objects may have outgrown their reservations in the meantime
+		remap_shm();
+		return;
+	}
+
+	if(debug_enabled(DEBUG_LOCKS))
 		logg("Waiting for SHM lock in %s() (%s:%i)", func, file, line);
+	PROBE3(lock_wait, func, line, file);
 
 	int result = pthread_mutex_lock(&shmLock->lock.outer);
 
@@ -388,7 +581,7 @@ void _lock_shm(const char *func, const int line, const char *file)
 	if(result == EOWNERDEAD) {
 		// Try to make the lock consistent if the other process died while
 		// holding the lock
-		if(config.debug & DEBUG_LOCKS)
+		if(debug_enabled(DEBUG_LOCKS))
 			logg("Owner of outer SHM lock died, making lock consistent");
 
 		result = pthread_mutex_consistent(&shmLock->lock.outer);
@@ -396,15 +589,25 @@ void _lock_shm(const char *func, const int line, const char *file)
 			logg("Failed to make outer SHM lock consistent: %s", strerror(result));
 	}
 
+	// Tell lockless readers that the objects are being modified. The
+	// counter is already odd if the previous owner died while holding the
+	// lock
+	if((atomic_load_explicit(&shmLock->seq, memory_order_relaxed) & 1u) == 0)
+		atomic_fetch_add_explicit(&shmLock->seq, 1u, memory_order_relaxed);
+	atomic_thread_fence(memory_order_release);
+
 	// Store lock owner after lock has been acquired and was made consistent (if required)
 	shmLock->owner.pid = getpid();
 	shmLock->owner.tid = gettid();
 
-	// Check if this process needs to remap the shared memory objects
-	if(shmSettings != NULL &&
-	   local_shm_counter != shmSettings->global_shm_counter)
+	// Check if this process needs to remap the shared memory objects. We
+	// always update the sizes of the objects (they may have been enlarged
+	// by another process), however, actual remapping is only necessary
+	// when an object outgrew its reserved address range
+	if(shmSettings != NULL)
 	{
-		if(config.debug & DEBUG_SHMEM)
+		if(debug_enabled(DEBUG_SHMEM) &&
+		   local_shm_counter != shmSettings->global_shm_counter)
 			logg("Remapping shared memory for current process %u %u",
 		             local_shm_counter, shmSettings->global_shm_counter);
 		remap_shm();
@@ -414,8 +617,9 @@ void _lock_shm(const char *func, const int line, const char *file)
 	shm_ensure_size();
 
 	result = pthread_mutex_lock(&shmLock->lock.inner);
+	PROBE3(lock_acquired, func, line, file);
 
-	if(config.debug & DEBUG_LOCKS)
+	if(debug_enabled(DEBUG_LOCKS))
 		logg("Obtained SHM lock for %s() (%s:%i)", func, file, line);
 
 	if(result != 0)
@@ -424,7 +628,7 @@ void _lock_shm(const char *func, const int line, const char *file)
 	if(result == EOWNERDEAD) {
 		// Try to make the lock consistent if the other process died while
 		// holding the lock
-		if(config.debug & DEBUG_LOCKS)
+		if(debug_enabled(DEBUG_LOCKS))
 			logg("Owner of inner SHM lock died, making lock consistent");
 
 		result = pthread_mutex_consistent(&shmLock->lock.inner);
@@ -436,26 +640,48 @@ void _lock_shm(const char *func, const int line, const char *file)
 // Release SHM lock
 void _unlock_shm(const char* func, const int line, const char * file)
 {
-	if(config.debug & DEBUG_LOCKS && !is_our_lock())
+	if(shm_readonly)
+	{
+		pthread_mutex_unlock(&readonly_lock);
+		return;
+	}
+
+	if(debug_enabled(DEBUG_LOCKS) && !is_our_lock())
 	{
 		logg("ERROR: Tried to unlock but lock is owned by %li/%li",
 		     (long int)shmLock->owner.pid, (long int)shmLock->owner.tid);
 	}
 
+	PROBE3(lock_release, func, line, file);
+
 	// Unlock mutex
 	int result = pthread_mutex_unlock(&shmLock->lock.inner);
 	shmLock->owner.pid = 0;
 	shmLock->owner.tid = 0;
 
-	if(config.debug & DEBUG_LOCKS)
+	if(debug_enabled(DEBUG_LOCKS))
 		logg("Removed lock in %s() (%s:%i)", func, file, line);
 
 	if(result != 0)
 		logg("Failed to unlock inner SHM lock: %s", strerror(result));
 
+	// All modifications are visible to lockless readers
+	atomic_fetch_add_explicit(&shmLock->seq, 1u, memory_order_release);
+
 	result = pthread_mutex_unlock(&shmLock->lock.outer);
 	if(result != 0)
 		logg("Failed to unlock outer SHM lock: %s", strerror(result));
+
+	// Prefault memory allocated while we were holding the lock. We do this
+	// after having released the lock so other threads and processes are
+	// not held up by this
+	if(prefault.shm != NULL)
+	{
+		pthread_rwlock_rdlock(&remap_lock);
+		prefault_shm(prefault.shm, prefault.from, prefault.to);
+		pthread_rwlock_unlock(&remap_lock);
+		prefault.shm = NULL;
+	}
 }
 
 // Return if we locked this mutex (PID and TID match)
@@ -467,14 +693,27 @@ bool is_our_lock(void)
 	return false;
 }
 
+// Forked processes (TCP workers) inherit remap_lock but not the threads which
+// may be holding it
+static void reset_remap_lock(void)
+{
+	const pthread_rwlock_t unlocked = PTHREAD_RWLOCK_INITIALIZER;
+	remap_lock = unlocked;
+}
+
 bool init_shmem()
 {
 	// Get kernel's page size
 	pagesize = getpagesize();
+	pthread_atfork(NULL, NULL, reset_remap_lock);
+
+	// Get size of transparent huge pages (if requested)
+	if(config.shmem_hugepages)
+		hugepagesize = get_hugepagesize();
 
 	/****************************** shared memory lock ******************************/
 	// Try to create shared memory object
-	shm_lock = create_shm(SHARED_LOCK_NAME, sizeof(ShmLock));
+	shm_lock = create_shm(SHARED_LOCK_NAME, sizeof(ShmLock), 0);
 	if(shm_lock.ptr == NULL)
 		return false;
 
@@ -484,7 +723,7 @@ bool init_shmem()
 
 	/****************************** shared counters struct ******************************/
 	// Try to create shared memory object
-	shm_counters = create_shm(SHARED_COUNTERS_NAME, sizeof(countersStruct));
+	shm_counters = create_shm(SHARED_COUNTERS_NAME, sizeof(countersStruct), 0);
 	if(shm_counters.ptr == NULL)
 		return false;
 
@@ -492,7 +731,7 @@ bool init_shmem()
 
 	/****************************** shared settings struct ******************************/
 	// Try to create shared memory object
-	shm_settings = create_shm(SHARED_SETTINGS_NAME, sizeof(ShmSettings));
+	shm_settings = create_shm(SHARED_SETTINGS_NAME, sizeof(ShmSettings), 0);
 	if(shm_settings.ptr == NULL)
 		return false;
 
@@ -503,7 +742,7 @@ bool init_shmem()
 
 	/****************************** shared strings buffer ******************************/
 	// Try to create shared memory object
-	shm_strings = create_shm(SHARED_STRINGS_NAME, STRINGS_ALLOC_STEP);
+	shm_strings = create_shm(SHARED_STRINGS_NAME, STRINGS_ALLOC_STEP, SHM_RESERVE_STRINGS);
 	if(shm_strings.ptr == NULL)
 		return false;
 
@@ -516,7 +755,7 @@ bool init_shmem()
 	/****************************** shared domains struct ******************************/
 	size_t size = get_optimal_object_size(sizeof(domainsData), 1);
 	// Try to create shared memory object
-	shm_domains = create_shm(SHARED_DOMAINS_NAME, size*sizeof(domainsData));
+	shm_domains = create_shm(SHARED_DOMAINS_NAME, size*sizeof(domainsData), SHM_RESERVE_DOMAINS);
 	if(shm_domains.ptr == NULL)
 		return false;
 
@@ -526,7 +765,7 @@ bool init_shmem()
 	/****************************** shared clients struct ******************************/
 	size = get_optimal_object_size(sizeof(clientsData), 1);
 	// Try to create shared memory object
-	shm_clients = create_shm(SHARED_CLIENTS_NAME, size*sizeof(clientsData));
+	shm_clients = create_shm(SHARED_CLIENTS_NAME, size*sizeof(clientsData), SHM_RESERVE_CLIENTS);
 	if(shm_clients.ptr == NULL)
 		return false;
 
@@ -536,7 +775,7 @@ bool init_shmem()
 	/****************************** shared upstreams struct ******************************/
 	size = get_optimal_object_size(sizeof(upstreamsData), 1);
 	// Try to create shared memory object
-	shm_upstreams = create_shm(SHARED_UPSTREAMS_NAME, size*sizeof(upstreamsData));
+	shm_upstreams = create_shm(SHARED_UPSTREAMS_NAME, size*sizeof(upstreamsData), SHM_RESERVE_UPSTREAMS);
 	if(shm_upstreams.ptr == NULL)
 		return false;
 	upstreams = (upstreamsData*)shm_upstreams.ptr;
@@ -545,7 +784,7 @@ bool init_shmem()
 
 	/****************************** shared queries struct ******************************/
 	// Try to create shared memory object
-	shm_queries = create_shm(SHARED_QUERIES_NAME, pagesize*sizeof(queriesData));
+	shm_queries = create_shm(SHARED_QUERIES_NAME, pagesize*sizeof(queriesData), SHM_RESERVE_QUERIES);
 	if(shm_queries.ptr == NULL)
 		return false;
 	queries = (queriesData*)shm_queries.ptr;
@@ -555,7 +794,7 @@ bool init_shmem()
 	/****************************** shared overTime struct ******************************/
 	size = get_optimal_object_size(sizeof(overTimeData), OVERTIME_SLOTS);
 	// Try to create shared memory object
-	shm_overTime = create_shm(SHARED_OVERTIME_NAME, size*sizeof(overTimeData));
+	shm_overTime = create_shm(SHARED_OVERTIME_NAME, size*sizeof(overTimeData), 0);
 	if(shm_overTime.ptr == NULL)
 		return false;
 
@@ -565,7 +804,7 @@ bool init_shmem()
 	/****************************** shared DNS cache struct ******************************/
 	size = get_optimal_object_size(sizeof(DNSCacheData), 1);
 	// Try to create shared memory object
-	shm_dns_cache = create_shm(SHARED_DNS_CACHE, size*sizeof(DNSCacheData));
+	shm_dns_cache = create_shm(SHARED_DNS_CACHE, size*sizeof(DNSCacheData), SHM_RESERVE_DNS_CACHE);
 	if(shm_dns_cache.ptr == NULL)
 		return false;
 
@@ -575,15 +814,167 @@ bool init_shmem()
 	/****************************** shared per-client regex buffer ******************************/
 	size = pagesize; // Allocate one pagesize initially. This may be expanded later on
 	// Try to create shared memory object
-	shm_per_client_regex = create_shm(SHARED_PER_CLIENT_REGEX, size);
+	shm_per_client_regex = create_shm(SHARED_PER_CLIENT_REGEX, size, SHM_RESERVE_CLIENTREGEX);
 	if(shm_per_client_regex.ptr == NULL)
 		return false;
 
 	counters->per_client_regex_MAX = size;
 
+	if(debug_enabled(DEBUG_SHMEM))
+		log_shmem_details();
+
+	return true;
+}
+
+// Map an existing shared memory object read-only. Growing objects are mapped
+// with the same reservation the owning process uses so they do not need to
+// be remapped when they grow
+static bool attach_shm(SharedMemory *sharedMemory, const char *name, const size_t reserve, const bool writable)
+{
+	sharedMemory->name = name;
+
+	const int fd = shm_open(name, writable ? O_RDWR : O_RDONLY, S_IRUSR | S_IWUSR);
+	if(fd == -1)
+	{
+		logg("FATAL: attach_shm(): Failed to open shared memory object \"%s\": %s",
+		     name, strerror(errno));
+		if(errno == ENOENT && reserve > 0)
+			logg("       Objects backed by huge pages (SHMEM_HUGEPAGES) cannot be attached");
+		return false;
+	}
+
+	struct stat st;
+	if(fstat(fd, &st) != 0)
+	{
+		logg("FATAL: attach_shm(): Failed to stat shared memory object \"%s\": %s",
+		     name, strerror(errno));
+		close(fd);
+		return false;
+	}
+	const size_t size = st.st_size;
+	const size_t len = size > reserve ? size : reserve;
+
+	void *shm = mmap(NULL, len, writable ? PROT_READ | PROT_WRITE : PROT_READ,
+	                 MAP_SHARED | MAP_NORESERVE, fd, 0);
+	close(fd);
+	if(shm == MAP_FAILED)
+	{
+		logg("FATAL: attach_shm(): Failed to map shared memory object \"%s\" (%zu bytes): %s",
+		     name, len, strerror(errno));
+		return false;
+	}
+
+	sharedMemory->ptr = shm;
+	sharedMemory->size = size;
+	sharedMemory->reserved = len;
+
+	return true;
+}
+
+// Attach to the shared memory objects of a running FTL instance without
+// creating or modifying them. The objects are mapped read-only, only the lock
+// is writable. Readers use shm_read_begin() and shm_read_retry() to detect
+// concurrent modifications, shm_read_lock() is the fallback if this fails
+bool attach_shmem(void)
+{
+	pagesize = getpagesize();
+	shm_readonly = true;
+
+	if(!attach_shm(&shm_lock, SHARED_LOCK_NAME, 0, true) ||
+	   !attach_shm(&shm_settings, SHARED_SETTINGS_NAME, 0, false))
+		return false;
+	shmLock = (ShmLock*)shm_lock.ptr;
+	shmSettings = (ShmSettings*)shm_settings.ptr;
+
+	if(shmSettings->version != SHARED_MEMORY_VERSION)
+	{
+		logg("FATAL: Shared memory version mismatch (found %d, expected %d)",
+		     shmSettings->version, SHARED_MEMORY_VERSION);
+		return false;
+	}
+	shmem_pid = shmSettings->pid;
+
+	// Remember the settings object to detect a restart of FTL
+	struct stat st;
+	if(stat(SHMEM_PATH "/" SHARED_SETTINGS_NAME, &st) == 0)
+		settings_inode = st.st_ino;
+
+	if(!attach_shm(&shm_counters, SHARED_COUNTERS_NAME, 0, false) ||
+	   !attach_shm(&shm_overTime, SHARED_OVERTIME_NAME, 0, false) ||
+	   !attach_shm(&shm_strings, SHARED_STRINGS_NAME, SHM_RESERVE_STRINGS, false) ||
+	   !attach_shm(&shm_domains, SHARED_DOMAINS_NAME, SHM_RESERVE_DOMAINS, false) ||
+	   !attach_shm(&shm_clients, SHARED_CLIENTS_NAME, SHM_RESERVE_CLIENTS, false) ||
+	   !attach_shm(&shm_upstreams, SHARED_UPSTREAMS_NAME, SHM_RESERVE_UPSTREAMS, false) ||
+	   !attach_shm(&shm_queries, SHARED_QUERIES_NAME, SHM_RESERVE_QUERIES, false) ||
+	   !attach_shm(&shm_dns_cache, SHARED_DNS_CACHE, SHM_RESERVE_DNS_CACHE, false) ||
+	   !attach_shm(&shm_per_client_regex, SHARED_PER_CLIENT_REGEX, SHM_RESERVE_CLIENTREGEX, false))
+		return false;
+
+	counters = (countersStruct*)shm_counters.ptr;
+	overTime = (overTimeData*)shm_overTime.ptr;
+	queries = (queriesData*)shm_queries.ptr;
+	domains = (domainsData*)shm_domains.ptr;
+	clients = (clientsData*)shm_clients.ptr;
+	upstreams = (upstreamsData*)shm_upstreams.ptr;
+	dns_cache = (DNSCacheData*)shm_dns_cache.ptr;
+
+	logg("Attached to shared memory of FTL (PID %d)", (int)shmem_pid);
 	return true;
 }
 
+// Begin a lockless read of the shared memory objects. Waits (for a limited
+// time) while a writer is holding the lock. Returns the sequence number to be
+// passed to shm_read_retry() after reading
+unsigned int shm_read_begin(void)
+{
+	unsigned int seq = atomic_load_explicit(&shmLock->seq, memory_order_acquire);
+	for(unsigned int i = 0; (seq & 1u) && i < SHM_READ_WAIT; i++)
+	{
+		sleepms(1);
+		seq = atomic_load_explicit(&shmLock->seq, memory_order_acquire);
+	}
+
+	return seq;
+}
+
+// Check if the shared memory objects have been modified since shm_read_begin()
+// returned seq. Everything read in between has to be discarded in this case
+bool shm_read_retry(const unsigned int seq)
+{
+	atomic_thread_fence(memory_order_acquire);
+	return (seq & 1u) || atomic_load_explicit(&shmLock->seq, memory_order_relaxed) != seq;
+}
+
+static void lock_robust(pthread_mutex_t *lock)
+{
+	if(pthread_mutex_lock(lock) == EOWNERDEAD)
+		pthread_mutex_consistent(lock);
+}
+
+// Take the lock of the running FTL instance to read the objects while no writer
+// can modify them. The sequence counter is not changed as nothing is written.
+// Writers are held up while we are holding the lock, use this only when the
+// lockless read failed repeatedly
+void shm_read_lock(void)
+{
+	lock_robust(&shmLock->lock.outer);
+	lock_robust(&shmLock->lock.inner);
+}
+
+void shm_read_unlock(void)
+{
+	pthread_mutex_unlock(&shmLock->lock.inner);
+	pthread_mutex_unlock(&shmLock->lock.outer);
+}
+
+// Check if the attached shared memory objects have been removed or replaced,
+// e.g., because FTL terminated or has been restarted
+bool shm_replaced(void)
+{
+	struct stat st;
+	return stat(SHMEM_PATH "/" SHARED_SETTINGS_NAME, &st) != 0 || st.st_ino != settings_inode;
+}
+
 // CHOWN all shared memory objects to supplied user/group
 void chown_all_shmem(struct passwd *ent_pw)
 {
@@ -611,13 +1002,14 @@ void destroy_shmem(void)
 ///
 /// \param name the name of the shared memory
 /// \param size the size to allocate
+/// \param reserve the size of the virtual address range to reserve
 /// \return a structure with a pointer to the mounted shared memory. The pointer
 /// will always be valid, because if it failed FTL will have exited.
-static SharedMemory create_shm(const char *name, const size_t size)
+static SharedMemory create_shm(const char *name, const size_t size, const size_t reserve)
 {
 	char df[64] =  { 0 };
 	const int percentage = get_dev_shm_usage(df);
-	if(config.debug & DEBUG_SHMEM || (config.check.shmem > 0 && percentage > config.check.shmem))
+	if(debug_enabled(DEBUG_SHMEM) || (config.check.shmem > 0 && percentage > config.check.shmem))
 	{
 		logg("Creating shared memory with name \"%s\" and size %zu (%s)", name, size, df);
 	}
@@ -627,9 +1019,23 @@ static SharedMemory create_shm(const char *name, const size_t size)
 	SharedMemory sharedMemory = {
 		.name = name,
 		.size = size,
-		.ptr = NULL
+		.reserved = size,
+		.ptr = NULL,
+		.memfd = false
 	};
 
+	// The kernel only uses transparent huge pages for tmpfs mounts with
+	// the huge=... mount option which /dev/shm typically does not have.
+	// Anonymous (memfd) objects use the system-wide setting instead
+	if(hugepagesize > 0 && reserve > size && is_large_shm(name))
+	{
+		sharedMemory = create_shm_memfd(name, size, reserve);
+		if(sharedMemory.ptr != NULL)
+			return sharedMemory;
+		// else: fall back to a named object
+		sharedMemory.memfd = false;
+	}
+
 	// Create the shared memory file in read/write mode with 600 (u+rw) permissions
 	// and the following open flags:
 	// - O_RDWR: Open the object for read-write access (we need to be able to modify the locks)
@@ -662,8 +1068,23 @@ static SharedMemory create_shm(const char *name, const size_t size)
 	// We only add here as this is a new file
 	used_shmem += size;
 
-	// Create shared memory mapping
-	void *shm = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	// Create shared memory mapping. If requested, we map a larger range
+	// than the object currently needs. Accessing the range beyond the end
+	// of the file would raise SIGBUS, however, we never access more than
+	// the *_MAX counters allow. Once the file is extended, the additional
+	// pages become available in all processes sharing this mapping
+	void *shm = MAP_FAILED;
+	if(reserve > size)
+	{
+		shm = mmap(NULL, reserve, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_NORESERVE, fd, 0);
+		if(shm != MAP_FAILED)
+			sharedMemory.reserved = reserve;
+		else
+			logg("WARN: create_shm(): Failed to reserve %zu bytes for \"%s\": %s",
+			     reserve, sharedMemory.name, strerror(errno));
+	}
+	if(shm == MAP_FAILED)
+		shm = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
 
 	// Check for `mmap` error
 	if(shm == MAP_FAILED)
@@ -681,6 +1102,68 @@ static SharedMemory create_shm(const char *name, const size_t size)
 	return sharedMemory;
 }
 
+// Create an anonymous shared memory object backed by huge pages. We cannot
+// keep its file descriptor open (dnsmasq closes all unknown descriptors
+// during startup) so the file is sized to the entire reservation right away.
+// This does not allocate any memory, the pages are allocated through the
+// mapping whenever the object grows (see allocate_shm())
+static SharedMemory create_shm_memfd(const char *name, const size_t size, const size_t reserve)
+{
+	SharedMemory sharedMemory = {
+		.name = name,
+		.size = size,
+		.reserved = reserve,
+		.ptr = NULL,
+		.memfd = true
+	};
+
+#ifdef MFD_CLOEXEC
+	const int fd = memfd_create(name, MFD_CLOEXEC);
+	if(fd == -1)
+	{
+		logg("WARN: create_shm(): Failed to create anonymous object \"%s\": %s",
+		     name, strerror(errno));
+		return sharedMemory;
+	}
+
+	void *addr = get_aligned_address(reserve);
+	void *shm = MAP_FAILED;
+	if(ftruncate(fd, reserve) == 0)
+		shm = mmap(addr, reserve, PROT_READ | PROT_WRITE,
+		           MAP_SHARED | MAP_NORESERVE | (addr != NULL ? MAP_FIXED : 0), fd, 0);
+	close(fd);
+
+	if(shm == MAP_FAILED)
+	{
+		logg("WARN: create_shm(): Failed to map anonymous object \"%s\": %s",
+		     name, strerror(errno));
+		if(addr != NULL)
+			munmap(addr, reserve);
+		return sharedMemory;
+	}
+
+	// Ask the kernel to back this object with huge pages
+	if(madvise(shm, reserve, MADV_HUGEPAGE) != 0)
+		logg("WARN: create_shm(): Cannot use huge pages for \"%s\": %s",
+		     name, strerror(errno));
+
+	sharedMemory.ptr = shm;
+	if(allocate_shm(&sharedMemory, 0u, size) != 0)
+	{
+		logg("FATAL: create_shm(): Failed to allocate %zu bytes for \"%s\": %s",
+		     size, name, strerror(errno));
+		exit(EXIT_FAILURE);
+	}
+
+	// Update how much memory FTL uses
+	used_shmem += size;
+#else
+	logg("WARN: create_shm(): Anonymous shared memory objects are not supported");
+#endif
+
+	return sharedMemory;
+}
+
 static void *enlarge_shmem_struct(const char type)
 {
 	SharedMemory *sharedMemory = NULL;
@@ -733,11 +1216,48 @@ static void *enlarge_shmem_struct(const char type)
 
 	// Reallocate enough space for requested object
 	const size_t current = sharedMemory->size/sizeofobj;
+
+	// Grow large objects in multiples of the huge page size. Otherwise, the
+	// kernel cannot use huge pages for the end of the object
+	if(hugepagesize > 0 && is_large_shm(sharedMemory->name))
+	{
+		size_t target = (current + allocation_step)*sizeofobj;
+		target += (hugepagesize - target % hugepagesize) % hugepagesize;
+		allocation_step = target/sizeofobj - current;
+	}
+
+	const size_t oldsize = sharedMemory->size;
 	realloc_shm(sharedMemory, current + allocation_step, sizeofobj, true);
 
 	// Add allocated memory to corresponding counter
 	*counter += allocation_step;
 
+	// Prefault the newly allocated memory. We defer this until the lock is
+	// released when the object is still inside its reserved address range.
+	// It may be moved by another thread before the deferred prefault runs,
+	// see remap_lock. Objects which had to be remapped just now are
+	// prefaulted right away. Anonymous objects are already populated
+	if(config.shmem_prefault && !sharedMemory->memfd)
+	{
+		if(prefault.shm != NULL && prefault.shm != sharedMemory)
+		{
+			prefault_shm(prefault.shm, prefault.from, prefault.to);
+			prefault.shm = NULL;
+		}
+		if(sharedMemory->size < sharedMemory->reserved)
+		{
+			if(prefault.shm != sharedMemory)
+				prefault.from = oldsize;
+			prefault.shm = sharedMemory;
+			prefault.to = sharedMemory->size;
+		}
+		else
+			prefault_shm(sharedMemory, oldsize, sharedMemory->size);
+	}
+
+	if(debug_enabled(DEBUG_SHMEM))
+		log_shmem_details();
+
 	return sharedMemory->ptr;
 }
 
@@ -746,6 +1266,14 @@ static bool realloc_shm(SharedMemory *sharedMemory, const size_t size1, const si
 	// Absolute target size
 	const size_t size = size1 * size2;
 
+	// Nothing to remap if the object still fits into the address range
+	// reserved for it. This is the case most of the time
+	if(!resize && size <= sharedMemory->reserved)
+	{
+		sharedMemory->size = size;
+		return true;
+	}
+
 	// Log that we are doing something here
 	char df[64] =  { 0 };
 	const int percentage = get_dev_shm_usage(df);
@@ -770,6 +1298,22 @@ static bool realloc_shm(SharedMemory *sharedMemory, const size_t size1, const si
 		// Verify shared memory ownership
 		verify_shmem_pid();
 
+		// Anonymous objects are already large enough, we only need to
+		// allocate the memory. They cannot grow beyond their reservation
+		if(sharedMemory->memfd)
+		{
+			if(size > sharedMemory->reserved ||
+			   allocate_shm(sharedMemory, sharedMemory->size, size) != 0)
+			{
+				logg("FATAL: realloc_shm(): Failed to allocate \"%s\" to %zu (%zu reserved): %s",
+				     sharedMemory->name, size, sharedMemory->reserved, strerror(errno));
+				exit(EXIT_FAILURE);
+			}
+			used_shmem += (size - sharedMemory->size);
+			sharedMemory->size = size;
+			return true;
+		}
+
 		// Open shared memory object
 		const int fd = shm_open(sharedMemory->name, O_RDWR, S_IRUSR | S_IWUSR);
 		if(fd == -1)
@@ -795,16 +1339,27 @@ static bool realloc_shm(SharedMemory *sharedMemory, const size_t size1, const si
 		// needed after having called f[tl]allocate()
 		close(fd);
 
+		// The object still fits into the reserved address range, all
+		// processes can access the new size without remapping
+		if(size <= sharedMemory->reserved)
+		{
+			used_shmem += (size - sharedMemory->size);
+			sharedMemory->size = size;
+			return true;
+		}
+
 		// Update shm counters to indicate that at least one shared memory object changed
 		shmSettings->global_shm_counter++;
 		local_shm_counter++;
 	}
 
-	void *new_ptr = mremap(sharedMemory->ptr, sharedMemory->size, size, MREMAP_MAYMOVE);
+	// The object outgrew its reserved address range and has to be remapped
+	pthread_rwlock_wrlock(&remap_lock);
+	void *new_ptr = mremap(sharedMemory->ptr, sharedMemory->reserved, size, MREMAP_MAYMOVE);
 	if(new_ptr == MAP_FAILED)
 	{
 		logg("FATAL: realloc_shm(): mremap(%p, %zu, %zu, MREMAP_MAYMOVE): Failed to reallocate \"%s\": %s",
-		     sharedMemory->ptr, sharedMemory->size, size, sharedMemory->name,
+		     sharedMemory->ptr, sharedMemory->reserved, size, sharedMemory->name,
 		     strerror(errno));
 		exit(EXIT_FAILURE);
 	}
@@ -813,7 +1368,7 @@ static bool realloc_shm(SharedMemory *sharedMemory, const size_t size1, const si
 	// We add the difference between updated and previous size
 	used_shmem += (size - sharedMemory->size);
 
-	if(config.debug & DEBUG_SHMEM)
+	if(debug_enabled(DEBUG_SHMEM))
 	{
 		if(sharedMemory->ptr == new_ptr)
 			logg("SHMEM pointer not updated: %p (%zu %zu)",
@@ -825,6 +1380,8 @@ static bool realloc_shm(SharedMemory *sharedMemory, const size_t size1, const si
 
 	sharedMemory->ptr = new_ptr;
 	sharedMemory->size = size;
+	sharedMemory->reserved = size;
+	pthread_rwlock_unlock(&remap_lock);
 
 	return true;
 }
@@ -834,10 +1391,14 @@ static void delete_shm(SharedMemory *sharedMemory)
 	// Unmap shared memory (if mmapped)
 	if(sharedMemory->ptr != NULL)
 	{
-		if(munmap(sharedMemory->ptr, sharedMemory->size) != 0)
-			logg("delete_shm(): munmap(%p, %zu) failed: %s", sharedMemory->ptr, sharedMemory->size, strerror(errno));
+		if(munmap(sharedMemory->ptr, sharedMemory->reserved) != 0)
+			logg("delete_shm(): munmap(%p, %zu) failed: %s", sharedMemory->ptr, sharedMemory->reserved, strerror(errno));
 	}
 
+	// Anonymous objects are destroyed once all processes unmapped them
+	if(sharedMemory->memfd)
+		return;
+
 	// Now you can no longer `shm_open` the memory, and once all others
 	// unlink, it will be destroyed.
 	if(shm_unlink(sharedMemory->name) != 0)
@@ -866,7 +1427,7 @@ static size_t get_optimal_object_size(const size_t objsize, const size_t minsize
 	const size_t optsize = pagesize / gcd(pagesize, objsize);
 	if(optsize < minsize)
 	{
-		if(config.debug & DEBUG_SHMEM)
+		if(debug_enabled(DEBUG_SHMEM))
 		{
 			logg("DEBUG: LCM(%i, %zu) == %zu < %zu",
 			     pagesize, objsize,
@@ -880,7 +1441,7 @@ static size_t get_optimal_object_size(const size_t objsize, const size_t minsize
 		// Second part: Catch a possibly happened clipping event by adding
 		//              one to the number: (5 % 3 != 0) is 1
 		const size_t multiplier = (minsize/optsize) + ((minsize % optsize != 0) ? 1u : 0u);
-		if(config.debug & DEBUG_SHMEM)
+		if(debug_enabled(DEBUG_SHMEM))
 		{
 			logg("DEBUG: Using %zu*%zu == %zu >= %zu",
 			     multiplier, optsize*objsize,
@@ -893,7 +1454,7 @@ static size_t get_optimal_object_size(const size_t objsize, const size_t minsize
 	}
 	else
 	{
-		if(config.debug & DEBUG_SHMEM)
+		if(debug_enabled(DEBUG_SHMEM))
 		{
 			logg("DEBUG: LCM(%i, %zu) == %zu >= %zu",
 			     pagesize, objsize,
@@ -1057,7 +1618,7 @@ queriesData* _getQuery(int queryID, bool checkMagic, int line, const char *func,
 		return NULL;
 
 	// We are not in a locked situation, return a NULL pointer
-	if(config.debug & DEBUG_LOCKS && !is_our_lock())
+	if(debug_enabled(DEBUG_LOCKS) && !is_our_lock())
 	{
 		logg("ERROR: Tried to obtain query pointer without lock in %s() (%s:%i)!",
 		     func, short_path(file), line);
@@ -1079,7 +1640,7 @@ clientsData* _getClient(int clientID, bool checkMagic, int line, const char *fun
 		return NULL;
 
 	// We are not in a locked situation, return a NULL pointer
-	if(config.debug & DEBUG_LOCKS && !is_our_lock())
+	if(debug_enabled(DEBUG_LOCKS) && !is_our_lock())
 	{
 		logg("ERROR: Tried to obtain client pointer without lock in %s() (%s:%i)!",
 		     func, short_path(file), line);
@@ -1101,7 +1662,7 @@ domainsData* _getDomain(int domainID, bool checkMagic, int line, const char *fun
 		return NULL;
 
 	// We are not in a locked situation, return a NULL pointer
-	if(config.debug & DEBUG_LOCKS && !is_our_lock())
+	if(debug_enabled(DEBUG_LOCKS) && !is_our_lock())
 	{
 		logg("ERROR: Tried to obtain domain pointer without lock in %s() (%s:%i)!",
 		     func, short_path(file), line);
@@ -1123,7 +1684,7 @@ upstreamsData* _getUpstream(int upstreamID, bool checkMagic, int line, const cha
 		return NULL;
 
 	// We are not in a locked situation, return a NULL pointer
-	if(config.debug & DEBUG_LOCKS && !is_our_lock())
+	if(debug_enabled(DEBUG_LOCKS) && !is_our_lock())
 	{
 		logg("ERROR: Tried to obtain upstream pointer without lock in %s() (%s:%i)!",
 		     func, short_path(file), line);
@@ -1145,7 +1706,7 @@ DNSCacheData* _getDNSCache(int cacheID, bool checkMagic, int line, const char *f
 		return NULL;
 
 	// We are not in a locked situation, return a NULL pointer
-	if(config.debug & DEBUG_LOCKS && !is_our_lock())
+	if(debug_enabled(DEBUG_LOCKS) && !is_our_lock())
 	{
 		logg("ERROR: Tried to obtain cache pointer without lock in %s() (%s:%i)!",
 		     func, short_path(file), line);
@@ -1159,3 +1720,65 @@ DNSCacheData* _getDNSCache(int cacheID, bool checkMagic, int line, const char *f
 	else
 		return NULL;
 }
+
+// Get memory statistics of the mapping starting at ptr from /proc/self/smaps
+// (values are in kB)
+static bool get_mapping_details(const void *ptr, unsigned long *rss, unsigned long *huge,
+                                unsigned long *pagesz)
+{
+	FILE *fp = fopen("/proc/self/smaps", "r");
+	if(fp == NULL)
+		return false;
+
+	char line[256];
+	bool found = false;
+	*rss = *huge = *pagesz = 0ul;
+	while(fgets(line, sizeof(line), fp) != NULL)
+	{
+		// Mapping header lines start with the address range
+		unsigned long start = 0ul, end = 0ul;
+		if(sscanf(line, "%lx-%lx ", &start, &end) == 2)
+		{
+			if(found)
+				break;
+			found = (start == (uintptr_t)ptr);
+			continue;
+		}
+		if(!found)
+			continue;
+
+		unsigned long value = 0ul;
+		if(sscanf(line, "Rss: %lu kB", &value) == 1)
+			*rss = value;
+		else if(sscanf(line, "ShmemPmdMapped: %lu kB", &value) == 1 ||
+		        sscanf(line, "FilePmdMapped: %lu kB", &value) == 1)
+			*huge += value;
+		else if(sscanf(line, "KernelPageSize: %lu kB", &value) == 1)
+			*pagesz = value;
+	}
+	fclose(fp);
+
+	return found;
+}
+
+// Log size, reservation and effective page size of all shared memory objects
+void log_shmem_details(void)
+{
+	logg("Shared memory objects (page size %d bytes, huge pages %s):", pagesize,
+	     hugepagesize > 0 ? "enabled" : "disabled");
+	for(unsigned int i = 0; i < NUM_SHMEM; i++)
+	{
+		const SharedMemory *sharedMemory = sharedMemories[i];
+		if(sharedMemory->ptr == NULL)
+			continue;
+
+		unsigned long rss = 0ul, huge = 0ul, pagesz = 0ul;
+		if(get_mapping_details(sharedMemory->ptr, &rss, &huge, &pagesz))
+			logg("  %-20s %10zu bytes (%zu reserved), %lu kB resident, %lu kB in huge pages, %lu kB pages",
+			     sharedMemory->name, sharedMemory->size, sharedMemory->reserved,
+			     rss, huge, pagesz);
+		else
+			logg("  %-20s %10zu bytes (%zu reserved)",
+			     sharedMemory->name, sharedMemory->size, sharedMemory->reserved);
+	}
+}
@@ -21,7 +21,12 @@
 typedef struct {
     const char *name;
     size_t size;
+    // Size of the virtual address range mapped for this object. The
+    // object can grow up to this size without being remapped
+    size_t reserved;
     void *ptr;
+    // Anonymous (memfd) objects are not visible in /dev/shm
+    bool memfd;
 } SharedMemory;
 
 typedef struct {
@@ -58,9 +63,11 @@ extern countersStruct *counters;
 ///
 /// \param name the name of the shared memory
 /// \param size the size to allocate
+/// \param reserve the size of the virtual address range to reserve
 /// \return a structure with a pointer to the mounted shared memory. The pointer
 /// will always be valid, because if it failed FTL will have exited.
-static SharedMemory create_shm(const char *name, const size_t size);
+static SharedMemory create_shm(const char *name, const size_t size, const size_t reserve);
+static SharedMemory create_shm_memfd(const char *name, const size_t size, const size_t reserve);
 
 /// Reallocate shared memory
 ///
@@ -101,9 +108,20 @@ void _unlock_log(const char* func, const int line, const char * file);
 
 bool init_shmem(void);
 void destroy_shmem(void);
+
+// Read-only access to the shared memory objects of a running FTL instance
+// How long should lockless readers wait for a writer to release the lock? [ms]
+#define SHM_READ_WAIT 1000
+bool attach_shmem(void);
+unsigned int shm_read_begin(void);
+bool shm_read_retry(const unsigned int seq);
+void shm_read_lock(void);
+void shm_read_unlock(void);
+bool shm_replaced(void);
 size_t addstr(const char *str);
 #define getstr(pos) _getstr(pos, __FUNCTION__, __LINE__, __FILE__)
 const char *_getstr(const size_t pos, const char *func, const int line, const char *file);
+bool getstrpos(const char *str, size_t *pos);
 
 /**
  * Escapes a string by replacing special characters, such as spaces
@@ -114,7 +132,7 @@ char *str_escape(const char *input, unsigned int *N) __attribute__ ((malloc));
 /**
  * Compare two strings. Escape them if needed
  */
-bool strcmp_escaped(const char *a, const char *b);
+bool strcmp_escaped(const char *a, const char *b) __attribute__((pure));
 
 /**
  * Create a new overTime client shared memory block.
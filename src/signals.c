@@ -318,6 +318,11 @@ static void SIGRT_handler(int signum, siginfo_t *si, void *unused)
 		// Parse neighbor cache
 		set_event(PARSE_NEIGHBOR_CACHE);
 	}
+	else if(rtsig == 6)
+	{
+		// Write allocation profile into the log
+		set_event(DUMP_ALLOC_PROFILE);
+	}
 
 	// Restore errno before returning back to previous context
 	errno = _errno;
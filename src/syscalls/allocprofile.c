@@ -0,0 +1,273 @@
+/* Pi-hole: A black hole for Internet advertisements
+*  (c) 2023 Pi-hole, LLC (https://pi-hole.net)
+*  Network-wide ad blocking via your own hardware.
+*
+*  FTL Engine
+*  Allocation profiler for the memory syscall wrappers
+*
+*  This file is copyright under the latest version of the EUPL.
+*  Please see LICENSE file for your rights under this license. */
+
+#include "../FTL.h"
+//#include "syscalls.h" is implicitly done in FTL.h
+#include "../log.h"
+#include <stdatomic.h>
+#include <stdint.h>
+// mmap()
+#include <sys/mman.h>
+
+// Allocations are aggregated per call site (file + line). Sites are never
+// removed from the table. Live allocations are tracked in a second table
+// mapping the returned pointer to its size and call site so that frees can
+// be attributed to the site which allocated the memory. Both tables use open
+// addressing and atomic operations only, they can be used concurrently from
+// all threads without locking. Each process (incl. TCP workers) has its own
+// copy of the tables
+#define ALLOC_SITES 1024u
+#define ALLOC_PTRS (1u << 18)
+// Maximum number of probes before we give up tracking a pointer
+#define ALLOC_PROBES 64u
+
+// Marks a pointer slot whose allocation has been freed
+#define PTR_TOMBSTONE ((uintptr_t)1)
+
+struct alloc_site {
+	_Atomic uint64_t key;
+	const char *file;
+	const char *func;
+	int line;
+	atomic_ullong allocs;
+	atomic_ullong frees;
+	atomic_ullong total;
+	atomic_llong live;
+	atomic_llong peak;
+};
+
+struct alloc_ptr {
+	_Atomic uintptr_t ptr;
+	size_t size;
+	unsigned int site;
+};
+
+static struct alloc_site *sites = NULL;
+static struct alloc_ptr *ptrs = NULL;
+static atomic_llong live_bytes = 0;
+static atomic_llong peak_bytes = 0;
+static atomic_ullong untracked = 0;
+static atomic_bool enabled = false;
+
+// Allocate the tables. The tables themselves are not allocated through the
+// wrappers so they do not show up in the profile
+void alloc_profile_init(void)
+{
+	if(atomic_load(&enabled))
+		return;
+
+	sites = mmap(NULL, ALLOC_SITES*sizeof(struct alloc_site), PROT_READ | PROT_WRITE,
+	             MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	ptrs = mmap(NULL, ALLOC_PTRS*sizeof(struct alloc_ptr), PROT_READ | PROT_WRITE,
+	            MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+	if(sites == MAP_FAILED || ptrs == MAP_FAILED)
+	{
+		logg("WARN: Cannot allocate memory for the allocation profiler: %s", strerror(errno));
+		sites = NULL;
+		ptrs = NULL;
+		return;
+	}
+
+	atomic_store(&enabled, true);
+}
+
+static inline void update_max(atomic_llong *max, const long long value)
+{
+	long long old = atomic_load_explicit(max, memory_order_relaxed);
+	while(value > old &&
+	      !atomic_compare_exchange_weak_explicit(max, &old, value, memory_order_relaxed, memory_order_relaxed));
+}
+
+static inline unsigned int hash_ptr(const uintptr_t ptr)
+{
+	// Fibonacci hashing, memory returned by malloc() is at least 8 bytes
+	// aligned so we drop the lowest bits
+	return (unsigned int)(((uint64_t)(ptr >> 3) * 11400714819323198485ULL) >> 40);
+}
+
+static struct alloc_site *find_site(const char *file, const char *func, const int line)
+{
+	// Pointers to (user-space) string literals are below 2^48 so this key
+	// is unique for all sites in files with less than 65536 lines
+	const uint64_t key = ((uint64_t)(uintptr_t)file << 16) ^ (uint16_t)line;
+	const unsigned int hash = (unsigned int)((key * 11400714819323198485ULL) >> 40);
+	for(unsigned int i = 0; i < ALLOC_PROBES; i++)
+	{
+		struct alloc_site *site = &sites[(hash + i) % ALLOC_SITES];
+		uint64_t old = atomic_load_explicit(&site->key, memory_order_acquire);
+		if(old == key)
+			return site;
+		if(old == 0 &&
+		   (atomic_compare_exchange_strong(&site->key, &old, key) || old == key))
+		{
+			// We claimed the slot (or somebody else did it for this
+			// site at the same time)
+			site->file = file;
+			site->func = func;
+			site->line = line;
+			return site;
+		}
+	}
+	return NULL;
+}
+
+// Record an allocation of size bytes at ptr
+void alloc_profile_add(void *ptr, const size_t size, const char *file, const char *func, const int line)
+{
+	if(!atomic_load_explicit(&enabled, memory_order_relaxed) || ptr == NULL)
+		return;
+
+	struct alloc_site *site = find_site(file, func, line);
+	if(site == NULL)
+	{
+		atomic_fetch_add_explicit(&untracked, 1, memory_order_relaxed);
+		return;
+	}
+
+	// Remember which site allocated this memory
+	const unsigned int hash = hash_ptr((uintptr_t)ptr);
+	struct alloc_ptr *slot = NULL;
+	for(unsigned int i = 0; i < ALLOC_PROBES; i++)
+	{
+		struct alloc_ptr *p = &ptrs[(hash + i) % ALLOC_PTRS];
+		uintptr_t old = atomic_load_explicit(&p->ptr, memory_order_relaxed);
+		if((old == 0 || old == PTR_TOMBSTONE) &&
+		   atomic_compare_exchange_strong(&p->ptr, &old, (uintptr_t)ptr))
+		{
+			slot = p;
+			break;
+		}
+	}
+	if(slot == NULL)
+	{
+		atomic_fetch_add_explicit(&untracked, 1, memory_order_relaxed);
+		return;
+	}
+	slot->size = size;
+	slot->site = (unsigned int)(site - sites);
+
+	atomic_fetch_add_explicit(&site->allocs, 1, memory_order_relaxed);
+	atomic_fetch_add_explicit(&site->total, size, memory_order_relaxed);
+	update_max(&site->peak, atomic_fetch_add_explicit(&site->live, size, memory_order_relaxed) + size);
+	update_max(&peak_bytes, atomic_fetch_add_explicit(&live_bytes, size, memory_order_relaxed) + size);
+}
+
+// Record that the memory at ptr is freed. Memory which was not allocated while
+// the profiler was active (or by the C library) is ignored
+void alloc_profile_remove(void *ptr)
+{
+	if(!atomic_load_explicit(&enabled, memory_order_relaxed) || ptr == NULL)
+		return;
+
+	const unsigned int hash = hash_ptr((uintptr_t)ptr);
+	for(unsigned int i = 0; i < ALLOC_PROBES; i++)
+	{
+		struct alloc_ptr *p = &ptrs[(hash + i) % ALLOC_PTRS];
+		const uintptr_t old = atomic_load_explicit(&p->ptr, memory_order_relaxed);
+		if(old == 0)
+			return;
+		if(old != (uintptr_t)ptr)
+			continue;
+
+		struct alloc_site *site = &sites[p->site];
+		atomic_fetch_add_explicit(&site->frees, 1, memory_order_relaxed);
+		atomic_fetch_sub_explicit(&site->live, p->size, memory_order_relaxed);
+		atomic_fetch_sub_explicit(&live_bytes, p->size, memory_order_relaxed);
+		atomic_store_explicit(&p->ptr, PTR_TOMBSTONE, memory_order_release);
+		return;
+	}
+}
+
+static int alloc_stat_cmp(const void *a, const void *b)
+{
+	const struct alloc_stat *sa = a, *sb = b;
+	if(sa->live < sb->live)
+		return 1;
+	if(sa->live > sb->live)
+		return -1;
+	if(sa->allocs < sb->allocs)
+		return 1;
+	if(sa->allocs > sb->allocs)
+		return -1;
+	return 0;
+}
+
+// Copy the statistics of up to num call sites into out, sorted by the number
+// of live bytes (descending). Returns the number of sites copied
+unsigned int get_alloc_profile(struct alloc_stat *out, const unsigned int num, struct alloc_summary *summary)
+{
+	memset(summary, 0, sizeof(*summary));
+	summary->enabled = atomic_load(&enabled);
+	if(!summary->enabled)
+		return 0;
+
+	summary->live = atomic_load(&live_bytes);
+	summary->peak = atomic_load(&peak_bytes);
+	summary->untracked = atomic_load(&untracked);
+
+	// Take a snapshot of all sites. We use the C library directly as the
+	// snapshot itself should not show up in the profile
+	struct alloc_stat *all = (calloc)(ALLOC_SITES, sizeof(struct alloc_stat));
+	if(all == NULL)
+		return 0;
+
+	unsigned int n = 0;
+	for(unsigned int i = 0; i < ALLOC_SITES; i++)
+	{
+		const struct alloc_site *site = &sites[i];
+		if(atomic_load(&site->key) == 0 || site->file == NULL)
+			continue;
+		all[n].file = short_path(site->file);
+		all[n].func = site->func;
+		all[n].line = site->line;
+		all[n].allocs = atomic_load(&site->allocs);
+		all[n].frees = atomic_load(&site->frees);
+		all[n].total = atomic_load(&site->total);
+		all[n].live = atomic_load(&site->live);
+		all[n].peak = atomic_load(&site->peak);
+		n++;
+	}
+	summary->sites = n;
+
+	qsort(all, n, sizeof(struct alloc_stat), alloc_stat_cmp);
+	if(n > num)
+		n = num;
+	memcpy(out, all, n*sizeof(struct alloc_stat));
+	(free)(all);
+
+	return n;
+}
+
+// Write the profile into the log file
+void log_alloc_profile(const unsigned int num)
+{
+	struct alloc_summary summary;
+	struct alloc_stat *stats = calloc(num, sizeof(struct alloc_stat));
+	if(stats == NULL)
+		return;
+
+	const unsigned int n = get_alloc_profile(stats, num, &summary);
+	if(!summary.enabled)
+	{
+		logg("Allocation profiler is disabled (ALLOC_PROFILE)");
+		free(stats);
+		return;
+	}
+
+	logg("Allocation profile: %lld bytes live (peak %lld) in %u call sites, %llu allocations not tracked",
+	     summary.live, summary.peak, summary.sites, summary.untracked);
+	logg("      live       peak    allocs     frees      total  call site");
+	for(unsigned int i = 0; i < n; i++)
+		logg("%10lld %10lld %9llu %9llu %10llu  %s() (%s:%i)",
+		     stats[i].live, stats[i].peak, stats[i].allocs, stats[i].frees,
+		     stats[i].total, stats[i].func, stats[i].file, stats[i].line);
+
+	free(stats);
+}
@@ -38,6 +38,9 @@ void* __attribute__((malloc)) __attribute__((alloc_size(1,2))) FTLcalloc(const s
 		logg("FATAL: Memory allocation (%zu x %zu) failed in %s() (%s:%i)",
 		     nmemb, size, func, file, line);
 
+	// Record allocation (if profiling is enabled)
+	alloc_profile_add(ptr, nmemb*size, file, func, line);
+
 	// Restore errno value
 	errno = _errno;
 
@@ -25,5 +25,6 @@ void FTLfree(void *ptr, const char *file, const char *func, const int line)
 		return;
 	}
 
+	alloc_profile_remove(ptr);
 	free(ptr);
 }
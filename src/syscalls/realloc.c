@@ -25,6 +25,11 @@ void __attribute__((alloc_size(2))) *FTLrealloc(void *ptr_in, const size_t size,
 	// have been returned by an earlier call to malloc(), calloc() or realloc().
 	// If the area pointed to was moved, a free(ptr) is done implicitly.
 	void *ptr_out = NULL;
+
+	// Stop tracking the old memory before it is released. Another thread
+	// may get the same address from malloc() right after realloc() moved
+	// the memory
+	alloc_profile_remove(ptr_in);
 	do
 	{
 		errno = 0;
@@ -42,6 +47,9 @@ void __attribute__((alloc_size(2))) *FTLrealloc(void *ptr_in, const size_t size,
 		logg("FATAL: Memory reallocation (%p -> %zu) failed in %s() (%s:%i)",
 		     ptr_in, size, func, file, line);
 
+	// Record new allocation (if profiling is enabled)
+	alloc_profile_add(ptr_out, size, file, func, line);
+
 	// Restore errno value
 	errno = _errno;
 
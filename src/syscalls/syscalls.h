@@ -47,6 +47,32 @@ int FTLpthread_mutex_lock(pthread_mutex_t *__mutex, const char *file, const char
 // Interrupt-safe file routines
 FILE *FTLfopen(const char *pathname, const char *mode, const char *file, const char *func, const int line) __attribute__ ((__malloc__));
 
+// Allocation profiler
+struct alloc_stat {
+	const char *file;
+	const char *func;
+	int line;
+	unsigned long long allocs;
+	unsigned long long frees;
+	unsigned long long total;
+	long long live;
+	long long peak;
+};
+
+struct alloc_summary {
+	bool enabled;
+	unsigned int sites;
+	unsigned long long untracked;
+	long long live;
+	long long peak;
+};
+
+void alloc_profile_init(void);
+void alloc_profile_add(void *ptr, const size_t size, const char *file, const char *func, const int line);
+void alloc_profile_remove(void *ptr);
+unsigned int get_alloc_profile(struct alloc_stat *out, const unsigned int num, struct alloc_summary *summary);
+void log_alloc_profile(const unsigned int num);
+
 // Syscall helpers
 void syscalls_report_error(const char *error, FILE *stream, const int _errno, const char *format, const char *func, const char *file, const int line);
 
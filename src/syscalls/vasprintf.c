@@ -54,6 +54,10 @@ int FTLvasprintf(const char *file, const char *func, const int line, char **buff
 		                      stdout, _errno, format, func, file, line);
 	}
 
+	// Record allocation (if profiling is enabled)
+	if(length >= 0)
+		alloc_profile_add(*buffer, length + 1, file, func, line);
+
 	// Restore errno value
 	errno = _errno;
 
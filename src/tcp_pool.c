@@ -0,0 +1,737 @@
+/* Pi-hole: A black hole for Internet advertisements
+*  (c) 2023 Pi-hole, LLC (https://pi-hole.net)
+*  Network-wide ad blocking via your own hardware.
+*
+*  FTL Engine
+*  TCP upstream connection pool
+*
+*  This file is copyright under the latest version of the EUPL.
+*  Please see LICENSE file for your rights under this license. */
+
+#define FTLDNS
+#include "dnsmasq/dnsmasq.h"
+#undef __USE_XOPEN
+#include "FTL.h"
+#include "tcp_pool.h"
+// logg()
+#include "log.h"
+// struct config
+#include "config.h"
+// killed, thread_names[], thread_cancellable[]
+#include "signals.h"
+#include <sys/un.h>
+#include <netinet/tcp.h>
+
+// dnsmasq handles each TCP client in a forked worker process which opens its
+// own connections to the upstream servers. Every worker pays a TCP handshake
+// for its first query and the connections are closed when the worker
+// terminates.
+//
+// This thread keeps persistent connections to the upstream servers instead.
+// The workers hand their queries to it through a local socket. Queries of
+// all workers are pipelined on the same connections (RFC 7766), each one
+// with a query ID identifying the slot it occupies so replies can be
+// matched in any order. Idle connections are closed after TCP_POOL_IDLE
+// seconds. Whenever the pool cannot answer a query, the worker falls back to
+// connecting to the upstream itself
+
+enum reply_status { POOL_FAILED, POOL_OK };
+
+// Query as sent by the workers, followed by the DNS packet (without length)
+struct pool_request {
+	union mysockaddr addr;
+	union mysockaddr source_addr;
+	char interface[IF_NAMESIZE+1];
+	unsigned int ifindex;
+};
+
+struct pool_slot {
+	bool used;
+	u16 id;
+	u16 orig_id;
+	int client;
+	unsigned long client_serial;
+	time_t sent;
+};
+
+struct pool_conn {
+	int fd;
+	bool connected;
+	// Incremented whenever the connection is (re)opened
+	unsigned int serial;
+	unsigned int inflight;
+	unsigned long queries;
+	u16 gen;
+	time_t last_used;
+	// Queries not yet written to the socket
+	unsigned char *tx;
+	size_t tx_len, tx_size;
+	// Partially received reply (length prefix + up to 64 KB)
+	unsigned char *rx;
+	size_t rx_len;
+	struct pool_slot slot[TCP_POOL_PIPELINE];
+};
+
+struct pool_upstream {
+	union mysockaddr addr;
+	union mysockaddr source_addr;
+	char interface[IF_NAMESIZE+1];
+	unsigned int ifindex;
+	unsigned int failures_in_row;
+	time_t down_until;
+	unsigned long queries, reused, connects, failures, timeouts;
+	struct pool_conn conn[TCP_POOL_CONNS];
+};
+
+struct pool_client {
+	int fd;
+	unsigned long serial;
+};
+
+#define RX_SIZE (sizeof(u16) + 65535)
+
+static struct pool_upstream upstreams[TCP_POOL_MAX_UPSTREAMS];
+static unsigned int num_upstreams = 0;
+static struct pool_client clients[TCP_POOL_MAX_CLIENTS];
+static unsigned long client_serial = 0;
+static pthread_mutex_t pool_lock = PTHREAD_MUTEX_INITIALIZER;
+
+// Pool socket and its address (set before the first TCP worker is forked)
+static int pool_listenfd = -1;
+static struct sockaddr_un pool_addr = { 0 };
+static socklen_t pool_addrlen = 0;
+
+// Connection of this TCP worker to the pool
+static int pool_fd = -1;
+
+static void get_ip_port(const union mysockaddr *addr, char ip[ADDRSTRLEN+1], in_port_t *port)
+{
+	if(addr->sa.sa_family == AF_INET6)
+	{
+		inet_ntop(AF_INET6, &addr->in6.sin6_addr, ip, ADDRSTRLEN);
+		*port = ntohs(addr->in6.sin6_port);
+	}
+	else
+	{
+		inet_ntop(AF_INET, &addr->in.sin_addr, ip, ADDRSTRLEN);
+		*port = ntohs(addr->in.sin_port);
+	}
+}
+
+// Send a reply (or a failure if payload is NULL) to a TCP worker
+static void send_reply(const int client, const unsigned long serial, unsigned char *payload, const size_t len)
+{
+	if(client < 0 || clients[client].fd == -1 || clients[client].serial != serial)
+		return;
+
+	unsigned char status = payload != NULL ? POOL_OK : POOL_FAILED;
+	struct iovec iov[2] = {
+		{ .iov_base = &status, .iov_len = sizeof(status) },
+		{ .iov_base = payload, .iov_len = payload != NULL ? len : 0 }
+	};
+	struct msghdr msg = { .msg_iov = iov, .msg_iovlen = 2 };
+	if(sendmsg(clients[client].fd, &msg, MSG_DONTWAIT | MSG_NOSIGNAL) == -1 &&
+	   debug_enabled(DEBUG_QUERIES))
+		logg("TCP pool: Cannot send reply to worker: %s", strerror(errno));
+}
+
+static unsigned int count_connections(const struct pool_upstream *up, unsigned int *inflight)
+{
+	unsigned int n = 0;
+	for(unsigned int i = 0; i < TCP_POOL_CONNS; i++)
+	{
+		if(up->conn[i].fd == -1)
+			continue;
+		n++;
+		if(inflight != NULL)
+			*inflight += up->conn[i].inflight;
+	}
+	return n;
+}
+
+// Close a connection. Queries still in flight fail, the worker will retry
+// them on its own
+static void close_conn(struct pool_upstream *up, struct pool_conn *conn, const bool failed, const time_t now)
+{
+	if(conn->fd == -1)
+		return;
+
+	if(failed)
+	{
+		up->failures++;
+		// A server closing a connection after having replied to us
+		// works, it may just not support pipelining. Failing to
+		// connect at all repeatedly takes it out of the pool for a
+		// while
+		if(conn->queries == conn->inflight && ++up->failures_in_row >= TCP_POOL_MAX_FAILURES)
+		{
+			up->down_until = now + TCP_POOL_BACKOFF;
+			if(debug_enabled(DEBUG_QUERIES))
+			{
+				char ip[ADDRSTRLEN+1] = { 0 };
+				in_port_t port = 0;
+				get_ip_port(&up->addr, ip, &port);
+				logg("TCP pool: %s#%u failed %u times in a row, not using it for %d seconds",
+				     ip, port, up->failures_in_row, TCP_POOL_BACKOFF);
+			}
+		}
+	}
+
+	for(unsigned int i = 0; i < TCP_POOL_PIPELINE; i++)
+	{
+		struct pool_slot *slot = &conn->slot[i];
+		if(!slot->used)
+			continue;
+		send_reply(slot->client, slot->client_serial, NULL, 0);
+		slot->used = false;
+	}
+
+	shutdown(conn->fd, SHUT_RDWR);
+	close(conn->fd);
+	conn->fd = -1;
+	conn->connected = false;
+	conn->inflight = 0;
+	conn->queries = 0;
+	conn->tx_len = 0;
+	conn->rx_len = 0;
+	if(conn->tx != NULL)
+		free(conn->tx);
+	conn->tx = NULL;
+	conn->tx_size = 0;
+	if(conn->rx != NULL)
+		free(conn->rx);
+	conn->rx = NULL;
+}
+
+static bool open_conn(struct pool_upstream *up, struct pool_conn *conn, const time_t now)
+{
+	conn->fd = socket(up->addr.sa.sa_family, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+	if(conn->fd == -1)
+		return false;
+
+	conn->rx = malloc(RX_SIZE);
+	if(conn->rx == NULL || !local_bind(conn->fd, &up->source_addr, up->interface, up->ifindex, 1))
+	{
+		close_conn(up, conn, true, now);
+		return false;
+	}
+
+#ifdef TCP_SYNCNT
+	// Do not wait for ages if the server is not reachable
+	const unsigned int syncnt = 2;
+	setsockopt(conn->fd, IPPROTO_TCP, TCP_SYNCNT, &syncnt, sizeof(syncnt));
+#endif
+
+	up->connects++;
+	conn->serial++;
+	conn->last_used = now;
+	if(connect(conn->fd, &up->addr.sa, sa_len(&up->addr)) == 0)
+		conn->connected = true;
+	else if(errno != EINPROGRESS)
+	{
+		close_conn(up, conn, true, now);
+		return false;
+	}
+
+	return true;
+}
+
+// Write as much of the pending queries as the socket accepts
+static void flush_conn(struct pool_upstream *up, struct pool_conn *conn, const time_t now)
+{
+	if(!conn->connected || conn->tx_len == 0)
+		return;
+
+	const ssize_t n = send(conn->fd, conn->tx, conn->tx_len, MSG_NOSIGNAL);
+	if(n == -1)
+	{
+		if(errno != EAGAIN && errno != EINTR)
+			close_conn(up, conn, true, now);
+		return;
+	}
+
+	conn->tx_len -= n;
+	memmove(conn->tx, conn->tx + n, conn->tx_len);
+}
+
+static struct pool_upstream *find_upstream(const struct pool_request *req)
+{
+	for(unsigned int i = 0; i < num_upstreams; i++)
+	{
+		struct pool_upstream *up = &upstreams[i];
+		if(sockaddr_isequal(&up->addr, &req->addr) &&
+		   sockaddr_isequal(&up->source_addr, &req->source_addr) &&
+		   up->ifindex == req->ifindex &&
+		   strcmp(up->interface, req->interface) == 0)
+			return up;
+	}
+
+	if(num_upstreams >= TCP_POOL_MAX_UPSTREAMS)
+		return NULL;
+
+	struct pool_upstream *up = &upstreams[num_upstreams++];
+	memset(up, 0, sizeof(*up));
+	memcpy(&up->addr, &req->addr, sizeof(up->addr));
+	memcpy(&up->source_addr, &req->source_addr, sizeof(up->source_addr));
+	memcpy(up->interface, req->interface, sizeof(up->interface));
+	up->interface[IF_NAMESIZE] = '\0';
+	up->ifindex = req->ifindex;
+	for(unsigned int i = 0; i < TCP_POOL_CONNS; i++)
+		up->conn[i].fd = -1;
+	return up;
+}
+
+// Pick the least busy connection to this upstream. A new connection is only
+// opened when all existing ones are full
+static struct pool_conn *get_conn(struct pool_upstream *up, const time_t now)
+{
+	struct pool_conn *best = NULL, *unused = NULL;
+	for(unsigned int i = 0; i < TCP_POOL_CONNS; i++)
+	{
+		struct pool_conn *conn = &up->conn[i];
+		if(conn->fd == -1)
+		{
+			if(unused == NULL)
+				unused = conn;
+			continue;
+		}
+		if(conn->inflight < TCP_POOL_PIPELINE && (best == NULL || conn->inflight < best->inflight))
+			best = conn;
+	}
+
+	if(best != NULL)
+		return best;
+	if(unused != NULL && open_conn(up, unused, now))
+		return unused;
+	return NULL;
+}
+
+// Forward a query received from a TCP worker
+static void handle_request(const int client, unsigned char *msg, const size_t len, const time_t now)
+{
+	struct pool_request req;
+	unsigned char *query = msg + sizeof(struct pool_request);
+	const size_t qlen = len - sizeof(struct pool_request);
+	struct pool_upstream *up = NULL;
+	struct pool_conn *conn = NULL;
+
+	if(len >= sizeof(struct pool_request))
+		memcpy(&req, msg, sizeof(req));
+
+	if(len < sizeof(struct pool_request) + sizeof(struct dns_header) ||
+	   qlen > 65535 ||
+	   (up = find_upstream(&req)) == NULL ||
+	   now < up->down_until ||
+	   (conn = get_conn(up, now)) == NULL)
+	{
+		send_reply(client, clients[client].serial, NULL, 0);
+		return;
+	}
+
+	// Make room for the query and its length prefix
+	if(conn->tx_len + sizeof(u16) + qlen > conn->tx_size)
+	{
+		const size_t size = conn->tx_len + sizeof(u16) + qlen;
+		unsigned char *tx = realloc(conn->tx, size);
+		if(tx == NULL)
+		{
+			send_reply(client, clients[client].serial, NULL, 0);
+			return;
+		}
+		conn->tx = tx;
+		conn->tx_size = size;
+	}
+
+	unsigned int s = 0;
+	while(conn->slot[s].used)
+		s++;
+
+	// The lower bits of the ID we send identify the slot, the upper bits
+	// make sure a late reply to an earlier query in the same slot is not
+	// taken for the current one
+	struct pool_slot *slot = &conn->slot[s];
+	slot->used = true;
+	slot->id = (u16)(++conn->gen * TCP_POOL_PIPELINE + s);
+	slot->client = client;
+	slot->client_serial = clients[client].serial;
+	slot->sent = now;
+
+	// The ID is the first field of the DNS header
+	unsigned char *p = query;
+	GETSHORT(slot->orig_id, p);
+	p = query;
+	PUTSHORT(slot->id, p);
+
+	p = conn->tx + conn->tx_len;
+	PUTSHORT(qlen, p);
+	memcpy(p, query, qlen);
+	conn->tx_len += sizeof(u16) + qlen;
+
+	up->queries++;
+	if(conn->queries++ > 0)
+		up->reused++;
+	conn->inflight++;
+	conn->last_used = now;
+
+	flush_conn(up, conn, now);
+}
+
+// Hand a complete reply to the worker waiting for it
+static void handle_reply(struct pool_upstream *up, struct pool_conn *conn, unsigned char *reply, const size_t len, const time_t now)
+{
+	if(len < sizeof(struct dns_header))
+		return;
+
+	u16 id;
+	unsigned char *p = reply;
+	GETSHORT(id, p);
+	struct pool_slot *slot = &conn->slot[id % TCP_POOL_PIPELINE];
+	if(!slot->used || slot->id != id)
+		return;
+
+	p = reply;
+	PUTSHORT(slot->orig_id, p);
+	send_reply(slot->client, slot->client_serial, reply, len);
+
+	slot->used = false;
+	conn->inflight--;
+	conn->last_used = now;
+	up->failures_in_row = 0;
+}
+
+static void read_conn(struct pool_upstream *up, struct pool_conn *conn, const time_t now)
+{
+	const ssize_t n = recv(conn->fd, conn->rx + conn->rx_len, RX_SIZE - conn->rx_len, 0);
+	if(n == 0 || (n == -1 && errno != EAGAIN && errno != EINTR))
+	{
+		// The server closing an idle connection is not an error
+		close_conn(up, conn, conn->inflight > 0, now);
+		return;
+	}
+	else if(n == -1)
+		return;
+
+	conn->rx_len += n;
+
+	// Process all complete replies in the buffer
+	size_t pos = 0;
+	while(conn->rx_len - pos >= sizeof(u16))
+	{
+		const size_t len = (conn->rx[pos] << 8) | conn->rx[pos + 1];
+		if(conn->rx_len - pos < sizeof(u16) + len)
+			break;
+		handle_reply(up, conn, conn->rx + pos + sizeof(u16), len, now);
+		pos += sizeof(u16) + len;
+	}
+
+	conn->rx_len -= pos;
+	memmove(conn->rx, conn->rx + pos, conn->rx_len);
+}
+
+// Fail queries which have not been answered in time and close idle
+// connections
+static void check_timeouts(const time_t now)
+{
+	for(unsigned int i = 0; i < num_upstreams; i++)
+	{
+		struct pool_upstream *up = &upstreams[i];
+		for(unsigned int j = 0; j < TCP_POOL_CONNS; j++)
+		{
+			struct pool_conn *conn = &up->conn[j];
+			if(conn->fd == -1)
+				continue;
+
+			for(unsigned int k = 0; k < TCP_POOL_PIPELINE; k++)
+			{
+				struct pool_slot *slot = &conn->slot[k];
+				if(!slot->used || now - slot->sent < TCP_POOL_TIMEOUT)
+					continue;
+				send_reply(slot->client, slot->client_serial, NULL, 0);
+				slot->used = false;
+				conn->inflight--;
+				up->timeouts++;
+			}
+
+			if(!conn->connected && now - conn->last_used >= TCP_POOL_TIMEOUT)
+				close_conn(up, conn, true, now);
+			else if(conn->inflight == 0 && now - conn->last_used >= (time_t)config.tcp_pool_idle)
+				close_conn(up, conn, false, now);
+		}
+	}
+}
+
+static void accept_client(const int listenfd)
+{
+	const int fd = accept4(listenfd, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC);
+	if(fd == -1)
+		return;
+
+	// Only our own TCP workers may use the pool. Everybody else could make
+	// us connect anywhere
+	struct ucred cred;
+	socklen_t credlen = sizeof(cred);
+	if(getsockopt(fd, SOL_SOCKET, SO_PEERCRED, &cred, &credlen) == -1 ||
+	   cred.uid != geteuid())
+	{
+		close(fd);
+		return;
+	}
+
+	for(unsigned int i = 0; i < TCP_POOL_MAX_CLIENTS; i++)
+	{
+		if(clients[i].fd != -1)
+			continue;
+		clients[i].fd = fd;
+		clients[i].serial = ++client_serial;
+		return;
+	}
+
+	// No free slot, the worker will connect to the upstream itself
+	close(fd);
+}
+
+// Called before dnsmasq forks any TCP worker: the workers only see the
+// address of the socket if it was set before they were forked
+void listen_tcp_pool(void)
+{
+	if(!config.tcp_pool)
+		return;
+
+	const int fd = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+	if(fd == -1)
+	{
+		logg("TCP pool: Cannot create socket: %s", strerror(errno));
+		return;
+	}
+
+	// Abstract socket (leading NUL byte), it vanishes with the process
+	struct sockaddr_un addr = { .sun_family = AF_UNIX };
+	const int len = snprintf(addr.sun_path + 1, sizeof(addr.sun_path) - 1,
+	                         "pihole-FTL.tcp-pool.%d", (int)getpid());
+	const socklen_t addrlen = offsetof(struct sockaddr_un, sun_path) + 1 + len;
+	if(bind(fd, (struct sockaddr *)&addr, addrlen) == -1 || listen(fd, TCP_POOL_MAX_CLIENTS) == -1)
+	{
+		logg("TCP pool: Cannot listen: %s", strerror(errno));
+		close(fd);
+		return;
+	}
+
+	memcpy(&pool_addr, &addr, sizeof(pool_addr));
+	pool_addrlen = addrlen;
+	pool_listenfd = fd;
+}
+
+void *TCPpool_thread(void *val)
+{
+	// Set thread name
+	thread_names[TCPpool] = "TCP pool";
+	prctl(PR_SET_NAME, thread_names[TCPpool], 0, 0, 0);
+
+	const int listenfd = pool_listenfd;
+	if(listenfd == -1)
+		return NULL;
+
+	for(unsigned int i = 0; i < TCP_POOL_MAX_CLIENTS; i++)
+		clients[i].fd = -1;
+
+	// Listening socket, workers and upstream connections
+	struct pollfd pfd[1 + TCP_POOL_MAX_CLIENTS + TCP_POOL_MAX_UPSTREAMS*TCP_POOL_CONNS];
+	// Pointers to the workers and connections the entries belong to
+	struct pool_client *pclient[sizeof(pfd)/sizeof(pfd[0])];
+	struct pool_conn *pconn[sizeof(pfd)/sizeof(pfd[0])];
+	struct pool_upstream *pup[sizeof(pfd)/sizeof(pfd[0])];
+	unsigned int pserial[sizeof(pfd)/sizeof(pfd[0])];
+	unsigned char *msg = malloc(sizeof(struct pool_request) + 65536);
+	if(msg == NULL)
+	{
+		close(listenfd);
+		return NULL;
+	}
+
+	while(!killed)
+	{
+		nfds_t n = 0;
+		pfd[n] = (struct pollfd){ .fd = listenfd, .events = POLLIN };
+		pclient[n] = NULL; pconn[n] = NULL; pup[n] = NULL;
+		n++;
+
+		pthread_mutex_lock(&pool_lock);
+		for(unsigned int i = 0; i < TCP_POOL_MAX_CLIENTS; i++)
+		{
+			if(clients[i].fd == -1)
+				continue;
+			pfd[n] = (struct pollfd){ .fd = clients[i].fd, .events = POLLIN };
+			pclient[n] = &clients[i]; pconn[n] = NULL; pup[n] = NULL;
+			n++;
+		}
+		for(unsigned int i = 0; i < num_upstreams; i++)
+			for(unsigned int j = 0; j < TCP_POOL_CONNS; j++)
+			{
+				struct pool_conn *conn = &upstreams[i].conn[j];
+				if(conn->fd == -1)
+					continue;
+				pfd[n] = (struct pollfd){ .fd = conn->fd, .events = POLLIN };
+				if(!conn->connected || conn->tx_len > 0)
+					pfd[n].events |= POLLOUT;
+				pclient[n] = NULL; pconn[n] = conn; pup[n] = &upstreams[i];
+				pserial[n] = conn->serial;
+				n++;
+			}
+		pthread_mutex_unlock(&pool_lock);
+
+		thread_cancellable[TCPpool] = true;
+		const int ret = poll(pfd, n, 1000);
+		thread_cancellable[TCPpool] = false;
+		if(ret == -1 && errno != EINTR)
+		{
+			logg("TCP pool: poll() failed: %s", strerror(errno));
+			break;
+		}
+
+		const time_t now = time(NULL);
+		pthread_mutex_lock(&pool_lock);
+		for(nfds_t i = 0; ret > 0 && i < n; i++)
+		{
+			if(pfd[i].revents == 0)
+				continue;
+
+			if(i == 0)
+				accept_client(listenfd);
+			else if(pclient[i] != NULL)
+			{
+				// Query from a TCP worker
+				const int client = pclient[i] - clients;
+				const ssize_t len = recv(pfd[i].fd, msg, sizeof(struct pool_request) + 65536, 0);
+				if(len > 0)
+					handle_request(client, msg, len, now);
+				else if(len == 0 || (errno != EAGAIN && errno != EINTR))
+				{
+					// The worker terminated, drop replies for it
+					close(pclient[i]->fd);
+					pclient[i]->fd = -1;
+				}
+			}
+			else if(pconn[i]->fd != -1 && pconn[i]->serial == pserial[i])
+			{
+				// Upstream connection (unless it has been closed
+				// or reopened above while handling another event)
+				struct pool_conn *conn = pconn[i];
+				if(!conn->connected && pfd[i].revents & (POLLOUT | POLLERR | POLLHUP))
+				{
+					int err = 0;
+					socklen_t errlen = sizeof(err);
+					if(getsockopt(conn->fd, SOL_SOCKET, SO_ERROR, &err, &errlen) == -1 || err != 0)
+					{
+						close_conn(pup[i], conn, true, now);
+						continue;
+					}
+					conn->connected = true;
+				}
+				if(pfd[i].revents & POLLOUT)
+					flush_conn(pup[i], conn, now);
+				if(conn->fd != -1 && pfd[i].revents & (POLLIN | POLLERR | POLLHUP))
+					read_conn(pup[i], conn, now);
+			}
+		}
+
+		check_timeouts(now);
+		pthread_mutex_unlock(&pool_lock);
+	}
+
+	pthread_mutex_lock(&pool_lock);
+	for(unsigned int i = 0; i < num_upstreams; i++)
+		for(unsigned int j = 0; j < TCP_POOL_CONNS; j++)
+			close_conn(&upstreams[i], &upstreams[i].conn[j], false, time(NULL));
+	pthread_mutex_unlock(&pool_lock);
+
+	free(msg);
+	close(listenfd);
+	return NULL;
+}
+
+// Called by TCP workers: Send a query through the pool and wait for the reply.
+// The reply is stored in payload which has to be able to hold 64 KB. Returns
+// the size of the reply or -1 if the worker should connect to the upstream
+// itself
+ssize_t FTL_tcp_pool_query(const struct server *serv, unsigned char *payload, const size_t qsize)
+{
+	if(!config.tcp_pool || pool_addrlen == 0)
+		return -1;
+
+	if(pool_fd == -1)
+	{
+		pool_fd = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0);
+		if(pool_fd == -1)
+			return -1;
+		if(connect(pool_fd, (struct sockaddr *)&pool_addr, pool_addrlen) == -1)
+		{
+			close(pool_fd);
+			pool_fd = -1;
+			return -1;
+		}
+	}
+
+	struct pool_request req;
+	memset(&req, 0, sizeof(req));
+	memcpy(&req.addr, &serv->addr, sizeof(req.addr));
+	memcpy(&req.source_addr, &serv->source_addr, sizeof(req.source_addr));
+	memcpy(req.interface, serv->interface, sizeof(req.interface));
+	req.ifindex = serv->ifindex;
+
+	struct iovec iov[2] = {
+		{ .iov_base = &req, .iov_len = sizeof(req) },
+		{ .iov_base = payload, .iov_len = qsize }
+	};
+	struct msghdr msg = { .msg_iov = iov, .msg_iovlen = 2 };
+	if(sendmsg(pool_fd, &msg, MSG_NOSIGNAL) == -1)
+		goto fail;
+
+	// The pool times out queries on its own, wait a bit longer than that
+	struct pollfd pfd = { .fd = pool_fd, .events = POLLIN };
+	if(poll(&pfd, 1, (TCP_POOL_TIMEOUT + 1)*1000) <= 0)
+		goto fail;
+
+	unsigned char status = POOL_FAILED;
+	iov[0] = (struct iovec){ .iov_base = &status, .iov_len = sizeof(status) };
+	iov[1] = (struct iovec){ .iov_base = payload, .iov_len = 65535 };
+	const ssize_t len = recvmsg(pool_fd, &msg, 0);
+	if(len <= 0)
+		goto fail;
+
+	if(status != POOL_OK || len <= (ssize_t)sizeof(status))
+		return -1;
+
+	return len - sizeof(status);
+
+fail:
+	// Do not reuse this connection, a late reply could be taken for the
+	// one to our next query
+	close(pool_fd);
+	pool_fd = -1;
+	return -1;
+}
+
+// Copy the state of the connections to up to num upstream servers into out
+unsigned int get_tcp_pool_stats(struct tcp_pool_info *out, const unsigned int num)
+{
+	const time_t now = time(NULL);
+	pthread_mutex_lock(&pool_lock);
+	unsigned int n = 0;
+	for(; n < num_upstreams && n < num; n++)
+	{
+		const struct pool_upstream *up = &upstreams[n];
+		struct tcp_pool_info *info = &out[n];
+		memset(info, 0, sizeof(*info));
+		get_ip_port(&up->addr, info->ip, &info->port);
+		info->down = now < up->down_until;
+		info->connections = count_connections(up, &info->inflight);
+		info->queries = up->queries;
+		info->reused = up->reused;
+		info->connects = up->connects;
+		info->failures = up->failures;
+		info->timeouts = up->timeouts;
+	}
+	pthread_mutex_unlock(&pool_lock);
+
+	return n;
+}
@@ -0,0 +1,48 @@
+/* Pi-hole: A black hole for Internet advertisements
+*  (c) 2023 Pi-hole, LLC (https://pi-hole.net)
+*  Network-wide ad blocking via your own hardware.
+*
+*  FTL Engine
+*  TCP upstream connection pool prototypes
+*
+*  This file is copyright under the latest version of the EUPL.
+*  Please see LICENSE file for your rights under this license. */
+#ifndef TCP_POOL_H
+#define TCP_POOL_H
+
+// How many connections do we keep to each upstream server at most?
+#define TCP_POOL_CONNS 4
+// How many queries may be in flight on one connection at the same time? This
+// has to be a power of two as the slot is encoded in the query ID
+#define TCP_POOL_PIPELINE 32
+// How long do we wait for a reply before giving up [seconds]?
+#define TCP_POOL_TIMEOUT 10
+// How many upstream servers do we keep connections to at most?
+#define TCP_POOL_MAX_UPSTREAMS 64
+// How many TCP workers can use the pool at the same time?
+#define TCP_POOL_MAX_CLIENTS 64
+// After this many failed connections in a row, an upstream is not used
+// through the pool for TCP_POOL_BACKOFF seconds
+#define TCP_POOL_MAX_FAILURES 3
+#define TCP_POOL_BACKOFF 30
+
+struct tcp_pool_info {
+	char ip[INET6_ADDRSTRLEN+1];
+	in_port_t port;
+	bool down;
+	unsigned int connections;
+	unsigned int inflight;
+	unsigned long queries;
+	unsigned long reused;
+	unsigned long connects;
+	unsigned long failures;
+	unsigned long timeouts;
+};
+
+struct server;
+void listen_tcp_pool(void);
+void *TCPpool_thread(void *val);
+ssize_t FTL_tcp_pool_query(const struct server *serv, unsigned char *payload, const size_t qsize);
+unsigned int get_tcp_pool_stats(struct tcp_pool_info *out, const unsigned int num);
+
+#endif //TCP_POOL_H
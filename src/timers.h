@@ -13,6 +13,7 @@
 // Timer enumeration
 enum timers {
 	DATABASE_WRITE_TIMER,
+	DATABASE_CHECKPOINT_TIMER,
 	EXIT_TIMER,
 	GC_TIMER,
 	LISTS_TIMER,
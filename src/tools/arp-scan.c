@@ -23,8 +23,16 @@
 #include <linux/if_packet.h>
 #include <linux/if_ether.h>
 #include <linux/if_arp.h>
+// struct sock_fprog
+#include <linux/filter.h>
 //htons etc
 #include <arpa/inet.h>
+// offsetof()
+#include <stddef.h>
+// ppoll()
+#include <poll.h>
+// mmap()
+#include <sys/mman.h>
 
 // How many threads do we spawn at maximum?
 // This is also the limit for interfaces
@@ -37,9 +45,28 @@
 // How many ARP requests do we send per IP address?
 #define NUM_SCANS 10
 
-// How long do we wait for ARP replies in each scan [seconds]?
+// How long do we wait for ARP replies after the last scan [seconds]?
 #define ARP_TIMEOUT 1
 
+// How many ARP requests do we send per second and interface at most?
+#define ARP_RATE 100000
+
+// How many ARP requests do we hand to the kernel at once?
+#define ARP_BATCH 64
+
+// How long does one scan take at least [milliseconds]? Replies are counted
+// for the scan that sent the last request to an address, so this has to be
+// longer than the time it takes a device to reply
+#define ARP_MIN_SCAN_TIME 100
+
+// Receive ring: RING_BLOCKS blocks of RING_BLOCK_SIZE bytes each. Blocks are
+// handed to us when they are full or RING_BLOCK_TIMEOUT ms after the first
+// packet in it arrived
+#define RING_BLOCK_SIZE (1 << 16)
+#define RING_BLOCKS 32
+#define RING_FRAME_SIZE 128
+#define RING_BLOCK_TIMEOUT 10
+
 // Protocol definitions
 #define PROTO_ARP 0x0806
 #define ETH2_HEADER_LEN 14
@@ -103,6 +130,11 @@ struct thread_data {
 	uint32_t scanned_addresses;
 	const char *error;
 	struct ifaddrs *ifa;
+	// Scan which sent the last request to each address
+	unsigned char *sent_scan;
+	// Memory-mapped receive ring (NULL = not available)
+	unsigned char *ring;
+	unsigned int ring_block;
 	union {
 		struct arp_result_extreme *result_extreme;
 		struct arp_result *result;
@@ -112,85 +144,6 @@ struct thread_data {
 	struct sockaddr_in mask;
 };
 
-// Sends multiple ARP who-has request on interface ifindex, using source mac src_mac and source ip src_ip.
-// Iterates over all IP addresses in the range of dst_ip/cidr.
-static int send_arps(const int fd, const int ifindex, struct thread_data *thread_data)
-{
-	int err = -1;
-	unsigned char buffer[BUF_SIZE];
-	memset(buffer, 0, sizeof(buffer));
-
-	// Construct the Ethernet header
-	struct sockaddr_ll socket_address;
-	socket_address.sll_family = AF_PACKET;
-	socket_address.sll_protocol = htons(ETH_P_ARP);
-	socket_address.sll_ifindex = ifindex;
-	socket_address.sll_hatype = htons(ARPHRD_ETHER);
-	socket_address.sll_pkttype = PACKET_BROADCAST;
-	socket_address.sll_halen = MAC_LENGTH;
-	socket_address.sll_addr[6] = 0;
-	socket_address.sll_addr[7] = 0;
-
-	struct ethhdr *send_req = (struct ethhdr *) buffer;
-	struct arp_header *arp_req = (struct arp_header *) (buffer + ETH2_HEADER_LEN);
-	ssize_t ret;
-
-	// Destination is the broadcast address
-	memset(send_req->h_dest, 0xff, MAC_LENGTH);
-
-	// Target MAC is zero (we don't know it)
-	memset(arp_req->target_mac, 0x00, MAC_LENGTH);
-
-	// Source MAC to our own MAC address
-	memcpy(send_req->h_source, thread_data->mac, MAC_LENGTH);
-	memcpy(arp_req->sender_mac, thread_data->mac, MAC_LENGTH);
-	memcpy(socket_address.sll_addr, thread_data->mac, MAC_LENGTH);
-
-	// Protocol type is ARP
-	send_req->h_proto = htons(ETH_P_ARP);
-
-	// Create ARP request
-	arp_req->hardware_type = htons(HW_TYPE);
-	arp_req->protocol_type = htons(ETH_P_IP);
-	arp_req->hardware_len = MAC_LENGTH;
-	arp_req->protocol_len = IPV4_LENGTH;
-	arp_req->opcode = htons(ARP_REQUEST);
-
-	// Copy IP address to arp_req
-	memcpy(arp_req->sender_ip, &thread_data->src_addr.sin_addr.s_addr, sizeof(thread_data->src_addr.sin_addr.s_addr));
-
-	// Loop over all possible IP addresses in the range dst_ip/cidr
-	// We start at 1 because the first IP address has already been set above
-	struct in_addr dst_ip = thread_data->dst_addr.sin_addr;
-	for(unsigned int i = 0; i < (1u << (32 - thread_data->dst_cidr)); i++)
-	{
-		// Fill in target IP address
-		memcpy(arp_req->target_ip, &dst_ip.s_addr, sizeof(dst_ip.s_addr));
-
-#ifdef DEBUG
-		printf("Sending ARP request for %s@%s\n", inet_ntoa(*dst_ip), iface);
-#endif
-
-		// Send ARP request
-		ret = sendto(fd, buffer, 42, 0, (struct sockaddr *) &socket_address, sizeof(socket_address));
-		if (ret == -1)
-		{
-			err = errno;
-			thread_data->error = strerror(err);
-			goto out;
-		}
-
-		// Increment IP address
-		dst_ip.s_addr = htonl(ntohl(dst_ip.s_addr) + 1);
-
-		thread_data->scanned_addresses++;
-	}
-
-	err = 0;
-out:
-	return err;
-}
-
 static int create_arp_socket(const int ifindex, const char *iface, const char **error)
 {
 	// Create socket for ARP communications
@@ -204,6 +157,25 @@ static int create_arp_socket(const int ifindex, const char *iface, const char **
 		return -1;
 	}
 
+	// Let the kernel drop everything but ARP replies (tcpdump -dd "arp[6:2] = 2")
+	// This is only an optimization, received packets are checked again
+	// in process_reply()
+	struct sock_filter filter[] = {
+		BPF_STMT(BPF_LD | BPF_H | BPF_ABS, 12),
+		BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, PROTO_ARP, 0, 3),
+		BPF_STMT(BPF_LD | BPF_H | BPF_ABS, ETH2_HEADER_LEN + offsetof(struct arp_header, opcode)),
+		BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, ARP_REPLY, 0, 1),
+		BPF_STMT(BPF_RET | BPF_K, BUF_SIZE),
+		BPF_STMT(BPF_RET | BPF_K, 0),
+	};
+	const struct sock_fprog fprog = { sizeof(filter)/sizeof(filter[0]), filter };
+	if(setsockopt(arp_socket, SOL_SOCKET, SO_ATTACH_FILTER, &fprog, sizeof(fprog)) < 0)
+	{
+#ifdef DEBUG
+		printf("Unable to attach ARP reply filter on interface %s: %s\n", iface, strerror(errno));
+#endif
+	}
+
 	// Bind socket to interface
 	struct sockaddr_ll sll;
 	memset(&sll, 0, sizeof(struct sockaddr_ll));
@@ -219,21 +191,43 @@ static int create_arp_socket(const int ifindex, const char *iface, const char **
 		return -1;
 	}
 
-	// Set timeout
-	struct timeval tv;
-	tv.tv_sec = ARP_TIMEOUT;
-	tv.tv_usec = 0;
-	if (setsockopt(arp_socket, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv)) < 0)
+	return arp_socket;
+}
+
+// Set up a memory-mapped receive ring (TPACKET_V3) on the ARP socket so
+// replies can be read without one system call per packet. If this fails,
+// replies are read with recvfrom()
+static void setup_rx_ring(const int fd, struct thread_data *thread_data)
+{
+	const int version = TPACKET_V3;
+	if(setsockopt(fd, SOL_PACKET, PACKET_VERSION, &version, sizeof(version)) < 0)
+		return;
+
+	struct tpacket_req3 req;
+	memset(&req, 0, sizeof(req));
+	req.tp_block_size = RING_BLOCK_SIZE;
+	req.tp_block_nr = RING_BLOCKS;
+	req.tp_frame_size = RING_FRAME_SIZE;
+	req.tp_frame_nr = RING_BLOCK_SIZE / RING_FRAME_SIZE * RING_BLOCKS;
+	req.tp_retire_blk_tov = RING_BLOCK_TIMEOUT;
+	if(setsockopt(fd, SOL_PACKET, PACKET_RX_RING, &req, sizeof(req)) < 0)
+		return;
+
+	void *ring = mmap(NULL, (size_t)RING_BLOCK_SIZE * RING_BLOCKS, PROT_READ | PROT_WRITE,
+	                  MAP_SHARED | MAP_LOCKED, fd, 0);
+	if(ring == MAP_FAILED)
+		ring = mmap(NULL, (size_t)RING_BLOCK_SIZE * RING_BLOCKS, PROT_READ | PROT_WRITE,
+		            MAP_SHARED, fd, 0);
+	if(ring == MAP_FAILED)
 	{
-		*error = strerror(errno);
-#ifdef DEBUG
-		printf("Unable to set timeout for ARP communications on interface %s: %s\n", iface, *error);
-#endif
-		close(arp_socket);
-		return -1;
+		// Remove the ring again, recvfrom() does not work with it
+		memset(&req, 0, sizeof(req));
+		setsockopt(fd, SOL_PACKET, PACKET_RX_RING, &req, sizeof(req));
+		return;
 	}
 
-	return arp_socket;
+	thread_data->ring = ring;
+	thread_data->ring_block = 0;
 }
 
 static void add_result(struct in_addr *rcv_ip, unsigned char *sender_mac,
@@ -270,72 +264,258 @@ static void add_result(struct in_addr *rcv_ip, unsigned char *sender_mac,
 		}
 	}
 
+	// No space left for another device using this IP address
+	if(j == MAX_MACS)
+		return;
+
 	// Memorize that we have received a reply for this IP address
 	thread_data->extreme ?
 	  thread_data->result_extreme[i].device[j].replied[scan_id]++ :
 	  thread_data->result[i].device[j].replied[scan_id]++;
 }
 
-// Read all ARP responses
-static ssize_t read_arp(const int fd, struct thread_data *thread_data)
+// Process one received packet
+static void process_reply(const unsigned char *buffer, const size_t len, struct thread_data *thread_data)
 {
-	ssize_t ret = 0;
-	unsigned char buffer[BUF_SIZE];
+	if(len < ETH2_HEADER_LEN + sizeof(struct arp_header))
+		return;
 
-	// Read ARP responses
-	while(ret >= 0)
+	const struct ethhdr *rcv_resp = (const struct ethhdr *) buffer;
+	const struct arp_header *arp_resp = (const struct arp_header *) (buffer + ETH2_HEADER_LEN);
+	if (ntohs(rcv_resp->h_proto) != PROTO_ARP)
+	{
+#ifdef DEBUG
+		printf("Not an ARP packet");
+#endif
+		return;
+	}
+	if (ntohs(arp_resp->opcode) != ARP_REPLY)
 	{
-		ret = recvfrom(fd, buffer, BUF_SIZE, 0, NULL, NULL);
+#ifdef DEBUG
+		printf("Not an ARP reply");
+#endif
+		return;
+	}
+#ifdef DEBUG
+	printf("received ARP len=%zu", len);
+#endif
+	struct in_addr sender_a;
+	memcpy(&sender_a.s_addr, arp_resp->sender_ip, sizeof(sender_a.s_addr));
+
+#ifdef DEBUG
+	printf("%-16s %-20s\t%02x:%02x:%02x:%02x:%02x:%02x",
+	     thread_data->iface, inet_ntoa(sender_a),
+	     arp_resp->sender_mac[0],
+	     arp_resp->sender_mac[1],
+	     arp_resp->sender_mac[2],
+	     arp_resp->sender_mac[3],
+	     arp_resp->sender_mac[4],
+	     arp_resp->sender_mac[5]);
+#endif
+	// Count the reply for the scan that sent the last request to this
+	// address. Scans overlap as we do not wait for all replies in between
+	const uint32_t i = ntohl(sender_a.s_addr) - ntohl(thread_data->dst_addr.sin_addr.s_addr);
+	const unsigned int scan_id = i < thread_data->result_size ?
+	                               thread_data->sent_scan[i] : thread_data->num_scans;
+	unsigned char sender_mac[MAC_LENGTH];
+	memcpy(sender_mac, arp_resp->sender_mac, MAC_LENGTH);
+	add_result(&sender_a, sender_mac, thread_data, scan_id);
+}
+
+// Read all ARP responses available right now
+static void read_arp(const int fd, struct thread_data *thread_data)
+{
+	// Read blocks the kernel has passed to us from the receive ring
+	while(thread_data->ring != NULL)
+	{
+		struct tpacket_block_desc *block = (void *)
+			(thread_data->ring + (size_t)thread_data->ring_block * RING_BLOCK_SIZE);
+		if(!(__atomic_load_n(&block->hdr.bh1.block_status, __ATOMIC_ACQUIRE) & TP_STATUS_USER))
+			return;
+
+		const struct tpacket3_hdr *pkt = (const void *)
+			((unsigned char *)block + block->hdr.bh1.offset_to_first_pkt);
+		for(unsigned int i = 0; i < block->hdr.bh1.num_pkts; i++)
+		{
+			process_reply((const unsigned char *)pkt + pkt->tp_mac, pkt->tp_snaplen, thread_data);
+			pkt = (const void *)((const unsigned char *)pkt + pkt->tp_next_offset);
+		}
+
+		// Hand the block back to the kernel
+		__atomic_store_n(&block->hdr.bh1.block_status, TP_STATUS_KERNEL, __ATOMIC_RELEASE);
+		thread_data->ring_block = (thread_data->ring_block + 1) % RING_BLOCKS;
+	}
+
+	// No receive ring, read the socket until it is empty
+	unsigned char buffer[BUF_SIZE];
+	while(true)
+	{
+		const ssize_t ret = recvfrom(fd, buffer, BUF_SIZE, MSG_DONTWAIT, NULL, NULL);
 		if (ret == -1)
 		{
-			if(errno == EAGAIN)
-			{
-				// Timeout
-				ret = 0;
-				break;
-			}
+			if(errno == EAGAIN || errno == EINTR)
+				return;
 
 			// Error
 			thread_data->error = strerror(errno);
 			printf("recvfrom(): %s", thread_data->error);
-			break;
+			return;
 		}
-		struct ethhdr *rcv_resp = (struct ethhdr *) buffer;
-		struct arp_header *arp_resp = (struct arp_header *) (buffer + ETH2_HEADER_LEN);
-		if (ntohs(rcv_resp->h_proto) != PROTO_ARP)
+		process_reply(buffer, ret, thread_data);
+	}
+}
+
+// Wait at most timeout for ARP responses and read them
+static void wait_arp(const int fd, struct thread_data *thread_data, const struct timespec *timeout)
+{
+	struct pollfd pfd = { .fd = fd, .events = POLLIN };
+	if(ppoll(&pfd, 1, timeout, NULL) > 0)
+		read_arp(fd, thread_data);
+}
+
+// Read ARP responses until ns nanoseconds have passed since start
+static void wait_arp_until(const int fd, struct thread_data *thread_data,
+                           const struct timespec *start, const uint64_t ns)
+{
+	do
+	{
+		struct timespec now;
+		clock_gettime(CLOCK_MONOTONIC, &now);
+		const int64_t left = (int64_t)ns - ((int64_t)(now.tv_sec - start->tv_sec) * 1000000000 +
+		                                    (now.tv_nsec - start->tv_nsec));
+		if(left <= 0)
+			break;
+
+		const struct timespec timeout = { left / 1000000000, left % 1000000000 };
+		wait_arp(fd, thread_data, &timeout);
+	} while(thread_data->error == NULL);
+
+	// Always empty the ring so it does not overflow while we are sending
+	read_arp(fd, thread_data);
+}
+
+// Sends ARP who-has requests on interface ifindex for all IP addresses in the
+// range of dst_ip/cidr, using our own MAC and IP address as sender. Requests
+// are handed to the kernel ARP_BATCH at a time and sent at no more than
+// ARP_RATE per second. Replies are read in between
+static int send_arps(const int fd, const int ifindex, struct thread_data *thread_data)
+{
+	int err = -1;
+	unsigned char buffer[ARP_BATCH][BUF_SIZE];
+	memset(buffer, 0, sizeof(buffer));
+
+	// Construct the Ethernet header
+	struct sockaddr_ll socket_address;
+	socket_address.sll_family = AF_PACKET;
+	socket_address.sll_protocol = htons(ETH_P_ARP);
+	socket_address.sll_ifindex = ifindex;
+	socket_address.sll_hatype = htons(ARPHRD_ETHER);
+	socket_address.sll_pkttype = PACKET_BROADCAST;
+	socket_address.sll_halen = MAC_LENGTH;
+	socket_address.sll_addr[6] = 0;
+	socket_address.sll_addr[7] = 0;
+
+	struct ethhdr *send_req = (struct ethhdr *) buffer[0];
+	struct arp_header *arp_req = (struct arp_header *) (buffer[0] + ETH2_HEADER_LEN);
+
+	// Destination is the broadcast address
+	memset(send_req->h_dest, 0xff, MAC_LENGTH);
+
+	// Target MAC is zero (we don't know it)
+	memset(arp_req->target_mac, 0x00, MAC_LENGTH);
+
+	// Source MAC to our own MAC address
+	memcpy(send_req->h_source, thread_data->mac, MAC_LENGTH);
+	memcpy(arp_req->sender_mac, thread_data->mac, MAC_LENGTH);
+	memcpy(socket_address.sll_addr, thread_data->mac, MAC_LENGTH);
+
+	// Protocol type is ARP
+	send_req->h_proto = htons(ETH_P_ARP);
+
+	// Create ARP request
+	arp_req->hardware_type = htons(HW_TYPE);
+	arp_req->protocol_type = htons(ETH_P_IP);
+	arp_req->hardware_len = MAC_LENGTH;
+	arp_req->protocol_len = IPV4_LENGTH;
+	arp_req->opcode = htons(ARP_REQUEST);
+
+	// Copy IP address to arp_req
+	memcpy(arp_req->sender_ip, &thread_data->src_addr.sin_addr.s_addr, sizeof(thread_data->src_addr.sin_addr.s_addr));
+
+	// All requests of a batch only differ in the target IP address
+	struct iovec iov[ARP_BATCH];
+	struct mmsghdr msgs[ARP_BATCH];
+	memset(msgs, 0, sizeof(msgs));
+	for(unsigned int k = 0; k < ARP_BATCH; k++)
+	{
+		if(k > 0)
+			memcpy(buffer[k], buffer[0], BUF_SIZE);
+		iov[k].iov_base = buffer[k];
+		iov[k].iov_len = ETH2_HEADER_LEN + sizeof(struct arp_header);
+		msgs[k].msg_hdr.msg_name = &socket_address;
+		msgs[k].msg_hdr.msg_namelen = sizeof(socket_address);
+		msgs[k].msg_hdr.msg_iov = &iov[k];
+		msgs[k].msg_hdr.msg_iovlen = 1;
+	}
+
+	struct timespec start;
+	clock_gettime(CLOCK_MONOTONIC, &start);
+
+	// Loop over all possible IP addresses in the range dst_ip/cidr
+	const uint32_t first_ip = ntohl(thread_data->dst_addr.sin_addr.s_addr);
+	const uint32_t num_ips = thread_data->result_size;
+	for(uint32_t i = 0; i < num_ips; )
+	{
+		const unsigned int batch = num_ips - i < ARP_BATCH ? num_ips - i : ARP_BATCH;
+		for(unsigned int k = 0; k < batch; k++)
 		{
-#ifdef DEBUG
-			printf("Not an ARP packet");
-#endif
-			continue;
+			// Fill in target IP address
+			const uint32_t dst_ip = htonl(first_ip + i + k);
+			memcpy(buffer[k] + ETH2_HEADER_LEN + offsetof(struct arp_header, target_ip),
+			       &dst_ip, sizeof(dst_ip));
+			thread_data->sent_scan[i + k] = thread_data->num_scans;
 		}
-		if (ntohs(arp_resp->opcode) != ARP_REPLY)
+
+		// Send ARP requests
+		for(unsigned int sent = 0; sent < batch; )
 		{
-#ifdef DEBUG
-			printf("Not an ARP reply");
-#endif
-			continue;
+			const int ret = sendmmsg(fd, msgs + sent, batch - sent, 0);
+			if(ret > 0)
+			{
+				sent += ret;
+				continue;
+			}
+
+			// The device queue is full, try again shortly
+			if(ret == -1 && (errno == ENOBUFS || errno == EAGAIN || errno == EINTR))
+			{
+				const struct timespec timeout = { 0, 1000000 };
+				wait_arp(fd, thread_data, &timeout);
+				continue;
+			}
+
+			err = errno;
+			thread_data->error = strerror(err);
+			goto out;
 		}
-#ifdef DEBUG
-		printf("received ARP len=%ld", ret);
-#endif
-		struct in_addr sender_a;
-		memcpy(&sender_a.s_addr, arp_resp->sender_ip, sizeof(sender_a.s_addr));
 
-#ifdef DEBUG
-		printf("%-16s %-20s\t%02x:%02x:%02x:%02x:%02x:%02x",
-		     thread_data->iface, inet_ntoa(sender_a),
-		     arp_resp->sender_mac[0],
-		     arp_resp->sender_mac[1],
-		     arp_resp->sender_mac[2],
-		     arp_resp->sender_mac[3],
-		     arp_resp->sender_mac[4],
-		     arp_resp->sender_mac[5]);
-#endif
-		add_result(&sender_a, arp_resp->sender_mac, thread_data, thread_data->num_scans);
+		i += batch;
+		thread_data->scanned_addresses += batch;
+
+		// Read replies until the next batch is due. The scan does not
+		// end before ARP_MIN_SCAN_TIME so replies to its last requests
+		// are counted for it
+		uint64_t due = (uint64_t)i * 1000000000 / ARP_RATE;
+		if(i == num_ips && due < (uint64_t)ARP_MIN_SCAN_TIME * 1000000)
+			due = (uint64_t)ARP_MIN_SCAN_TIME * 1000000;
+		wait_arp_until(fd, thread_data, &start, due);
+		if(thread_data->error != NULL)
+			goto out;
 	}
 
-	return ret;
+	err = 0;
+out:
+	return err;
 }
 
 // Convert netmask to CIDR
@@ -410,6 +590,9 @@ static void *arp_scan_iface(void *args)
 	// Get hardware address of client machine
 	get_hardware_address(arp_socket, iface, thread_data->mac);
 
+	// Receive replies through a memory-mapped ring if possible
+	setup_rx_ring(arp_socket, thread_data);
+
 	// Define destination IP address by masking source IP with netmask
 	thread_data->dst_addr.sin_addr.s_addr = thread_data->src_addr.sin_addr.s_addr & thread_data->mask.sin_addr.s_addr;
 
@@ -445,26 +628,48 @@ static void *arp_scan_iface(void *args)
 		thread_data->result = result;
 	}
 
+	// Allocate memory for the scan that sent the last request to each address
+	thread_data->sent_scan = calloc(arp_result_len, sizeof(*thread_data->sent_scan));
+	if(thread_data->sent_scan == NULL)
+	{
+		thread_data->status = STATUS_ERROR;
+		thread_data->error = strerror(ENOMEM);
+		pthread_exit(NULL);
+	}
+
 	for(thread_data->num_scans = 0; thread_data->num_scans < thread_data->total_scans; thread_data->num_scans++)
 	{
 #ifdef DEBUG
 		printf("Still scanning interface %s (%s/%i) %i%%...\n", iface, thread_data->ipstr, thread_data->dst_cidr, 100*scan_id/thread_data->total_scans);
 #endif
-		// Send ARP requests to all IPs in subnet
+		// Send ARP requests to all IPs in subnet, replies are read
+		// while sending
 		if(send_arps(arp_socket, ifindex, thread_data) != 0)
 		{
 			thread_data->status = STATUS_ERROR;
 			break;
 		}
+	}
 
-		// Read ARP responses
-		if(read_arp(arp_socket, thread_data) != 0)
-		{
+	// Read the remaining ARP responses
+	if(thread_data->status != STATUS_ERROR)
+	{
+		thread_data->num_scans--;
+		struct timespec start;
+		clock_gettime(CLOCK_MONOTONIC, &start);
+		wait_arp_until(arp_socket, thread_data, &start, (uint64_t)ARP_TIMEOUT * 1000000000);
+		thread_data->num_scans++;
+		if(thread_data->error != NULL)
 			thread_data->status = STATUS_ERROR;
-			break;
-		}
 	}
 
+	// Unmap receive ring
+	if(thread_data->ring != NULL)
+		munmap(thread_data->ring, (size_t)RING_BLOCK_SIZE * RING_BLOCKS);
+	thread_data->ring = NULL;
+	free(thread_data->sent_scan);
+	thread_data->sent_scan = NULL;
+
 	// Close socket
 	if(close(arp_socket) != 0)
 		thread_data->status = STATUS_ERROR;
@@ -0,0 +1,191 @@
+/* Pi-hole: A black hole for Internet advertisements
+*  (c) 2023 Pi-hole, LLC (https://pi-hole.net)
+*  Network-wide ad blocking via your own hardware.
+*
+*  FTL Engine
+*  Binary query log routines
+*
+*  This file is copyright under the latest version of the EUPL.
+*  Please see LICENSE file for your rights under this license. */
+
+#define FTLDNS
+#include "dnsmasq/dnsmasq.h"
+#undef __USE_XOPEN
+#include "FTL.h"
+#include "query-log.h"
+
+// dnsmasq writes its query log into a binary file when --log-queries-binary
+// is set (see log.c). We print the records as the lines dnsmasq would have
+// written into the text log so existing tools can be used on them
+
+// Get a zero-terminated string from the record, returns NULL if there is none
+static char *get_string(char **p, const char *end)
+{
+	char *str = *p;
+	const char *term = memchr(str, '\0', end - str);
+	if(term == NULL)
+		return NULL;
+	*p = (char*)term + 1;
+	return str;
+}
+
+// Formats dnsmasq logs DNSKEY and DS records with (see dnssec.c). The format
+// stored in the file is only used to select one of them, it is never passed
+// to printf() itself
+static const char *keytag_formats[] = {
+	"DNSKEY keytag %hu, algo %hu",
+	"DNSKEY keytag %hu, algo %hu (not supported)",
+	"DS for keytag %hu, algo %hu, digest %hu",
+	"DS for keytag %hu, algo %hu, digest %hu (not supported)",
+};
+
+static char *get_keytag_format(const char *arg)
+{
+	for(unsigned int i = 0; i < sizeof(keytag_formats)/sizeof(keytag_formats[0]); i++)
+		if(strcmp(arg, keytag_formats[i]) == 0)
+			return (char*)keytag_formats[i];
+	return NULL;
+}
+
+// Check that the record has everything format_log_query() uses for its flags
+// (checked in the same order as there)
+static bool __attribute__((const)) record_complete(const unsigned int flags, const bool name, const bool arg, const bool addr)
+{
+	if((flags & F_KEYTAG) && !(flags & F_RR) && (!arg || !addr))
+		return false;
+	if((flags & F_REVERSE) && !name)
+		return false;
+
+	if(flags & (F_CONFIG | F_DHCP))
+		return true;
+	if(flags & F_HOSTS)
+		return arg;
+	if(flags & F_UPSTREAM)
+		return true;
+	if(flags & F_SECSTAT)
+		return arg;
+	if(flags & F_AUTH)
+		return true;
+	if(flags & F_DNSSEC)
+		return arg;
+	if(flags & F_SERVER)
+		return true;
+	if(flags & F_QUERY)
+		return arg;
+	if(flags & F_IPSET)
+		return arg && name;
+	return true;
+}
+
+int run_query_log(const char *file)
+{
+	FILE *fp = strcmp(file, "-") == 0 ? stdin : fopen(file, "rb");
+	if(fp == NULL)
+	{
+		printf("Cannot open %s: %s\n", file, strerror(errno));
+		return EXIT_FAILURE;
+	}
+
+	struct binlog_header header;
+	if(fread(&header, sizeof(header), 1, fp) != 1 ||
+	   memcmp(header.magic, BINLOG_MAGIC, sizeof(header.magic)) != 0)
+	{
+		printf("%s is not a binary query log\n", file);
+		fclose(fp);
+		return EXIT_FAILURE;
+	}
+	if(header.addr_size != sizeof(union all_addr) ||
+	   header.record_size != sizeof(struct binlog_record))
+	{
+		printf("%s has been written by an incompatible version of pihole-FTL\n", file);
+		fclose(fp);
+		return EXIT_FAILURE;
+	}
+
+	char *buffer = calloc(UINT16_MAX + 1, 1);
+	char *line = calloc(QUERY_LOG_LINE, 1);
+	if(buffer == NULL || line == NULL)
+	{
+		if(buffer != NULL)
+			free(buffer);
+		if(line != NULL)
+			free(line);
+		fclose(fp);
+		return EXIT_FAILURE;
+	}
+
+	int ret = EXIT_SUCCESS;
+	struct binlog_record record;
+	size_t got = 0;
+	while((got = fread(&record, 1, sizeof(record), fp)) == sizeof(record))
+	{
+		const size_t addr_size = record.contents & BINLOG_ADDR ? sizeof(union all_addr) : 0u;
+		const size_t len = record.length - sizeof(record);
+		if(record.length < sizeof(record) + addr_size ||
+		   fread(buffer, 1, len, fp) != len)
+		{
+			printf("Truncated or corrupted record\n");
+			ret = EXIT_FAILURE;
+			break;
+		}
+
+		// The address is copied as the record does not keep its alignment
+		union all_addr addr;
+		char *p = buffer + addr_size;
+		const char *end = buffer + len;
+		if(addr_size > 0)
+			memcpy(&addr, buffer, sizeof(addr));
+		char *name = record.contents & BINLOG_NAME ? get_string(&p, end) : NULL;
+		char *arg = record.contents & BINLOG_ARG ? get_string(&p, end) : NULL;
+		if(((record.contents & BINLOG_NAME) && name == NULL) ||
+		   ((record.contents & BINLOG_ARG) && arg == NULL) ||
+		   !record_complete(record.flags, name != NULL, arg != NULL, addr_size > 0))
+		{
+			printf("Truncated or corrupted record\n");
+			ret = EXIT_FAILURE;
+			break;
+		}
+		if((record.flags & F_KEYTAG) && !(record.flags & F_RR) &&
+		   (record.type != 0 || (arg = get_keytag_format(arg)) == NULL))
+		{
+			printf("Unknown DNSSEC record format\n");
+			ret = EXIT_FAILURE;
+			break;
+		}
+
+		union mysockaddr source;
+		memset(&source, 0, sizeof(source));
+		if(record.family == 4)
+		{
+			source.in.sin_family = AF_INET;
+			source.in.sin_port = htons(record.port);
+			memcpy(&source.in.sin_addr, record.client, INADDRSZ);
+		}
+		else if(record.family == 6)
+		{
+			source.in6.sin6_family = AF_INET6;
+			source.in6.sin6_port = htons(record.port);
+			memcpy(&source.in6.sin6_addr, record.client, IN6ADDRSZ);
+		}
+
+		format_log_query(line, QUERY_LOG_LINE, record.flags, name, addr_size > 0 ? &addr : NULL,
+		                 arg, record.type, record.id, record.family != 0 ? &source : NULL,
+		                 record.contents & BINLOG_EXTRA);
+
+		// Same prefix as in the text log (see my_syslog())
+		const time_t sec = record.sec;
+		printf("%.15s dnsmasq[%u]: %s\n", ctime(&sec) + 4, record.pid, line);
+	}
+	if(got > 0 && got < sizeof(record))
+	{
+		printf("Truncated record\n");
+		ret = EXIT_FAILURE;
+	}
+
+	free(buffer);
+	free(line);
+	if(fp != stdin)
+		fclose(fp);
+
+	return ret;
+}
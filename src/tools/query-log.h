@@ -0,0 +1,16 @@
+/* Pi-hole: A black hole for Internet advertisements
+*  (c) 2023 Pi-hole, LLC (https://pi-hole.net)
+*  Network-wide ad blocking via your own hardware.
+*
+*  FTL Engine
+*  Binary query log prototypes
+*
+*  This file is copyright under the latest version of the EUPL.
+*  Please see LICENSE file for your rights under this license. */
+
+#ifndef QUERY_LOG_H
+#define QUERY_LOG_H
+
+int run_query_log(const char *file);
+
+#endif // QUERY_LOG_H
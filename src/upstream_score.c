@@ -0,0 +1,311 @@
+/* Pi-hole: A black hole for Internet advertisements
+*  (c) 2023 Pi-hole, LLC (https://pi-hole.net)
+*  Network-wide ad blocking via your own hardware.
+*
+*  FTL Engine
+*  Latency-aware upstream scoring
+*
+*  This file is copyright under the latest version of the EUPL.
+*  Please see LICENSE file for your rights under this license. */
+
+#define FTLDNS
+#include "dnsmasq/dnsmasq.h"
+#undef __USE_XOPEN
+#include "FTL.h"
+#include "upstream_score.h"
+// fabs()
+#include <math.h>
+// logg()
+#include "log.h"
+// struct config
+#include "config.h"
+
+// dnsmasq sends a query to the server that answered first the last time all
+// servers were asked. We keep track of the response times and failures of
+// each upstream instead and send most queries to the fastest healthy one. A
+// small fraction of the queries is sent to the other servers so their scores
+// stay up to date and failing servers can recover.
+//
+// Statistics are kept per process. TCP workers (forks) use their own copy and
+// their replies are not accounted for
+
+// Upper bounds of the latency histogram buckets [milliseconds]
+static const unsigned int bucket_limit[SCORE_BUCKETS] = {
+	1, 2, 3, 4, 6, 8, 12, 16, 24, 32, 48, 64, 96, 128, 192, 256, 384, 512,
+	768, 1024, 1536, 2048, 3072, UINT_MAX
+};
+
+// Weight of a new sample in the moving averages
+#define SCORE_ALPHA 0.4
+// Decay of the latency histogram per sample (about the last 10 replies)
+#define SCORE_DECAY 0.9
+// Upstreams failing more often than this are only asked in probes
+#define SCORE_UNHEALTHY 0.5
+
+struct class_score {
+	unsigned long samples;
+	double ewma;
+	// Mean deviation from the moving average
+	double dev;
+	double weight;
+	double hist[SCORE_BUCKETS];
+};
+
+struct upstream_score {
+	union mysockaddr addr;
+	double failure;
+	unsigned long selected;
+	// Value of num_selections when this upstream was last chosen
+	unsigned long last_selected;
+	struct class_score class[SCORE_CLASS_MAX];
+};
+
+static struct upstream_score scores[SCORE_MAX_UPSTREAMS];
+static unsigned int num_scores = 0;
+static unsigned long num_selections = 0;
+static pthread_mutex_t score_lock = PTHREAD_MUTEX_INITIALIZER;
+
+// Find (or add) the scores of this upstream. Has to be called while holding
+// the score lock. Returns NULL if the table is full
+static struct upstream_score *find_score(const union mysockaddr *addr)
+{
+	for(unsigned int i = 0; i < num_scores; i++)
+		if(sockaddr_isequal(&scores[i].addr, addr))
+			return &scores[i];
+
+	if(num_scores >= SCORE_MAX_UPSTREAMS)
+		return NULL;
+
+	struct upstream_score *score = &scores[num_scores++];
+	memset(score, 0, sizeof(*score));
+	memcpy(&score->addr, addr, sizeof(score->addr));
+	return score;
+}
+
+static void get_ip_port(const union mysockaddr *addr, char ip[ADDRSTRLEN+1], in_port_t *port)
+{
+	if(addr->sa.sa_family == AF_INET6)
+	{
+		inet_ntop(AF_INET6, &addr->in6.sin6_addr, ip, ADDRSTRLEN);
+		*port = ntohs(addr->in6.sin6_port);
+	}
+	else
+	{
+		inet_ntop(AF_INET, &addr->in.sin_addr, ip, ADDRSTRLEN);
+		*port = ntohs(addr->in.sin_port);
+	}
+}
+
+static enum score_class __attribute__((const)) get_score_class(const unsigned short qtype)
+{
+	if(qtype == T_A || qtype == T_AAAA)
+		return SCORE_CLASS_ADDRESS;
+	return SCORE_CLASS_OTHER;
+}
+
+const char *score_class_name(const enum score_class class)
+{
+	switch(class)
+	{
+		case SCORE_CLASS_ADDRESS:
+			return "address";
+		case SCORE_CLASS_OTHER:
+		case SCORE_CLASS_MAX: // fall through
+		default:
+			return "other";
+	}
+}
+
+// Estimate a percentile of the (recent) response times [milliseconds]
+static double __attribute__((pure)) get_percentile(const struct class_score *cs, const double p)
+{
+	const double target = p * cs->weight;
+	double sum = 0.0;
+	for(unsigned int i = 0; i < SCORE_BUCKETS - 1; i++)
+	{
+		sum += cs->hist[i];
+		if(sum >= target)
+			return bucket_limit[i];
+	}
+	return 2.0*bucket_limit[SCORE_BUCKETS - 2];
+}
+
+// Lower is better. Jitter and failures make an upstream less attractive even
+// if its average is good. We do not use the histogram here as it follows
+// changes too slowly for servers which are only asked in probes
+static double __attribute__((pure)) get_score(const struct upstream_score *score, const enum score_class class)
+{
+	const struct class_score *cs = &score->class[class];
+	return (cs->ewma + cs->dev) * (1.0 + 4.0*score->failure);
+}
+
+// Account for a reply (or a failure) of an upstream server
+void upstream_reply(const struct server *server, const unsigned short qtype, const unsigned int msec, const bool failed)
+{
+	if(server == NULL)
+		return;
+
+	pthread_mutex_lock(&score_lock);
+	struct upstream_score *score = find_score(&server->addr);
+	if(score == NULL)
+	{
+		pthread_mutex_unlock(&score_lock);
+		return;
+	}
+
+	score->failure += SCORE_ALPHA * ((failed ? 1.0 : 0.0) - score->failure);
+	if(!failed)
+	{
+		struct class_score *cs = &score->class[get_score_class(qtype)];
+		if(cs->samples++ == 0)
+			cs->ewma = msec;
+		else
+		{
+			cs->dev += SCORE_ALPHA * (fabs(msec - cs->ewma) - cs->dev);
+			cs->ewma += SCORE_ALPHA * (msec - cs->ewma);
+		}
+
+		unsigned int bucket = 0;
+		while(msec > bucket_limit[bucket])
+			bucket++;
+		for(unsigned int i = 0; i < SCORE_BUCKETS; i++)
+			cs->hist[i] *= SCORE_DECAY;
+		cs->hist[bucket] += 1.0;
+		cs->weight = cs->weight * SCORE_DECAY + 1.0;
+	}
+	pthread_mutex_unlock(&score_lock);
+}
+
+// Forget the scores of upstream servers which are no longer configured.
+// Called whenever dnsmasq rebuilds its server array
+void upstream_scores_prune(void)
+{
+	pthread_mutex_lock(&score_lock);
+	unsigned int n = 0;
+	for(unsigned int i = 0; i < num_scores; i++)
+	{
+		const struct server *serv = daemon->servers;
+		while(serv != NULL && !sockaddr_isequal(&serv->addr, &scores[i].addr))
+			serv = serv->next;
+		if(serv == NULL)
+			continue;
+		if(n != i)
+			scores[n] = scores[i];
+		n++;
+	}
+	num_scores = n;
+	pthread_mutex_unlock(&score_lock);
+}
+
+// An upstream did not reply (in time) or refused the query
+void upstream_failed(const struct server *server)
+{
+	upstream_reply(server, 0, 0, true);
+}
+
+// Choose the server (index into daemon->serverarray between first and last)
+// a new query should be sent to. Returns -1 if scoring is disabled or no
+// server is healthy so dnsmasq falls back to its own strategy
+int FTL_select_upstream(const int first, const int last, const unsigned int gotname)
+{
+	if(!config.upstream_scoring || last - first < 2)
+		return -1;
+
+	const enum score_class class = gotname & (F_IPV4 | F_IPV6) ? SCORE_CLASS_ADDRESS : SCORE_CLASS_OTHER;
+	int best = -1, unknown = -1, chosen = -1;
+	double best_score = 0.0;
+
+	pthread_mutex_lock(&score_lock);
+	const unsigned long n = ++num_selections;
+	for(int i = first; i < last; i++)
+	{
+		const struct upstream_score *score = find_score(&daemon->serverarray[i]->addr);
+		if(score == NULL || score->failure >= SCORE_UNHEALTHY)
+			continue;
+
+		// Learn about new servers first
+		if(score->class[class].samples < SCORE_MIN_SAMPLES)
+		{
+			unknown = i;
+			break;
+		}
+
+		const double s = get_score(score, class);
+		if(best == -1 || s < best_score)
+		{
+			best = i;
+			best_score = s;
+		}
+	}
+
+	const unsigned long probe_interval = config.upstream_probe > 0 ? 100u / config.upstream_probe : 0u;
+	if(unknown != -1)
+		chosen = unknown;
+	else if(probe_interval > 0 && n % probe_interval == 0)
+	{
+		// Probe the server we have not asked for the longest time (this
+		// includes unhealthy ones)
+		unsigned long oldest = ULONG_MAX;
+		for(int i = first; i < last; i++)
+		{
+			const struct upstream_score *score = find_score(&daemon->serverarray[i]->addr);
+			if(i != best && score != NULL && score->last_selected < oldest)
+			{
+				chosen = i;
+				oldest = score->last_selected;
+			}
+		}
+	}
+	else
+		chosen = best;
+
+	if(chosen != -1)
+	{
+		struct upstream_score *score = find_score(&daemon->serverarray[chosen]->addr);
+		if(score != NULL)
+		{
+			score->selected++;
+			score->last_selected = n;
+		}
+	}
+	pthread_mutex_unlock(&score_lock);
+
+	if(debug_enabled(DEBUG_QUERIES) && chosen != -1)
+	{
+		char ip[ADDRSTRLEN+1] = { 0 };
+		in_port_t port = 0;
+		get_ip_port(&daemon->serverarray[chosen]->addr, ip, &port);
+		logg("Selected upstream %s#%u (%s)", ip, port,
+		     chosen == unknown ? "learning" : chosen == best ? "fastest" : "probe");
+	}
+
+	return chosen;
+}
+
+// Copy the scores of up to num upstream servers into out
+unsigned int get_upstream_scores(struct upstream_score_info *out, const unsigned int num)
+{
+	pthread_mutex_lock(&score_lock);
+	unsigned int n = 0;
+	for(; n < num_scores && n < num; n++)
+	{
+		const struct upstream_score *score = &scores[n];
+		struct upstream_score_info *info = &out[n];
+		memset(info, 0, sizeof(*info));
+		get_ip_port(&score->addr, info->ip, &info->port);
+		info->failure = score->failure;
+		info->healthy = score->failure < SCORE_UNHEALTHY;
+		info->selected = score->selected;
+		for(unsigned int c = 0; c < SCORE_CLASS_MAX; c++)
+		{
+			const struct class_score *cs = &score->class[c];
+			info->class[c].samples = cs->samples;
+			info->class[c].ewma = cs->ewma;
+			info->class[c].p50 = cs->samples > 0 ? get_percentile(cs, 0.5) : 0.0;
+			info->class[c].p95 = cs->samples > 0 ? get_percentile(cs, 0.95) : 0.0;
+		}
+	}
+	pthread_mutex_unlock(&score_lock);
+
+	return n;
+}
@@ -0,0 +1,50 @@
+/* Pi-hole: A black hole for Internet advertisements
+*  (c) 2023 Pi-hole, LLC (https://pi-hole.net)
+*  Network-wide ad blocking via your own hardware.
+*
+*  FTL Engine
+*  Upstream scoring prototypes
+*
+*  This file is copyright under the latest version of the EUPL.
+*  Please see LICENSE file for your rights under this license. */
+#ifndef UPSTREAM_SCORE_H
+#define UPSTREAM_SCORE_H
+
+// Number of latency histogram buckets (1 ms ... 3 s, logarithmic)
+#define SCORE_BUCKETS 24
+// How many replies do we need before we trust the score of an upstream?
+#define SCORE_MIN_SAMPLES 3
+// How many upstream servers do we keep scores for at most?
+#define SCORE_MAX_UPSTREAMS 64
+
+// Queries are scored separately for address lookups and everything else as
+// they can have very different response times
+enum score_class {
+	SCORE_CLASS_ADDRESS = 0,
+	SCORE_CLASS_OTHER,
+	SCORE_CLASS_MAX
+};
+
+struct upstream_score_info {
+	char ip[INET6_ADDRSTRLEN+1];
+	in_port_t port;
+	bool healthy;
+	double failure;
+	unsigned long selected;
+	struct {
+		unsigned long samples;
+		double ewma;
+		double p50;
+		double p95;
+	} class[SCORE_CLASS_MAX];
+};
+
+struct server;
+void upstream_reply(const struct server *server, const unsigned short qtype, const unsigned int msec, const bool failed);
+void upstream_failed(const struct server *server);
+void upstream_scores_prune(void);
+int FTL_select_upstream(const int first, const int last, const unsigned int gotname);
+unsigned int get_upstream_scores(struct upstream_score_info *out, const unsigned int num);
+const char *score_class_name(const enum score_class class) __attribute__((const));
+
+#endif //UPSTREAM_SCORE_H
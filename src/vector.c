@@ -16,7 +16,7 @@
 
 sqlite3_stmt_vec *new_sqlite3_stmt_vec(unsigned int initial_size)
 {
-	if(config.debug & DEBUG_VECTORS)
+	if(debug_enabled(DEBUG_VECTORS))
 		logg("Initializing new sqlite3_stmt* vector with size %u", initial_size);
 
 	sqlite3_stmt_vec *v = calloc(1, sizeof(sqlite3_stmt_vec));
@@ -31,7 +31,7 @@ sqlite3_stmt_vec *new_sqlite3_stmt_vec(unsigned int initial_size)
 
 static void resize_sqlite3_stmt_vec(sqlite3_stmt_vec *v, unsigned int capacity)
 {
-	if(config.debug & DEBUG_VECTORS)
+	if(debug_enabled(DEBUG_VECTORS))
 		logg("Resizing sqlite3_stmt* vector %p from %u to %u", v, v->capacity, capacity);
 
 	// If ptr is NULL, the call to realloc(ptr, size) is equivalent to
@@ -58,7 +58,7 @@ static void resize_sqlite3_stmt_vec(sqlite3_stmt_vec *v, unsigned int capacity)
 
 void set_sqlite3_stmt_vec(sqlite3_stmt_vec *v, unsigned int index, sqlite3_stmt *item)
 {
-	if(config.debug & DEBUG_VECTORS)
+	if(debug_enabled(DEBUG_VECTORS))
 		logg("Setting sqlite3_stmt** %p[%u] <-- %p", v, index, item);
 
 	if(v == NULL)
@@ -99,7 +99,7 @@ sqlite3_stmt * __attribute__((pure)) get_sqlite3_stmt_vec(sqlite3_stmt_vec *v, u
 	}
 
 	sqlite3_stmt* item = v->items[index];
-	if(config.debug & DEBUG_VECTORS)
+	if(debug_enabled(DEBUG_VECTORS))
 		logg("Getting sqlite3_stmt** %p[%u] --> %p", v, index, item);
 
 	return item;
@@ -107,7 +107,7 @@ sqlite3_stmt * __attribute__((pure)) get_sqlite3_stmt_vec(sqlite3_stmt_vec *v, u
 
 void free_sqlite3_stmt_vec(sqlite3_stmt_vec **v)
 {
-	if(config.debug & DEBUG_VECTORS)
+	if(debug_enabled(DEBUG_VECTORS))
 		logg("Freeing sqlite3_stmt* vector %p", *v);
 
 	// This vector was never allocated, invoking free_sqlite3_stmt_vec() on a
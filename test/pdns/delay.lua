@@ -0,0 +1,15 @@
+-- Pi-hole: A black hole for Internet advertisements
+-- (c) 2023 Pi-hole, LLC (https://pi-hole.net)
+-- Network-wide ad blocking via your own hardware.
+--
+-- Pi-hole testing environment: Delay every query of the slow recursive
+-- resolver by 200 ms before it is resolved as usual
+--
+-- This file is copyright under the latest version of the EUPL.
+-- Please see LICENSE file for your rights under this license.
+
+function preresolve(dq)
+  local start = os.clock()
+  while os.clock() - start < 0.2 do end
+  return false
+end
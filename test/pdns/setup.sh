@@ -26,6 +26,9 @@ else
 fi
 
 cp test/pdns/recursor.conf $RECURSOR_CONF
+# Second, slow recursor answering 200 ms late
+cp test/pdns/recursor-delay.conf "$(dirname $RECURSOR_CONF)/recursor-delay.conf"
+cp test/pdns/delay.lua /var/lib/powerdns/delay.lua
 
 # Create zone database
 if [ -f /usr/share/doc/pdns-backend-sqlite3/schema.sqlite3.sql ]; then
@@ -58,6 +61,10 @@ pdnsutil add-record ftl. regex-REPLYv46 A 192.168.2.7
 pdnsutil add-record ftl. regex-A A 192.168.2.8
 pdnsutil add-record ftl. regex-notA A 192.168.2.9
 pdnsutil add-record ftl. any A 192.168.3.1
+pdnsutil add-record ftl. scan A 192.168.4.1
+pdnsutil add-record ftl. '*.oneshot' A 192.168.4.2
+pdnsutil add-record ftl. '*.score' A 192.168.5.1
+pdnsutil add-record ftl. '*.delay' A 192.168.5.2
 
 # Create AAAA records
 pdnsutil add-record ftl. aaaa AAAA fe80::1c01
@@ -136,6 +143,7 @@ echo "********* Done installing PowerDNS configuration **********"
 killall pdns_server
 pdns_server --daemon
 # Have to create the socketdir or the recursor will fails to start
-mkdir -p /var/run/pdns-recursor
+mkdir -p /var/run/pdns-recursor /var/run/pdns-recursor-delay
 killall pdns_recursor
 pdns_recursor --daemon
+pdns_recursor --daemon --config-name=delay
@@ -20,14 +20,14 @@ while pidof -s pihole-FTL > /dev/null; do
 done
 
 # Clean up possible old files from earlier test runs
-rm -f /etc/pihole/gravity.db /etc/pihole/pihole-FTL.db /var/log/pihole/pihole.log /var/log/pihole/FTL.log /dev/shm/FTL-*
+rm -f /etc/pihole/gravity.db /etc/pihole/pihole-FTL.db /var/log/pihole/pihole.log /var/log/pihole/pihole.bin /var/log/pihole/FTL.log /var/log/pihole/slow-queries.log /dev/shm/FTL-*
 
 # Create necessary directories and files
 mkdir -p /home/pihole /etc/pihole /run/pihole /var/log/pihole
 echo "" > /var/log/pihole/FTL.log
 echo "" > /var/log/pihole/pihole.log
-touch /run/pihole-FTL.pid dig.log ptr.log
-chown pihole:pihole /etc/pihole /run/pihole /var/log/pihole/pihole.log /var/log/pihole/FTL.log /run/pihole-FTL.pid
+touch /run/pihole-FTL.pid /var/log/pihole/pihole.bin /var/log/pihole/slow-queries.log dig.log ptr.log
+chown pihole:pihole /etc/pihole /run/pihole /var/log/pihole/pihole.log /var/log/pihole/pihole.bin /var/log/pihole/FTL.log /var/log/pihole/slow-queries.log /run/pihole-FTL.pid
 
 # Copy binary into a location the new user pihole can access
 cp ./pihole-FTL /home/pihole/pihole-FTL
@@ -96,6 +96,10 @@ if [[ $RET != 0 ]]; then
   echo -n "pihole/pihole.log: "
   curl_to_tricorder /var/log/pihole/pihole.log
   echo ""
+  echo -n "pihole/pihole.bin: "
+  ./pihole-FTL query-log /var/log/pihole/pihole.bin > pihole.bin.log
+  curl_to_tricorder ./pihole.bin.log
+  echo ""
   echo -n "pihole/FTL.log: "
   curl_to_tricorder /var/log/pihole/FTL.log
   echo ""
@@ -654,6 +654,46 @@
   [[ ${lines[2]} == "" ]]
 }
 
+@test "Dictionary-encoded rows of >getallqueries match the plain format" {
+  run bash -c 'echo ">getallqueries-domain version.ftl >quit" | nc 127.0.0.1 4711'
+  printf "%s\n" "${lines[@]}"
+  expected="$(cut -d " " -f 2-6 <<< "${lines[0]}")"
+  # The dictionary format is only available on the Unix socket
+  hex="$(echo ">getallqueries-domain version.ftl dict >quit" | nc -U /run/pihole/FTL.sock | od -An -tx1 -v | tr -d " \n")"
+  echo "${hex}"
+  # Generation (int64), index of the first entry and number of entries (uint32)
+  [[ ${hex:0:2} == "d3" && ${hex:18:2} == "ce" && ${hex:28:2} == "ce" ]]
+  first=$((16#${hex:20:8}))
+  entries=$((16#${hex:30:8}))
+  # Dictionary entries (str32)
+  pos=38
+  dict=()
+  for ((i = 0; i < entries; i++)); do
+    [[ ${hex:pos:2} == "db" ]]
+    len=$((16#${hex:pos+2:8}))
+    dict[first+i]="$(printf "%b" "$(sed 's/../\\x&/g' <<< "${hex:pos+10:2*len}")")"
+    pos=$((pos + 10 + 2*len))
+  done
+  # Number of rows (uint32) followed by the rows (bin32)
+  [[ ${hex:pos:2} == "ce" && ${hex:pos+10:2} == "c6" ]]
+  [[ $((16#${hex:pos+2:8})) -ge 1 ]]
+  row="${hex:pos+20:40}"
+  decoded="${dict[16#${row:8:8}]} ${dict[16#${row:16:8}]} ${dict[16#${row:24:8}]} $((16#${row:32:2})) $((16#${row:34:2}))"
+  echo "${decoded}"
+  [[ ${decoded} == "${expected}" ]]
+  [[ ${decoded} == "TXT version.ftl 127.0.0.1 "* ]]
+}
+
+@test "Domains starting with dict do not select the dictionary format" {
+  run bash -c "dig A dictionary.ftl @127.0.0.1"
+  hex="$(echo ">getallqueries-domain dictionary.ftl >quit" | nc -U /run/pihole/FTL.sock | od -An -tx1 -v | tr -d " \n")"
+  echo "${hex}"
+  # Plain rows start with the timestamp (int32) followed by the query type
+  # (fixstr "A") and the domain
+  [[ ${hex:0:2} == "d2" && ${hex:10:4} == "a141" ]]
+  [[ ${hex} == *"$(printf "dictionary.ftl" | od -An -tx1 -v | tr -d " \n")"* ]]
+}
+
 @test "Recent blocked shows expected content" {
   run bash -c 'echo ">recentBlocked >quit" | nc -v 127.0.0.1 4711'
   printf "%s\n" "${lines[@]}"
@@ -671,7 +711,7 @@
   [[ "${lines[@]}" == *"CREATE TABLE IF NOT EXISTS \"network\" (id INTEGER PRIMARY KEY NOT NULL, hwaddr TEXT UNIQUE NOT NULL, interface TEXT NOT NULL, firstSeen INTEGER NOT NULL, lastQuery INTEGER NOT NULL, numQueries INTEGER NOT NULL, macVendor TEXT, aliasclient_id INTEGER);"* ]]
   [[ "${lines[@]}" == *"CREATE TABLE IF NOT EXISTS \"network_addresses\" (network_id INTEGER NOT NULL, ip TEXT UNIQUE NOT NULL, lastSeen INTEGER NOT NULL DEFAULT (cast(strftime('%s', 'now') as int)), name TEXT, nameUpdated INTEGER, FOREIGN KEY(network_id) REFERENCES network(id));"* ]]
   [[ "${lines[@]}" == *"CREATE TABLE aliasclient (id INTEGER PRIMARY KEY NOT NULL, name TEXT NOT NULL, comment TEXT);"* ]]
-  [[ "${lines[@]}" == *"INSERT INTO ftl VALUES(0,12);"* ]] # Expecting FTL database version 12
+  [[ "${lines[@]}" == *"INSERT INTO ftl VALUES(0,13);"* ]] # Expecting FTL database version 13
   # vvv This has been added in version 10 vvv
   [[ "${lines[@]}" == *"CREATE VIEW queries AS SELECT id, timestamp, type, status, CASE typeof(domain) WHEN 'integer' THEN (SELECT domain FROM domain_by_id d WHERE d.id = q.domain) ELSE domain END domain,CASE typeof(client) WHEN 'integer' THEN (SELECT ip FROM client_by_id c WHERE c.id = q.client) ELSE client END client,CASE typeof(forward) WHEN 'integer' THEN (SELECT forward FROM forward_by_id f WHERE f.id = q.forward) ELSE forward END forward,CASE typeof(additional_info) WHEN 'integer' THEN (SELECT content FROM addinfo_by_id a WHERE a.id = q.additional_info) ELSE additional_info END additional_info, reply_type, reply_time, dnssec FROM query_storage q;"* ]]
   [[ "${lines[@]}" == *"CREATE TABLE domain_by_id (id INTEGER PRIMARY KEY, domain TEXT NOT NULL);"* ]]
@@ -684,6 +724,163 @@
   [[ "${lines[@]}" == *"CREATE UNIQUE INDEX addinfo_by_id_idx ON addinfo_by_id(type,content);"* ]]
 }
 
+@test "Number of stored queries is maintained in the counters table" {
+  run bash -c './pihole-FTL sqlite3 /etc/pihole/pihole-FTL.db "SELECT (SELECT value FROM counters WHERE id = 2) = (SELECT COUNT(*) FROM query_storage);"'
+  printf "%s\n" "${lines[@]}"
+  [[ ${lines[0]} == "1" ]]
+}
+
+@test "pihole-FTL.db uses WAL with checkpoints scheduled by FTL" {
+  run bash -c './pihole-FTL sqlite3 /etc/pihole/pihole-FTL.db "PRAGMA journal_mode"'
+  printf "%s\n" "${lines[@]}"
+  [[ ${lines[0]} == "wal" ]]
+  run bash -c 'echo ">dbwal >quit" | nc 127.0.0.1 4711'
+  printf "%s\n" "${lines[@]}"
+  [[ ${lines[0]} == "wal-enabled: yes" ]]
+  [[ ${lines[1]} == "wal-size: "* ]]
+  [[ ${lines[3]} == "checkpoints-passive: "* ]]
+}
+
+@test "SQL statement profiler counts runs and rows per statement" {
+  run bash -c 'echo ">dbprofile >quit" | nc 127.0.0.1 4711'
+  printf "%s\n" "${lines[@]}"
+  [[ ${lines[0]} == "---- profiling enabled, "*" statements not tracked" ]]
+  # Each run of this statement returns exactly one row
+  stmt="$(printf "%s\n" "${lines[@]}" | grep -F " SELECT count(DISTINCT domain)FROM vw_regex_whitelist;")"
+  read -r count total avg max rows sql <<< "${stmt}"
+  [[ ${count} -ge 1 ]]
+  [[ ${rows} == "${count}" ]]
+}
+
+@test "Allocation profiler aggregates live allocations per call site" {
+  run bash -c 'echo ">allocprofile >quit" | nc 127.0.0.1 4711'
+  printf "%s\n" "${lines[@]}"
+  [[ ${lines[0]} =~ ^"---- profiling enabled, "[1-9][0-9]*" bytes live, " ]]
+  # The telnet sockets are allocated once at startup and never freed
+  [[ "${lines[@]}" == *"src/api/socket.c:"*" listen_telnet"* ]]
+}
+
+@test "Upstream scoring rates the upstream servers by their response times" {
+  run bash -c 'echo ">upstream-scores >quit" | nc 127.0.0.1 4711'
+  printf "%s\n" "${lines[@]}"
+  [[ ${lines[0]} == "---- scoring enabled, probing 5%, "*" upstreams" ]]
+  # Address lookups have been answered by this server, it is healthy
+  score="$(printf "%s\n" "${lines[@]}" | awk '$1 == "127.0.0.1#5555" && $2 == "address" {print $3, $NF}')"
+  read -r samples health <<< "${score}"
+  [[ ${samples} -gt 0 ]]
+  [[ ${health} == "healthy" ]]
+}
+
+@test "Upstream scoring prefers the faster of two upstream servers" {
+  # score.ftl is served by 127.0.0.1#5555 and 127.0.0.1#5556, the latter
+  # replies 200 ms late (see dnsmasq.conf)
+  for i in $(seq 1 30); do
+    echo "q${i}.score.ftl @127.0.0.1 +short"
+  done > "${BATS_TMPDIR}/score.txt"
+  run bash -c "dig -f ${BATS_TMPDIR}/score.txt | sort | uniq -c"
+  printf "%s\n" "${lines[@]}"
+  [[ ${lines[0]} == *"30 192.168.5.1" ]]
+  run bash -c 'echo ">upstream-scores >quit" | nc 127.0.0.1 4711'
+  printf "%s\n" "${lines[@]}"
+  read -r fast_ewma fast_selected <<< "$(printf "%s\n" "${lines[@]}" | awk '$1 == "127.0.0.1#5555" && $2 == "address" {print int($4), $9}')"
+  read -r slow_ewma slow_selected <<< "$(printf "%s\n" "${lines[@]}" | awk '$1 == "127.0.0.1#5556" && $2 == "address" {print int($4), $9}')"
+  echo "fast: ${fast_ewma} ms, ${fast_selected} selected; slow: ${slow_ewma} ms, ${slow_selected} selected"
+  [[ ${fast_ewma} -lt ${slow_ewma} ]]
+  # Both servers are asked until they have a score, afterwards the slow one
+  # is only probed (every 20th query at 5%)
+  [[ ${slow_selected} -ge 3 ]]
+  [[ ${slow_selected} -le 5 ]]
+  [[ ${fast_selected} -ge 25 ]]
+}
+
+@test "TCP upstream connection pool reuses connections across TCP queries" {
+  run bash -c 'echo ">tcp-pool >quit" | nc 127.0.0.1 4711'
+  printf "%s\n" "${lines[@]}"
+  [[ ${lines[0]} == "---- pooling enabled, idle timeout 10s, "* ]]
+  before="$(printf "%s\n" "${lines[@]}" | awk '$1 == "127.0.0.1#5555" {print $5, $6}')"
+  # Each TCP query is handled by a separate TCP worker
+  run bash -c "dig A tcp-pool-1.ftl @127.0.0.1 +tcp && dig A tcp-pool-2.ftl @127.0.0.1 +tcp"
+  printf "%s\n" "${lines[@]}"
+  run bash -c 'echo ">tcp-pool >quit" | nc 127.0.0.1 4711'
+  printf "%s\n" "${lines[@]}"
+  after="$(printf "%s\n" "${lines[@]}" | awk '$1 == "127.0.0.1#5555" {print $5, $6}')"
+  echo "reused, connects before: ${before:-0 0} after: ${after}"
+  read -r reused_before connects_before <<< "${before:-0 0}"
+  read -r reused_after connects_after <<< "${after}"
+  # The second worker sends its query on the connection opened for the first
+  [[ $((reused_after - reused_before)) -ge 1 ]]
+  [[ $((connects_after - connects_before)) -le 1 ]]
+}
+
+@test "Slow query recorder records queries without reply" {
+  # slow.ftl is forwarded to a server which never replies (see dnsmasq.conf)
+  run bash -c "dig A slow.ftl @127.0.0.1 +tries=1 +time=3"
+  printf "%s\n" "${lines[@]}"
+  run bash -c 'echo ">slow-queries >quit" | nc 127.0.0.1 4711'
+  printf "%s\n" "${lines[@]}"
+  [[ ${lines[0]} == "---- recording enabled, threshold 500 ms, "*" queries" ]]
+  [[ "${lines[@]}" == *" A slow.ftl from 127.0.0.1 (ID "*", no reply"* ]]
+  run bash -c 'grep " A slow.ftl from 127.0.0.1 " /var/log/pihole/slow-queries.log'
+  printf "%s\n" "${lines[@]}"
+  [[ ${lines[0]} == *", no reply"* ]]
+}
+
+@test "Slow query recorder sees replies to duplicated and CNAME-blocked queries" {
+  # The second query is answered together with the first one, it is never
+  # forwarded on its own
+  run bash -c "dig A dup.delay.ftl @127.0.0.1 +short & dig A dup.delay.ftl @127.0.0.1 +short; wait"
+  printf "%s\n" "${lines[@]}"
+  [[ ${lines[0]} == "192.168.5.2" ]]
+  [[ ${lines[1]} == "192.168.5.2" ]]
+  # Wait until unanswered queries would have been recorded by the sweep
+  sleep 2
+  run bash -c 'echo ">slow-queries >quit" | nc 127.0.0.1 4711'
+  printf "%s\n" "${lines[@]}"
+  [[ "${lines[@]}" != *" dup.delay.ftl from "*", no reply"* ]]
+  [[ "${lines[@]}" != *" cname-1.ftl from "*", no reply"* ]]
+  [[ "${lines[@]}" != *" cname-7.ftl from "*", no reply"* ]]
+}
+
+@test "DNS cache reports segmented LRU statistics" {
+  run bash -c 'echo ">cacheinfo >quit" | nc 127.0.0.1 4711'
+  printf "%s\n" "${lines[@]}"
+  [[ "${lines[@]}" == *"probation: "* ]]
+  [[ "${lines[@]}" == *"protected: "* ]]
+  [[ "${lines[@]}" == *"bytes-limit: 49152"* ]]
+}
+
+@test "DNS cache keeps names looked up repeatedly during a burst of one-shot names" {
+  # The second lookup moves scan.ftl into the protected segment
+  run bash -c "dig scan.ftl @127.0.0.1 +short && dig scan.ftl @127.0.0.1 +short"
+  printf "%s\n" "${lines[@]}"
+  [[ ${lines[0]} == "192.168.4.1" ]]
+  [[ ${lines[1]} == "192.168.4.1" ]]
+  # Look up more one-shot names than fit into the cache: each record takes
+  # about 120 bytes, so 600 of them exceed the memory limit (cache-bytes)
+  for i in $(seq 1 600); do
+    echo "os${i}.oneshot.ftl @127.0.0.1 +short"
+  done > "${BATS_TMPDIR}/oneshot.txt"
+  run bash -c "dig -f ${BATS_TMPDIR}/oneshot.txt | sort | uniq -c"
+  printf "%s\n" "${lines[@]}"
+  [[ ${lines[0]} == *"600 192.168.4.2" ]]
+  # scan.ftl is still answered from the cache
+  run bash -c "dig scan.ftl @127.0.0.1 +short"
+  printf "%s\n" "${lines[@]}"
+  [[ ${lines[0]} == "192.168.4.1" ]]
+  run bash -c 'grep -c "forwarded scan.ftl to" /var/log/pihole/pihole.log'
+  printf "%s\n" "${lines[@]}"
+  [[ ${lines[0]} == "1" ]]
+}
+
+@test "DNS cache stays within its memory limit (cache-bytes)" {
+  run bash -c 'echo ">cacheinfo >quit" | nc 127.0.0.1 4711'
+  printf "%s\n" "${lines[@]}"
+  bytes="$(printf "%s\n" "${lines[@]}" | sed -n "s/^bytes: //p")"
+  evicted="$(printf "%s\n" "${lines[@]}" | sed -n "s/^evicted-memory: //p")"
+  [[ ${bytes} -le 49152 ]]
+  [[ ${evicted} -gt 0 ]]
+}
+
 @test "Ownership, permissions and type of pihole-FTL.db correct" {
   run bash -c 'ls -l /etc/pihole/pihole-FTL.db'
   printf "%s\n" "${lines[@]}"
@@ -703,6 +900,13 @@
   [[ ${lines[2]} == "Try '/home/pihole/pihole-FTL --help' for more information" ]]
 }
 
+@test "Binary query log renderer rejects other files" {
+  run bash -c '/home/pihole/pihole-FTL query-log /etc/hostname'
+  printf "%s\n" "${lines[@]}"
+  [[ ${lines[0]} == "/etc/hostname is not a binary query log" ]]
+  [[ $status == 1 ]]
+}
+
 @test "Help CLI argument return help text" {
   run bash -c '/home/pihole/pihole-FTL help'
   printf "%s\n" "${lines[@]}"
@@ -1465,3 +1669,78 @@
   [[ "$firstnum" == 7 ]]
   [[ "$lastnum" == 7 ]]
 }
+
+@test "API replica answers like the API of pihole-FTL" {
+  su pihole -s /bin/sh -c "/home/pihole/pihole-FTL api" > /dev/null 2>&1 &
+  # Wait until the replica is listening
+  for i in {1..50}; do
+    echo ">quit" | nc 127.0.0.1 4712 > /dev/null 2>&1 && break
+    sleep 0.1
+  done
+  for cmd in ">stats" ">top-domains (100)" ">top-clients" ">querytypes"; do
+    ftl="$(echo "${cmd} >quit" | nc 127.0.0.1 4711)"
+    replica="$(echo "${cmd} >quit" | nc 127.0.0.1 4712)"
+    printf "%s\n%s\n%s\n" "${cmd}" "${ftl}" "${replica}"
+    [[ -n "${replica}" ]]
+    [[ "${replica}" == "${ftl}" ]]
+  done
+  # Commands depending on the state of the resolver are refused
+  run bash -c 'echo ">slow-queries >quit" | nc 127.0.0.1 4712'
+  printf "%s\n" "${lines[@]}"
+  pkill -f "^/home/pihole/pihole-FTL api$"
+  [[ ${lines[0]} == ">slow-queries is not available in the API replica" ]]
+}
+
+# The following tests restart pihole-FTL, they have to be the last ones
+@test "API responses are served from the cache until the data changes" {
+  # Cache responses long enough so they cannot expire during this test
+  echo "API_CACHE_MS=60000" >> /etc/pihole/pihole-FTL.conf
+  kill "$(pidof -s pihole-FTL)"
+  while pidof pihole-FTL > /dev/null; do sleep 0.1; done
+  su pihole -s /bin/sh -c "/home/pihole/pihole-FTL"
+  for i in $(seq 1 100); do
+    dig TXT CHAOS version.bind @127.0.0.1 +short +time=1 +tries=1 > /dev/null && break
+    sleep 0.1
+  done
+  before="$(echo ">stats >quit" | nc 127.0.0.1 4711)"
+  served="$(grep -c "API: Served \">stats\" from cache" /var/log/pihole/FTL.log)"
+  # A new query does not invalidate the cached response
+  dig A cache.oneshot.ftl @127.0.0.1 +short
+  cached="$(echo ">stats >quit" | nc 127.0.0.1 4711)"
+  printf "%s\n" "${before}" "${cached}"
+  [[ "${cached}" == "${before}" ]]
+  [[ $(grep -c "API: Served \">stats\" from cache" /var/log/pihole/FTL.log) -gt ${served} ]]
+  # Reloading the privacy level invalidates all cached responses
+  echo ">reresolve >quit" | nc 127.0.0.1 4711
+  for i in $(seq 1 50); do
+    after="$(echo ">stats >quit" | nc 127.0.0.1 4711)"
+    [[ "${after}" != "${before}" ]] && break
+    sleep 0.1
+  done
+  sed -i "/^API_CACHE_MS=/d" /etc/pihole/pihole-FTL.conf
+  printf "%s\n" "${after}"
+  [[ "${after}" != "${before}" ]]
+}
+
+@test "Binary query log renderer prints the queries like the text log" {
+  kill "$(pidof -s pihole-FTL)"
+  while pidof pihole-FTL > /dev/null; do sleep 0.1; done
+  su pihole -s /bin/sh -c "/home/pihole/pihole-FTL -- --log-queries-binary=/var/log/pihole/pihole.bin"
+  for i in $(seq 1 100); do
+    dig TXT CHAOS version.bind @127.0.0.1 +short +time=1 +tries=1 > /dev/null && break
+    sleep 0.1
+  done
+  run bash -c "dig A binlog.oneshot.ftl @127.0.0.1 +short"
+  printf "%s\n" "${lines[@]}"
+  [[ ${lines[0]} == "192.168.4.2" ]]
+  # The binary query log is written at least once per second
+  for i in $(seq 1 50); do
+    /home/pihole/pihole-FTL query-log /var/log/pihole/pihole.bin | grep -q " reply binlog.oneshot.ftl is " && break
+    sleep 0.1
+  done
+  run bash -c '/home/pihole/pihole-FTL query-log /var/log/pihole/pihole.bin | grep " binlog.oneshot.ftl "'
+  printf "%s\n" "${lines[@]}"
+  [[ ${lines[0]} == *" dnsmasq["*"]: "*" 127.0.0.1/"*" query[A] binlog.oneshot.ftl from 127.0.0.1" ]]
+  [[ "${lines[@]}" == *" forwarded binlog.oneshot.ftl to 127.0.0.1#5555"* ]]
+  [[ "${lines[@]}" == *" reply binlog.oneshot.ftl is 192.168.4.2"* ]]
+}